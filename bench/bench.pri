@@ -0,0 +1,11 @@
+TEMPLATE = app
+
+CONFIG += console c++11
+CONFIG -= app_bundle
+
+QT -= gui
+
+INCLUDEPATH += $$PWD \
+               $$PWD/../include
+
+HEADERS += $$PWD/benchmark.h
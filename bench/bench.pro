@@ -0,0 +1,15 @@
+#-------------------------------------------------
+#
+# Benchmarks of the parser hot paths, built apart from the application:
+#   qmake bench/bench.pro && make && ./decoder/decoder
+#
+#-------------------------------------------------
+
+TEMPLATE = subdirs
+
+SUBDIRS += decoder \
+           merge \
+           stl \
+           simplifier \
+           hartley \
+           reconstructor
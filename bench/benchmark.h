@@ -0,0 +1,38 @@
+#ifndef BENCHMARK_H
+#define BENCHMARK_H
+
+#include <functional>
+
+#include <QtCore/QElapsedTimer>
+#include <QtCore/QDebug>
+
+// runs of every measurement, the fastest one is reported
+#define BENCHMARK_RUNS 5
+
+namespace Benchmark {
+    // seconds of the fastest of runs calls
+    inline double bestTime(const std::function<void ()> & call, const int & runs = BENCHMARK_RUNS) {
+        double best = 0.0;
+
+        QElapsedTimer timer;
+
+        for (int i = 0; i != runs; ++ i) {
+            timer.start();
+            call();
+
+            const double elapsed = timer.nsecsElapsed() / 1e9;
+
+            if (!i || elapsed < best) {
+                best = elapsed;
+            }
+        }
+
+        return best;
+    }
+
+    inline double megabytesPerSecond(const double & bytes, const double & seconds) {
+        return seconds > 0.0 ? bytes / (1024.0 * 1024.0) / seconds : 0.0;
+    }
+}
+
+#endif // BENCHMARK_H
@@ -0,0 +1,9 @@
+include(../bench.pri)
+include(../opencv.pri)
+
+TARGET = decoder
+
+SOURCES += main.cpp \
+           $$PWD/../../src/Parser/PixelDecoder.cpp
+
+HEADERS += $$PWD/../../include/Parser/PixelDecoder.h
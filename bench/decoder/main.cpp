@@ -0,0 +1,171 @@
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+#include <opencv2/core/core.hpp>
+
+#include "benchmark.h"
+
+#include "Parser/PixelDecoder.h"
+
+// a series of 1000 slices of 512 x 512
+#define DECODER_WIDTH 512
+#define DECODER_HEIGHT 512
+#define DECODER_SLICES 1000
+
+// the odd tail keeps the scalar remainders of the dispatched decoders busy, the legacy loop only decodes whole slices
+#define DECODER_COUNT ((size_t) DECODER_WIDTH * DECODER_HEIGHT * DECODER_SLICES + 7)
+
+// pixels checked against the reference at once, the series is too large to be decoded twice
+#define DECODER_CHECK_COUNT ((size_t) DECODER_WIDTH * DECODER_HEIGHT)
+
+/* per pixel loop the dispatched decoders replaced, as it was in decodeSlice: every byte is shifted into
+ * place one by one and the slice goes through cv::Mat::at; kept as it was, char sign extension included
+ */
+static void legacyDecodeSlice(const int & position, std::vector<cv::Mat> & dst, const char * buffer,
+                              const int & bytesAllocated, const bool & isLittleEndian) {
+    cv::Mat dcmToMat(cv::Mat::zeros(DECODER_WIDTH, DECODER_HEIGHT, CV_16UC1));
+
+    quint16 pixelU;
+
+    const char * posInBuffer = buffer + (size_t) DECODER_WIDTH * DECODER_HEIGHT * bytesAllocated * position;
+
+    for (int y = 0; y != DECODER_HEIGHT; ++ y) {
+        for (int x = 0; x != DECODER_WIDTH; ++ x) {
+            pixelU = 0;
+
+            if (isLittleEndian) {
+                for (int k = 0; k < bytesAllocated; ++ k) {
+                    pixelU |= (quint16)*(posInBuffer + k) << (8 * k);
+                }
+            }
+            else {
+                for (int k = bytesAllocated - 1; k > 0 ; -- k) {
+                    pixelU |= (quint16)*posInBuffer << (8 * (bytesAllocated - k + 1));
+                }
+            }
+
+            posInBuffer += bytesAllocated;
+
+            dcmToMat.at<quint16>(y, x) = pixelU;
+        }
+    }
+
+    dst.at(position) = dcmToMat;
+}
+
+static void decode8Reference(const char * src, quint16 * dst, const size_t & count) {
+    for (size_t i = 0; i != count; ++ i) {
+        dst[i] = (uchar) src[i];
+    }
+}
+
+static void decode16Reference(const char * src, quint16 * dst, const size_t & count, const bool & littleEndian) {
+    const uchar * srcU = (const uchar *) src;
+
+    for (size_t i = 0; i != count; ++ i) {
+        dst[i] = littleEndian ? (quint16) (srcU[2 * i] | (srcU[2 * i + 1] << 8))
+                              : (quint16) ((srcU[2 * i] << 8) | srcU[2 * i + 1]);
+    }
+}
+
+static const char * instructionSetName(const Parser::PixelDecoder::InstructionSet & instructionSet) {
+    switch (instructionSet) {
+        case Parser::PixelDecoder::AVX2: return "AVX2";
+        case Parser::PixelDecoder::SSE2: return "SSE2";
+        default: return "SCALAR";
+    }
+}
+
+/* times the dispatched decoder against the legacy loop, false if it disagrees with the reference;
+ * reference decodes count pixels from the offset-th one on
+ */
+static bool compare(const char * name, const int & bytesAllocated,
+                    const std::function<void (quint16 *)> & decoder,
+                    const std::function<void (std::vector<cv::Mat> &)> & legacy,
+                    const std::function<void (quint16 *, const size_t &, const size_t &)> & reference) {
+    const size_t bytes = DECODER_COUNT * bytesAllocated;
+    const size_t legacyBytes = (size_t) DECODER_WIDTH * DECODER_HEIGHT * DECODER_SLICES * bytesAllocated;
+
+    std::vector<quint16> decoded(DECODER_COUNT);
+
+    const double decoderTime = Benchmark::bestTime([&]() { decoder(decoded.data()); });
+
+    double legacyTime;
+
+    {
+        std::vector<cv::Mat> slices(DECODER_SLICES);
+
+        legacyTime = Benchmark::bestTime([&]() { legacy(slices); });
+    }
+
+    std::vector<quint16> expected(DECODER_CHECK_COUNT);
+
+    bool equal = true;
+
+    for (size_t offset = 0; offset < DECODER_COUNT && equal; offset += DECODER_CHECK_COUNT) {
+        const size_t count = std::min((size_t) DECODER_CHECK_COUNT, DECODER_COUNT - offset);
+
+        reference(expected.data(), offset, count);
+
+        equal = !memcmp(decoded.data() + offset, expected.data(), sizeof(quint16) * count);
+    }
+
+    const double megabytesPerSecond = Benchmark::megabytesPerSecond(bytes, decoderTime);
+    const double legacyMegabytesPerSecond = Benchmark::megabytesPerSecond(legacyBytes, legacyTime);
+
+    qDebug() << name << "MB/s:" << megabytesPerSecond
+             << "legacy MB/s:" << legacyMegabytesPerSecond
+             << "speedup:" << megabytesPerSecond / legacyMegabytesPerSecond
+             << (equal ? "ok" : "MISMATCH");
+
+    return equal;
+}
+
+int main() {
+    // one byte of offset, so the simd kernels see unaligned sources as in a gdcm buffer
+    std::vector<char> buffer(2 * DECODER_COUNT + 1);
+
+    srand(0);
+
+    for (char & byte : buffer) {
+        byte = (char) (rand() & 0xff);
+    }
+
+    const char * src = buffer.data() + 1;
+
+    qDebug() << "Instruction set:" << instructionSetName(Parser::PixelDecoder::instructionSet());
+
+    // the legacy loop decoded slice after slice on one thread
+    auto legacy = [&](const int & bytesAllocated, const bool & isLittleEndian) {
+        return [=](std::vector<cv::Mat> & slices) {
+            for (int position = 0; position != DECODER_SLICES; ++ position) {
+                legacyDecodeSlice(position, slices, src, bytesAllocated, isLittleEndian);
+            }
+        };
+    };
+
+    bool ok = true;
+
+    ok &= compare("decode8", 1,
+                  [&](quint16 * dst) { Parser::PixelDecoder::decode8(src, dst, DECODER_COUNT); },
+                  legacy(1, true),
+                  [&](quint16 * dst, const size_t & offset, const size_t & count) { decode8Reference(src + offset, dst, count); });
+
+    ok &= compare("decode16LE", 2,
+                  [&](quint16 * dst) { Parser::PixelDecoder::decode16LE(src, dst, DECODER_COUNT); },
+                  legacy(2, true),
+                  [&](quint16 * dst, const size_t & offset, const size_t & count) {
+                      decode16Reference(src + 2 * offset, dst, count, true);
+                  });
+
+    // the reader only reaches this on big endian hosts, here the swap kernels are exercised
+    ok &= compare("decode16BE", 2,
+                  [&](quint16 * dst) { Parser::PixelDecoder::decode16BE(src, dst, DECODER_COUNT); },
+                  legacy(2, false),
+                  [&](quint16 * dst, const size_t & offset, const size_t & count) {
+                      decode16Reference(src + 2 * offset, dst, count, false);
+                  });
+
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,10 @@
+include(../bench.pri)
+include(../opencv.pri)
+
+QT += gui quick
+
+TARGET = hartley
+
+SOURCES += main.cpp
+
+HEADERS += $$PWD/../../include/Parser/hartleyprocessing.hpp
@@ -0,0 +1,110 @@
+#include <cmath>
+#include <cstdlib>
+
+#include "benchmark.h"
+
+#include "Parser/hartleyprocessing.hpp"
+
+// rows transformed at once, the last ones don't fill the simd lanes and go through the scalar butterflies
+#define HARTLEY_ROWS 66
+
+// relative to the largest output, float butterflies against a double sum
+#define HARTLEY_TOLERANCE 1e-4
+
+// H(k) = sum of x(n) * cas(2 pi n k / length), in doubles, rows zero padded at offset the way hartleyRows does it
+static void directRows(const cv::Mat & src, cv::Mat & dst, const int & length, const int & offset) {
+    std::vector<double> cosTable(length);
+    std::vector<double> sinTable(length);
+
+    for (int i = 0; i != length; ++ i) {
+        cosTable[i] = std::cos(PI_TIMES_2 * i / length);
+        sinTable[i] = std::sin(PI_TIMES_2 * i / length);
+    }
+
+    const int width = std::min(src.cols, length - offset);
+
+    for (int row = 0; row != src.rows; ++ row) {
+        const float * srcRow = src.ptr<float>(row);
+        float * dstRow = dst.ptr<float>(row);
+
+        for (int k = 0; k != length; ++ k) {
+            double sum = 0.0;
+
+            for (int col = 0; col != width; ++ col) {
+                const int angle = (int) (((long long) (offset + col) * k) % length);
+
+                sum += srcRow[col] * (cosTable[angle] + sinTable[angle]);
+            }
+
+            dstRow[k] = (float) sum;
+        }
+    }
+}
+
+// largest difference over the largest value
+static double relativeError(const cv::Mat & a, const cv::Mat & b) {
+    double difference = 0.0;
+    double largest = 0.0;
+
+    for (int row = 0; row != a.rows; ++ row) {
+        for (int col = 0; col != a.cols; ++ col) {
+            difference = std::max(difference, (double) std::abs(a.at<float>(row, col) - b.at<float>(row, col)));
+            largest = std::max(largest, (double) std::abs(b.at<float>(row, col)));
+        }
+    }
+
+    return largest ? difference / largest : difference;
+}
+
+int main() {
+    bool ok = true;
+
+    srand(0);
+
+    // detector widths, padded the way the reconstructor pads them; 170 ends up on a power of two
+    const int widths[] = { 64, 100, 170, 256, 367, 512, 729, 1024 };
+
+    for (const int & width : widths) {
+        const int padded = (int) (width * PADDED_INCREASE);
+
+        Parser::HartleyTables tables(padded);
+
+        const int length = tables.length;
+        const int offset = (length - width) / 2;
+
+        int powerOfTwo = HARTLEY_MIN_LENGTH;
+
+        while (powerOfTwo < padded) {
+            powerOfTwo <<= 1;
+        }
+
+        cv::Mat src(HARTLEY_ROWS, width, CV_32FC1);
+
+        for (int row = 0; row != src.rows; ++ row) {
+            for (int col = 0; col != src.cols; ++ col) {
+                src.at<float>(row, col) = rand() / (float) RAND_MAX;
+            }
+        }
+
+        cv::Mat fast(HARTLEY_ROWS, length, CV_32FC1);
+        cv::Mat direct(HARTLEY_ROWS, length, CV_32FC1);
+
+        const double fastTime = Benchmark::bestTime([&]() { Parser::hartleyRows<float>(src, fast, tables, offset); });
+        const double directTime = Benchmark::bestTime([&]() { directRows(src, direct, length, offset); }, 1);
+
+        const double error = relativeError(fast, direct);
+
+        const bool accurate = error <= HARTLEY_TOLERANCE;
+
+        ok &= accurate;
+
+        qDebug() << "width:" << width << "length:" << length << "(power of two:" << powerOfTwo << ")"
+                 << "radix-3 stages:" << tables.radix3Stages
+                 << "fht rows/s:" << HARTLEY_ROWS / fastTime
+                 << "dht rows/s:" << HARTLEY_ROWS / directTime
+                 << "speedup:" << directTime / fastTime
+                 << "error:" << error << (accurate ? "ok" : "INACCURATE");
+    }
+
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
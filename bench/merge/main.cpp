@@ -0,0 +1,102 @@
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+#include "benchmark.h"
+
+#include "Parser/ctprocessing.hpp"
+
+#define MERGE_WIDTH 512
+#define MERGE_HEIGHT 512
+#define MERGE_DEPTH 192
+
+#define MERGE_MAX_THREADS 64
+
+// merges the synthetic series with threads workers, merged slices are left in merged
+static double mergeSeries(const std::vector<char> & series, const int & neighbourRadius, const int & threads,
+                          std::vector<TextureInfo::MergedData> & merged) {
+    cv::setNumThreads(threads);
+
+    QOpenGLPixelTransferOptions pixelTransferOptions;
+
+    TextureInfo::MergedDataPtr mergeLocation = nullptr;
+
+    const double elapsed = Benchmark::bestTime([&]() {
+        delete [] mergeLocation;
+
+        Parser::DicomData dicomData;
+
+        dicomData.bytesAllocated = 2;
+        dicomData.isLittleEndian = (Q_BYTE_ORDER == Q_LITTLE_ENDIAN);
+
+        dicomData.width = dicomData.rawWidth = MERGE_WIDTH;
+        dicomData.height = dicomData.rawHeight = MERGE_HEIGHT;
+        dicomData.depth = MERGE_DEPTH;
+
+        dicomData.buffer = series.data();
+        dicomData.neighbourRadius = neighbourRadius;
+        dicomData.canceled = nullptr;
+
+        dicomData.mergeLocation = &mergeLocation;
+        dicomData.pixelTransferOptions = &pixelTransferOptions;
+
+        Parser::SliceProcessing sliceProcessing(&dicomData);
+
+        cv::parallel_for_(cv::Range(0, MERGE_DEPTH), sliceProcessing);
+    });
+
+    const size_t mergedSize = sizeof(quint16) * MERGE_WIDTH * MERGE_HEIGHT * std::max(0, MERGE_DEPTH - 2 * neighbourRadius);
+
+    merged.assign(mergeLocation, mergeLocation + mergedSize);
+
+    delete [] mergeLocation;
+
+    return elapsed;
+}
+
+int main() {
+    std::vector<char> series(sizeof(quint16) * MERGE_WIDTH * MERGE_HEIGHT * MERGE_DEPTH);
+
+    srand(0);
+
+    for (size_t i = 0; i < series.size(); i += 2) {
+        // 12 bits stored, as ct scanners write them
+        const quint16 value = (quint16) (rand() & 0x0fff);
+        memcpy(&(series[i]), &value, sizeof(value));
+    }
+
+    const int defaultThreads = cv::getNumThreads();
+
+    qDebug() << "Series:" << MERGE_WIDTH << "x" << MERGE_HEIGHT << "x" << MERGE_DEPTH
+             << "cpus:" << cv::getNumberOfCPUs() << "default threads:" << defaultThreads;
+
+    bool ok = true;
+
+    const int radii[] = { 0, 1, 2, 4 };
+
+    for (const int & neighbourRadius : radii) {
+        std::vector<TextureInfo::MergedData> expected;
+        std::vector<TextureInfo::MergedData> merged;
+
+        const double singleTime = mergeSeries(series, neighbourRadius, 1, expected);
+
+        for (int threads = 1; threads <= MERGE_MAX_THREADS; threads *= 2) {
+            const double elapsed = threads == 1 ? singleTime : mergeSeries(series, neighbourRadius, threads, merged);
+
+            // every thread count has to merge the very same volume as a single thread does
+            const bool equal = threads == 1 || merged == expected;
+
+            ok &= equal;
+
+            qDebug() << "neighbourRadius:" << neighbourRadius << "threads:" << threads
+                     << "slices/s:" << MERGE_DEPTH / elapsed
+                     << "speedup:" << singleTime / elapsed
+                     << "efficiency:" << singleTime / elapsed / threads
+                     << (equal ? "ok" : "MISMATCH");
+        }
+    }
+
+    cv::setNumThreads(defaultThreads);
+
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,12 @@
+include(../bench.pri)
+include(../opencv.pri)
+
+QT += gui quick
+
+TARGET = merge
+
+SOURCES += main.cpp \
+           $$PWD/../../src/Parser/PixelDecoder.cpp
+
+HEADERS += $$PWD/../../include/Parser/ctprocessing.hpp \
+           $$PWD/../../include/Parser/PixelDecoder.h
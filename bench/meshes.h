@@ -0,0 +1,82 @@
+#ifndef MESHES_H
+#define MESHES_H
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+namespace Benchmark {
+    // triangle counts of well known public scans, meshes of the benchmarks are generated at these sizes
+    class MeshSize {
+    public:
+        const char * name;
+        size_t triangles;
+    };
+
+    static const MeshSize publicMeshSizes[] = {
+        { "bunny", 69451 },
+        { "armadillo", 345944 },
+        { "dragon", 871414 },
+        { "happy buddha", 1087716 }
+    };
+
+    /* closed bumpy sphere of about triangleCount triangles, as a soup: 9 coordinates per triangle,
+     * every inner vertex is shared by six triangles the way it is in a scanned surface
+     */
+    inline std::vector<float> bumpySphere(const size_t & triangleCount) {
+        const int segments = std::max(3, (int) std::sqrt((double) triangleCount));
+        const int rings = std::max(2, (int) (triangleCount / (2 * segments)) + 1);
+
+        const double pi = std::acos(-1.0);
+
+        std::vector<float> grid(3 * (rings + 1) * segments);
+
+        for (int ring = 0; ring <= rings; ++ ring) {
+            const double theta = pi * ring / rings;
+
+            for (int segment = 0; segment != segments; ++ segment) {
+                const double phi = 2.0 * pi * segment / segments;
+                const double radius = 1.0 + 0.1 * std::sin(5.0 * theta) * std::sin(7.0 * phi);
+
+                float * vertex = &(grid[3 * (ring * segments + segment)]);
+
+                vertex[0] = (float) (radius * std::sin(theta) * std::cos(phi));
+                vertex[1] = (float) (radius * std::sin(theta) * std::sin(phi));
+                vertex[2] = (float) (radius * std::cos(theta));
+            }
+        }
+
+        std::vector<float> triangles;
+        triangles.reserve(9 * 2 * rings * segments);
+
+        auto addTriangle = [&grid, &triangles, &segments](const int & a, const int & b, const int & c) {
+            for (int corner : { a, b, c }) {
+                triangles.insert(triangles.end(), &(grid[3 * corner]), &(grid[3 * corner]) + 3);
+            }
+        };
+
+        for (int ring = 0; ring != rings; ++ ring) {
+            for (int segment = 0; segment != segments; ++ segment) {
+                const int next = (segment + 1) % segments;
+
+                const int a = ring * segments + segment;
+                const int b = ring * segments + next;
+                const int c = (ring + 1) * segments + segment;
+                const int d = (ring + 1) * segments + next;
+
+                // poles are single points, the degenerate half of their quads is left out
+                if (ring) {
+                    addTriangle(a, c, b);
+                }
+
+                if (ring != rings - 1) {
+                    addTriangle(b, c, d);
+                }
+            }
+        }
+
+        return triangles;
+    }
+}
+
+#endif // MESHES_H
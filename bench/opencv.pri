@@ -0,0 +1,25 @@
+unix:macx {
+    INCLUDEPATH += /usr/local/include
+
+    LIBS += -L/usr/local/lib -lopencv_core \
+                            -lopencv_imgproc
+}
+
+unix:!macx {
+    LIBS += -lopencv_core \
+            -lopencv_imgproc
+}
+
+win32 {
+    INCLUDEPATH += "C:\opencv\build\include"
+
+    !contains(QMAKE_HOST.arch, x86_64) {
+        LIBS += -L"C:\opencv\build\x86\vc12\lib"
+    }
+    else {
+        LIBS += -L"C:\opencv\build\x64\vc12\lib"
+    }
+
+    LIBS += -lopencv_core249 \
+            -lopencv_imgproc249
+}
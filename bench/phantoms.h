@@ -0,0 +1,80 @@
+#ifndef PHANTOMS_H
+#define PHANTOMS_H
+
+#include <algorithm>
+#include <cmath>
+
+#include <QtCore/QVector>
+
+#include <opencv2/core/core.hpp>
+
+// one projection per degree, as the polar tables of the reconstructor expect
+#define PHANTOM_ANGLES 180
+
+namespace Benchmark {
+    // in detector widths around the center of rotation
+    class Disc {
+    public:
+        float x;
+        float y;
+
+        float radius;
+        float density;
+    };
+
+    // one off center, so that the projections differ by angle
+    static const Disc phantomDiscs[] = {
+        { 0.0f, 0.0f, 0.3125f, 1.0f },
+        { 0.125f, -0.09375f, 0.09375f, 2.0f }
+    };
+
+    /* radon transform of the discs, a chord through every detector pixel; rows get denser
+     * from the first one on, so gauss3d blurs across them as well
+     */
+    inline QVector<cv::Mat> phantomProjections(const int & width, const int & rows) {
+        QVector<cv::Mat> projections;
+
+        for (int angle = 0; angle != PHANTOM_ANGLES; ++ angle) {
+            const float theta = angle * (float) CV_PI / PHANTOM_ANGLES;
+
+            cv::Mat projection(rows, width, CV_32FC1);
+
+            for (int col = 0; col != width; ++ col) {
+                const float u = col + 0.5f - width / 2.0f;
+
+                float chords = 0.0f;
+
+                for (const Disc & disc : phantomDiscs) {
+                    const float distance = u - width * (disc.x * std::cos(theta) + disc.y * std::sin(theta));
+                    const float radius = width * disc.radius;
+                    const float squared = radius * radius - distance * distance;
+
+                    chords += squared > 0.0f ? 2.0f * disc.density * std::sqrt(squared) : 0.0f;
+                }
+
+                for (int row = 0; row != rows; ++ row) {
+                    projection.at<float>(row, col) = chords * (1.0f + 0.1f * row);
+                }
+            }
+
+            projections.push_back(projection);
+        }
+
+        return projections;
+    }
+
+    // largest difference over the largest value of expected, slices of a volume against the ones expected
+    inline double relativeError(const QVector<cv::Mat> & slices, const QVector<cv::Mat> & expected) {
+        double difference = 0.0;
+        double largest = 0.0;
+
+        for (int i = 0; i != expected.size(); ++ i) {
+            difference = std::max(difference, cv::norm(slices.at(i), expected.at(i), cv::NORM_INF));
+            largest = std::max(largest, cv::norm(expected.at(i), cv::NORM_INF));
+        }
+
+        return largest ? difference / largest : difference;
+    }
+}
+
+#endif // PHANTOMS_H
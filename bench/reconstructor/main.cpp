@@ -0,0 +1,76 @@
+#include <cstdlib>
+#include <cstring>
+
+#include "benchmark.h"
+#include "phantoms.h"
+
+#include "Parser/Reconstructor.h"
+
+#include "Info/CLInfo.h"
+
+// every run reconstructs the whole volume, native ones take seconds on the widest detector
+#define RECONSTRUCTOR_RUNS 3
+
+#define RECONSTRUCTOR_ROWS 16
+
+// relative to the largest native value, as in the reconstructor test
+#define RECONSTRUCTOR_TOLERANCE 1e-2
+
+/* local sizes come from the device profile; with --autotune they are tuned first, as the application does it,
+ * and every kernel logs its tuned and default local size with their times
+ */
+int main(int argc, char ** argv) {
+    for (int i = 1; i != argc; ++ i) {
+        if (!strcmp(argv[i], "--autotune")) {
+            CLInfo::setAutotuning(true);
+        }
+    }
+
+    bool ok = true;
+
+    const int widths[] = { 128, 256, 512 };
+
+    Parser::Reconstructor reconstructorNative;
+    // kernel times of every run are logged by the reconstructor
+    Parser::Reconstructor reconstructorOCL;
+
+    for (const int & width : widths) {
+        const QVector<cv::Mat> projections = Benchmark::phantomProjections(width, RECONSTRUCTOR_ROWS);
+
+        QVector<cv::Mat> nativeSlices;
+        QVector<cv::Mat> slices;
+
+        CLInfo::setDevice(CLInfo::NATIVE);
+
+        const double nativeTime = Benchmark::bestTime([&]() {
+            reconstructorNative.reconstructSlices(projections, nativeSlices);
+        }, RECONSTRUCTOR_RUNS);
+
+        CLInfo::setDevice(CLInfo::GPU);
+
+        bool isReconstructedOCL = true;
+
+        const double time = Benchmark::bestTime([&]() {
+            isReconstructedOCL = reconstructorOCL.reconstructSlices(projections, slices) && isReconstructedOCL;
+        }, RECONSTRUCTOR_RUNS);
+
+        if (!isReconstructedOCL) {
+            qDebug() << "width:" << width << "native s:" << nativeTime << "no OpenCL reconstruction";
+            continue;
+        }
+
+        const double error = Benchmark::relativeError(slices, nativeSlices);
+
+        const bool equal = error <= RECONSTRUCTOR_TOLERANCE;
+
+        ok &= equal;
+
+        qDebug() << "width:" << width << "rows:" << RECONSTRUCTOR_ROWS << "angles:" << PHANTOM_ANGLES
+                 << "native s:" << nativeTime
+                 << "opencl s:" << time
+                 << "speedup:" << nativeTime / time
+                 << "error:" << error << (equal ? "ok" : "MISMATCH");
+    }
+
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
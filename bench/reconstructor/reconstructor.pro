@@ -0,0 +1,51 @@
+include(../bench.pri)
+include(../opencv.pri)
+
+QT += gui quick
+
+TARGET = reconstructor
+
+SOURCES += main.cpp \
+           $$PWD/../../src/Parser/Reconstructor.cpp \
+           $$PWD/../../src/Parser/AbstractParser.cpp \
+           $$PWD/../../src/Message/AbstractMessage.cpp \
+           $$PWD/../../src/Message/SettingsMessage.cpp \
+           $$PWD/../../src/Info/CLInfo.cpp
+
+HEADERS += $$PWD/../phantoms.h \
+           $$PWD/../../include/Parser/Reconstructor.h \
+           $$PWD/../../include/Parser/AbstractParser.h \
+           $$PWD/../../include/Parser/parallelprocessing.hpp \
+           $$PWD/../../include/Message/AbstractMessage.h \
+           $$PWD/../../include/Message/SettingsMessage.h \
+           $$PWD/../../include/Info/CLInfo.h
+
+# cl/reconstructor.cl is built from the resources
+RESOURCES += $$PWD/../../resources.qrc
+
+unix:macx {
+    LIBS += -lopencv_highgui
+
+    LIBS += -framework OpenCL
+}
+
+unix:!macx {
+    LIBS += -lopencv_highgui
+
+    LIBS += -lOpenCL
+}
+
+win32 {
+    INCLUDEPATH += "C:\Program Files (x86)\AMD APP SDK\2.9-1\include"
+
+    !contains(QMAKE_HOST.arch, x86_64) {
+        LIBS += -L"C:\Program Files (x86)\AMD APP SDK\2.9-1\lib\x86"
+    }
+    else {
+        LIBS += -L"C:\Program Files (x86)\AMD APP SDK\2.9-1\lib\x86_64"
+    }
+
+    LIBS += -lopencv_highgui249
+
+    LIBS += -lOpenCL
+}
@@ -0,0 +1,84 @@
+#include <cstdlib>
+
+#include "benchmark.h"
+#include "meshes.h"
+
+#include "Parser/lodprocessing.hpp"
+
+// as many levels as StlReader builds by default
+#define SIMPLIFIER_LEVELS 3
+
+// triangle soup without stored normals, welding takes them from the geometry as it does for most files
+static ModelInfo::VerticesVN soup(const std::vector<float> & triangles) {
+    ModelInfo::VerticesVN vertices;
+    vertices.reserve((int) (triangles.size() / 3));
+
+    for (size_t i = 0; i != triangles.size() / 3; ++ i) {
+        vertices.push_back(ModelInfo::VertexVN(triangles[3 * i], triangles[3 * i + 1], triangles[3 * i + 2], 0.0f, 0.0f, 0.0f));
+    }
+
+    return vertices;
+}
+
+// every level has to reference welded vertices only and be noticeably smaller than the previous one
+static bool validLevels(const std::vector<Parser::LevelOfDetail> & levels, const ModelInfo::Indices & indices, const int & vertexCount) {
+    for (size_t i = 0; i != levels.size(); ++ i) {
+        if (levels[i].count % 3 || levels[i].first + levels[i].count > (size_t) indices.size()) {
+            return false;
+        }
+
+        if (i && levels[i].count * 10 > levels[i - 1].count * 9) {
+            return false;
+        }
+
+        for (size_t j = levels[i].first; j != levels[i].first + levels[i].count; ++ j) {
+            if (indices[(int) j] >= (GLuint) vertexCount) {
+                return false;
+            }
+        }
+    }
+
+    return true;
+}
+
+int main() {
+    qDebug() << "Threads:" << cv::getNumThreads();
+
+    bool ok = true;
+
+    for (const Benchmark::MeshSize & meshSize : Benchmark::publicMeshSizes) {
+        const ModelInfo::VerticesVN vertices = soup(Benchmark::bumpySphere(meshSize.triangles));
+
+        ModelInfo::BuffersVN buffers;
+
+        const double weldTime = Benchmark::bestTime([&]() { buffers = Parser::weldVertices(vertices, Parser::WeldSettings()); });
+
+        const ModelInfo::Indices welded = *buffers.indices;
+
+        ModelInfo::Indices indices;
+        std::vector<Parser::LevelOfDetail> levels;
+
+        const double simplifyTime = Benchmark::bestTime([&]() {
+            // levels are appended to the indices, every run starts from the welded mesh
+            indices = welded;
+            levels = Parser::buildLevelsOfDetail(*buffers.vertices, indices, SIMPLIFIER_LEVELS);
+        });
+
+        const bool valid = levels.size() > 1 && validLevels(levels, indices, buffers.vertices->size());
+
+        ok &= valid;
+
+        QDebug log = qDebug() << meshSize.name << vertices.size() / 3 << "triangles,"
+                              << vertices.size() << "->" << buffers.vertices->size() << "vertices,"
+                              << "weld s:" << weldTime << "simplify s:" << simplifyTime
+                              << "triangles/s:" << welded.size() / 3 / simplifyTime << "levels:";
+
+        for (const Parser::LevelOfDetail & level : levels) {
+            log << level.count / 3;
+        }
+
+        log << (valid ? "ok" : "INVALID");
+    }
+
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
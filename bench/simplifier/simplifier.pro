@@ -0,0 +1,14 @@
+include(../bench.pri)
+include(../opencv.pri)
+
+QT += gui
+
+TARGET = simplifier
+
+SOURCES += main.cpp \
+           $$PWD/../../src/Parser/VertexPacker.cpp \
+           $$PWD/../../src/Parser/PixelDecoder.cpp
+
+HEADERS += $$PWD/../meshes.h \
+           $$PWD/../../include/Parser/meshprocessing.hpp \
+           $$PWD/../../include/Parser/lodprocessing.hpp
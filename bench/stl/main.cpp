@@ -0,0 +1,163 @@
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include <QtCore/QFile>
+#include <QtCore/QTemporaryDir>
+
+#include "benchmark.h"
+#include "meshes.h"
+
+#include "Parser/StlReader.h"
+#include "Parser/stlprocessing.hpp"
+
+// ascii coordinates are printed with 7 significant digits, as exporters do
+#define STL_TOLERANCE 1e-5f
+
+static std::vector<char> binaryStl(const std::vector<float> & triangles) {
+    const quint32 triangleCount = (quint32) (triangles.size() / 9);
+
+    std::vector<char> stl(STL_BINARY_HEADER + STL_BINARY_TRIANGLE * triangleCount, 0);
+
+    memcpy(&(stl[80]), &triangleCount, sizeof(triangleCount));
+
+    for (quint32 t = 0; t != triangleCount; ++ t) {
+        // normals are left zero, the reader takes them as they are
+        memcpy(&(stl[STL_BINARY_HEADER + STL_BINARY_TRIANGLE * t + 12]), &(triangles[9 * t]), 9 * sizeof(float));
+    }
+
+    return stl;
+}
+
+static std::string asciiStl(const std::vector<float> & triangles) {
+    std::string stl("solid bench\n");
+
+    char line[128];
+
+    for (size_t t = 0; t != triangles.size() / 9; ++ t) {
+        stl += "  facet normal 0.000000e+00 0.000000e+00 0.000000e+00\n    outer loop\n";
+
+        for (int v = 0; v != 3; ++ v) {
+            const float * vertex = &(triangles[9 * t + 3 * v]);
+
+            snprintf(line, sizeof(line), "      vertex %.6e %.6e %.6e\n", vertex[0], vertex[1], vertex[2]);
+            stl += line;
+        }
+
+        stl += "    endloop\n  endfacet\n";
+    }
+
+    stl += "endsolid bench\n";
+
+    return stl;
+}
+
+// copied out of the mapping of the file, the most any parser reading all of it can do
+static void copyMapped(const QString & fileName, std::vector<char> & copy) {
+    QFile file(fileName);
+
+    if (!file.open(QIODevice::ReadOnly)) {
+        return;
+    }
+
+    const qint64 fileSize = file.size();
+
+    copy.resize(fileSize);
+
+    uchar * mapped = file.map(0, fileSize);
+
+    if (mapped) {
+        memcpy(copy.data(), mapped, fileSize);
+        file.unmap(mapped);
+    }
+}
+
+static bool writeFile(const QString & fileName, const char * data, const size_t & size) {
+    QFile file(fileName);
+
+    return file.open(QIODevice::WriteOnly) && file.write(data, size) == (qint64) size;
+}
+
+// mapped and parsed by StlReader the way loads do it, welding and the rest of the load are left out
+static double parseTime(Parser::StlReader & reader, const QString & fileName, ModelInfo::VerticesVN & vertices) {
+    return Benchmark::bestTime([&]() {
+        ModelInfo::VerticesVNPtr read = reader.readVertices(fileName);
+
+        vertices = read ? *read : ModelInfo::VerticesVN();
+
+        delete read;
+    });
+}
+
+static bool sameVertices(const ModelInfo::VerticesVN & a, const ModelInfo::VerticesVN & b) {
+    if (a.isEmpty() || a.size() != b.size()) {
+        return false;
+    }
+
+    for (int i = 0; i != a.size(); ++ i) {
+        if (std::abs(a[i].x - b[i].x) > STL_TOLERANCE ||
+            std::abs(a[i].y - b[i].y) > STL_TOLERANCE ||
+            std::abs(a[i].z - b[i].z) > STL_TOLERANCE) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+int main() {
+    qDebug() << "Threads:" << cv::getNumThreads();
+
+    QTemporaryDir dir;
+
+    if (!dir.isValid()) {
+        qDebug() << "No temporary directory for the meshes";
+        return EXIT_FAILURE;
+    }
+
+    const QString binaryFileName = dir.path() + "/binary.stl";
+    const QString asciiFileName = dir.path() + "/ascii.stl";
+
+    Parser::StlReader reader;
+
+    bool ok = true;
+
+    for (const Benchmark::MeshSize & meshSize : Benchmark::publicMeshSizes) {
+        const std::vector<float> triangles = Benchmark::bumpySphere(meshSize.triangles);
+
+        const std::vector<char> binary = binaryStl(triangles);
+        const std::string ascii = asciiStl(triangles);
+
+        if (!writeFile(binaryFileName, binary.data(), binary.size()) || !writeFile(asciiFileName, ascii.data(), ascii.size())) {
+            qDebug() << "Writing the meshes failed";
+            return EXIT_FAILURE;
+        }
+
+        std::vector<char> copy;
+
+        // both the copies and the parsers read the files from the page cache
+        const double binaryCopyTime = Benchmark::bestTime([&]() { copyMapped(binaryFileName, copy); });
+        const double asciiCopyTime = Benchmark::bestTime([&]() { copyMapped(asciiFileName, copy); });
+
+        ModelInfo::VerticesVN binaryVertices;
+        ModelInfo::VerticesVN asciiVertices;
+
+        const double binaryTime = parseTime(reader, binaryFileName, binaryVertices);
+        const double asciiTime = parseTime(reader, asciiFileName, asciiVertices);
+
+        // both readers normalize into the same box, so they have to agree up to the printed precision
+        const bool equal = binaryVertices.size() == (int) triangles.size() / 3 && sameVertices(binaryVertices, asciiVertices);
+
+        ok &= equal;
+
+        qDebug() << meshSize.name << triangles.size() / 9 << "triangles,"
+                 << "binary MB/s:" << Benchmark::megabytesPerSecond(binary.size(), binaryTime)
+                 << "of memcpy:" << binaryCopyTime / binaryTime
+                 << "ascii MB/s:" << Benchmark::megabytesPerSecond(ascii.size(), asciiTime)
+                 << "of memcpy:" << asciiCopyTime / asciiTime
+                 << "memcpy MB/s:" << Benchmark::megabytesPerSecond(binary.size(), binaryCopyTime)
+                 << (equal ? "ok" : "MISMATCH");
+    }
+
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,20 @@
+include(../bench.pri)
+include(../opencv.pri)
+
+QT += gui quick
+
+TARGET = stl
+
+SOURCES += main.cpp \
+           $$PWD/../../src/Parser/StlReader.cpp \
+           $$PWD/../../src/Parser/AbstractParser.cpp \
+           $$PWD/../../src/Parser/VertexPacker.cpp \
+           $$PWD/../../src/Parser/PixelDecoder.cpp \
+           $$PWD/../../src/Model/TriangleBvh.cpp \
+           $$PWD/../../src/Message/AbstractMessage.cpp \
+           $$PWD/../../src/Message/SettingsMessage.cpp
+
+HEADERS += $$PWD/../meshes.h \
+           $$PWD/../../include/Parser/StlReader.h \
+           $$PWD/../../include/Parser/AbstractParser.h \
+           $$PWD/../../include/Parser/stlprocessing.hpp
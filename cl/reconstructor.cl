@@ -2,89 +2,263 @@
 
 __constant sampler_t sampler = CLK_NORMALIZED_COORDS_FALSE | CLK_ADDRESS_CLAMP_TO_EDGE | CLK_FILTER_NEAREST;
 
-float calcElem(image3d_t src,
-               __global float * cas,
-               float4 pos,
-               int offset,
-               float coeff);
-
 int reflect(int maxDir,
             int curP);
 
-float calcElem(image3d_t src,
-               __global float * cas,
-               float4 pos,
-               int offset,
-               float coeff) {
-    int width = get_image_width(src);
-    
-    int casPos = (int) round(pos.x * width + offset);
-    float i = 0.0f;
-    
-    float elem = 0.0f;
-    
-    while (i < width) {
-        elem += (read_imagef(src, sampler, (float4) (i, pos.y, pos.z, 0.0f)).x *
-                 cas[casPos ++]);
-        i += 1.0f;
+void fhtLoadRow(image3d_t src,
+                __local float * row,
+                __global const int * reordered,
+                int width,
+                int length,
+                int offset,
+                int y,
+                int z);
+
+void fhtButterflies(__local float * row,
+                    __global const float * cosTable,
+                    __global const float * sinTable,
+                    int length);
+
+// row of src goes zero padded to length at offset, in digit reversed order
+void fhtLoadRow(image3d_t src,
+                __local float * row,
+                __global const int * reordered,
+                int width,
+                int length,
+                int offset,
+                int y,
+                int z) {
+    for (int i = get_local_id(0); i < length; i += get_local_size(0)) {
+        const int col = i - offset;
+
+        row[reordered[i]] = (col >= 0 && col < width) ?
+                    read_imagef(src, sampler, (int4) (col, y, z, 0)).x : 0.0f;
     }
 
-    return elem * coeff;
+    barrier(CLK_LOCAL_MEM_FENCE);
 }
 
+/* mixed radix fast hartley transform (Bracewell) of one row per work-group, length is 2^a * 3^b:
+ * radix-2 stages on the power of two blocks, then radix-3 ones, work-items share the butterflies of every stage
+ */
+void fhtButterflies(__local float * row,
+                    __global const float * cosTable,
+                    __global const float * sinTable,
+                    int length) {
+    const int id = get_local_id(0);
+    const int size = get_local_size(0);
+
+    // 3^b is odd, so the lowest bit set is the power of two part
+    const int radix2Length = length & - length;
+
+    for (int i = 2 * id; i < length; i += 2 * size) {
+        const float a = row[i];
+
+        row[i] = a + row[i + 1];
+        row[i + 1] = a - row[i + 1];
+    }
+
+    barrier(CLK_LOCAL_MEM_FENCE);
+
+    for (int half = 2, blocks = length / 4; half < radix2Length; half *= 2, blocks /= 2) {
+        const int quarter = half / 2;
+
+        for (int q = id; q < length / 4; q += size) {
+            __local float * first = row + (q / quarter) * 2 * half;
+            __local float * second = first + half;
+
+            const int k = q % quarter;
+
+            if (k) {
+                const float c = cosTable[k * blocks];
+                const float s = sinTable[k * blocks];
+
+                const float t1 = second[k] * c + second[half - k] * s;
+                const float t2 = second[half - k] * c - second[k] * s;
+
+                const float a = first[k];
+                const float b = first[half - k];
+
+                first[k] = a + t1;
+                second[k] = a - t1;
+
+                first[half - k] = b - t2;
+                second[half - k] = b + t2;
+            }
+            else {
+                float a = first[0];
+
+                first[0] = a + second[0];
+                second[0] = a - second[0];
+
+                a = first[quarter];
+
+                first[quarter] = a + second[quarter];
+                second[quarter] = a - second[quarter];
+            }
+        }
+
+        barrier(CLK_LOCAL_MEM_FENCE);
+    }
+
+    // same as hartleyButterflies on the host: k-th and (third - k)-th points of the thirds give those of the result
+    for (int third = radix2Length; third < length; third *= 3) {
+        const int stride = length / (3 * third);
+        const int pairs = third / 2 + 1;
+
+        for (int p = id; p < stride * pairs; p += size) {
+            __local float * first = row + (p / pairs) * 3 * third;
+
+            const int k = p % pairs;
+            const int j = (third - k) % third;
+
+            const float a0 = first[k];
+            const float a1 = first[third + k];
+            const float a2 = first[2 * third + k];
+
+            const float b0 = first[j];
+            const float b1 = first[third + j];
+            const float b2 = first[2 * third + j];
+
+            for (int q = 0; q != 3; ++ q) {
+                const int kq = k + q * third;
+                const int t1 = (kq * stride) % length;
+                const int t2 = (2 * kq * stride) % length;
+
+                first[kq] = a0 + a1 * cosTable[t1] + b1 * sinTable[t1] + a2 * cosTable[t2] + b2 * sinTable[t2];
+            }
+
+            if (j != k) {
+                for (int q = 0; q != 3; ++ q) {
+                    const int jq = j + q * third;
+                    const int t1 = (jq * stride) % length;
+                    const int t2 = (2 * jq * stride) % length;
+
+                    first[jq] = b0 + b1 * cosTable[t1] + a1 * sinTable[t1] + b2 * cosTable[t2] + a2 * sinTable[t2];
+                }
+            }
+        }
+
+        barrier(CLK_LOCAL_MEM_FENCE);
+    }
+}
+
+// mirrors curP back into [0, maxDir) without repeating the edge
 int reflect(int maxDir,
             int curP) {
-    float k1 = 1 - step((float) curP, 0.0f);
-    float k2 = step((float) curP, (float) maxDir);
+    if (curP < 0) {
+        return min(- curP, maxDir - 1);
+    }
+
+    if (curP >= maxDir) {
+        return max(2 * maxDir - curP - 2, 0);
+    }
 
-    return int(round(2 * maxDir * k2 - (k1 + k2) * curP + (1 - k1) * (1 - k2) * curP - k1 - k2));
+    return curP;
 }
 
-__kernel void gauss1d(__read_only image3d_t src,
+/* all three gauss passes at once: the work-group's block and radius voxels around it are read
+ * into tile, blurred along x into pass, along y back into tile and along z into dst;
+ * tile and pass hold (size + 2 * radius) floats along every axis of the work-group
+ */
+__kernel void gauss3d(__read_only image3d_t src,
                       __write_only image3d_t dst,
                       __constant float * gaussTab,
-                      uint dirX,
-                      uint dirY,
-                      uint dirZ,
-                      int kernGaussSize) {
+                      __local float * tile,
+                      __local float * pass,
+                      int radius) {
+    const int4 size = {get_image_width(src), get_image_height(src), get_image_depth(src), 0};
+    const int4 group = {get_local_size(0), get_local_size(1), get_local_size(2), 0};
+
+    const int4 tileSize = group + (int4) (2 * radius, 2 * radius, 2 * radius, 0);
+    const int4 origin = {get_group_id(0) * group.x - radius,
+                         get_group_id(1) * group.y - radius,
+                         get_group_id(2) * group.z - radius,
+                         0};
+
+    const int id = (get_local_id(2) * group.y + get_local_id(1)) * group.x + get_local_id(0);
+    const int groupSize = group.x * group.y * group.z;
+
+    const int planeSize = tileSize.x * tileSize.y;
+
+    for (int i = id; i < planeSize * tileSize.z; i += groupSize) {
+        const int x = i % tileSize.x;
+        const int y = (i / tileSize.x) % tileSize.y;
+        const int z = i / planeSize;
+
+        tile[i] = read_imagef(src, sampler, (int4) (reflect(size.x, origin.x + x),
+                                                    reflect(size.y, origin.y + y),
+                                                    reflect(size.z, origin.z + z),
+                                                    0)).x;
+    }
+
+    barrier(CLK_LOCAL_MEM_FENCE);
+
+    // every row of the tile, only the columns of the block are needed from here on
+    for (int i = id; i < group.x * tileSize.y * tileSize.z; i += groupSize) {
+        const int pos = (i / group.x) * tileSize.x + i % group.x + radius;
+
+        float sum = 0.0f;
+
+        for (int k = - radius; k <= radius; ++ k) {
+            sum += gaussTab[radius + k] * tile[pos + k];
+        }
+
+        pass[pos] = sum;
+    }
+
+    barrier(CLK_LOCAL_MEM_FENCE);
+
+    for (int i = id; i < group.x * group.y * tileSize.z; i += groupSize) {
+        const int x = i % group.x + radius;
+        const int y = (i / group.x) % group.y + radius;
+        const int z = i / (group.x * group.y);
+
+        const int pos = (z * tileSize.y + y) * tileSize.x + x;
+
+        float sum = 0.0f;
+
+        for (int k = - radius; k <= radius; ++ k) {
+            sum += gaussTab[radius + k] * pass[pos + k * tileSize.x];
+        }
+
+        tile[pos] = sum;
+    }
+
+    barrier(CLK_LOCAL_MEM_FENCE);
+
     const int4 pos = {get_global_id(0), get_global_id(1), get_global_id(2), 0};
-    
-    float sum = 0.0f;
-    int4 posR = (int4) (0);
 
-    __local int w;
-    __local int h;
-    __local int d;
+    // global sizes are padded up to the local ones
+    if (pos.x >= size.x || pos.y >= size.y || pos.z >= size.z) {
+        return;
+    }
 
-    w = get_image_width(src);
-    h = get_image_height(src);
-    d = get_image_depth(src);
-    
-    for (int i = - kernGaussSize + 1; i != kernGaussSize; ++ i) {
-        posR.x = reflect(w, pos.x + dirX * i);
-        posR.y = reflect(h, pos.y + dirY * i);
-        posR.z = reflect(d, pos.z + dirZ * i);
-        
-        sum += (gaussTab[kernGaussSize + i] * read_imagef(src, sampler, posR).x);
+    const int posT = ((get_local_id(2) + radius) * tileSize.y + get_local_id(1) + radius) * tileSize.x + get_local_id(0) + radius;
+
+    float sum = 0.0f;
+
+    for (int k = - radius; k <= radius; ++ k) {
+        sum += gaussTab[radius + k] * tile[posT + k * planeSize];
     }
 
     write_imagef(dst, pos, (float4) (sum));
 }
 
-__kernel void calcTables(__global float * cas,
-                         __global float * tanTable,
+__kernel void calcTables(__global float * tanTable,
                          __global float * radTable,
                          int width,
-                         int height,
-                         float twoPiN) {
+                         int height) {
     const int2 pos = {get_global_id(0), get_global_id(1)};
+
+    if (pos.x >= width || pos.y >= height) {
+        return;
+    }
+
     const float2 origin = {pos.x - width / 2.0f, pos.y - height / 2.0f};
 
     const int posT = pos.y * width + pos.x;
 
-    const float xyPiN = pos.x * pos.y * twoPiN;
-    cas[posT] = sin(xyPiN) + cos(xyPiN);
-    
     tanTable[posT] = - atan2pi(origin.y, origin.x) * 180.0f;
     radTable[posT] = sqrt(origin.y * origin.y + origin.x * origin.x);
 
@@ -95,9 +269,37 @@ __kernel void calcTables(__global float * cas,
     tanTable[posT] = min(tanTable[posT] + k180, tanTable[posT] * k + k180);
 }
 
+/* every sinogram row from firstRow on, centered in length, work-groups are (1, rows, angles),
+ * rows of src above firstRow and below the last one are the gauss halo of the slab
+ */
+__kernel void fhtSinogram(__read_only image3d_t src,
+                          __global float * dst,
+                          __global const float * cosTable,
+                          __global const float * sinTable,
+                          __local float * row,
+                          int length,
+                          __global const int * reordered,
+                          int firstRow) {
+    const int y = get_group_id(1);
+    const int z = get_group_id(2);
+
+    const int width = get_image_width(src);
+    const int rows = get_num_groups(1);
+
+    fhtLoadRow(src, row, reordered, width, length, (length - width) / 2, firstRow + y, z);
+
+    fhtButterflies(row, cosTable, sinTable, length);
+
+    __global float * dstRow = dst + (z * rows + y) * length;
+
+    for (int i = get_local_id(0); i < length; i += get_local_size(0)) {
+        dstRow[i] = row[i];
+    }
+}
+
 __kernel void fourier2d(__read_only image3d_t src,
                         __write_only image3d_t dst,
-                        __global float * cas,
+                        __global const float * hartley,
                         __global float * tanTable,
                         __global float * radTable) {
     const int4 pos = {get_global_id(0), get_global_id(1), get_global_id(2), 0};
@@ -110,16 +312,24 @@ __kernel void fourier2d(__read_only image3d_t src,
 
     const float2 pad = {size.x / (float) size.z, size.y / (float) size.w};
 
+    const int rows = get_image_depth(dst);
+
+    if (pos.x >= size.z || pos.y >= size.w || pos.z >= rows) {
+        return;
+    }
+
     const int posT = pos.y * size.z + pos.x;
 
     float4 srcPos = {radTable[posT], pos.z, tanTable[posT], 0.0f};
     
     const float sinoX = (center.z + srcPos.x) * pad.x;
     srcPos.x = round(sinoX + (srcPos.x < 0 ? 1 : -1) * center.x);
-        
-    const float dhtValue = calcElem(src, cas, srcPos, (int) center.z - center.x, 1.0f);
-    
-    barrier(CLK_LOCAL_MEM_FENCE);
+
+    // sampled the way the nearest, clamped sampler reads the sinogram
+    const int frequency = clamp((int) srcPos.x, 0, size.z - 1);
+    const int angle = clamp((int) floor(srcPos.z), 0, size.y - 1);
+
+    const float dhtValue = hartley[(angle * rows + pos.z) * size.z + frequency];
     
     write_imagef(dst,
                  (int4) (pos.x + (pos.x < center.z ? 1 : -1) * center.z,
@@ -129,16 +339,26 @@ __kernel void fourier2d(__read_only image3d_t src,
                  (float4) (( ((int) round(sinoX) % 2 ? -1 : 1) * dhtValue)));
 }
 
+// work-groups are (1, rows, slices), rows of src become columns of dst
 __kernel void dht1dTranspose(__read_only image3d_t src,
                              __write_only image3d_t dst,
-                             __global float * cas,
+                             __global const float * cosTable,
+                             __global const float * sinTable,
+                             __local float * row,
+                             __global const int * reordered,
                              float coeff) {
-    const int4 pos = {get_global_id(0), get_global_id(1), get_global_id(2), 0};
-    const float4 dhtValue = (float4) (calcElem(src, cas, convert_float4(pos), 0, coeff));
-    
-    barrier(CLK_LOCAL_MEM_FENCE);
-    
-    write_imagef(dst, (int4) (pos.y, pos.x, pos.z, 0), dhtValue);
+    const int y = get_group_id(1);
+    const int z = get_group_id(2);
+
+    const int length = get_image_width(src);
+
+    fhtLoadRow(src, row, reordered, length, length, 0, y, z);
+
+    fhtButterflies(row, cosTable, sinTable, length);
+
+    for (int i = get_local_id(0); i < length; i += get_local_size(0)) {
+        write_imagef(dst, (int4) (y, i, z, 0), (float4) (row[i] * coeff));
+    }
 }
 
 __kernel void butterflyDht2d(__read_only image3d_t src,
@@ -151,6 +371,10 @@ __kernel void butterflyDht2d(__read_only image3d_t src,
     const int4 center = {size.x / 2, size.y / 2,
                          size.z / 2, size.w / 2};
 
+    if (pos.x > center.x || pos.y > center.y || pos.z >= get_image_depth(dst)) {
+        return;
+    }
+
     int4 positions = {pos.x, pos.y, (size.x - pos.x) % size.x, (size.y - pos.y) % size.y};
 
     const float4 readPixels = {
@@ -170,11 +394,9 @@ __kernel void butterflyDht2d(__read_only image3d_t src,
 
     positions.xz -= (center.x - center.z);
     positions.yw -= (center.y - center.w);
- 
-    barrier(CLK_LOCAL_MEM_FENCE);
     
-    write_imagef(dst, (int4) (positions.x, positions.y, pos.z, 0), (readPixels.x - E));
-    write_imagef(dst, (int4) (positions.x, positions.w, pos.z, 0), (readPixels.y + E));
-    write_imagef(dst, (int4) (positions.z, positions.y, pos.z, 0), (readPixels.z + E));
-    write_imagef(dst, (int4) (positions.z, positions.w, pos.z, 0), (readPixels.w - E));
+    write_imagef(dst, (int4) (positions.x, positions.y, pos.z, 0), (float4) (readPixels.x - E));
+    write_imagef(dst, (int4) (positions.x, positions.w, pos.z, 0), (float4) (readPixels.y + E));
+    write_imagef(dst, (int4) (positions.z, positions.y, pos.z, 0), (float4) (readPixels.z + E));
+    write_imagef(dst, (int4) (positions.z, positions.w, pos.z, 0), (float4) (readPixels.w - E));
 }
@@ -95,6 +95,10 @@ namespace Camera {
 
         static bool unproject(const PointsInfo::Position3D & projection, const Matrix & mvp, PointsInfo::Position3D & unprojectedPoint);
 
+        // ray through a point of the viewport ([0, 1] on both axes), from the near plane to the far one: direction spans the frustum
+        static bool unprojectRay(const PointsInfo::Position2D & projection, const Matrix & mvp,
+                                 PointsInfo::Position3D & origin, PointsInfo::Position3D & direction);
+
         void zoom(const ZoomFactor & zoomFactor, const AspectRatio & ratio);
         
         void setEye(const Eye & eye);
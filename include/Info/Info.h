@@ -10,6 +10,7 @@
 #include <QtQuick/QQuickItem>
 
 namespace PointsInfo {
+    using Position2D = QPointF;
     using Position3D = QVector3D;
     using Position4D = QVector4D;
 }
@@ -2,6 +2,7 @@
 #define CLINFO_H
 
 #include <QtCore/QString>
+#include <QtCore/QJsonObject>
 
 #ifdef __APPLE__
     #include <OpenCL/opencl.h>
@@ -17,8 +18,6 @@
 #define WORK_GROUP_WIDTH 8
 #define WORK_GROUP_HEIGHT 8
 #define WORK_GROUP_DEPTH 8
-
-#define PADDED_INCREASE 1.0f
 #endif
 
 #ifdef AMD_BARTS
@@ -27,11 +26,29 @@
 #define WORK_GROUP_DEPTH 4
 
 #define CL_CONTEXT_OFFLINE_DEVICES_AMD 0x403F
-
-#define PADDED_INCREASE 1.5f
 #endif
 
 namespace CLInfo {
+    enum Device {
+        GPU = 0,
+        CPU = 1,
+        NATIVE = 2
+    };
+
+    // device the reconstruction runs on, set once from the command line, gpu by default
+    Device device();
+    void setDevice(const Device & device);
+
+    // "gpu", "cpu" (e.g. pocl) or "native" (plain c++), anything else is gpu
+    Device deviceFromName(const QString & name);
+
+    cl_device_type deviceType(const Device & device);
+
+    // bytes the reconstruction may hold at once, 0 leaves it to the device
+    size_t memoryBudget();
+    void setMemoryBudget(const size_t & bytes);
+
+    // first platform with a device of device_type is used, nullptr and CL_DEVICE_NOT_FOUND if there's none
     cl_context createContext(cl_device_type device_type,
                              cl_uint num_devices,
                              cl_device_id * device_id,
@@ -40,7 +57,27 @@ namespace CLInfo {
                              cl_int * errcode_ret,
                              const bool & graphicsShared = true);
 
+    // benchmark work-group sizes instead of taking them from the device profile
+    bool isAutotuning();
+    void setAutotuning(const bool & autotuning);
+
+    // small json of parameters tuned for device, empty if it wasn't tuned yet
+    QJsonObject loadDeviceProfile(cl_device_id device, const QString & name);
+    bool storeDeviceProfile(cl_device_id device, const QString & name, const QJsonObject & profile);
+
+    // options every program is built with, e.g. from the command line
+    QString buildOptions();
+    void setBuildOptions(const QString & options);
+
     cl_program createProgram(cl_context context, const QString & source);
+
+    /* source built for device, loaded from the binary cache when it was built the same way before,
+     * nullptr if it doesn't build, the build log goes to log either way
+     */
+    cl_program buildProgram(cl_context context, cl_device_id device, const QString & source,
+                            const QString & options = buildOptions(), QString * log = nullptr);
+
+    QString buildLog(cl_program program, cl_device_id device);
 }
 
 #endif // CLINFO_H
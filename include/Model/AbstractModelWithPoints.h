@@ -5,6 +5,7 @@
 
 #include "Model/AbstractModel.h"
 #include "Model/PointsModel.h"
+#include "Model/TriangleBvh.h"
 
 #include "Info/PointsInfo.h"
 #include "Info/ViewRangeInfo.h"
@@ -13,6 +14,12 @@ namespace Model {
     class AbstractModelWithPoints : public AbstractModel {
         Q_OBJECT
 
+    public:
+        /* nearest hit of origin + t * direction (model coordinates) with triangles left by the view range,
+         * no gl involved; false for models without triangles on the cpu side
+         */
+        bool castRay(const PointsInfo::Position3D & origin, const PointsInfo::Position3D & direction, PointsInfo::Position3D & hit) const;
+
     protected:
         explicit AbstractModelWithPoints(Scene::AbstractScene * scene,
                                 const ShaderInfo::ShaderFiles & shaderFiles = ShaderInfo::ShaderFiles(),
@@ -45,8 +52,19 @@ namespace Model {
 
         QOpenGLTexture * _pointsTexture;
 
+        // triangles of models that sent them, points are placed on them without reading gl buffers back
+        ModelInfo::TriangleBvhPointer _bvh;
+
         virtual void updatePointsTexture(QOpenGLShaderProgram * program) final;
 
+        // castRay without locking the model
+        bool intersect(const PointsInfo::Position3D & origin, const PointsInfo::Position3D & direction, PointsInfo::Position3D & hit) const;
+
+        // casts the ray under the point through the model, picked is the nearest hit
+        bool pickPoint(const PointsInfo::ModelPoint * modelPoint, const Viewport::Viewport * viewport, PointsInfo::Position3D & picked) const;
+
+        void positionCalculated(PointsInfo::ModelPoint * modelPoint, const PointsInfo::Position3D & position);
+
     public slots:
         virtual void addPoint(const PointsInfo::PointID & id, PointsInfo::ModelPoint * point) final;
         virtual void setPoint(const PointsInfo::PointID & id, const PointsInfo::Position3D & position, Viewport::Viewport * viewport) final;
@@ -2,7 +2,10 @@
 #define STLMODEL_H
 
 #include "Model/AbstractModelWithPoints.h"
-#include "Model/VertexVN.h"
+#include "Model/VertexVNPacked.h"
+
+// coarsest level with at most this many triangles per pixel of the projected model is drawn
+#define LOD_TRIANGLES_PER_PIXEL 0.5
 
 namespace Model {
     class StlModel : public AbstractModelWithPoints {
@@ -27,6 +30,27 @@ namespace Model {
     protected:
         virtual void bindUniformValues(QOpenGLShaderProgram * program, const Viewport::Viewport * viewport) const;
         virtual void bindAttributeArrays(QOpenGLShaderProgram * program) const;
+
+        virtual void drawingRoutine() const;
+
+    private:
+        // ranges of the index buffer, finest first
+        QVector<QPair<GLsizei, GLsizei> > _lods;
+
+        // of the sphere around normalized vertices
+        GLfloat _radius;
+
+        // one level coarser while the model is being dragged around
+        bool _coarseWhileRotating;
+        bool _rotating;
+
+        // picked per viewport right before it's drawn
+        mutable int _currentLod;
+
+        int lodFor(const Viewport::Viewport * viewport) const;
+
+    public slots:
+        virtual void invoke(const QString & name, const ModelInfo::Params & params = ModelInfo::Params());
     };
 }
 #endif // STLMODEL_H
@@ -0,0 +1,70 @@
+#ifndef TRIANGLEBVH_H
+#define TRIANGLEBVH_H
+
+#include "Info/ModelInfo.h"
+
+// deep enough for any tree the sah builder makes out of 2^32 triangles
+#define BVH_STACK_SIZE 64
+
+namespace ModelInfo {
+    // inner nodes keep their children next to each other: first and first + 1
+    class BvhNode {
+    public:
+        VertexV minV;
+        VertexV maxV;
+
+        GLuint first;
+        // of triangles in a leaf, 0 for inner nodes
+        GLuint count;
+
+        BvhNode() :
+            first(0),
+            count(0) {
+        }
+    };
+
+    // edges are precomputed for the ray test
+    class BvhTriangle {
+    public:
+        VertexV v0;
+        VertexV e1;
+        VertexV e2;
+
+        BvhTriangle() { }
+        BvhTriangle(const VertexV & v0, const VertexV & v1, const VertexV & v2) :
+            v0(v0),
+            e1(v1.x - v0.x, v1.y - v0.y, v1.z - v0.z),
+            e2(v2.x - v0.x, v2.y - v0.y, v2.z - v0.z) {
+        }
+    };
+
+    using BvhNodes = QVector<BvhNode>;
+    using BvhTriangles = QVector<BvhTriangle>;
+
+    // triangles of the finest level in model coordinates, leaves own contiguous runs of them
+    class TriangleBvh {
+    public:
+        BvhNodes nodes;
+        BvhTriangles triangles;
+
+        /* nearest hit of origin + t * direction with t >= 0,
+         * thread safe, no gl involved
+         */
+        bool intersect(const QVector3D & origin, const QVector3D & direction, GLfloat & t) const;
+
+        // same, hits outside of the box [minV, maxV] don't count, the ray goes on through them
+        bool intersect(const QVector3D & origin, const QVector3D & direction, const VertexV & minV, const VertexV & maxV,
+                       GLfloat & t) const;
+
+    private:
+        // nearest hit with t in [tMin, tMax]
+        bool intersect(const QVector3D & origin, const QVector3D & direction, const GLfloat & tMin, const GLfloat & tMax,
+                       GLfloat & t) const;
+    };
+
+    using TriangleBvhPointer = QSharedPointer<TriangleBvh>;
+}
+
+Q_DECLARE_METATYPE(ModelInfo::TriangleBvhPointer)
+
+#endif // TRIANGLEBVH_H
@@ -0,0 +1,46 @@
+#ifndef VERTEXVNPACKED_H
+#define VERTEXVNPACKED_H
+
+#include "Info/ModelInfo.h"
+
+#define SNORM16_MAX 32767.0f
+
+namespace ModelInfo {
+    // snorm16 position in [-1, 1] and octahedral snorm16 normal: 12 bytes instead of 24 of VertexVN
+    class VertexVNPacked {
+    public:
+        GLshort x;
+        GLshort y;
+        GLshort z;
+        // keeps the normal 4 byte aligned
+        GLshort padding;
+        GLshort nx;
+        GLshort ny;
+
+        VertexVNPacked() { }
+        VertexVNPacked(
+                const GLshort & x,
+                const GLshort & y,
+                const GLshort & z,
+                const GLshort & nx,
+                const GLshort & ny
+                ) :
+            x(x), y(y), z(z), padding(0),
+            nx(nx), ny(ny) {
+        }
+    };
+
+    using VerticesVNPacked = QVector<VertexVNPacked>;
+    using VerticesVNPackedPtr = VerticesVNPacked *;
+
+    using VerticesVNPackedPointer = QSharedPointer<VerticesVNPacked>;
+
+    class BuffersVNPacked : public BuffersV {
+    public:
+        VerticesVNPackedPointer vertices;
+    };
+}
+
+Q_DECLARE_METATYPE(ModelInfo::BuffersVNPacked)
+
+#endif // VERTEXVNPACKED_H
@@ -3,9 +3,13 @@
 
 #include <QtCore/QVariant>
 #include <QtCore/QUrl>
+#include <QtCore/QThread>
+#include <QtCore/QAtomicInt>
 
 #include <QtCore/QDebug>
 
+#include <functional>
+
 #include "Message/SettingsMessage.h"
 
 namespace Parser {
@@ -15,18 +19,53 @@ namespace Parser {
 
         Q_PROPERTY(QVariant blueprint READ blueprint WRITE setBlueprint NOTIFY blueprintChanged)
 
+        Q_PROPERTY(bool loading READ loading NOTIFY loadingChanged)
+
         Q_OBJECT
     public:
+        virtual ~AbstractParser();
+
         QUrl file() const;
         QVariant files() const;
 
         QVariant blueprint() const;
 
+        bool loading() const;
+
     protected:
-        explicit AbstractParser();
+        explicit AbstractParser(const QString & name = "Parser");
 
         QVariant _blueprint;
 
+        /* runs job on a worker thread, previous load is canceled without blocking the gui thread:
+         * job is queued until the canceled one winds down, so jobs never run side by side;
+         * job returns whether something was loaded, finished() is emitted with it on the gui thread
+         */
+        void load(const std::function<bool ()> & job);
+
+        bool isCanceled() const;
+        const QAtomicInt * cancelFlag() const;
+
+        // thread safe, goes to sidebar as "setProgress"
+        void reportProgress(const QString & stage, const qreal & progress, const QVariantMap & details = QVariantMap());
+
+    private:
+        QString _name;
+
+        // running load, a superseded one may still be winding down here
+        QThread * _loadingThread;
+
+        // job waiting for the superseded load to finish
+        std::function<bool ()> _queuedJob;
+
+        int _loadingGeneration;
+
+        QAtomicInt _canceled;
+
+        void startLoading();
+        // cancels running load and makes it superseded, never waits for it
+        void stopLoading();
+
     signals:
         void send(const Message::SettingsMessage & model);
 
@@ -35,11 +74,17 @@ namespace Parser {
 
         void blueprintChanged(const QVariant & blueprint);
 
+        void loadingChanged();
+
+        void finished(bool success);
+
     public slots:
         virtual void setFile(const QUrl & file);
         virtual void setFiles(const QVariant & files);
 
         virtual void setBlueprint(const QVariant & blueprint);
+
+        virtual void cancel();
     };
 }
 
@@ -0,0 +1,47 @@
+#ifndef DICOMINDEX_H
+#define DICOMINDEX_H
+
+#include "Parser/AbstractParser.h"
+#include "Parser/SeriesIndex.h"
+
+namespace Parser {
+    /* lists series found in the directories set as files, subdirectories included, without reading pixel data;
+     * pick one of series and pass seriesFiles() of it to DicomReader
+     */
+    class DicomIndex : public AbstractParser {
+        Q_PROPERTY(QVariantList series READ series NOTIFY seriesChanged)
+
+        Q_OBJECT
+    public:
+        explicit DicomIndex();
+
+        QVariant files() const;
+
+        QVariantList series() const;
+
+        // sorted along the series, as urls
+        Q_INVOKABLE QVariantList seriesFiles(const QString & seriesUID) const;
+
+    private:
+        QVariant _directories;
+
+        QVariantList _series;
+        QHash<QString, QStringList> _seriesFiles;
+
+        // written by the scan, taken on the gui thread once it's finished
+        std::vector<std::vector<SeriesSlice> > _scannedSeries;
+
+        bool scan(const QList<QUrl> & urls);
+
+    private slots:
+        void takeScannedSeries(bool success);
+
+    signals:
+        void seriesChanged();
+
+    public slots:
+        virtual void setFiles(const QVariant & files);
+    };
+}
+
+#endif // DICOMINDEX_H
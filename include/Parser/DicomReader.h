@@ -10,25 +10,91 @@
 #include "Info/VolumeInfo.h"
 
 namespace Parser {
+class EncapsulatedFrames;
+class SliceStream;
+
 class DicomReader : public AbstractParser {
+    // {"origin": vector3d, "size": vector3d, "stride": vector3d} in voxels, applies to the next file or files set
+    Q_PROPERTY(QVariant region READ region WRITE setRegion NOTIFY regionChanged)
+
+    // volume is shown right away and filled in as slices are processed
+    Q_PROPERTY(bool progressive READ progressive WRITE setProgressive NOTIFY progressiveChanged)
+
     Q_OBJECT
 public:
     explicit DicomReader();
 
     QUrl file() const;
+    QVariant files() const;
+
+    QVariant region() const;
+
+    bool progressive() const;
 
 private:
     QUrl _dicomFile;
+    QVariant _dicomFiles;
+
+    QVariant _region;
+
+    bool _progressive;
+
+    QSharedPointer<SliceStream> _sliceStream;
 
     DicomData _dicomData;
 
-    void readImage(gdcm::File &dFile, const gdcm::Image & dImage);
+    // processed volume is stored under this key, empty if it shouldn't be cached
+    QString _cacheKey;
+
+    QAtomicInt _decodedSlices;
 
+    // progressive is taken when the load starts, the gui thread can change it meanwhile
+    bool readFile(const QString & fileName, const VolumeRegion & region, const bool & progressive);
+    // only frames and rows of the region are read from the file, the whole one if gdcm can't read regions of it
+    bool readFileRegion(const QString & fileName, const VolumeRegion & region, const bool & progressive);
+    bool readWholeFile(const QString & fileName, const VolumeRegion & region, const bool & progressive);
+    // image is cropped to the region once it's in memory
+    bool readImage(gdcm::File &dFile, const gdcm::Image & dImage, const VolumeRegion & region, const bool & progressive);
+    bool readSeries(const QStringList & fileNames, const VolumeRegion & region, const bool & progressive);
+
+    QStringList listFiles(const QList<QUrl> & urls);
+
+    // reports every percent of slices passed through _dicomData.sliceDecoded
+    void trackSlices(const QString & stage, const int & slicesTotal);
+
+    void fetchDicomParams(DicomData & dicomData, gdcm::File & dFile, const gdcm::Image & dImage);
     void fetchDicomData(DicomData & dicomData, gdcm::File & dFile, const gdcm::Image & dImage);
-    void runSliceProcessing(const bool & tellAboutHURange = false);
+    // frames are decoded first if given, slices are taken from _dicomData.buffer otherwise
+    bool runSliceProcessing(const bool & progressive, const bool & tellAboutHURange = false,
+                            const EncapsulatedFrames * encapsulatedFrames = nullptr);
+
+    bool sendCachedVolume(const QString & cacheKey);
+    // called after the volume is sent, so the scene shows it while it's being stored
+    void cacheVolume(const TextureInfo::MergedDataPointer & mergedData, const QOpenGLPixelTransferOptions & pixelTransferOptions);
+
+    /* sends the volume without data along with the first batch of merged slices reported through _dicomData.slicesMerged,
+     * later batches are uploaded into it and the texture is finished once all of them are there
+     */
+    void streamVolume(const TextureInfo::MergedDataPointer & mergedData, const QOpenGLPixelTransferOptions & pixelTransferOptions,
+                      const bool & tellAboutHURange = false);
+    void finishStream();
+
+    TextureInfo::TextureInfo volumeTexture(const TextureInfo::MergedDataPointer & mergedData,
+                                           const QOpenGLPixelTransferOptions & pixelTransferOptions) const;
+
+    void sendVolume(const TextureInfo::MergedDataPointer & mergedData, const QOpenGLPixelTransferOptions & pixelTransferOptions,
+                    const bool & tellAboutHURange = false);
+
+signals:
+    void regionChanged();
+    void progressiveChanged();
 
 public slots:
     virtual void setFile(const QUrl & file);
+    virtual void setFiles(const QVariant & files);
+
+    void setRegion(const QVariant & region);
+    void setProgressive(const bool & progressive);
 };
 }
 
@@ -0,0 +1,29 @@
+#ifndef PIXELDECODER_H
+#define PIXELDECODER_H
+
+#include <QtCore/QtGlobal>
+
+namespace Parser {
+    namespace PixelDecoder {
+        enum InstructionSet {
+            SCALAR = 0,
+            SSE2 = 1,
+            AVX2 = 2
+        };
+
+        // best instruction set available on this cpu, detected once
+        InstructionSet instructionSet();
+
+        // all decoders write host-ordered 16 bit pixels, src and dst may be unaligned
+        void decode8(const char * src, quint16 * dst, const size_t & count);
+        void decode16LE(const char * src, quint16 * dst, const size_t & count);
+        void decode16BE(const char * src, quint16 * dst, const size_t & count);
+
+        // running sums of slices: acc += src, acc += incoming - outgoing, dst = round(acc / divisor)
+        void accumulate16(const quint16 * src, quint32 * acc, const size_t & count);
+        void slide16(const quint16 * incoming, const quint16 * outgoing, quint32 * acc, const size_t & count);
+        void average32(const quint32 * acc, quint16 * dst, const size_t & count, const quint32 & divisor);
+    }
+}
+
+#endif // PIXELDECODER_H
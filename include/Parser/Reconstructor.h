@@ -2,6 +2,7 @@
 #define RECONSTRUCTOR_H
 
 #include <QtCore/QStringList>
+#include <QtCore/QMap>
 
 #ifdef __APPLE__
     #include <OpenCL/opencl.h>
@@ -14,8 +15,19 @@
 
 #include "Info/VolumeInfo.h"
 
+// slabs of detector rows in flight, one uploads or reads back while the other computes
+#define SLABS_IN_FLIGHT 2
+
 namespace Parser {
+    class HartleyTables;
+
     class Reconstructor : public AbstractParser {
+        // of the gauss prefilter, in detector pixels
+        Q_PROPERTY(qreal gaussSigma READ gaussSigma WRITE setGaussSigma NOTIFY gaussSigmaChanged)
+
+        // taps of the gauss prefilter along every axis, odd; 1 leaves the projections as they are
+        Q_PROPERTY(int gaussSize READ gaussSize WRITE setGaussSize NOTIFY gaussSizeChanged)
+
         Q_OBJECT
     public:
         explicit Reconstructor();
@@ -23,9 +35,20 @@ namespace Parser {
 
         QVariant files() const;
 
+        qreal gaussSigma() const;
+        int gaussSize() const;
+
+        /* unmasked slices of projections (CV_32FC1, one per angle) on the device picked with CLInfo::setDevice,
+         * false if they were done natively, asked for or not
+         */
+        bool reconstructSlices(const QVector<cv::Mat> & projections, QVector<cv::Mat> & slices);
+
     private:
         QVariant _imgFiles;
 
+        qreal _gaussSigma;
+        int _gaussSize;
+
         QVector<cv::Mat>_src;
         QVector<cv::Mat *>_slicesOCL;
 
@@ -33,28 +56,53 @@ namespace Parser {
         cl_device_id _device_id;
         cl_program _programReconstruction;
 
-        cl_kernel _gauss1dKernel;
+        cl_kernel _gauss3dKernel;
         cl_kernel _calcTablesKernel;
         cl_kernel _dht1dTransposeKernel;
+        cl_kernel _fhtSinogramKernel;
         cl_kernel _fourier2dKernel;
         cl_kernel _butterflyDht2dKernel;
 
-        cl_command_queue _queue;
+        // one per slab in flight
+        cl_command_queue _queues[SLABS_IN_FLIGHT];
+
+        // local size of every kernel by its name, {0, 0, 0} leaves it to the runtime
+        QMap<QString, QVector<size_t> > _localSizes;
         
         bool _isOCLInitialized;
 
-        void initOCL();
+        bool initOCL();
+
+        // fastest local sizes of the device on synthetic data, they go to its profile
+        void autotune();
+        // seconds of one run, less than 0 if the device can't run localSize
+        double timeKernel(cl_kernel kernel, const cl_uint & dims, const size_t * globalThreads,
+                          const QVector<size_t> & localSize);
         void releaseOCLResources();
 
+        // slices are masked and sent to the scene
         void reconstruct();
-        void reconstructCPU();
+        // on the device picked on the command line, natively if there's no such opencl device; true if by opencl
+        bool reconstructSlices();
+        bool reconstructOCL(const std::vector<float> & gaussTable, const HartleyTables & hartley);
+        void reconstructCPU(const std::vector<float> & gaussTable, const HartleyTables & hartley);
+
+        // volume wide normalization to 8 bit, everything out of the contours is masked out
+        void maskSlices();
 
         void sendToScene();
 
         void reset();
 
+    signals:
+        void gaussSigmaChanged();
+        void gaussSizeChanged();
+
     public slots:
         virtual void setFiles(const QVariant & files) final;
+
+        void setGaussSigma(const qreal & gaussSigma);
+        void setGaussSize(const int & gaussSize);
     };
 }
 
@@ -0,0 +1,26 @@
+#ifndef SERIESINDEX_H
+#define SERIESINDEX_H
+
+#include <QtCore/QStringList>
+
+#include "Parser/seriesprocessing.hpp"
+
+namespace Parser {
+    /* headers of dicom files kept in the cache location, one index per directory;
+     * a header is read again only if size or modification time of its file has changed,
+     * or if gdcm couldn't read it last time, as the file may have been locked or still written then
+     */
+    namespace SeriesIndex {
+        // headerRead is called from workers after every header actually read, not for indexed ones
+        std::vector<SeriesSlice> scan(const QStringList & fileNames, const QAtomicInt * canceled = nullptr,
+                                      const std::function<void (const int & read, const int & total)> & headerRead = nullptr);
+
+        // valid slices grouped by series and sorted along it, the largest series goes first
+        std::vector<std::vector<SeriesSlice> > group(const std::vector<SeriesSlice> & slices);
+
+        // seriesUID, modality, transferSyntax, directory, width, height, slices and spacing of the series
+        QVariantMap describe(const std::vector<SeriesSlice> & series);
+    }
+}
+
+#endif // SERIESINDEX_H
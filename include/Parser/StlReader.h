@@ -3,11 +3,41 @@
 
 #include "Parser/Helpers.hpp"
 #include "Parser/AbstractParser.h"
+#include "Parser/cacheprocessing.hpp"
+#include "Parser/bvhprocessing.hpp"
 
 #include "Model/VertexVN.h"
+#include "Model/VertexVNPacked.h"
 
 namespace Parser {
+    // what happens to the triangle soup once it's read
+    class StlSettings {
+    public:
+        WeldSettings weldSettings;
+
+        int lodLevels;
+
+        bool overdrawOrdering;
+
+        StlSettings() :
+            lodLevels(3),
+            overdrawOrdering(false) {
+        }
+    };
+
     class StlReader : public AbstractParser {
+        // positions closer than this in normalized model units are welded into one vertex, negative keeps the triangle soup
+        Q_PROPERTY(qreal weldEpsilon READ weldEpsilon WRITE setWeldEpsilon NOTIFY weldEpsilonChanged)
+
+        // normals of welded faces meeting at a smaller angle (degrees) are averaged, sharper edges stay hard
+        Q_PROPERTY(qreal creaseAngle READ creaseAngle WRITE setCreaseAngle NOTIFY creaseAngleChanged)
+
+        // simplified levels built for welded meshes, 0 sends the mesh alone
+        Q_PROPERTY(int lodLevels READ lodLevels WRITE setLodLevels NOTIFY lodLevelsChanged)
+
+        // patches of triangles facing out of the model are drawn first, after they are ordered for the vertex cache
+        Q_PROPERTY(bool overdrawOrdering READ overdrawOrdering WRITE setOverdrawOrdering NOTIFY overdrawOrderingChanged)
+
         Q_OBJECT
     public:
         explicit StlReader();
@@ -15,19 +45,59 @@ namespace Parser {
 
         QUrl file() const;
 
+        qreal weldEpsilon() const;
+        qreal creaseAngle() const;
+
+        int lodLevels() const;
+
+        bool overdrawOrdering() const;
+
+        /* triangle soup of the file normalized into the unit box, parsed right from its mapping the way loads do it;
+         * nullptr if it can't be read, the caller owns the vertices
+         */
+        ModelInfo::VerticesVNPtr readVertices(const QString & fileName);
+
     private:
         QUrl _stlFile;
 
-        void readASCII(QFile & stlFile, const bool & solidChecked = false);
-        void readBinary(QFile & stlFile);
+        StlSettings _settings;
+
+        // reordering time is logged as a part of the load from here on
+        float _loadStartTime;
+
+        bool readFile(const QString & fileName, const StlSettings & settings);
+
+        ModelInfo::VerticesVNPtr readASCII(QFile & stlFile, const bool & solidChecked = false);
+        ModelInfo::VerticesVNPtr readBinary(QFile & stlFile);
 
-        void sendBuffers(ModelInfo::BuffersVN buffers);
+        /* welds the triangle soup into indexed vertices, simplifies them and orders triangles for the vertex cache
+         * if enabled, takes ownership of vertices
+         */
+        bool sendVertices(ModelInfo::VerticesVNPtr vertices, const StlSettings & settings);
+
+        // positions and normals go to the gpu as snorm16, the float vertices are released with buffers
+        ModelInfo::BuffersVNPacked packBuffers(const ModelInfo::BuffersVN & buffers);
+
+        // of the finest level, models with points pick on it instead of reading the depth buffer back
+        ModelInfo::TriangleBvhPointer buildBvh(const ModelInfo::BuffersVN & buffers, const std::vector<LevelOfDetail> & levels);
+
+        bool sendBuffers(ModelInfo::BuffersVN buffers, const std::vector<LevelOfDetail> & levels = std::vector<LevelOfDetail>());
 
     signals:
         void readingErrorHappened();
 
+        void weldEpsilonChanged();
+        void creaseAngleChanged();
+        void lodLevelsChanged();
+        void overdrawOrderingChanged();
+
     public slots:
         virtual void setFile(const QUrl & file);
+
+        void setWeldEpsilon(const qreal & weldEpsilon);
+        void setCreaseAngle(const qreal & creaseAngle);
+        void setLodLevels(const int & lodLevels);
+        void setOverdrawOrdering(const bool & overdrawOrdering);
     };
 }
 #endif // STLREADER_H
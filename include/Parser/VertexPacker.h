@@ -0,0 +1,19 @@
+#ifndef VERTEXPACKER_H
+#define VERTEXPACKER_H
+
+#include "Model/VertexVN.h"
+#include "Model/VertexVNPacked.h"
+
+namespace Parser {
+    namespace VertexPacker {
+        /* positions are clamped to [-1, 1], normals are expected to be unit or zero;
+         * scalar and simd kernels give the same bits, src and dst may be unaligned
+         */
+        void pack(const ModelInfo::VertexVN * src, ModelInfo::VertexVNPacked * dst, const size_t & count);
+
+        // of a vertex packed by pack(), normal comes out unit
+        void unpack(const ModelInfo::VertexVNPacked & src, ModelInfo::VertexVN & dst);
+    }
+}
+
+#endif // VERTEXPACKER_H
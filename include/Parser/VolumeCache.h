@@ -0,0 +1,34 @@
+#ifndef VOLUMECACHE_H
+#define VOLUMECACHE_H
+
+#include <QtCore/QStringList>
+
+#include "Parser/ctprocessing.hpp"
+
+namespace Parser {
+    /* processed volumes stored in the cache location: one page of params followed by merged data,
+     * so loaded volume is just a memory mapping of the file, texture reads straight from it
+     */
+    namespace VolumeCache {
+        /* series identity plus size, modification time and header of every file, and the region taken from it;
+         * pixel data is only sampled in a few files, so it's a heuristic: pixels rewritten in place
+         * with size and modification time kept aren't noticed
+         */
+        QString key(const QString & seriesUID, const QStringList & fileNames, const int & neighbourRadius,
+                    const VolumeRegion & region = VolumeRegion());
+
+        bool load(const QString & key, DicomData & dicomData,
+                  TextureInfo::MergedDataPointer & mergedData, QOpenGLPixelTransferOptions & pixelTransferOptions);
+
+        // least recently used volumes are evicted once the cache grows over limit, nothing is kept if canceled meanwhile
+        bool store(const QString & key, const DicomData & dicomData,
+                   const TextureInfo::MergedDataPointer & mergedData, const QOpenGLPixelTransferOptions & pixelTransferOptions,
+                   const QAtomicInt * canceled = nullptr);
+
+        // bytes all cached volumes may take together
+        quint64 sizeLimit();
+        void setSizeLimit(const quint64 & bytes);
+    }
+}
+
+#endif // VOLUMECACHE_H
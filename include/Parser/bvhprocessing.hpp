@@ -0,0 +1,409 @@
+#ifndef BVHPROCESSING_HPP
+#define BVHPROCESSING_HPP
+
+#include "Parser/stlprocessing.hpp"
+
+#include "Model/TriangleBvh.h"
+
+// centroids are binned along the widest axis to find the sah split
+#define BVH_BINS 16
+// nodes of this many triangles are always leaves
+#define BVH_LEAF_TRIANGLES 4
+// sah may keep up to this many triangles in a leaf if splitting doesn't pay off
+#define BVH_MAX_LEAF_TRIANGLES 16
+// deeper nodes are leaves whatever their size, keeps traversal within BVH_STACK_SIZE
+#define BVH_MAX_DEPTH (BVH_STACK_SIZE - 2)
+// top of the tree is split until there are about this many subtrees per thread, they are built in parallel
+#define BVH_TASKS_PER_THREAD 4
+
+namespace Parser {
+    class BvhPrimitive {
+    public:
+        BoundingBox box;
+
+        GLfloat centroid[3];
+    };
+
+    // a subtree left for a thread: triangles [begin, end) below node
+    class BvhTask {
+    public:
+        GLuint node;
+
+        size_t begin;
+        size_t end;
+
+        int depth;
+
+        BvhTask(const GLuint & node, const size_t & begin, const size_t & end, const int & depth) :
+            node(node),
+            begin(begin),
+            end(end),
+            depth(depth) {
+        }
+    };
+
+    inline GLfloat surfaceArea(const BoundingBox & box) {
+        if (box.isEmpty) {
+            return 0.0f;
+        }
+
+        GLfloat dx = box.maxV.x - box.minV.x;
+        GLfloat dy = box.maxV.y - box.minV.y;
+        GLfloat dz = box.maxV.z - box.minV.z;
+
+        return 2.0f * (dx * dy + dy * dz + dz * dx);
+    }
+
+    inline GLuint bvhVertex(const GLuint * indices, const size_t & triangle, const int & corner) {
+        return indices ? indices[3 * triangle + corner] : (GLuint) (3 * triangle + corner);
+    }
+
+    // binned sah over a range of primitive references, which are partitioned in place
+    class BvhBuilder {
+    private:
+        const std::vector<BvhPrimitive> * _primitives;
+
+        GLuint * _references;
+
+        void makeLeaf(ModelInfo::BvhNode & node, const size_t & begin, const size_t & end) const {
+            node.first = (GLuint) begin;
+            node.count = (GLuint) (end - begin);
+        }
+
+    public:
+        BvhBuilder(const std::vector<BvhPrimitive> * primitives, GLuint * references) :
+            _primitives(primitives),
+            _references(references) {
+        }
+
+        /* builds triangles [begin, end) under nodes[nodeIndex];
+         * with tasks, ranges of at most taskSize triangles are left there instead of being built
+         */
+        void build(ModelInfo::BvhNodes & nodes, const GLuint & nodeIndex, const size_t & begin, const size_t & end, const int & depth,
+                   std::vector<BvhTask> * tasks = nullptr, const size_t & taskSize = 0) const {
+            BoundingBox box;
+            BoundingBox centroids;
+
+            for (size_t i = begin; i != end; ++ i) {
+                const BvhPrimitive & primitive = _primitives->at(_references[i]);
+
+                box.add(primitive.box);
+                centroids.add(primitive.centroid[0], primitive.centroid[1], primitive.centroid[2]);
+            }
+
+            ModelInfo::BvhNode & node = nodes[nodeIndex];
+            node.minV = box.minV;
+            node.maxV = box.maxV;
+
+            size_t count = end - begin;
+
+            if (tasks && count <= taskSize) {
+                tasks->push_back(BvhTask(nodeIndex, begin, end, depth));
+                return;
+            }
+
+            if (count <= BVH_LEAF_TRIANGLES || depth >= BVH_MAX_DEPTH) {
+                makeLeaf(node, begin, end);
+                return;
+            }
+
+            const GLfloat minC[3] = { centroids.minV.x, centroids.minV.y, centroids.minV.z };
+            const GLfloat sizeC[3] = { centroids.maxV.x - minC[0], centroids.maxV.y - minC[1], centroids.maxV.z - minC[2] };
+
+            int axis = (sizeC[0] > sizeC[1]) ? ((sizeC[0] > sizeC[2]) ? 0 : 2) : ((sizeC[1] > sizeC[2]) ? 1 : 2);
+
+            size_t middle = begin + count / 2;
+
+            if (sizeC[axis] > 0.0f) {
+                BoundingBox binBoxes[BVH_BINS];
+                size_t binCounts[BVH_BINS] = { 0 };
+
+                GLfloat binScale = BVH_BINS / sizeC[axis];
+
+                for (size_t i = begin; i != end; ++ i) {
+                    const BvhPrimitive & primitive = _primitives->at(_references[i]);
+
+                    int bin = std::min((int) ((primitive.centroid[axis] - minC[axis]) * binScale), BVH_BINS - 1);
+
+                    binBoxes[bin].add(primitive.box);
+                    ++ binCounts[bin];
+                }
+
+                // cost of everything right of the split, swept from the right
+                GLfloat rightCosts[BVH_BINS];
+
+                BoundingBox rightBox;
+                size_t rightCount = 0;
+
+                for (int bin = BVH_BINS - 1; bin > 0; -- bin) {
+                    rightBox.add(binBoxes[bin]);
+                    rightCount += binCounts[bin];
+
+                    rightCosts[bin] = rightCount ? surfaceArea(rightBox) * rightCount : -1.0f;
+                }
+
+                BoundingBox leftBox;
+                size_t leftCount = 0;
+
+                int bestSplit = 0;
+                GLfloat bestCost = 0.0f;
+
+                for (int split = 1; split != BVH_BINS; ++ split) {
+                    leftBox.add(binBoxes[split - 1]);
+                    leftCount += binCounts[split - 1];
+
+                    if (!leftCount || rightCosts[split] < 0.0f) {
+                        continue;
+                    }
+
+                    GLfloat cost = surfaceArea(leftBox) * leftCount + rightCosts[split];
+
+                    if (!bestSplit || cost < bestCost) {
+                        bestSplit = split;
+                        bestCost = cost;
+                    }
+                }
+
+                // a traversal step costs about as much as one triangle test
+                GLfloat area = surfaceArea(box);
+
+                if (count <= BVH_MAX_LEAF_TRIANGLES && (!bestSplit || area * count <= area + bestCost)) {
+                    makeLeaf(node, begin, end);
+                    return;
+                }
+
+                if (bestSplit) {
+                    const std::vector<BvhPrimitive> * primitives = _primitives;
+
+                    middle = std::partition(_references + begin, _references + end, [&](const GLuint & reference) {
+                        const BvhPrimitive & primitive = primitives->at(reference);
+
+                        return std::min((int) ((primitive.centroid[axis] - minC[axis]) * binScale), BVH_BINS - 1) < bestSplit;
+                    }) - _references;
+                }
+            }
+            else if (count <= BVH_MAX_LEAF_TRIANGLES) {
+                // all centroids in one point, no split tells them apart
+                makeLeaf(node, begin, end);
+                return;
+            }
+
+            GLuint children = (GLuint) nodes.size();
+
+            // nodes may be reallocated, node is not valid past this point
+            nodes[nodeIndex].first = children;
+            nodes[nodeIndex].count = 0;
+
+            nodes.resize(nodes.size() + 2);
+
+            build(nodes, children, begin, middle, depth + 1, tasks, taskSize);
+            build(nodes, children + 1, middle, end, depth + 1, tasks, taskSize);
+        }
+    };
+
+    class BvhBounding : public cv::ParallelLoopBody {
+    private:
+        const ModelInfo::VertexVN * _vertices;
+        const GLuint * _indices;
+
+        size_t _triangleCount;
+
+        int _chunkCount;
+
+        BvhPrimitive * _primitives;
+
+    public:
+        BvhBounding(const ModelInfo::VertexVN * vertices, const GLuint * indices, const size_t & triangleCount, const int & chunkCount,
+                    BvhPrimitive * primitives) :
+            _vertices(vertices),
+            _indices(indices),
+            _triangleCount(triangleCount),
+            _chunkCount(chunkCount),
+            _primitives(primitives) {
+        }
+
+        virtual void operator ()(const cv::Range & r) const {
+            size_t first;
+            size_t last;
+
+            for (int chunk = r.start; chunk != r.end; ++ chunk) {
+                stlChunk(chunk, _chunkCount, _triangleCount, first, last);
+
+                for (size_t t = first; t != last; ++ t) {
+                    BvhPrimitive & primitive = _primitives[t];
+
+                    for (int corner = 0; corner != 3; ++ corner) {
+                        const ModelInfo::VertexVN & vertex = _vertices[bvhVertex(_indices, t, corner)];
+
+                        primitive.box.add(vertex.x, vertex.y, vertex.z);
+                    }
+
+                    primitive.centroid[0] = (primitive.box.minV.x + primitive.box.maxV.x) / 2.0f;
+                    primitive.centroid[1] = (primitive.box.minV.y + primitive.box.maxV.y) / 2.0f;
+                    primitive.centroid[2] = (primitive.box.minV.z + primitive.box.maxV.z) / 2.0f;
+                }
+            }
+        }
+    };
+
+    // every subtree goes to its own node vector, they are stitched into the tree afterwards
+    class BvhSubtreeBuilding : public cv::ParallelLoopBody {
+    private:
+        const std::vector<BvhTask> * _tasks;
+
+        std::vector<ModelInfo::BvhNodes> * _subtrees;
+
+        BvhBuilder _builder;
+
+        const QAtomicInt * _canceled;
+
+    public:
+        BvhSubtreeBuilding(const std::vector<BvhTask> * tasks, std::vector<ModelInfo::BvhNodes> * subtrees, const BvhBuilder & builder,
+                           const QAtomicInt * canceled = nullptr) :
+            _tasks(tasks),
+            _subtrees(subtrees),
+            _builder(builder),
+            _canceled(canceled) {
+        }
+
+        virtual void operator ()(const cv::Range & r) const {
+            for (int task = r.start; task != r.end && !(_canceled && _canceled->load()); ++ task) {
+                const BvhTask & bvhTask = _tasks->at(task);
+
+                ModelInfo::BvhNodes & subtree = (*_subtrees)[task];
+                subtree.resize(1);
+                subtree.reserve(2 * (bvhTask.end - bvhTask.begin));
+
+                _builder.build(subtree, 0, bvhTask.begin, bvhTask.end, bvhTask.depth);
+            }
+        }
+    };
+
+    class BvhGathering : public cv::ParallelLoopBody {
+    private:
+        const ModelInfo::VertexVN * _vertices;
+        const GLuint * _indices;
+
+        const GLuint * _references;
+
+        size_t _triangleCount;
+
+        int _chunkCount;
+
+        ModelInfo::BvhTriangle * _triangles;
+
+    public:
+        BvhGathering(const ModelInfo::VertexVN * vertices, const GLuint * indices, const GLuint * references, const size_t & triangleCount,
+                     const int & chunkCount, ModelInfo::BvhTriangle * triangles) :
+            _vertices(vertices),
+            _indices(indices),
+            _references(references),
+            _triangleCount(triangleCount),
+            _chunkCount(chunkCount),
+            _triangles(triangles) {
+        }
+
+        virtual void operator ()(const cv::Range & r) const {
+            size_t first;
+            size_t last;
+
+            for (int chunk = r.start; chunk != r.end; ++ chunk) {
+                stlChunk(chunk, _chunkCount, _triangleCount, first, last);
+
+                for (size_t i = first; i != last; ++ i) {
+                    ModelInfo::VertexV corners[3];
+
+                    for (int corner = 0; corner != 3; ++ corner) {
+                        const ModelInfo::VertexVN & vertex = _vertices[bvhVertex(_indices, _references[i], corner)];
+
+                        corners[corner] = ModelInfo::VertexV(vertex.x, vertex.y, vertex.z);
+                    }
+
+                    _triangles[i] = ModelInfo::BvhTriangle(corners[0], corners[1], corners[2]);
+                }
+            }
+        }
+    };
+
+    /* triangles are consecutive vertices without indices;
+     * the top of the tree is built by the calling thread, the rest in parallel
+     */
+    inline ModelInfo::TriangleBvhPointer buildTriangleBvh(const ModelInfo::VerticesVN & vertices, const GLuint * indices,
+                                                          const size_t & triangleCount, const QAtomicInt * canceled = nullptr) {
+        ModelInfo::TriangleBvhPointer bvh(new ModelInfo::TriangleBvh);
+
+        if (!triangleCount) {
+            return bvh;
+        }
+
+        int chunkCount = stlChunkCount(triangleCount);
+
+        std::vector<BvhPrimitive> primitives(triangleCount);
+
+        cv::parallel_for_(cv::Range(0, chunkCount),
+                          BvhBounding(vertices.constData(), indices, triangleCount, chunkCount, primitives.data()), chunkCount);
+
+        if (canceled && canceled->load()) {
+            return ModelInfo::TriangleBvhPointer();
+        }
+
+        std::vector<GLuint> references(triangleCount);
+
+        for (size_t t = 0; t != triangleCount; ++ t) {
+            references[t] = (GLuint) t;
+        }
+
+        BvhBuilder builder(&primitives, references.data());
+
+        size_t taskSize = std::max(triangleCount / (cv::getNumThreads() * BVH_TASKS_PER_THREAD), (size_t) BVH_MAX_LEAF_TRIANGLES);
+
+        std::vector<BvhTask> tasks;
+
+        bvh->nodes.resize(1);
+
+        builder.build(bvh->nodes, 0, 0, triangleCount, 0, &tasks, taskSize);
+
+        if (canceled && canceled->load()) {
+            return ModelInfo::TriangleBvhPointer();
+        }
+
+        std::vector<ModelInfo::BvhNodes> subtrees(tasks.size());
+
+        cv::parallel_for_(cv::Range(0, (int) tasks.size()), BvhSubtreeBuilding(&tasks, &subtrees, builder, canceled), (double) tasks.size());
+
+        if (canceled && canceled->load()) {
+            return ModelInfo::TriangleBvhPointer();
+        }
+
+        // subtree roots replace the task nodes, the rest is appended; children of inner nodes are shifted along
+        for (size_t task = 0; task != tasks.size(); ++ task) {
+            ModelInfo::BvhNodes & subtree = subtrees[task];
+
+            GLuint shift = (GLuint) bvh->nodes.size() - 1;
+
+            for (ModelInfo::BvhNode & node : subtree) {
+                if (!node.count) {
+                    node.first += shift;
+                }
+            }
+
+            bvh->nodes[tasks[task].node] = subtree[0];
+
+            for (int i = 1; i < subtree.size(); ++ i) {
+                bvh->nodes.append(subtree[i]);
+            }
+
+            subtree.clear();
+        }
+
+        bvh->triangles.resize(triangleCount);
+
+        cv::parallel_for_(cv::Range(0, chunkCount),
+                          BvhGathering(vertices.constData(), indices, references.data(), triangleCount, chunkCount, bvh->triangles.data()),
+                          chunkCount);
+
+        return bvh;
+    }
+}
+
+#endif // BVHPROCESSING_HPP
@@ -0,0 +1,407 @@
+#ifndef CACHEPROCESSING_HPP
+#define CACHEPROCESSING_HPP
+
+#include "Parser/lodprocessing.hpp"
+
+// lru cache triangles are ordered for
+#define VERTEX_CACHE_SIZE 32
+// fifo cache acmr is measured with, like the one most of the hardware has
+#define VERTEX_CACHE_FIFO 16
+// triangles are reordered by one thread in clusters of about this many, they never leave their cluster
+#define CACHE_CLUSTER_TRIANGLES 65536
+// runs of reordered triangles are split into patches of this many for overdraw ordering
+#define OVERDRAW_CLUSTER_TRIANGLES 512
+
+namespace Parser {
+    // average cache miss ratio: transformed vertices per triangle
+    inline qreal acmr(const GLuint * indices, const size_t & indexCount, const size_t & vertexCount) {
+        if (indexCount < 3) {
+            return 0.0;
+        }
+
+        // vertex is in the fifo if it was put there less than VERTEX_CACHE_FIFO misses ago
+        std::vector<size_t> insertedAt(vertexCount, 0);
+
+        size_t misses = 0;
+
+        for (size_t i = 0; i != indexCount; ++ i) {
+            size_t & inserted = insertedAt[indices[i]];
+
+            if (!inserted || misses - inserted >= VERTEX_CACHE_FIFO) {
+                ++ misses;
+                inserted = misses;
+            }
+        }
+
+        return (qreal) misses / (indexCount / 3);
+    }
+
+    // scores of Forsyth's linear-speed vertex cache optimization
+    class VertexCacheScores {
+    private:
+        float _cacheScores[VERTEX_CACHE_SIZE];
+        float _valenceScores[64];
+
+    public:
+        VertexCacheScores() {
+            for (int i = 0; i != VERTEX_CACHE_SIZE; ++ i) {
+                // vertices of the last triangle get the same score, so it doesn't matter in which order they were used
+                _cacheScores[i] = (i < 3) ? 0.75f : std::pow(1.0f - (float) (i - 3) / (VERTEX_CACHE_SIZE - 3), 1.5f);
+            }
+
+            for (int i = 0; i != 64; ++ i) {
+                // vertices with a few triangles left are worth finishing off
+                _valenceScores[i] = i ? 2.0f / std::sqrt((float) i) : 0.0f;
+            }
+        }
+
+        inline float score(const int & cachePosition, const int & valence) const {
+            if (!valence) {
+                return -1.0f;
+            }
+
+            float valenceScore = (valence < 64) ? _valenceScores[valence] : 2.0f / std::sqrt((float) valence);
+
+            return (cachePosition < 0 ? 0.0f : _cacheScores[cachePosition]) + valenceScore;
+        }
+    };
+
+    class CacheOrdering : public cv::ParallelLoopBody {
+    private:
+        const ModelInfo::VertexVN * _vertices;
+
+        const GLuint * _source;
+        GLuint * _target;
+
+        const std::vector<LevelOfDetail> * _clusters;
+
+        bool _overdrawOrdering;
+
+        const QAtomicInt * _canceled;
+
+        VertexCacheScores _scores;
+
+    public:
+        // every cluster is a range of source indices, its triangles go to the same range of target ones
+        CacheOrdering(const ModelInfo::VertexVN * vertices, const GLuint * source, GLuint * target,
+                      const std::vector<LevelOfDetail> * clusters, const bool & overdrawOrdering, const QAtomicInt * canceled = nullptr) :
+            _vertices(vertices),
+            _source(source),
+            _target(target),
+            _clusters(clusters),
+            _overdrawOrdering(overdrawOrdering),
+            _canceled(canceled) {
+        }
+
+        virtual void operator ()(const cv::Range & r) const {
+            for (int cluster = r.start; cluster != r.end && !(_canceled && _canceled->load()); ++ cluster) {
+                const LevelOfDetail & range = _clusters->at(cluster);
+
+                orderForCache(_source + range.first, _target + range.first, range.count / 3);
+
+                if (_overdrawOrdering) {
+                    orderForOverdraw(_target + range.first, range.count / 3);
+                }
+            }
+        }
+
+        void orderForCache(const GLuint * source, GLuint * target, const size_t & triangleCount) const {
+            std::unordered_map<GLuint, int> localOf;
+            localOf.reserve(triangleCount);
+
+            std::vector<int> corners(triangleCount * 3);
+            std::vector<GLuint> globalOf;
+
+            for (size_t i = 0; i != triangleCount * 3; ++ i) {
+                std::pair<std::unordered_map<GLuint, int>::iterator, bool> inserted =
+                        localOf.insert(std::make_pair(source[i], (int) globalOf.size()));
+
+                if (inserted.second) {
+                    globalOf.push_back(source[i]);
+                }
+
+                corners[i] = inserted.first->second;
+            }
+
+            size_t vertexCount = globalOf.size();
+
+            // triangles not emitted yet of every vertex, packed one vertex after another
+            std::vector<int> valences(vertexCount, 0);
+            std::vector<size_t> adjacencyStarts(vertexCount + 1, 0);
+            std::vector<int> adjacency(triangleCount * 3);
+
+            for (int corner : corners) {
+                ++ valences[corner];
+            }
+
+            for (size_t v = 0; v != vertexCount; ++ v) {
+                adjacencyStarts[v + 1] = adjacencyStarts[v] + valences[v];
+                valences[v] = 0;
+            }
+
+            for (size_t i = 0; i != triangleCount * 3; ++ i) {
+                int v = corners[i];
+                adjacency[adjacencyStarts[v] + valences[v] ++] = (int) (i / 3);
+            }
+
+            std::vector<float> vertexScores(vertexCount);
+
+            for (size_t v = 0; v != vertexCount; ++ v) {
+                vertexScores[v] = _scores.score(-1, valences[v]);
+            }
+
+            std::vector<char> emitted(triangleCount, 0);
+
+            int bestTriangle = -1;
+            float bestScore = -1.0f;
+
+            for (size_t t = 0; t != triangleCount; ++ t) {
+                float score = vertexScores[corners[3 * t]] + vertexScores[corners[3 * t + 1]] + vertexScores[corners[3 * t + 2]];
+
+                if (score > bestScore) {
+                    bestScore = score;
+                    bestTriangle = (int) t;
+                }
+            }
+
+            int cache[VERTEX_CACHE_SIZE + 3];
+            int cacheSize = 0;
+
+            size_t nextUnemitted = 0;
+
+            for (size_t emittedCount = 0; emittedCount != triangleCount; ++ emittedCount) {
+                if (bestTriangle < 0) {
+                    // nothing in the cache has triangles left, take the next one in the source order
+                    while (emitted[nextUnemitted]) {
+                        ++ nextUnemitted;
+                    }
+
+                    bestTriangle = (int) nextUnemitted;
+                }
+
+                emitted[bestTriangle] = 1;
+
+                const int * triangle = &(corners[3 * bestTriangle]);
+
+                int newCache[VERTEX_CACHE_SIZE + 3];
+                int newCacheSize = 0;
+
+                for (int i = 0; i != 3; ++ i) {
+                    int v = triangle[i];
+
+                    target[3 * emittedCount + i] = globalOf[v];
+
+                    // triangle leaves adjacency of its vertices
+                    int * first = &(adjacency[adjacencyStarts[v]]);
+                    int * last = first + valences[v];
+
+                    *std::find(first, last, bestTriangle) = *(last - 1);
+                    -- valences[v];
+
+                    newCache[newCacheSize ++] = v;
+                }
+
+                for (int i = 0; i != cacheSize; ++ i) {
+                    int v = cache[i];
+
+                    if (v != triangle[0] && v != triangle[1] && v != triangle[2]) {
+                        newCache[newCacheSize ++] = v;
+                    }
+                }
+
+                cacheSize = std::min(newCacheSize, VERTEX_CACHE_SIZE);
+
+                // vertices pushed out of the cache
+                for (int i = cacheSize; i < newCacheSize; ++ i) {
+                    vertexScores[newCache[i]] = _scores.score(-1, valences[newCache[i]]);
+                }
+
+                for (int i = 0; i != cacheSize; ++ i) {
+                    cache[i] = newCache[i];
+                    vertexScores[cache[i]] = _scores.score(i, valences[cache[i]]);
+                }
+
+                bestTriangle = -1;
+                bestScore = -1.0f;
+
+                for (int i = 0; i != newCacheSize; ++ i) {
+                    int v = newCache[i];
+
+                    for (size_t a = adjacencyStarts[v]; a != adjacencyStarts[v] + valences[v]; ++ a) {
+                        int t = adjacency[a];
+
+                        float score = vertexScores[corners[3 * t]] + vertexScores[corners[3 * t + 1]] + vertexScores[corners[3 * t + 2]];
+
+                        if (score > bestScore) {
+                            bestScore = score;
+                            bestTriangle = t;
+                        }
+                    }
+                }
+            }
+        }
+
+        /* patches facing out of the model go first, they hide what's behind them:
+         * model is normalized around the origin, so it's taken as the center
+         */
+        void orderForOverdraw(GLuint * indices, const size_t & triangleCount) const {
+            size_t patchCount = (triangleCount + OVERDRAW_CLUSTER_TRIANGLES - 1) / OVERDRAW_CLUSTER_TRIANGLES;
+
+            if (patchCount < 2) {
+                return;
+            }
+
+            std::vector<std::pair<float, size_t> > patches(patchCount);
+
+            for (size_t patch = 0; patch != patchCount; ++ patch) {
+                size_t first = patch * OVERDRAW_CLUSTER_TRIANGLES;
+                size_t last = std::min(first + OVERDRAW_CLUSTER_TRIANGLES, triangleCount);
+
+                double centroid[3] = { 0.0, 0.0, 0.0 };
+                double normal[3] = { 0.0, 0.0, 0.0 };
+
+                double area = 0.0;
+
+                for (size_t t = first; t != last; ++ t) {
+                    const ModelInfo::VertexVN & p0 = _vertices[indices[3 * t]];
+                    const ModelInfo::VertexVN & p1 = _vertices[indices[3 * t + 1]];
+                    const ModelInfo::VertexVN & p2 = _vertices[indices[3 * t + 2]];
+
+                    double e1[3] = { (double) p1.x - p0.x, (double) p1.y - p0.y, (double) p1.z - p0.z };
+                    double e2[3] = { (double) p2.x - p0.x, (double) p2.y - p0.y, (double) p2.z - p0.z };
+
+                    double n[3] = {
+                        e1[1] * e2[2] - e1[2] * e2[1],
+                        e1[2] * e2[0] - e1[0] * e2[2],
+                        e1[0] * e2[1] - e1[1] * e2[0]
+                    };
+
+                    double faceArea = std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+
+                    centroid[0] += faceArea * (p0.x + p1.x + p2.x) / 3.0;
+                    centroid[1] += faceArea * (p0.y + p1.y + p2.y) / 3.0;
+                    centroid[2] += faceArea * (p0.z + p1.z + p2.z) / 3.0;
+
+                    for (int axis = 0; axis != 3; ++ axis) {
+                        normal[axis] += n[axis];
+                    }
+
+                    area += faceArea;
+                }
+
+                double normalLength = std::sqrt(normal[0] * normal[0] + normal[1] * normal[1] + normal[2] * normal[2]);
+
+                float key = 0.0f;
+
+                if (area > 0.0 && normalLength > 0.0) {
+                    key = (float) ((centroid[0] * normal[0] + centroid[1] * normal[1] + centroid[2] * normal[2]) / (area * normalLength));
+                }
+
+                patches[patch] = std::make_pair(- key, patch);
+            }
+
+            std::stable_sort(patches.begin(), patches.end());
+
+            std::vector<GLuint> ordered;
+            ordered.reserve(triangleCount * 3);
+
+            for (const std::pair<float, size_t> & patch : patches) {
+                size_t first = patch.second * OVERDRAW_CLUSTER_TRIANGLES;
+                size_t last = std::min(first + OVERDRAW_CLUSTER_TRIANGLES, triangleCount);
+
+                ordered.insert(ordered.end(), indices + 3 * first, indices + 3 * last);
+            }
+
+            std::copy(ordered.begin(), ordered.end(), indices);
+        }
+    };
+
+    /* reorders triangles within every level, levels keep their ranges of indices;
+     * big levels are bucketed into a grid first, so every cluster is a piece of the surface whatever order the file had
+     */
+    inline void optimizeTriangleOrder(const ModelInfo::VerticesVN & vertices, ModelInfo::Indices & indices,
+                                      const std::vector<LevelOfDetail> & levels, const bool & overdrawOrdering,
+                                      const QAtomicInt * canceled = nullptr) {
+        BoundingBox box;
+
+        for (const ModelInfo::VertexVN & vertex : vertices) {
+            box.add(vertex.x, vertex.y, vertex.z);
+        }
+
+        const GLfloat minV[3] = { box.minV.x, box.minV.y, box.minV.z };
+        const GLfloat size[3] = { box.maxV.x - box.minV.x, box.maxV.y - box.minV.y, box.maxV.z - box.minV.z };
+
+        ModelInfo::Indices source = indices;
+
+        std::vector<LevelOfDetail> clusters;
+
+        for (const LevelOfDetail & level : levels) {
+            size_t triangleCount = level.count / 3;
+
+            int cellsPerAxis = std::max(1, (int) std::floor(std::cbrt((double) triangleCount / CACHE_CLUSTER_TRIANGLES) + 0.5));
+
+            if (cellsPerAxis == 1) {
+                clusters.push_back(level);
+                continue;
+            }
+
+            const GLuint * triangles = indices.constData() + level.first;
+
+            std::vector<int> triangleCells(triangleCount);
+            std::vector<size_t> cellStarts(cellsPerAxis * cellsPerAxis * cellsPerAxis + 1, 0);
+
+            for (size_t t = 0; t != triangleCount; ++ t) {
+                const ModelInfo::VertexVN & p0 = vertices[triangles[3 * t]];
+                const ModelInfo::VertexVN & p1 = vertices[triangles[3 * t + 1]];
+                const ModelInfo::VertexVN & p2 = vertices[triangles[3 * t + 2]];
+
+                const GLfloat centroid[3] = { (p0.x + p1.x + p2.x) / 3.0f, (p0.y + p1.y + p2.y) / 3.0f, (p0.z + p1.z + p2.z) / 3.0f };
+
+                int cell = 0;
+
+                for (int axis = 0; axis != 3; ++ axis) {
+                    int position = size[axis] ? (int) ((centroid[axis] - minV[axis]) / size[axis] * cellsPerAxis) : 0;
+
+                    cell = cell * cellsPerAxis + std::min(std::max(position, 0), cellsPerAxis - 1);
+                }
+
+                triangleCells[t] = cell;
+
+                ++ cellStarts[cell + 1];
+            }
+
+            for (size_t cell = 1; cell != cellStarts.size(); ++ cell) {
+                cellStarts[cell] += cellStarts[cell - 1];
+            }
+
+            for (size_t cell = 0; cell + 1 != cellStarts.size(); ++ cell) {
+                if (cellStarts[cell + 1] != cellStarts[cell]) {
+                    clusters.push_back(LevelOfDetail(level.first + 3 * cellStarts[cell], 3 * (cellStarts[cell + 1] - cellStarts[cell])));
+                }
+            }
+
+            // triangles of every cell together, in the order they had
+            std::vector<size_t> offsets(cellStarts.begin(), cellStarts.end() - 1);
+
+            GLuint * bucketed = source.data() + level.first;
+
+            for (size_t t = 0; t != triangleCount; ++ t) {
+                std::copy(triangles + 3 * t, triangles + 3 * t + 3, bucketed + 3 * offsets[triangleCells[t]] ++);
+            }
+        }
+
+        int clusterCount = (int) clusters.size();
+
+        ModelInfo::Indices original = indices;
+
+        cv::parallel_for_(cv::Range(0, clusterCount),
+                          CacheOrdering(vertices.constData(), source.constData(), indices.data(), &clusters, overdrawOrdering, canceled),
+                          clusterCount);
+
+        if (canceled && canceled->load()) {
+            indices = original;
+        }
+    }
+}
+
+#endif // CACHEPROCESSING_HPP
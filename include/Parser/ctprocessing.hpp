@@ -1,7 +1,12 @@
 #ifndef CTPROCESSING_HPP
 #define CTPROCESSING_HPP
 
+#include <QtCore/QAtomicInt>
+
+#include <functional>
+
 #include "Parser/Helpers.hpp"
+#include "Parser/PixelDecoder.h"
 
 #include "Info/VolumeInfo.h"
 #include "Info/TextureInfo.h"
@@ -42,93 +47,120 @@ namespace Parser {
         //cv::equalizeHist(filtered, dst);
     }
 
-    inline void smoothSlices(const int startSlice, const int endSlice, std::vector<cv::Mat> & slices, cv::Mat & smoothed) {
-        int cols = slices.at(startSlice).cols;
-        int rows = slices.at(startSlice).rows;
+    /* averages every window of neighbourDiameter + 1 slices starting in [startWindow, endWindow):
+     * the first window is summed up, each next one only adds its incoming slice and subtracts the outgoing one
+     */
+    inline void smoothSlab(const int & startWindow, const int & endWindow, const int & neighbourDiameter,
+                           const std::vector<cv::Mat> & slices, uchar * mergeStartPoint, const size_t & sliceSize) {
+        const size_t count = slices.at(startWindow).total();
+        const quint32 windowSize = (quint32) neighbourDiameter + 1;
 
-        cv::Mat mergeMat(cv::Mat::zeros(rows, cols, CV_32FC1));
-        cv::Mat conv16;
+        std::vector<quint32> acc(count, 0);
 
-        for (int i = startSlice; i != endSlice; ++ i) {
-            slices.at(i).convertTo(conv16, CV_32FC1, FROM_8_TO_16);
-            mergeMat += conv16;
+        for (int i = startWindow; i != startWindow + neighbourDiameter + 1; ++ i) {
+            PixelDecoder::accumulate16((const quint16 *) slices.at(i).data, &(acc[0]), count);
         }
 
-        mergeMat /= (endSlice - startSlice);
-
-        mergeMat.convertTo(smoothed, CV_16UC1, FROM_16_TO_8);
-    }
+        PixelDecoder::average32(&(acc[0]), (quint16 *) mergeStartPoint, count, windowSize);
 
-    inline void mergeSlice(const int & startSlice, const int & endSlice, const size_t & sliceSize,
-                           std::vector<cv::Mat> & slices, uchar * mergeStartPoint) {
-        cv::Mat smoothed;
+        for (int window = startWindow + 1; window < endWindow; ++ window) {
+            PixelDecoder::slide16((const quint16 *) slices.at(window + neighbourDiameter).data,
+                                  (const quint16 *) slices.at(window - 1).data,
+                                  &(acc[0]), count);
 
-        smoothSlices(startSlice, endSlice, slices, smoothed);
-/*
-        if (startSlice < slices.size() / 2) {
-            cv::circle(smoothed, cv::Point(smoothed.cols / 2, smoothed.rows / 2), 5, 65535, CV_FILLED);
+            PixelDecoder::average32(&(acc[0]), (quint16 *) (mergeStartPoint + sliceSize * (window - startWindow)), count, windowSize);
         }
+    }
 
-        if (startSlice > slices.size() / 2 - 2 && startSlice < slices.size() / 2 + 2) {
-            cv::line(smoothed, cv::Point(40, smoothed.rows / 2), cv::Point(smoothed.cols / 2, smoothed.rows / 2), 64300, 3);
-            cv::line(smoothed, cv::Point(smoothed.cols / 2, 40), cv::Point(smoothed.cols / 2, smoothed.rows / 2), 64000, 3);
+    // box of the volume taken every stride-th voxel along each axis, zero size stands for "up to the end"
+    class VolumeRegion {
+    public:
+        size_t origin[3];
+        size_t size[3];
+        size_t stride[3];
+
+        VolumeRegion() {
+            for (int axis = 0; axis != 3; ++ axis) {
+                origin[axis] = 0;
+                size[axis] = 0;
+                stride[axis] = 1;
+            }
         }
-*/
-        memcpy(mergeStartPoint, smoothed.data, sliceSize);
-    }
 
-    static cv::Mutex sliceMutex;
+        // {"origin": vector3d, "size": vector3d, "stride": vector3d}, missing keys keep their defaults
+        static VolumeRegion fromVariant(const QVariant & variant) {
+            VolumeRegion region;
 
-    inline void checkNeighbours(const int & position, const int & neighbourDiameter,
-                                const int & minNeighbour, const int & maxNeighbour,
-                                std::vector<cv::Mat> & filtered, std::vector<bool> & hasMerged,
-                                const size_t & sliceSize, uchar * mergeStartPoint) {
-        int leftestMergeNeighbour = std::max(minNeighbour, position - neighbourDiameter);
-        int rightestMergeNeighbour = std::min(maxNeighbour - neighbourDiameter, position + 1);
+            const QVariantMap regionMap = variant.toMap();
 
-        int rightCheckNeighbour;
-        int currentCheckNeighbour;
+            const char * keys[] = { "origin", "size", "stride" };
+            size_t * values[] = { region.origin, region.size, region.stride };
 
-        bool canMerge;
+            for (int i = 0; i != 3; ++ i) {
+                if (!regionMap.contains(keys[i])) {
+                    continue;
+                }
 
-        for (int leftCheckNeighbour = leftestMergeNeighbour; leftCheckNeighbour != rightestMergeNeighbour; ++ leftCheckNeighbour) {
+                const QVariant value = regionMap[keys[i]];
 
-            if (hasMerged[leftCheckNeighbour]) {
-                continue;
-            }
+                QVector3D vector = value.value<QVector3D>();
 
-            rightCheckNeighbour = leftCheckNeighbour + neighbourDiameter + 1;
-            currentCheckNeighbour = leftCheckNeighbour;
+                if (value.type() == QVariant::List) {
+                    const QVariantList list = value.toList();
 
-            sliceMutex.lock();
+                    for (int axis = 0; axis != std::min(3, list.size()); ++ axis) {
+                        vector[axis] = list.at(axis).toFloat();
+                    }
+                }
 
-            canMerge = true;
+                for (int axis = 0; axis != 3; ++ axis) {
+                    values[i][axis] = (size_t) std::max(0.0f, vector[axis]);
+                }
+            }
 
-            while (canMerge && currentCheckNeighbour != rightCheckNeighbour) {
-                canMerge &= !filtered[currentCheckNeighbour ++].empty();
+            for (int axis = 0; axis != 3; ++ axis) {
+                region.stride[axis] = std::max((size_t) 1, region.stride[axis]);
             }
 
-            if (canMerge) {
-                hasMerged[leftCheckNeighbour] = true;
-                sliceMutex.unlock();
+            return region;
+        }
 
-                mergeSlice(leftCheckNeighbour, rightCheckNeighbour, sliceSize, filtered, mergeStartPoint + sliceSize * leftCheckNeighbour);
+        bool isFull() const {
+            for (int axis = 0; axis != 3; ++ axis) {
+                if (origin[axis] || size[axis] || stride[axis] != 1) {
+                    return false;
+                }
             }
-            else {
-                sliceMutex.unlock();
+
+            return true;
+        }
+
+        // box fitted into the volume, its size is never zero unless the volume is empty
+        VolumeRegion clamped(const size_t & width, const size_t & height, const size_t & depth) const {
+            const size_t dimensions[3] = { width, height, depth };
+
+            VolumeRegion region;
+
+            for (int axis = 0; axis != 3; ++ axis) {
+                region.origin[axis] = std::min(origin[axis], dimensions[axis] ? dimensions[axis] - 1 : 0);
+
+                size_t left = dimensions[axis] - region.origin[axis];
+
+                region.size[axis] = size[axis] ? std::min(size[axis], left) : left;
+                region.stride[axis] = stride[axis];
             }
+
+            return region;
         }
-    }
 
-    inline void processSlice(const int & i, std::vector<cv::Mat> & noisy, std::vector<cv::Mat> & filtered,
-                             std::vector<bool> & hasMerged,
-                             const size_t & sliceSize,
-                             const cv::Mat & dilateMat, const cv::Size & gaussSize,
-                             const int & neighbourDiameter, uchar * mergeLocation) {
-        //filterSlice(noisy[i], filtered[i], dilateMat, gaussSize);
+        inline size_t samples(const int & axis) const {
+            return (size[axis] + stride[axis] - 1) / stride[axis];
+        }
 
-        checkNeighbours(i, neighbourDiameter, 0, (int) filtered.size(), noisy, hasMerged, sliceSize, mergeLocation);
-    }
+        inline size_t source(const int & axis, const size_t & sample) const {
+            return origin[axis] + sample * stride[axis];
+        }
+    };
 
     class DicomData {
     public:
@@ -142,9 +174,17 @@ namespace Parser {
         size_t height;
         size_t depth;
 
+        // of raw slices in buffer, width and height above are of decoded ones
+        size_t rawWidth;
+        size_t rawHeight;
+
+        // x and y of the region decoded from every raw slice, z is applied before slices get into buffer
+        VolumeRegion sampling;
+
         size_t sliceSize;
 
-        char * buffer;
+        // points either to vbuffer or straight to pixel data owned by gdcm::File, which has to outlive processing
+        const char * buffer;
 
         int type;
 
@@ -171,61 +211,136 @@ namespace Parser {
         QOpenGLPixelTransferOptions * pixelTransferOptions;
 
         int neighbourRadius;
-    };
 
-    inline void decodeSlice(const int & position, std::vector<cv::Mat> & dst, const DicomData * dicomData) {
-        cv::Mat dcmToMat(cv::Mat::zeros((int) dicomData->width, (int) dicomData->height, dicomData->type));
+        // set by the owner of the load, workers skip remaining slices once it's raised
+        const QAtomicInt * canceled;
 
-        quint16 pixelU;
-        qint32 pixel;
+        // called from workers after every slice, may be empty
+        std::function<void (const int &)> sliceDecoded;
 
-        char * posInBuffer = dicomData->buffer + dicomData->sliceSize * position;
+        // called from workers once merged slices [first, first + count) are final, may be empty
+        std::function<void (const int &, const int &)> slicesMerged;
 
-        for (int y = 0; y != (int) dicomData->height; ++ y) {
-            for (int x = 0; x != (int) dicomData->width; ++ x) {
-                pixel = 0;
-                pixelU = 0;
+        inline bool isCanceled() const {
+            return canceled && canceled->load();
+        }
 
-                if (dicomData->isLittleEndian) {
-                    for (int k = 0; k < dicomData->bytesAllocated; ++ k) {
-                        pixelU |= (quint16)*(posInBuffer + k) << (8 * k);
-                    }
-                }
-                else {
-                    for (int k = dicomData->bytesAllocated - 1; k > 0 ; -- k) {
-                        pixelU |= (quint16)*posInBuffer << (8 * (dicomData->bytesAllocated - k + 1));
-                    }
-                }
+        inline void reportSlice(const int & i) const {
+            if (sliceDecoded) {
+                sliceDecoded(i);
+            }
+        }
+
+        inline void reportMerged(const int & first, const int & count) const {
+            if (slicesMerged) {
+                slicesMerged(first, count);
+            }
+        }
+    };
+
+    inline void decodePixels(const char * src, quint16 * dst, const size_t & count, const DicomData * dicomData) {
+        switch (dicomData->bytesAllocated) {
+        case 1:
+            PixelDecoder::decode8(src, dst, count);
+            break;
+        case 2:
+            if (dicomData->isLittleEndian) {
+                PixelDecoder::decode16LE(src, dst, count);
+            }
+            else {
+                PixelDecoder::decode16BE(src, dst, count);
+            }
+            break;
+        default: {
+            // wider pixels don't fit the texture anyway, keep two least significant bytes
+            const uchar * posInBuffer = (const uchar *) src;
+            const int lsb = dicomData->isLittleEndian ? 0 : dicomData->bytesAllocated - 1;
+            const int next = dicomData->isLittleEndian ? 1 : dicomData->bytesAllocated - 2;
+
+            for (size_t i = 0; i != count; ++ i) {
+                dst[i] = (quint16) (posInBuffer[lsb] | (posInBuffer[next] << 8));
 
                 posInBuffer += dicomData->bytesAllocated;
+            }
+            break;
+        }
+        }
+    }
 
-                /* see http://www.dabsoft.ch/dicom/3/C.11.2.1.2/*/ /*
-                pixel = dicomData->slope * pixelU + dicomData->intercept;
+    // cropped slices are decoded row by row, decimated rows are gathered first to keep the vector decoders
+    inline void decodeSlicePixels(const char * src, quint16 * dst, const DicomData * dicomData) {
+        if (dicomData->width == dicomData->rawWidth && dicomData->height == dicomData->rawHeight) {
+            decodePixels(src, dst, dicomData->width * dicomData->height, dicomData);
+            return;
+        }
 
-                if (pixel < dicomData->minHU || pixel > dicomData->maxHU) {
-                    dcmToMat.at<quint16>(y, x) = 0;
-                    continue;
-                }
+        const VolumeRegion & sampling = dicomData->sampling;
+        const size_t pixelSize = dicomData->bytesAllocated;
 
-                if (pixel <= (dicomData->windowCenter - 0.5 - (dicomData->windowWidth - 1) / 2.0)) {
-                    pixelU = (quint16)dicomData->minValue;
-                }
-                else if (pixel > (dicomData->windowCenter - 0.5 + (dicomData->windowWidth - 1) / 2.0)) {
-                    pixelU = (quint16)dicomData->maxValue;
-                }
-                else {
-                    pixelU = ((pixel - dicomData->windowCenter + 0.5) / (dicomData->windowWidth - 1) + 0.5) *
-                            (dicomData->maxValue - dicomData->minValue);
+        std::vector<char> gathered(sampling.stride[0] != 1 ? pixelSize * dicomData->width : 0);
+
+        for (size_t y = 0; y != dicomData->height; ++ y) {
+            const char * rawRow = src + pixelSize * (dicomData->rawWidth * sampling.source(1, y) + sampling.origin[0]);
+
+            if (!gathered.empty()) {
+                for (size_t x = 0; x != dicomData->width; ++ x) {
+                    memcpy(&(gathered[pixelSize * x]), rawRow + pixelSize * sampling.stride[0] * x, pixelSize);
                 }
-*/
 
-                dcmToMat.at<quint16>(y, x) = pixelU;
+                rawRow = &(gathered[0]);
             }
+
+            decodePixels(rawRow, dst + dicomData->width * y, dicomData->width, dicomData);
         }
+    }
+
+    /* narrows dicomData, which still describes the whole volume, to the region clamped to it;
+     * spacings grow with the stride, so the physical size of the box stays right
+     */
+    inline void sampleRegion(DicomData & dicomData, const VolumeRegion & region) {
+        dicomData.rawWidth = dicomData.width;
+        dicomData.rawHeight = dicomData.height;
+
+        dicomData.sampling = region;
+
+        dicomData.width = region.samples(0);
+        dicomData.height = region.samples(1);
+        dicomData.depth = region.samples(2);
+
+        dicomData.imageSpacings *= QVector3D(region.stride[0], region.stride[1], region.stride[2]);
+    }
+
+    /* region of a volume which is whole in memory: x and y are left to decoding,
+     * slices out of the region are dropped, so the buffer holds just the sampled ones
+     */
+    inline void cropVolume(DicomData & dicomData, const VolumeRegion & region) {
+        sampleRegion(dicomData, region.clamped(dicomData.width, dicomData.height, dicomData.depth));
+
+        const size_t sliceSize = dicomData.bytesAllocated * dicomData.rawWidth * dicomData.rawHeight;
+
+        std::vector<char> cropped(sliceSize * dicomData.depth);
+
+        for (size_t i = 0; i != dicomData.depth; ++ i) {
+            memcpy(&(cropped[sliceSize * i]), dicomData.buffer + sliceSize * dicomData.sampling.source(2, i), sliceSize);
+        }
+
+        dicomData.vbuffer.swap(cropped);
+        dicomData.buffer = dicomData.vbuffer.empty() ? nullptr : &(dicomData.vbuffer[0]);
+    }
+
+    inline void decodeSlice(const int & position, std::vector<cv::Mat> & dst, const DicomData * dicomData) {
+        cv::Mat dcmToMat((int) dicomData->height, (int) dicomData->width, CV_16UC1);
+
+        decodeSlicePixels(dicomData->buffer + dicomData->sliceSize * position, (quint16 *) dcmToMat.data, dicomData);
 
         dst.at(position) = dcmToMat;
     }
 
+    /* slices are merged in windows of neighbourDiameter + 1, consecutive windows are grouped in slabs
+     * to be smoothed with a running sum; every slab counts its slices which are still not decoded
+     * and every slice counts slabs which still need it, so no thread ever waits for another:
+     * the one that decodes the last slice of a slab smoothes it, the one that smoothes the last slab of a slice frees it
+     */
     class SliceProcessing : public cv::ParallelLoopBody {
     private:
         DicomData * _dicomData;
@@ -236,37 +351,92 @@ namespace Parser {
 
         int _neighbourDiameter;
 
-        mutable std::vector<bool>_hasMerged;
+        int _slicesMergeCount;
+
+        int _slabLength;
+        int _slabCount;
+
+        mutable std::vector<QAtomicInt> _pendingSlices;
+        mutable std::vector<QAtomicInt> _pendingMerges;
 
         mutable std::vector<cv::Mat> _noisy;
-        mutable std::vector<cv::Mat> _filtered;
 
         size_t _sliceSize;
 
+        inline void slabsOfSlice(const int & i, int & firstSlab, int & lastSlab) const {
+            firstSlab = std::min(_slabCount - 1, std::max(0, i - _neighbourDiameter) / _slabLength);
+            lastSlab = std::min(_slabCount - 1, i / _slabLength);
+        }
+
         inline void fetchCvMats(const cv::Size & newSize, const int & depth, const int & newType = CV_16UC1) {
             int slicesTotalCount = depth;
-            int slicesMergeCount = slicesTotalCount - _neighbourDiameter;
 
-            _noisy.resize(slicesTotalCount);
-            _filtered.resize(slicesTotalCount);
+            _slicesMergeCount = std::max(0, slicesTotalCount - _neighbourDiameter);
+
+            if (_neighbourDiameter && _slicesMergeCount) {
+                // long enough to amortize the first full sum, short enough to keep every thread busy
+                _slabLength = std::max(4 * (_neighbourDiameter + 1),
+                                       (_slicesMergeCount + 2 * cv::getNumThreads() - 1) / (2 * cv::getNumThreads()));
+                _slabLength = std::min(_slabLength, _slicesMergeCount);
 
-            _hasMerged.resize(slicesMergeCount, false);
+                _slabCount = (_slicesMergeCount + _slabLength - 1) / _slabLength;
 
-            cv::Mat dummyMat(cv::Mat::zeros(newSize, newType));
+                _noisy.resize(slicesTotalCount);
+
+                _pendingSlices.resize(_slabCount);
+                _pendingMerges.resize(slicesTotalCount, QAtomicInt(0));
+
+                for (int slab = 0; slab != _slabCount; ++ slab) {
+                    int startWindow = slab * _slabLength;
+                    int endWindow = std::min(_slicesMergeCount, startWindow + _slabLength);
+
+                    _pendingSlices[slab].store(endWindow - startWindow + _neighbourDiameter);
+                }
+
+                int firstSlab;
+                int lastSlab;
+
+                for (int i = 0; i != slicesTotalCount; ++ i) {
+                    slabsOfSlice(i, firstSlab, lastSlab);
+                    _pendingMerges[i].store(lastSlab - firstSlab + 1);
+                }
+            }
+            else {
+                _slabLength = 0;
+                _slabCount = 0;
+            }
+
+            cv::Mat dummyMat(newSize, newType);
 
             _sliceSize = (size_t) (dummyMat.elemSize() * dummyMat.total());
 
-            *(_dicomData->mergeLocation) = new TextureInfo::MergedData[_sliceSize * slicesMergeCount];
+            *(_dicomData->mergeLocation) = new TextureInfo::MergedData[_sliceSize * _slicesMergeCount];
 
             _dicomData->pixelTransferOptions->setAlignment((dummyMat.step & 3) ? 1 : 4);
             _dicomData->pixelTransferOptions->setRowLength((int) dummyMat.step1());
         }
 
+        inline void mergeSlab(const int & slab) const {
+            int startWindow = slab * _slabLength;
+            int endWindow = std::min(_slicesMergeCount, startWindow + _slabLength);
+
+            smoothSlab(startWindow, endWindow, _neighbourDiameter, _noisy,
+                       *(_dicomData->mergeLocation) + _sliceSize * startWindow, _sliceSize);
+
+            _dicomData->reportMerged(startWindow, endWindow - startWindow);
+
+            for (int i = startWindow; i != endWindow + _neighbourDiameter; ++ i) {
+                if (_pendingMerges[i].fetchAndAddOrdered(-1) == 1) {
+                    _noisy[i].release();
+                }
+            }
+        }
+
     public:
         SliceProcessing(DicomData * dicomData) :
             _dicomData(dicomData) {
 
-            _dicomData->sliceSize = _dicomData->bytesAllocated * _dicomData->width * _dicomData->height;
+            _dicomData->sliceSize = _dicomData->bytesAllocated * _dicomData->rawWidth * _dicomData->rawHeight;
 
             _neighbourDiameter = 2 * _dicomData->neighbourRadius;
 
@@ -276,14 +446,42 @@ namespace Parser {
             fetchCvMats(cv::Size((int) _dicomData->width, (int) _dicomData->height), (int) _dicomData->depth);
         }
 
+        // decodes i-th slice and smoothes every slab it completes, slices may come in any order from any thread
+        inline void process(const int & i) const {
+            if (!_neighbourDiameter) {
+                // nothing to smooth - decode straight into the merged block
+                decodeSlicePixels(_dicomData->buffer + _dicomData->sliceSize * i,
+                                  (quint16 *) (*(_dicomData->mergeLocation) + _sliceSize * i), _dicomData);
+
+                _dicomData->reportMerged(i, 1);
+                return;
+            }
+
+            if (!_slabCount) {
+                return;
+            }
+
+            decodeSlice(i, _noisy, _dicomData);
+
+            //filterSlice(_noisy[i], _noisy[i], _dilateMat, _gaussSize);
+
+            int firstSlab;
+            int lastSlab;
+
+            slabsOfSlice(i, firstSlab, lastSlab);
+
+            for (int slab = firstSlab; slab <= lastSlab; ++ slab) {
+                if (_pendingSlices[slab].fetchAndAddOrdered(-1) == 1) {
+                    mergeSlab(slab);
+                }
+            }
+        }
+
         virtual void operator ()(const cv::Range & r) const {
-            for (int i = r.start; i != r.end; ++ i) {
-                decodeSlice(i, _noisy, _dicomData);
-                processSlice(i, _noisy, _filtered, _hasMerged, _dicomData->sliceSize,
-                             _dilateMat, _gaussSize, _neighbourDiameter, *(_dicomData->mergeLocation));
+            for (int i = r.start; i != r.end && !_dicomData->isCanceled(); ++ i) {
+                process(i);
 
-                //_dicomData->noisy->at(i) = new cv::Mat(_noisy.at(i));
-                //_dicomData->filtered->at(i) = new cv::Mat(_filtered.at(i));
+                _dicomData->reportSlice(i);
             }
         }
     };
@@ -0,0 +1,204 @@
+#ifndef FRAMEPROCESSING_HPP
+#define FRAMEPROCESSING_HPP
+
+#include <gdcmImage.h>
+#include <gdcmFile.h>
+#include <gdcmSequenceOfFragments.h>
+#include <gdcmJPEGCodec.h>
+#include <gdcmJPEGLSCodec.h>
+#include <gdcmJPEG2000Codec.h>
+
+#include "Parser/ctprocessing.hpp"
+
+namespace Parser {
+    // compressed frames of one multi-frame image, fragments belong to the gdcm::File which has to outlive them
+    class EncapsulatedFrames {
+    public:
+        gdcm::TransferSyntax transferSyntax;
+        gdcm::PixelFormat pixelFormat;
+        gdcm::PhotometricInterpretation photometricInterpretation;
+
+        unsigned int planarConfiguration;
+
+        bool needByteSwap;
+
+        // of a single frame
+        unsigned int dimensions[3];
+
+        std::vector<std::vector<const gdcm::Fragment *> > frames;
+    };
+
+    inline gdcm::ImageCodec * createFrameCodec(const gdcm::TransferSyntax & transferSyntax) {
+        if (gdcm::JPEGCodec().CanDecode(transferSyntax)) {
+            return new gdcm::JPEGCodec;
+        }
+
+        if (gdcm::JPEGLSCodec().CanDecode(transferSyntax)) {
+            return new gdcm::JPEGLSCodec;
+        }
+
+        if (gdcm::JPEG2000Codec().CanDecode(transferSyntax)) {
+            return new gdcm::JPEG2000Codec;
+        }
+
+        return nullptr;
+    }
+
+    /* frames can be decoded independently only if we know which fragments belong to which frame:
+     * either there's a fragment per frame or basic offset table tells where frames start
+     */
+    inline bool splitFrames(const gdcm::File & dFile, const gdcm::Image & dImage, EncapsulatedFrames & encapsulatedFrames) {
+        const gdcm::TransferSyntax & transferSyntax = dImage.GetTransferSyntax();
+
+        size_t frameCount = dImage.GetNumberOfDimensions() > 2 ? dImage.GetDimension(2) : 1;
+
+        if (!transferSyntax.IsEncapsulated() || frameCount < 2) {
+            return false;
+        }
+
+        QScopedPointer<gdcm::ImageCodec> codec(createFrameCodec(transferSyntax));
+
+        if (!codec) {
+            return false;
+        }
+
+        const gdcm::DataSet & dDataSet = dFile.GetDataSet();
+        const gdcm::Tag pixelDataTag(0x7fe0, 0x0010);
+
+        if (!dDataSet.FindDataElement(pixelDataTag)) {
+            return false;
+        }
+
+        const gdcm::SequenceOfFragments * fragments = dDataSet.GetDataElement(pixelDataTag).GetSequenceOfFragments();
+
+        if (!fragments || !fragments->GetNumberOfFragments()) {
+            return false;
+        }
+
+        size_t fragmentCount = fragments->GetNumberOfFragments();
+
+        encapsulatedFrames.frames.clear();
+        encapsulatedFrames.frames.resize(frameCount);
+
+        if (fragmentCount == frameCount) {
+            for (size_t i = 0; i != fragmentCount; ++ i) {
+                encapsulatedFrames.frames[i].push_back(&(fragments->GetFragment(i)));
+            }
+        }
+        else {
+            const gdcm::ByteValue * table = fragments->GetTable().GetByteValue();
+
+            if (!table || table->GetLength() != frameCount * sizeof(quint32)) {
+                return false;
+            }
+
+            std::vector<quint32> frameOffsets(frameCount);
+            memcpy(&(frameOffsets[0]), table->GetPointer(), table->GetLength());
+
+            // offsets count from the first fragment item, each item has 8 bytes of tag and length
+            quint64 offset = 0;
+            size_t frame = 0;
+
+            for (size_t i = 0; i != fragmentCount; ++ i) {
+                while (frame + 1 < frameCount && frameOffsets[frame + 1] <= offset) {
+                    ++ frame;
+                }
+
+                const gdcm::Fragment & fragment = fragments->GetFragment(i);
+
+                encapsulatedFrames.frames[frame].push_back(&fragment);
+
+                offset += 8 + fragment.GetVL();
+            }
+
+            for (const std::vector<const gdcm::Fragment *> & frameFragments : encapsulatedFrames.frames) {
+                if (frameFragments.empty()) {
+                    return false;
+                }
+            }
+        }
+
+        encapsulatedFrames.transferSyntax = transferSyntax;
+        encapsulatedFrames.pixelFormat = dImage.GetPixelFormat();
+        encapsulatedFrames.photometricInterpretation = dImage.GetPhotometricInterpretation();
+        encapsulatedFrames.planarConfiguration = dImage.GetPlanarConfiguration();
+        encapsulatedFrames.needByteSwap = dImage.GetNeedByteSwap();
+
+        encapsulatedFrames.dimensions[0] = dImage.GetDimension(0);
+        encapsulatedFrames.dimensions[1] = dImage.GetDimension(1);
+        encapsulatedFrames.dimensions[2] = 1;
+
+        return true;
+    }
+
+    /* every worker owns its codec, decompressed frame goes to dicomData->vbuffer
+     * and right away through the slice pipeline, it doesn't wait for the rest of the volume
+     */
+    class FrameDecoding : public cv::ParallelLoopBody {
+    private:
+        const EncapsulatedFrames * _encapsulatedFrames;
+
+        DicomData * _dicomData;
+
+        const SliceProcessing * _sliceProcessing;
+
+        mutable QAtomicInt _failedCount;
+
+    public:
+        FrameDecoding(const EncapsulatedFrames * encapsulatedFrames, DicomData * dicomData, const SliceProcessing * sliceProcessing) :
+            _encapsulatedFrames(encapsulatedFrames),
+            _dicomData(dicomData),
+            _sliceProcessing(sliceProcessing),
+            _failedCount(0) {
+        }
+
+        int failedCount() const {
+            return _failedCount.load();
+        }
+
+        virtual void operator ()(const cv::Range & r) const {
+            QScopedPointer<gdcm::ImageCodec> codec(createFrameCodec(_encapsulatedFrames->transferSyntax));
+
+            codec->SetNumberOfDimensions(2);
+            codec->SetDimensions(_encapsulatedFrames->dimensions);
+            codec->SetPixelFormat(_encapsulatedFrames->pixelFormat);
+            codec->SetPhotometricInterpretation(_encapsulatedFrames->photometricInterpretation);
+            codec->SetPlanarConfiguration(_encapsulatedFrames->planarConfiguration);
+            codec->SetNeedByteSwap(_encapsulatedFrames->needByteSwap);
+
+            const gdcm::Tag pixelDataTag(0x7fe0, 0x0010);
+
+            for (int i = r.start; i != r.end && !_dicomData->isCanceled(); ++ i) {
+                gdcm::SmartPointer<gdcm::SequenceOfFragments> frameFragments = new gdcm::SequenceOfFragments;
+
+                for (const gdcm::Fragment * fragment : _encapsulatedFrames->frames[i]) {
+                    frameFragments->AddFragment(*fragment);
+                }
+
+                gdcm::DataElement frameIn(pixelDataTag);
+                frameIn.SetValue(*frameFragments);
+                frameIn.SetVLToUndefined();
+
+                gdcm::DataElement frameOut;
+
+                char * sliceLocation = &(_dicomData->vbuffer[0]) + _dicomData->sliceSize * i;
+
+                const gdcm::ByteValue * decoded = codec->Decode(frameIn, frameOut) ? frameOut.GetByteValue() : nullptr;
+
+                if (decoded && decoded->GetLength() >= _dicomData->sliceSize) {
+                    memcpy(sliceLocation, decoded->GetPointer(), _dicomData->sliceSize);
+                }
+                else {
+                    memset(sliceLocation, 0, _dicomData->sliceSize);
+                    _failedCount.fetchAndAddRelaxed(1);
+                }
+
+                _sliceProcessing->process(i);
+
+                _dicomData->reportSlice(i);
+            }
+        }
+    };
+}
+
+#endif // FRAMEPROCESSING_HPP
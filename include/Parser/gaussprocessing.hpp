@@ -0,0 +1,133 @@
+#ifndef GAUSSPROCESSING_HPP
+#define GAUSSPROCESSING_HPP
+
+#include "Parser/Helpers.hpp"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+    #define GAUSS_SSE2
+
+    #include <emmintrin.h>
+#endif
+
+// floats of a row blurred side by side by the simd sums
+#define GAUSS_SIMD_WIDTH 4
+
+// mirrors out of range positions back into [0, size), as reflect() in the kernels
+inline int reflectPosition(const int & size, const int & pos) {
+    if (pos < 0) {
+        return std::min(- pos, size - 1);
+    }
+
+    if (pos >= size) {
+        return std::max(2 * size - pos - 2, 0);
+    }
+
+    return pos;
+}
+
+namespace Parser {
+    // normalized weights of size taps (odd, one at least), weights[radius + i] is the i-th neighbour's
+    inline std::vector<float> gaussWeights(const double & sigma, const int & size) {
+        const int radius = std::max(size, 1) / 2;
+
+        std::vector<float> weights(2 * radius + 1);
+
+        const double s = 2.0 * sigma * sigma;
+
+        double sum = 0.0;
+
+        for (int i = - radius; i <= radius; ++ i) {
+            weights[radius + i] = (float) std::exp(- i * i / s);
+            sum += weights[radius + i];
+        }
+
+        for (float & weight : weights) {
+            weight = (float) (weight / sum);
+        }
+
+        return weights;
+    }
+
+    // dst = sum of weights[k] * rows[k] for every tap, rows are width floats long
+    inline void gaussWeightedSum(const float * const * rows, const std::vector<float> & weights,
+                                 float * dst, const int & width) {
+        const int taps = weights.size();
+
+        int x = 0;
+
+#ifdef GAUSS_SSE2
+        for (; x + GAUSS_SIMD_WIDTH <= width; x += GAUSS_SIMD_WIDTH) {
+            __m128 sum = _mm_setzero_ps();
+
+            for (int k = 0; k != taps; ++ k) {
+                sum = _mm_add_ps(sum, _mm_mul_ps(_mm_set1_ps(weights[k]), _mm_loadu_ps(rows[k] + x)));
+            }
+
+            _mm_storeu_ps(dst + x, sum);
+        }
+#endif
+
+        for (; x < width; ++ x) {
+            float sum = 0.0f;
+
+            for (int k = 0; k != taps; ++ k) {
+                sum += weights[k] * rows[k][x];
+            }
+
+            dst[x] = sum;
+        }
+    }
+
+    // gauss along x and y of one image, both passes stay in the cache
+    inline void gaussPlane(const cv::Mat & src, cv::Mat & dst, const std::vector<float> & weights) {
+        const int radius = weights.size() / 2;
+
+        const int width = src.cols;
+        const int height = src.rows;
+
+        cv::Mat blurred(height, width, CV_32FC1);
+
+        std::vector<float> padded(width + 2 * radius);
+        std::vector<const float *> rows(weights.size());
+
+        for (int y = 0; y != height; ++ y) {
+            const float * srcRow = src.ptr<float>(y);
+
+            for (int i = 0; i != (int) padded.size(); ++ i) {
+                padded[i] = srcRow[reflectPosition(width, i - radius)];
+            }
+
+            // shifted views of the row, so x is blurred the way y and z are
+            for (int k = 0; k != (int) rows.size(); ++ k) {
+                rows[k] = padded.data() + k;
+            }
+
+            gaussWeightedSum(rows.data(), weights, blurred.ptr<float>(y), width);
+        }
+
+        for (int y = 0; y != height; ++ y) {
+            for (int k = 0; k != (int) rows.size(); ++ k) {
+                rows[k] = blurred.ptr<float>(reflectPosition(height, y + k - radius));
+            }
+
+            gaussWeightedSum(rows.data(), weights, dst.ptr<float>(y), width);
+        }
+    }
+
+    // gauss along z of the z-th image of the volume
+    inline void gaussDepth(const QVector<cv::Mat> & src, const int & z, cv::Mat & dst, const std::vector<float> & weights) {
+        const int radius = weights.size() / 2;
+
+        std::vector<const float *> rows(weights.size());
+
+        for (int y = 0; y != dst.rows; ++ y) {
+            for (int k = 0; k != (int) rows.size(); ++ k) {
+                rows[k] = src.at(reflectPosition(src.size(), z + k - radius)).ptr<float>(y);
+            }
+
+            gaussWeightedSum(rows.data(), weights, dst.ptr<float>(y), dst.cols);
+        }
+    }
+}
+
+#endif // GAUSSPROCESSING_HPP
@@ -0,0 +1,308 @@
+#ifndef HARTLEYPROCESSING_HPP
+#define HARTLEYPROCESSING_HPP
+
+#include "Parser/Helpers.hpp"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+    #define HARTLEY_SSE2
+
+    #include <emmintrin.h>
+#endif
+
+// shortest transform, the butterflies below start with 4 point blocks
+#define HARTLEY_MIN_LENGTH 4
+// rows transformed side by side by the simd butterflies, one per lane
+#define HARTLEY_SIMD_ROWS 4
+
+// detector rows of the reconstructor are padded by this much before they are transformed
+#define PADDED_INCREASE 1.5f
+
+namespace Parser {
+    /* smallest 2^a * 3^b with a >= 2 the fast transform runs on, rows are zero padded up to it;
+     * radix-3 stages keep the padding within a third of the length instead of a half
+     */
+    inline int hartleyLength(const int & length) {
+        int hartley = 0;
+
+        for (int power3 = 1; ; power3 *= 3) {
+            int candidate = HARTLEY_MIN_LENGTH * power3;
+
+            while (candidate < length) {
+                candidate <<= 1;
+            }
+
+            if (!hartley || candidate < hartley) {
+                hartley = candidate;
+            }
+
+            if (HARTLEY_MIN_LENGTH * power3 >= length) {
+                break;
+            }
+        }
+
+        return hartley;
+    }
+
+    /* permutation and twiddles of a mixed radix fast hartley transform (Bracewell) of one length:
+     * radix-2 stages run on the power of two blocks, radix-3 ones join them up to the whole length
+     */
+    class HartleyTables {
+    public:
+        int length;
+        // power of two part of the length, 3^radix3Stages is the rest
+        int radix2Length;
+        int radix3Stages;
+
+        // where every input sample goes before the butterflies: digits of its index in reverse
+        std::vector<int> digitReversed;
+
+        // of 2 pi i / length for i in [0, length), radix-2 stages only use the first quarter
+        std::vector<float> cosTable;
+        std::vector<float> sinTable;
+
+        explicit HartleyTables(const int & length = HARTLEY_MIN_LENGTH) :
+            length(hartleyLength(length)),
+            radix2Length(this->length & - this->length),
+            radix3Stages(0),
+            digitReversed(this->length),
+            cosTable(this->length),
+            sinTable(this->length) {
+
+            int log2Length = 0;
+
+            while ((1 << log2Length) < radix2Length) {
+                ++ log2Length;
+            }
+
+            for (int rest = this->length / radix2Length; rest > 1; rest /= 3) {
+                ++ radix3Stages;
+            }
+
+            for (int i = 0; i != this->length; ++ i) {
+                // radix-3 digits first: i = 3m + r goes to the r-th third, m is placed within it the same way
+                int position = 0;
+                int block = this->length;
+                int rest = i;
+
+                for (int stage = 0; stage != radix3Stages; ++ stage) {
+                    block /= 3;
+                    position += (rest % 3) * block;
+                    rest /= 3;
+                }
+
+                int reversed = 0;
+
+                for (int bit = 0; bit != log2Length; ++ bit) {
+                    reversed |= ((rest >> bit) & 1) << (log2Length - 1 - bit);
+                }
+
+                digitReversed[i] = position + reversed;
+            }
+
+            double twoPiN = PI_TIMES_2 / this->length;
+
+            for (int i = 0; i != this->length; ++ i) {
+                cosTable[i] = (float) std::cos(twoPiN * i);
+                sinTable[i] = (float) std::sin(twoPiN * i);
+            }
+        }
+    };
+
+#ifdef HARTLEY_SSE2
+    // 4 rows in lanes, so the butterflies are the scalar ones with wider operands
+    class HartleyLanes {
+    public:
+        __m128 v;
+
+        HartleyLanes() { }
+        HartleyLanes(const __m128 & v) : v(v) { }
+
+        inline HartleyLanes operator +(const HartleyLanes & other) const {
+            return _mm_add_ps(v, other.v);
+        }
+
+        inline HartleyLanes operator -(const HartleyLanes & other) const {
+            return _mm_sub_ps(v, other.v);
+        }
+
+        inline HartleyLanes operator *(const float & factor) const {
+            return _mm_mul_ps(v, _mm_set1_ps(factor));
+        }
+    };
+#endif
+
+    /* in-place transform of data already in digit reversed order:
+     * H(k) = sum of x(n) * cas(2 pi n k / length), unscaled
+     */
+    template <class T>
+    inline void hartleyButterflies(T * x, const HartleyTables & tables) {
+        const int length = tables.length;
+        const int radix2Length = tables.radix2Length;
+
+        for (int i = 0; i < length; i += 2) {
+            T a = x[i];
+
+            x[i] = a + x[i + 1];
+            x[i + 1] = a - x[i + 1];
+        }
+
+        // blocks of 2 * half tile every power of two part of the row; the k-th and (half - k)-th pairs of a block share their twiddle
+        for (int half = 2, blocks = length / 4; half < radix2Length; half *= 2, blocks /= 2) {
+            for (int block = 0; block != blocks; ++ block) {
+                T * first = x + block * 2 * half;
+                T * second = first + half;
+
+                T a = first[0];
+
+                first[0] = a + second[0];
+                second[0] = a - second[0];
+
+                a = first[half / 2];
+
+                first[half / 2] = a + second[half / 2];
+                second[half / 2] = a - second[half / 2];
+
+                for (int k = 1; k < half / 2; ++ k) {
+                    const float & c = tables.cosTable[k * blocks];
+                    const float & s = tables.sinTable[k * blocks];
+
+                    T t1 = second[k] * c + second[half - k] * s;
+                    T t2 = second[half - k] * c - second[k] * s;
+
+                    second[k] = first[k] - t1;
+                    first[k] = first[k] + t1;
+
+                    second[half - k] = first[half - k] + t2;
+                    first[half - k] = first[half - k] - t2;
+                }
+            }
+        }
+
+        /* three transforms of third = M points each make one of 3M: H(k) = sum over r of
+         * Hr(k) * cos(2 pi r k / 3M) + Hr(-k) * sin(2 pi r k / 3M), so the k-th and (M - k)-th points of the thirds
+         * give the k-th and (M - k)-th points of every third of the result
+         */
+        for (int third = radix2Length; third < length; third *= 3) {
+            const int stride = length / (3 * third);
+
+            for (int block = 0; block != stride; ++ block) {
+                T * first = x + block * 3 * third;
+
+                for (int k = 0; k <= third / 2; ++ k) {
+                    const int j = (third - k) % third;
+
+                    const T a0 = first[k];
+                    const T a1 = first[third + k];
+                    const T a2 = first[2 * third + k];
+
+                    const T b0 = first[j];
+                    const T b1 = first[third + j];
+                    const T b2 = first[2 * third + j];
+
+                    for (int q = 0; q != 3; ++ q) {
+                        const int kq = k + q * third;
+                        // twiddles of r = 1 and 2, 2 pi r kq / 3M of the whole length's table
+                        const int t1 = (kq * stride) % length;
+                        const int t2 = (2 * kq * stride) % length;
+
+                        first[kq] = a0 + a1 * tables.cosTable[t1] + b1 * tables.sinTable[t1]
+                                + a2 * tables.cosTable[t2] + b2 * tables.sinTable[t2];
+                    }
+
+                    // k and M - k are the same point at 0 and M / 2
+                    if (j == k) {
+                        continue;
+                    }
+
+                    for (int q = 0; q != 3; ++ q) {
+                        const int jq = j + q * third;
+                        const int t1 = (jq * stride) % length;
+                        const int t2 = (2 * jq * stride) % length;
+
+                        first[jq] = b0 + b1 * tables.cosTable[t1] + a1 * tables.sinTable[t1]
+                                + b2 * tables.cosTable[t2] + a2 * tables.sinTable[t2];
+                    }
+                }
+            }
+        }
+    }
+
+    /* transforms rows [0, rows) of src into dst, rows shorter than the transform are zero padded at offset,
+     * dst rows are tables.length long and scaled by scale
+     */
+    template <class T>
+    inline void hartleyRows(const cv::Mat & src, cv::Mat & dst, const HartleyTables & tables,
+                            const int & offset = 0, const float & scale = 1.0f) {
+        const int length = tables.length;
+        const int width = std::min(src.cols, length - offset);
+
+        // where every source column lands after the digit reversal
+        std::vector<int> columns(width);
+
+        for (int col = 0; col != width; ++ col) {
+            columns[col] = tables.digitReversed[offset + col];
+        }
+
+        int row = 0;
+
+#ifdef HARTLEY_SSE2
+        std::vector<HartleyLanes> lanes(length, HartleyLanes(_mm_setzero_ps()));
+
+        for (; row + HARTLEY_SIMD_ROWS <= src.rows; row += HARTLEY_SIMD_ROWS) {
+            const T * rows[HARTLEY_SIMD_ROWS];
+
+            for (int lane = 0; lane != HARTLEY_SIMD_ROWS; ++ lane) {
+                rows[lane] = src.ptr<T>(row + lane);
+            }
+
+            for (int i = 0; i != length; ++ i) {
+                lanes[i].v = _mm_setzero_ps();
+            }
+
+            for (int col = 0; col != width; ++ col) {
+                lanes[columns[col]].v = _mm_setr_ps(rows[0][col], rows[1][col], rows[2][col], rows[3][col]);
+            }
+
+            hartleyButterflies(lanes.data(), tables);
+
+            float * dstRows[HARTLEY_SIMD_ROWS];
+
+            for (int lane = 0; lane != HARTLEY_SIMD_ROWS; ++ lane) {
+                dstRows[lane] = dst.ptr<float>(row + lane);
+            }
+
+            float values[HARTLEY_SIMD_ROWS];
+
+            for (int i = 0; i != length; ++ i) {
+                _mm_storeu_ps(values, _mm_mul_ps(lanes[i].v, _mm_set1_ps(scale)));
+
+                for (int lane = 0; lane != HARTLEY_SIMD_ROWS; ++ lane) {
+                    dstRows[lane][i] = values[lane];
+                }
+            }
+        }
+#endif
+
+        std::vector<float> x(length);
+
+        for (; row < src.rows; ++ row) {
+            const T * srcRow = src.ptr<T>(row);
+
+            std::fill(x.begin(), x.end(), 0.0f);
+
+            for (int col = 0; col != width; ++ col) {
+                x[columns[col]] = srcRow[col];
+            }
+
+            hartleyButterflies(x.data(), tables);
+
+            float * dstRow = dst.ptr<float>(row);
+
+            for (int i = 0; i != length; ++ i) {
+                dstRow[i] = x[i] * scale;
+            }
+        }
+    }
+}
+
+#endif // HARTLEYPROCESSING_HPP
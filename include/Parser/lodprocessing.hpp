@@ -0,0 +1,517 @@
+#ifndef LODPROCESSING_HPP
+#define LODPROCESSING_HPP
+
+#include <queue>
+
+#include "Parser/meshprocessing.hpp"
+
+// meshes with fewer triangles aren't simplified any further
+#define LOD_MIN_TRIANGLES 20000
+// every level keeps this part of triangles of the previous one
+#define LOD_RATIO 4
+// level is simplified in cells of LOD_GRID^3 grid at once, vertices shared by cells stay where they are
+#define LOD_GRID 4
+// open borders of scans are held in place by planes through them, weighted this much against faces
+#define LOD_BORDER_WEIGHT 100.0
+// collapses turning any face by more than ~80 degrees are refused
+#define LOD_MIN_FACE_COS 0.2
+
+namespace Parser {
+    // error quadric of Garland and Heckbert: xx xy xz xw yy yz yw zz zw ww
+    class Quadric {
+    public:
+        double a[10];
+
+        Quadric() {
+            std::fill(a, a + 10, 0.0);
+        }
+
+        // plane n * p + d = 0 with unit n
+        Quadric(const double & nx, const double & ny, const double & nz, const double & d, const double & weight) {
+            a[0] = weight * nx * nx; a[1] = weight * nx * ny; a[2] = weight * nx * nz; a[3] = weight * nx * d;
+            a[4] = weight * ny * ny; a[5] = weight * ny * nz; a[6] = weight * ny * d;
+            a[7] = weight * nz * nz; a[8] = weight * nz * d;
+            a[9] = weight * d * d;
+        }
+
+        Quadric & operator +=(const Quadric & other) {
+            for (int i = 0; i != 10; ++ i) {
+                a[i] += other.a[i];
+            }
+
+            return *this;
+        }
+
+        double error(const double & x, const double & y, const double & z) const {
+            return a[0] * x * x + 2.0 * a[1] * x * y + 2.0 * a[2] * x * z + 2.0 * a[3] * x +
+                   a[4] * y * y + 2.0 * a[5] * y * z + 2.0 * a[6] * y +
+                   a[7] * z * z + 2.0 * a[8] * z +
+                   a[9];
+        }
+    };
+
+    class LevelOfDetail {
+    public:
+        // in indices
+        size_t first;
+        size_t count;
+
+        LevelOfDetail(const size_t & first = 0, const size_t & count = 0) :
+            first(first),
+            count(count) {
+        }
+    };
+
+    class LodData {
+    public:
+        const ModelInfo::VertexVN * vertices;
+
+        // triangles of the level being simplified
+        const GLuint * indices;
+
+        std::vector<std::vector<GLuint> > cellTriangles;
+
+        // used by triangles of different cells
+        std::vector<char> locked;
+
+        std::vector<std::vector<GLuint> > cellIndices;
+    };
+
+    /* edge collapse with subset placement: a vertex always moves onto the other end of the edge,
+     * so every level indexes the same vertex buffer and only indices are added per level
+     */
+    class CellSimplifying : public cv::ParallelLoopBody {
+    private:
+        class Collapse {
+        public:
+            double cost;
+
+            int from;
+            int to;
+
+            uint fromVersion;
+            uint toVersion;
+
+            bool operator <(const Collapse & other) const {
+                // cheapest on top
+                return cost > other.cost;
+            }
+        };
+
+        LodData * _lodData;
+
+        const QAtomicInt * _canceled;
+
+        static void faceNormal(const ModelInfo::VertexVN & p0, const ModelInfo::VertexVN & p1, const ModelInfo::VertexVN & p2, double * n) {
+            double e1[3] = { (double) p1.x - p0.x, (double) p1.y - p0.y, (double) p1.z - p0.z };
+            double e2[3] = { (double) p2.x - p0.x, (double) p2.y - p0.y, (double) p2.z - p0.z };
+
+            n[0] = e1[1] * e2[2] - e1[2] * e2[1];
+            n[1] = e1[2] * e2[0] - e1[0] * e2[2];
+            n[2] = e1[0] * e2[1] - e1[1] * e2[0];
+        }
+
+    public:
+        CellSimplifying(LodData * lodData, const QAtomicInt * canceled = nullptr) :
+            _lodData(lodData),
+            _canceled(canceled) {
+        }
+
+        virtual void operator ()(const cv::Range & r) const {
+            for (int cell = r.start; cell != r.end && !(_canceled && _canceled->load()); ++ cell) {
+                simplifyCell(cell);
+            }
+        }
+
+        void simplifyCell(const int & cell) const {
+            const std::vector<GLuint> & triangles = _lodData->cellTriangles[cell];
+
+            if (triangles.empty()) {
+                return;
+            }
+
+            const ModelInfo::VertexVN * positions = _lodData->vertices;
+
+            std::unordered_map<GLuint, int> localOf;
+            localOf.reserve(triangles.size());
+
+            std::vector<GLuint> globalOf;
+            std::vector<int> corners(triangles.size() * 3);
+
+            for (size_t t = 0; t != triangles.size(); ++ t) {
+                for (int i = 0; i != 3; ++ i) {
+                    GLuint global = _lodData->indices[3 * triangles[t] + i];
+
+                    std::pair<std::unordered_map<GLuint, int>::iterator, bool> inserted =
+                            localOf.insert(std::make_pair(global, (int) globalOf.size()));
+
+                    if (inserted.second) {
+                        globalOf.push_back(global);
+                    }
+
+                    corners[3 * t + i] = inserted.first->second;
+                }
+            }
+
+            size_t vertexCount = globalOf.size();
+            size_t triangleCount = triangles.size();
+
+            std::vector<Quadric> quadrics(vertexCount);
+            std::vector<std::vector<int> > vertexTriangles(vertexCount);
+
+            std::vector<char> locked(vertexCount);
+            std::vector<char> alive(triangleCount, 1);
+            std::vector<uint> versions(vertexCount, 0);
+
+            for (size_t v = 0; v != vertexCount; ++ v) {
+                locked[v] = _lodData->locked[globalOf[v]];
+            }
+
+            // edge -> how many faces use it and the last of them
+            std::unordered_map<quint64, std::pair<int, int> > edges;
+            edges.reserve(triangleCount * 2);
+
+            for (size_t t = 0; t != triangleCount; ++ t) {
+                const int * corner = &(corners[3 * t]);
+
+                double n[3];
+                faceNormal(positions[globalOf[corner[0]]], positions[globalOf[corner[1]]], positions[globalOf[corner[2]]], n);
+
+                double length = std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+
+                if (length > 0.0) {
+                    const ModelInfo::VertexVN & p0 = positions[globalOf[corner[0]]];
+
+                    double d = - (n[0] * p0.x + n[1] * p0.y + n[2] * p0.z) / length;
+
+                    // weighted by the area
+                    Quadric quadric(n[0] / length, n[1] / length, n[2] / length, d, length * 0.5);
+
+                    for (int i = 0; i != 3; ++ i) {
+                        quadrics[corner[i]] += quadric;
+                    }
+                }
+
+                for (int i = 0; i != 3; ++ i) {
+                    vertexTriangles[corner[i]].push_back((int) t);
+
+                    int a = std::min(corner[i], corner[(i + 1) % 3]);
+                    int b = std::max(corner[i], corner[(i + 1) % 3]);
+
+                    std::pair<int, int> & edge = edges[((quint64) a << 32) | (quint64) b];
+
+                    ++ edge.first;
+                    edge.second = (int) t;
+                }
+            }
+
+            for (const std::pair<const quint64, std::pair<int, int> > & edge : edges) {
+                int a = (int) (edge.first >> 32);
+                int b = (int) (edge.first & 0xffffffff);
+
+                if (edge.second.first > 2) {
+                    // non-manifold edges are kept as they are
+                    locked[a] = locked[b] = 1;
+                    continue;
+                }
+
+                if (edge.second.first != 1) {
+                    continue;
+                }
+
+                // plane along the border edge, perpendicular to its face
+                const ModelInfo::VertexVN & pa = positions[globalOf[a]];
+                const ModelInfo::VertexVN & pb = positions[globalOf[b]];
+
+                const int * corner = &(corners[3 * edge.second.second]);
+
+                double n[3];
+                faceNormal(positions[globalOf[corner[0]]], positions[globalOf[corner[1]]], positions[globalOf[corner[2]]], n);
+
+                double e[3] = { (double) pb.x - pa.x, (double) pb.y - pa.y, (double) pb.z - pa.z };
+
+                double p[3] = {
+                    e[1] * n[2] - e[2] * n[1],
+                    e[2] * n[0] - e[0] * n[2],
+                    e[0] * n[1] - e[1] * n[0]
+                };
+
+                double length = std::sqrt(p[0] * p[0] + p[1] * p[1] + p[2] * p[2]);
+
+                if (length > 0.0) {
+                    double d = - (p[0] * pa.x + p[1] * pa.y + p[2] * pa.z) / length;
+
+                    Quadric quadric(p[0] / length, p[1] / length, p[2] / length, d,
+                                    LOD_BORDER_WEIGHT * (e[0] * e[0] + e[1] * e[1] + e[2] * e[2]));
+
+                    quadrics[a] += quadric;
+                    quadrics[b] += quadric;
+                }
+            }
+
+            std::priority_queue<Collapse> collapses;
+
+            auto pushCollapse = [&](const int & a, const int & b) {
+                Quadric sum = quadrics[a];
+                sum += quadrics[b];
+
+                Collapse collapse;
+                collapse.cost = std::numeric_limits<double>::max();
+
+                if (!locked[a]) {
+                    const ModelInfo::VertexVN & pb = positions[globalOf[b]];
+
+                    collapse.cost = sum.error(pb.x, pb.y, pb.z);
+                    collapse.from = a;
+                    collapse.to = b;
+                }
+
+                if (!locked[b]) {
+                    const ModelInfo::VertexVN & pa = positions[globalOf[a]];
+
+                    double cost = sum.error(pa.x, pa.y, pa.z);
+
+                    if (cost < collapse.cost) {
+                        collapse.cost = cost;
+                        collapse.from = b;
+                        collapse.to = a;
+                    }
+                }
+
+                if (collapse.cost != std::numeric_limits<double>::max()) {
+                    collapse.fromVersion = versions[collapse.from];
+                    collapse.toVersion = versions[collapse.to];
+
+                    collapses.push(collapse);
+                }
+            };
+
+            for (const std::pair<const quint64, std::pair<int, int> > & edge : edges) {
+                pushCollapse((int) (edge.first >> 32), (int) (edge.first & 0xffffffff));
+            }
+
+            size_t aliveCount = triangleCount;
+            size_t targetCount = triangleCount / LOD_RATIO;
+
+            while (aliveCount > targetCount && !collapses.empty()) {
+                Collapse collapse = collapses.top();
+                collapses.pop();
+
+                // some of the ends moved since, there's a fresher collapse for them in the queue
+                if (versions[collapse.from] != collapse.fromVersion || versions[collapse.to] != collapse.toVersion) {
+                    continue;
+                }
+
+                const ModelInfo::VertexVN & target = positions[globalOf[collapse.to]];
+
+                bool isFlipping = false;
+
+                for (int t : vertexTriangles[collapse.from]) {
+                    const int * corner = &(corners[3 * t]);
+
+                    if (!alive[t] || corner[0] == collapse.to || corner[1] == collapse.to || corner[2] == collapse.to) {
+                        continue;
+                    }
+
+                    const ModelInfo::VertexVN * moved[3];
+
+                    for (int i = 0; i != 3; ++ i) {
+                        moved[i] = (corner[i] == collapse.from) ? &target : &(positions[globalOf[corner[i]]]);
+                    }
+
+                    double before[3];
+                    double after[3];
+
+                    faceNormal(positions[globalOf[corner[0]]], positions[globalOf[corner[1]]], positions[globalOf[corner[2]]], before);
+                    faceNormal(*moved[0], *moved[1], *moved[2], after);
+
+                    double dot = before[0] * after[0] + before[1] * after[1] + before[2] * after[2];
+                    double lengths = std::sqrt((before[0] * before[0] + before[1] * before[1] + before[2] * before[2]) *
+                                               (after[0] * after[0] + after[1] * after[1] + after[2] * after[2]));
+
+                    if (dot <= LOD_MIN_FACE_COS * lengths) {
+                        isFlipping = true;
+                        break;
+                    }
+                }
+
+                if (isFlipping) {
+                    continue;
+                }
+
+                quadrics[collapse.to] += quadrics[collapse.from];
+
+                std::vector<int> & toTriangles = vertexTriangles[collapse.to];
+
+                for (int t : vertexTriangles[collapse.from]) {
+                    if (!alive[t]) {
+                        continue;
+                    }
+
+                    int * corner = &(corners[3 * t]);
+
+                    if (corner[0] == collapse.to || corner[1] == collapse.to || corner[2] == collapse.to) {
+                        alive[t] = 0;
+                        -- aliveCount;
+                        continue;
+                    }
+
+                    for (int i = 0; i != 3; ++ i) {
+                        if (corner[i] == collapse.from) {
+                            corner[i] = collapse.to;
+                        }
+                    }
+
+                    toTriangles.push_back(t);
+                }
+
+                std::vector<int>().swap(vertexTriangles[collapse.from]);
+
+                toTriangles.erase(std::remove_if(toTriangles.begin(), toTriangles.end(), [&alive](const int & t) {
+                    return !alive[t];
+                }), toTriangles.end());
+
+                ++ versions[collapse.from];
+                ++ versions[collapse.to];
+
+                for (int t : toTriangles) {
+                    for (int i = 0; i != 3; ++ i) {
+                        if (corners[3 * t + i] != collapse.to) {
+                            pushCollapse(collapse.to, corners[3 * t + i]);
+                        }
+                    }
+                }
+            }
+
+            std::vector<GLuint> & cellIndices = _lodData->cellIndices[cell];
+            cellIndices.reserve(aliveCount * 3);
+
+            for (size_t t = 0; t != triangleCount; ++ t) {
+                if (alive[t]) {
+                    for (int i = 0; i != 3; ++ i) {
+                        cellIndices.push_back(globalOf[corners[3 * t + i]]);
+                    }
+                }
+            }
+        }
+    };
+
+    /* simplifies triangles of indices[first, first + count) into about a LOD_RATIO part of them, appended to indices;
+     * cells are shifted with every level, so vertices locked on cell borders get their turn with the next one
+     */
+    inline size_t simplifyLevel(const ModelInfo::VerticesVN & vertices, const BoundingBox & box, ModelInfo::Indices & indices,
+                                const LevelOfDetail & level, const int & levelNumber, const QAtomicInt * canceled = nullptr) {
+        LodData lodData;
+
+        lodData.vertices = vertices.constData();
+
+        // cells of the shifted grid spill over the box by one on every axis
+        const int cellsPerAxis = LOD_GRID + 1;
+        const GLfloat shift = (levelNumber % 2) ? 0.5f : 0.0f;
+
+        GLfloat size[3] = { box.maxV.x - box.minV.x, box.maxV.y - box.minV.y, box.maxV.z - box.minV.z };
+        const GLfloat minV[3] = { box.minV.x, box.minV.y, box.minV.z };
+
+        lodData.cellTriangles.resize(cellsPerAxis * cellsPerAxis * cellsPerAxis);
+        lodData.cellIndices.resize(lodData.cellTriangles.size());
+        lodData.locked.assign(vertices.size(), 0);
+
+        std::vector<int> vertexCells(vertices.size(), -1);
+
+        const GLuint * triangles = indices.constData() + level.first;
+
+        size_t triangleCount = level.count / 3;
+
+        for (size_t t = 0; t != triangleCount; ++ t) {
+            if ((t & 0xffff) == 0 && canceled && canceled->load()) {
+                return 0;
+            }
+
+            int cell = 0;
+
+            for (int axis = 0; axis != 3; ++ axis) {
+                GLfloat centroid = 0.0f;
+
+                for (int i = 0; i != 3; ++ i) {
+                    const ModelInfo::VertexVN & vertex = vertices[triangles[3 * t + i]];
+                    centroid += (axis == 0) ? vertex.x : (axis == 1) ? vertex.y : vertex.z;
+                }
+
+                GLfloat position = size[axis] ? (centroid / 3.0f - minV[axis]) / size[axis] * LOD_GRID + shift : 0.0f;
+
+                cell = cell * cellsPerAxis + std::min(std::max((int) position, 0), cellsPerAxis - 1);
+            }
+
+            lodData.cellTriangles[cell].push_back((GLuint) t);
+
+            for (int i = 0; i != 3; ++ i) {
+                int & vertexCell = vertexCells[triangles[3 * t + i]];
+
+                if (vertexCell == -1) {
+                    vertexCell = cell;
+                }
+                else if (vertexCell != cell) {
+                    lodData.locked[triangles[3 * t + i]] = 1;
+                }
+            }
+        }
+
+        lodData.indices = triangles;
+
+        int cellCount = (int) lodData.cellTriangles.size();
+
+        cv::parallel_for_(cv::Range(0, cellCount), CellSimplifying(&lodData, canceled), cellCount);
+
+        if (canceled && canceled->load()) {
+            return 0;
+        }
+
+        size_t added = 0;
+
+        for (const std::vector<GLuint> & cellIndices : lodData.cellIndices) {
+            for (GLuint index : cellIndices) {
+                indices.push_back(index);
+            }
+
+            added += cellIndices.size();
+        }
+
+        return added;
+    }
+
+    /* first level is the mesh as it is, every next one is simplified from the previous one
+     * while it has enough triangles and simplification still gets somewhere
+     */
+    inline std::vector<LevelOfDetail> buildLevelsOfDetail(const ModelInfo::VerticesVN & vertices, ModelInfo::Indices & indices,
+                                                          const int & levelCount, const QAtomicInt * canceled = nullptr) {
+        std::vector<LevelOfDetail> levels(1, LevelOfDetail(0, indices.size()));
+
+        BoundingBox box;
+
+        for (const ModelInfo::VertexVN & vertex : vertices) {
+            box.add(vertex.x, vertex.y, vertex.z);
+        }
+
+        while ((int) levels.size() <= levelCount && levels.back().count / 3 >= LOD_MIN_TRIANGLES) {
+            LevelOfDetail level(indices.size(), 0);
+
+            level.count = simplifyLevel(vertices, box, indices, levels.back(), (int) levels.size(), canceled);
+
+            if (canceled && canceled->load()) {
+                break;
+            }
+
+            // locked borders and refused flips can stall it
+            if (level.count * 10 > levels.back().count * 9) {
+                indices.resize((int) level.first);
+                break;
+            }
+
+            levels.push_back(level);
+        }
+
+        return levels;
+    }
+}
+
+#endif // LODPROCESSING_HPP
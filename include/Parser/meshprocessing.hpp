@@ -0,0 +1,395 @@
+#ifndef MESHPROCESSING_HPP
+#define MESHPROCESSING_HPP
+
+#include <unordered_map>
+#include <limits>
+
+#include "Parser/stlprocessing.hpp"
+
+// welded vertices are spread over this many partitions by hash, every partition is clustered by one thread
+#define WELD_PARTITIONS 64
+
+namespace Parser {
+    class WeldSettings {
+    public:
+        // positions closer than this (in normalized model units) become one vertex, negative keeps the triangle soup
+        qreal epsilon;
+        // normals of faces meeting at a smaller angle (in degrees) are averaged
+        qreal creaseAngle;
+
+        explicit WeldSettings(const qreal & epsilon = 1e-5, const qreal & creaseAngle = 30.0) :
+            epsilon(epsilon),
+            creaseAngle(creaseAngle) {
+        }
+
+        bool isEnabled() const {
+            return epsilon >= 0.0;
+        }
+    };
+
+    // quantized position, epsilon 0 keeps bits of the floats as they are
+    class WeldKey {
+    public:
+        qint32 q[3];
+
+        quint32 hash;
+
+        bool operator ==(const WeldKey & other) const {
+            return q[0] == other.q[0] && q[1] == other.q[1] && q[2] == other.q[2];
+        }
+
+        int partition() const {
+            return (int) (hash >> 26) % WELD_PARTITIONS;
+        }
+    };
+
+    class WeldKeyHash {
+    public:
+        size_t operator ()(const WeldKey & key) const {
+            return key.hash;
+        }
+    };
+
+    inline WeldKey weldKey(const ModelInfo::VertexVN & vertex, const GLfloat & inverseEpsilon) {
+        WeldKey key;
+
+        const GLfloat position[3] = { vertex.x, vertex.y, vertex.z };
+
+        for (int axis = 0; axis != 3; ++ axis) {
+            if (inverseEpsilon) {
+                key.q[axis] = (qint32) std::floor(position[axis] * inverseEpsilon + 0.5f);
+            }
+            else {
+                // -0.0 and 0.0 are the same position
+                GLfloat value = position[axis] + 0.0f;
+                memcpy(&key.q[axis], &value, sizeof(qint32));
+            }
+        }
+
+        quint32 hash = 2166136261u;
+
+        for (int axis = 0; axis != 3; ++ axis) {
+            hash = (hash ^ (quint32) key.q[axis]) * 16777619u;
+            hash ^= hash >> 15;
+        }
+
+        key.hash = hash * 0x2c1b3c6du;
+
+        return key;
+    }
+
+    /* face normal goes along the one stored in the file, but comes from the geometry as files often carry zeros there;
+     * weighted one is scaled by the area, so big faces dominate averaged normals
+     */
+    inline void faceNormal(const ModelInfo::VertexVN * triangle, ModelInfo::VertexV & unit, ModelInfo::VertexV & weighted) {
+        GLfloat e1[3] = { triangle[1].x - triangle[0].x, triangle[1].y - triangle[0].y, triangle[1].z - triangle[0].z };
+        GLfloat e2[3] = { triangle[2].x - triangle[0].x, triangle[2].y - triangle[0].y, triangle[2].z - triangle[0].z };
+
+        GLfloat n[3] = {
+            e1[1] * e2[2] - e1[2] * e2[1],
+            e1[2] * e2[0] - e1[0] * e2[2],
+            e1[0] * e2[1] - e1[1] * e2[0]
+        };
+
+        if (n[0] * triangle->nx + n[1] * triangle->ny + n[2] * triangle->nz < 0.0f) {
+            n[0] = - n[0];
+            n[1] = - n[1];
+            n[2] = - n[2];
+        }
+
+        GLfloat length = std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+
+        weighted = ModelInfo::VertexV(n[0] * 0.5f, n[1] * 0.5f, n[2] * 0.5f);
+
+        if (length > 0.0f) {
+            unit = ModelInfo::VertexV(n[0] / length, n[1] / length, n[2] / length);
+            return;
+        }
+
+        GLfloat storedLength = std::sqrt(triangle->nx * triangle->nx + triangle->ny * triangle->ny + triangle->nz * triangle->nz);
+
+        unit = storedLength > 0.0f ?
+                    ModelInfo::VertexV(triangle->nx / storedLength, triangle->ny / storedLength, triangle->nz / storedLength) :
+                    ModelInfo::VertexV(0.0f, 0.0f, 0.0f);
+    }
+
+    class WeldData {
+    public:
+        const ModelInfo::VertexVN * soup;
+
+        size_t triangleCount;
+
+        GLfloat inverseEpsilon;
+        GLfloat creaseCos;
+
+        std::vector<WeldKey> keys;
+
+        std::vector<ModelInfo::VertexV> unitNormals;
+        std::vector<ModelInfo::VertexV> weightedNormals;
+
+        // vertices per chunk and partition, turned into offsets to scatter them to
+        std::vector<std::vector<size_t> > chunkPartitions;
+        std::vector<size_t> partitionStarts;
+
+        // soup vertices grouped by partition, in the order of the soup within every partition
+        std::vector<GLuint> order;
+
+        // every vertex of the soup gets its cluster: local to the partition first, global after
+        std::vector<GLuint> clusterOf;
+
+        std::vector<std::vector<ModelInfo::VertexV> > partitionNormals;
+    };
+
+    class WeldKeying : public cv::ParallelLoopBody {
+    private:
+        WeldData * _weldData;
+
+    public:
+        WeldKeying(WeldData * weldData) :
+            _weldData(weldData) {
+        }
+
+        virtual void operator ()(const cv::Range & r) const {
+            size_t first;
+            size_t last;
+
+            for (int chunk = r.start; chunk != r.end; ++ chunk) {
+                stlChunk(chunk, (int) _weldData->chunkPartitions.size(), _weldData->triangleCount, first, last);
+
+                std::vector<size_t> & partitions = _weldData->chunkPartitions[chunk];
+
+                for (size_t t = first; t != last; ++ t) {
+                    faceNormal(_weldData->soup + 3 * t, _weldData->unitNormals[t], _weldData->weightedNormals[t]);
+
+                    for (size_t v = 3 * t; v != 3 * t + 3; ++ v) {
+                        _weldData->keys[v] = weldKey(_weldData->soup[v], _weldData->inverseEpsilon);
+
+                        ++ partitions[_weldData->keys[v].partition()];
+                    }
+                }
+            }
+        }
+    };
+
+    class WeldScattering : public cv::ParallelLoopBody {
+    private:
+        WeldData * _weldData;
+
+    public:
+        WeldScattering(WeldData * weldData) :
+            _weldData(weldData) {
+        }
+
+        virtual void operator ()(const cv::Range & r) const {
+            size_t first;
+            size_t last;
+
+            for (int chunk = r.start; chunk != r.end; ++ chunk) {
+                stlChunk(chunk, (int) _weldData->chunkPartitions.size(), _weldData->triangleCount, first, last);
+
+                std::vector<size_t> & offsets = _weldData->chunkPartitions[chunk];
+
+                for (size_t v = 3 * first; v != 3 * last; ++ v) {
+                    _weldData->order[offsets[_weldData->keys[v].partition()] ++] = (GLuint) v;
+                }
+            }
+        }
+    };
+
+    /* vertices sharing a key are split further by their face normals: a vertex joins the first cluster
+     * whose first face is within the crease angle, so hard edges keep separate vertices
+     */
+    class WeldClustering : public cv::ParallelLoopBody {
+    private:
+        WeldData * _weldData;
+
+        const QAtomicInt * _canceled;
+
+    public:
+        WeldClustering(WeldData * weldData, const QAtomicInt * canceled = nullptr) :
+            _weldData(weldData),
+            _canceled(canceled) {
+        }
+
+        virtual void operator ()(const cv::Range & r) const {
+            for (int partition = r.start; partition != r.end && !(_canceled && _canceled->load()); ++ partition) {
+                size_t first = _weldData->partitionStarts[partition];
+                size_t last = _weldData->partitionStarts[partition + 1];
+
+                std::vector<ModelInfo::VertexV> & normals = _weldData->partitionNormals[partition];
+
+                // face of the first vertex and the next cluster at the same position
+                std::vector<size_t> clusterFaces;
+                std::vector<GLuint> nextClusters;
+
+                std::unordered_map<WeldKey, GLuint, WeldKeyHash> firstClusters;
+                firstClusters.reserve(last - first);
+
+                for (size_t i = first; i != last; ++ i) {
+                    GLuint v = _weldData->order[i];
+                    size_t face = v / 3;
+
+                    const ModelInfo::VertexV & unit = _weldData->unitNormals[face];
+                    const ModelInfo::VertexV & weighted = _weldData->weightedNormals[face];
+
+                    bool isDegenerate = !unit.x && !unit.y && !unit.z;
+
+                    std::pair<std::unordered_map<WeldKey, GLuint, WeldKeyHash>::iterator, bool> inserted =
+                            firstClusters.insert(std::make_pair(_weldData->keys[v], (GLuint) clusterFaces.size()));
+
+                    GLuint cluster = inserted.first->second;
+
+                    if (!inserted.second) {
+                        for (;;) {
+                            const ModelInfo::VertexV & clusterUnit = _weldData->unitNormals[clusterFaces[cluster]];
+
+                            if (isDegenerate ||
+                                unit.x * clusterUnit.x + unit.y * clusterUnit.y + unit.z * clusterUnit.z >= _weldData->creaseCos) {
+                                break;
+                            }
+
+                            if (nextClusters[cluster] == cluster) {
+                                nextClusters[cluster] = (GLuint) clusterFaces.size();
+                                cluster = nextClusters[cluster];
+                                break;
+                            }
+
+                            cluster = nextClusters[cluster];
+                        }
+                    }
+
+                    if (cluster == clusterFaces.size()) {
+                        clusterFaces.push_back(face);
+                        nextClusters.push_back(cluster);
+                        normals.push_back(ModelInfo::VertexV(0.0f, 0.0f, 0.0f));
+                    }
+
+                    normals[cluster].x += weighted.x;
+                    normals[cluster].y += weighted.y;
+                    normals[cluster].z += weighted.z;
+
+                    _weldData->clusterOf[v] = cluster;
+                }
+
+                for (size_t cluster = 0; cluster != normals.size(); ++ cluster) {
+                    ModelInfo::VertexV & normal = normals[cluster];
+
+                    GLfloat length = std::sqrt(normal.x * normal.x + normal.y * normal.y + normal.z * normal.z);
+
+                    if (length > 0.0f) {
+                        normal = ModelInfo::VertexV(normal.x / length, normal.y / length, normal.z / length);
+                    }
+                    else {
+                        normal = _weldData->unitNormals[clusterFaces[cluster]];
+                    }
+                }
+            }
+        }
+    };
+
+    /* turns the triangle soup into indexed triangles, vertices are numbered in the order of their first use;
+     * triangles collapsed by welding are dropped, returns empty buffers if canceled
+     */
+    inline ModelInfo::BuffersVN weldVertices(const ModelInfo::VerticesVN & soup, const WeldSettings & settings,
+                                             const QAtomicInt * canceled = nullptr) {
+        WeldData weldData;
+
+        weldData.soup = soup.constData();
+        weldData.triangleCount = soup.size() / 3;
+
+        weldData.inverseEpsilon = settings.epsilon > 0.0 ? (GLfloat) (1.0 / settings.epsilon) : 0.0f;
+        weldData.creaseCos = (GLfloat) std::cos(settings.creaseAngle * CV_PI / 180.0);
+
+        size_t vertexCount = weldData.triangleCount * 3;
+
+        weldData.keys.resize(vertexCount);
+        weldData.unitNormals.resize(weldData.triangleCount);
+        weldData.weightedNormals.resize(weldData.triangleCount);
+
+        int chunkCount = stlChunkCount(weldData.triangleCount);
+
+        weldData.chunkPartitions.assign(chunkCount, std::vector<size_t>(WELD_PARTITIONS, 0));
+
+        cv::parallel_for_(cv::Range(0, chunkCount), WeldKeying(&weldData), chunkCount);
+
+        // chunk counts -> offsets, partition by partition so the soup order holds within every one of them
+        weldData.partitionStarts.assign(WELD_PARTITIONS + 1, 0);
+
+        size_t offset = 0;
+
+        for (int partition = 0; partition != WELD_PARTITIONS; ++ partition) {
+            weldData.partitionStarts[partition] = offset;
+
+            for (std::vector<size_t> & partitions : weldData.chunkPartitions) {
+                size_t count = partitions[partition];
+                partitions[partition] = offset;
+                offset += count;
+            }
+        }
+
+        weldData.partitionStarts[WELD_PARTITIONS] = offset;
+
+        weldData.order.resize(vertexCount);
+
+        cv::parallel_for_(cv::Range(0, chunkCount), WeldScattering(&weldData), chunkCount);
+
+        weldData.clusterOf.resize(vertexCount);
+        weldData.partitionNormals.resize(WELD_PARTITIONS);
+
+        cv::parallel_for_(cv::Range(0, WELD_PARTITIONS), WeldClustering(&weldData, canceled), WELD_PARTITIONS);
+
+        if (canceled && canceled->load()) {
+            return ModelInfo::BuffersVN();
+        }
+
+        std::vector<size_t> clusterStarts(WELD_PARTITIONS + 1, 0);
+
+        for (int partition = 0; partition != WELD_PARTITIONS; ++ partition) {
+            clusterStarts[partition + 1] = clusterStarts[partition] + weldData.partitionNormals[partition].size();
+        }
+
+        std::vector<GLuint> numbers(clusterStarts[WELD_PARTITIONS], std::numeric_limits<GLuint>::max());
+
+        ModelInfo::VerticesVNPtr vertices = new ModelInfo::VerticesVN;
+        vertices->reserve((int) numbers.size());
+
+        ModelInfo::IndicesPtr indices = new ModelInfo::Indices;
+        indices->reserve((int) vertexCount);
+
+        for (size_t t = 0; t != weldData.triangleCount; ++ t) {
+            size_t clusters[3];
+
+            for (int i = 0; i != 3; ++ i) {
+                size_t v = 3 * t + i;
+                clusters[i] = clusterStarts[weldData.keys[v].partition()] + weldData.clusterOf[v];
+            }
+
+            if (clusters[0] == clusters[1] || clusters[1] == clusters[2] || clusters[0] == clusters[2]) {
+                continue;
+            }
+
+            for (int i = 0; i != 3; ++ i) {
+                GLuint & number = numbers[clusters[i]];
+
+                if (number == std::numeric_limits<GLuint>::max()) {
+                    size_t v = 3 * t + i;
+
+                    const ModelInfo::VertexV & normal = weldData.partitionNormals[weldData.keys[v].partition()][weldData.clusterOf[v]];
+
+                    number = (GLuint) vertices->size();
+                    vertices->push_back(ModelInfo::VertexVN(soup[v].x, soup[v].y, soup[v].z, normal.x, normal.y, normal.z));
+                }
+
+                indices->push_back(number);
+            }
+        }
+
+        ModelInfo::BuffersVN buffers;
+        buffers.vertices = ModelInfo::VerticesVNPointer(vertices);
+        buffers.indices = ModelInfo::IndicesPointer(indices);
+
+        return buffers;
+    }
+}
+
+#endif // MESHPROCESSING_HPP
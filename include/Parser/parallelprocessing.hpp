@@ -2,229 +2,296 @@
 #define PARALLELPROCESSING_HPP
 
 #include "Parser/Helpers.hpp"
+#include "Parser/hartleyprocessing.hpp"
+#include "Parser/gaussprocessing.hpp"
+
+/* native counterpart of cl/reconstructor.cl, every stage below does what its kernel does,
+ * so both paths give the same slices up to float rounding
+ */
+
+// detector rows reconstructed together, the gauss halo around them is read but not reconstructed
+typedef struct _ReconstructionSlab {
+    int first;
+    int count;
+
+    int haloFirst;
+    int haloCount;
+} ReconstructionSlab;
+
+// rows per slab so that slabsInFlight of them fit into budget next to fixedBytes, one at least
+inline int slabRowCount(const size_t & budget, const size_t & fixedBytes, const size_t & rowBytes,
+                        const int & slabsInFlight, const int & rows) {
+    if (budget <= fixedBytes) {
+        return 1;
+    }
 
-#define PADDED_INCREASE 1.5f;
+    size_t rowCount = (budget - fixedBytes) / (rowBytes * slabsInFlight);
 
-inline void calcSinogram(const int & row, const int & paddedSize,
-                         const QVector<cv::Mat> * src, cv::Mat & dst) {
-    int rowWidth = src->at(0).cols;
+    return (int) std::max((size_t) 1, std::min(rowCount, (size_t) rows));
+}
 
-    cv::Mat sinogram;
-    cv::Mat sinogramRow(cv::Mat::zeros(1, paddedSize, CV_32FC1));
+// rows near the borders of the volume reflect into their own slab, like the whole volume would
+inline QVector<ReconstructionSlab> splitSlabs(const int & rows, const int & rowsPerSlab, const int & halo) {
+    QVector<ReconstructionSlab> slabs;
 
-    int startPoint = (paddedSize - rowWidth) / 2;
+    for (int first = 0; first < rows; first += rowsPerSlab) {
+        ReconstructionSlab slab;
 
-    for (int i = 0; i != src->size(); ++ i) {
-        (src->at(i)(cv::Rect(0, row, rowWidth, 1))).copyTo(sinogramRow(cv::Rect(startPoint, 0, rowWidth, 1)));
+        slab.first = first;
+        slab.count = std::min(rowsPerSlab, rows - first);
 
-        sinogram.push_back(sinogramRow);
+        slab.haloFirst = std::max(first - halo, 0);
+        slab.haloCount = std::min(first + slab.count + halo, rows) - slab.haloFirst;
 
-        sinogramRow = cv::Scalar(0);
+        slabs.push_back(slab);
     }
 
-    sinogram.copyTo(dst);
+    return slabs;
 }
 
-template <class T>
-inline void dht(const cv::Mat & src, cv::Mat & dst, const QVector<QVector<float> > & cas,
-                const bool inverted = false) {
-    cv::Mat fft1(cv::Mat::zeros(src.rows, src.cols, CV_32FC1));
+typedef struct _ReconstructorData {
+    ReconstructionSlab slab;
 
-    float elem;
+    const QVector<cv::Mat> * src;
+    QVector<cv::Mat *> * slices;
 
-    qDebug() << src.rows << src.cols;
+    // gaussTable[radius + i] weights the i-th neighbour, as in gauss3d
+    const std::vector<float> * gaussTable;
 
-    for (int angle = 0; angle != src.rows; ++ angle) {
-        for (int col = 0; col != src.cols; ++ col) {
-            elem = 0.0f;
-            for (int i = 0; i != src.cols; i ++) {
-                elem += (src.at<T>(angle, i) * cas[col][i]);
-            }
-            fft1.at<float>(angle, col) = elem * (inverted ? (1 / (float) src.cols) : 1);
+    const Parser::HartleyTables * hartley;
+} ReconstructionData;
+
+// gauss3d along x and y, images of the volume are shared out
+class GaussPlaneLoop : public cv::ParallelLoopBody {
+private:
+    const QVector<cv::Mat> * _src;
+    QVector<cv::Mat> * _dst;
+
+    const std::vector<float> * _gaussTable;
+
+public:
+    GaussPlaneLoop(const QVector<cv::Mat> * src, QVector<cv::Mat> * dst, const std::vector<float> * gaussTable) :
+        _src(src),
+        _dst(dst),
+        _gaussTable(gaussTable) {
+    }
+
+    virtual void operator ()(const cv::Range & r) const {
+        for (int z = r.start; z != r.end; ++ z) {
+            Parser::gaussPlane(_src->at(z), (*_dst)[z], *_gaussTable);
         }
     }
+};
 
-    fft1.copyTo(dst);
-}
+// gauss3d along z, needs all of the images along x and y blurred
+class GaussDepthLoop : public cv::ParallelLoopBody {
+private:
+    const QVector<cv::Mat> * _src;
+    QVector<cv::Mat> * _dst;
 
-template <class T>
-inline void dht2D(const cv::Mat & src, cv::Mat & dst, const QVector<QVector<float> > & cas,
-                  const int & unpaddedSide,
-                  const bool inverted = false) {
-    cv::Mat hRow;
-    cv::Mat hRowT;
-    cv::Mat hCol;
-    cv::Mat hColT;
-
-    dht<T>(src, hRow, cas, inverted);
-
-    cv::transpose(hRow, hRowT);
-
-    dht<T>(hRowT, hCol, cas, inverted);
-
-    cv::transpose(hCol, hColT);
-
-    int mRow;
-    int mCol;
-    float A;
-    float B;
-    float C;
-    float D;
-    float E;
-
-    float * data = (float *) hColT.data;
-
-    for (int row = 0; row <= src.cols / 2; ++ row) { // Now calculate actual Hartley transform
-        for (int col = 0; col <= src.cols / 2; ++ col) {
-                if (row * row + col * col <= src.cols * src.cols / 4) {
-                    mRow = (src.cols - row) % src.cols;
-                    mCol = (src.cols - col)  % src.cols;
-                    A = data[row * src.cols + col];	//  see Bracewell, 'Fast 2D Hartley Transf.' IEEE Procs. 9/86
-                    B = data[mRow * src.cols + col];
-                    C = data[row * src.cols + mCol];
-                    D = data[mRow * src.cols + mCol];
-                    E = ((A + D) - (B + C)) / 2;
-                    data[row * src.cols + col] = A - E;
-                    data[mRow * src.cols + col] = B + E;
-                    data[row * src.cols + mCol] = C + E;
-                    data[mRow * src.cols + mCol] = D - E;
-                }
-                else {
-                    data[row * src.cols + col] = 0;
-                    data[mRow * src.cols + col] = 0;
-                    data[row * src.cols + mCol] = 0;
-                    data[mRow * src.cols + mCol] = 0;
-                }
+    const std::vector<float> * _gaussTable;
+
+public:
+    GaussDepthLoop(const QVector<cv::Mat> * src, QVector<cv::Mat> * dst, const std::vector<float> * gaussTable) :
+        _src(src),
+        _dst(dst),
+        _gaussTable(gaussTable) {
+    }
+
+    virtual void operator ()(const cv::Range & r) const {
+        for (int z = r.start; z != r.end; ++ z) {
+            Parser::gaussDepth(*_src, z, (*_dst)[z], *_gaussTable);
         }
     }
+};
 
-    cv::Mat hColTUnPadded(cv::Mat::zeros(unpaddedSide, unpaddedSide, src.type()));
-    //hColT(cv::Rect(src.cols / 2 - unpaddedSide, src.cols / 2 - unpaddedSide, unpaddedSide, unpaddedSide)).copyTo(hColTUnPadded);
+// same tables as calcTables: signed radius and angle in degrees of every padded frequency
+inline void calcPolarTables(const int & length, cv::Mat & tanTable, cv::Mat & radTable) {
+    tanTable.create(length, length, CV_32FC1);
+    radTable.create(length, length, CV_32FC1);
 
-    hColT.copyTo(dst);
-}
+    for (int y = 0; y != length; ++ y) {
+        float * tanRow = tanTable.ptr<float>(y);
+        float * radRow = radTable.ptr<float>(y);
+
+        for (int x = 0; x != length; ++ x) {
+            const float originX = x - length / 2.0f;
+            const float originY = y - length / 2.0f;
 
-inline void swapDht(const cv::Mat & src, cv::Mat & dst) {
-    cv::Mat swapMat(cv::Mat::zeros(src.rows, src.cols, CV_32FC1));
+            float tan = - (std::atan2(originY, originX) / (float) CV_PI) * 180.0f;
+            float rad = std::sqrt(originY * originY + originX * originX);
 
-    int pos;
+            const float k = (tan > 0.0f) ? 0.0f : 1.0f;
+            const float k180 = 180.0f * (1 - k);
 
-    for (int angle = 0; angle != src.rows; ++ angle) {
-        for (int col = 0; col != src.cols; ++ col) {
-            pos = (col + src.cols / 2) % src.cols;
-            swapMat.at<float>(angle, pos) = ((pos % 2) ? (-1) : 1) * src.at<float>(angle, col);
+            radRow[x] = rad - (1 - k) * 2 * rad;
+            tanRow[x] = std::min(tan + k180, tan * k + k180);
         }
     }
-    swapMat.copyTo(dst);
 }
 
-inline void fourier1Dto2D(const cv::Mat & src, cv::Mat & dst,
-                          const QVector<float> & sinTable, const QVector<float> & cosTable) {
-    cv::Mat swapMat;
+// fourier2d of one slice, hartley holds the transformed sinogram rows (angles x length)
+inline void fourier2d(const cv::Mat & hartley, const int & width,
+                      const cv::Mat & tanTable, const cv::Mat & radTable, cv::Mat & dst) {
+    const int length = hartley.cols;
+    const int angles = hartley.rows;
 
-    swapDht(src, swapMat);
-    cv::Mat fft2(cv::Mat::zeros(swapMat.cols, swapMat.cols, CV_32FC1));
+    const float center = width / 2.0f;
+    const float centerPadded = length / 2.0f;
 
-    cv::Point2f center = cv::Point2f(swapMat.cols / 2, swapMat.cols / 2);
-    cv::Point2f curPoint;
+    const float pad = width / (float) length;
 
-    for (int angle = 0; angle != swapMat.rows; ++ angle) {
-        for (int col = 0; col != swapMat.cols; ++ col) {
-            curPoint = center + (col - center.x) * cv::Point2f(cosTable[angle], - sinTable[angle]);
-            fft2.at<float>(curPoint) = swapMat.at<float>(angle, col);
-        }
-    }
+    dst = cv::Mat::zeros(length, length, CV_32FC1);
 
-    fft2.copyTo(dst);
-}
+    for (int y = 0; y != length; ++ y) {
+        const float * tanRow = tanTable.ptr<float>(y);
+        const float * radRow = radTable.ptr<float>(y);
+
+        const int dstY = (int) (y + (y < centerPadded ? 1 : -1) * centerPadded);
+
+        float * dstRow = dst.ptr<float>(dstY);
+
+        for (int x = 0; x != length; ++ x) {
+            const float rad = radRow[x];
+
+            const float sinoX = (centerPadded + rad) * pad;
+            const float srcX = std::round(sinoX + (rad < 0 ? 1 : -1) * center);
+
+            const int frequency = std::min(std::max((int) srcX, 0), length - 1);
+            const int angle = std::min(std::max((int) std::floor(tanRow[x]), 0), angles - 1);
 
-inline void swapMatParts(const cv::Mat & src, cv::Mat & dst) {
-    cv::Mat swapMat(src);
+            const float dhtValue = hartley.at<float>(angle, frequency);
 
-    int halfRows = std::ceil(src.rows / 2);
-    int halfCols = std::ceil(src.cols / 2);
+            const int dstX = (int) (x + (x < centerPadded ? 1 : -1) * centerPadded);
 
-    for (int y = 0; y != src.rows; ++ y) {
-        for (int x = 0; x != halfCols; ++ x) {
-            std::swap(swapMat.at<float>(y, x), swapMat.at<float>(y + (y > halfRows ? -1 : 1) * halfRows, x + halfCols));
+            dstRow[dstX] = (((int) std::round(sinoX) % 2) ? -1 : 1) * dhtValue;
         }
     }
-    swapMat.copyTo(dst);
 }
 
-typedef struct _ReconstructorData {
-    int sliceCount;
+// butterflyDht2d, the centered width x width part of the 2d transform goes to dst
+inline void butterflyDht2d(const cv::Mat & src, const int & width, cv::Mat & dst) {
+    const int length = src.cols;
 
-    QVector<cv::Mat> * src;
-    QVector<cv::Mat *> * slices;
-} ReconstructionData;
+    const int center = length / 2;
+    const int shift = center - width / 2;
+
+    dst = cv::Mat::zeros(width, width, CV_32FC1);
+
+    for (int y = 0; y <= center; ++ y) {
+        for (int x = 0; x <= center; ++ x) {
+            int posX = x;
+            int posY = y;
+            int posMX = (length - x) % length;
+            int posMY = (length - y) % length;
+
+            const float A = src.at<float>(posY, posX);
+            const float B = src.at<float>(posMY, posX);
+            const float C = src.at<float>(posY, posMX);
+            const float D = src.at<float>(posMY, posMX);
+
+            const float E = ((A + D) - (B + C)) / 2.0f;
+
+            posX += center - shift;
+            posY += center - shift;
+            posMX -= center + shift;
+            posMY -= center + shift;
+
+            const bool inX = posX >= 0 && posX < width;
+            const bool inY = posY >= 0 && posY < width;
+            const bool inMX = posMX >= 0 && posMX < width;
+            const bool inMY = posMY >= 0 && posMY < width;
+
+            if (inX && inY) {
+                dst.at<float>(posY, posX) = A - E;
+            }
+
+            if (inX && inMY) {
+                dst.at<float>(posMY, posX) = B + E;
+            }
+
+            if (inMX && inY) {
+                dst.at<float>(posY, posMX) = C + E;
+            }
+
+            if (inMX && inMY) {
+                dst.at<float>(posMY, posMX) = D - E;
+            }
+        }
+    }
+}
 
+// rows of the blurred slab are shared out, every row is reconstructed into a slice on its own
 class ReconstructorLoop : public cv::ParallelLoopBody {
 private:
     ReconstructionData * _reconstructorData;
 
-    QVector<float>_cosTable;
-    QVector<float>_sinTable;
+    QVector<cv::Mat> _gauss;
 
-    QVector<QVector<float> >_cas;
-
-    int _paddedSize;
+    cv::Mat _tanTable;
+    cv::Mat _radTable;
 
 public:
     ReconstructorLoop(ReconstructionData * reconstructionData) :
         _reconstructorData(reconstructionData) {
 
-        _reconstructorData->slices->resize(_reconstructorData->sliceCount);
+        const ReconstructionSlab & slab = _reconstructorData->slab;
 
-        for (int angle = 0; angle != _reconstructorData->src->size(); ++ angle) {
-            _cosTable.push_back(std::cos(toRad(angle)));
-            _sinTable.push_back(std::sin(toRad(angle)));
-        }
+        // views of the slab's rows, halo included
+        QVector<cv::Mat> src;
+        QVector<cv::Mat> blurred;
 
-        //_paddedSize = std::pow(2, (std::ceil(std::log2(_reconstructorData->sliceCount)) + PADDED_INCREASE));
+        for (const cv::Mat & image : *_reconstructorData->src) {
+            src.push_back(image.rowRange(slab.haloFirst, slab.haloFirst + slab.haloCount));
 
-        _paddedSize = _reconstructorData->sliceCount * PADDED_INCREASE;
+            _gauss.push_back(cv::Mat(slab.haloCount, image.cols, CV_32FC1));
+            blurred.push_back(cv::Mat(slab.haloCount, image.cols, CV_32FC1));
+        }
 
-        float twoPiN = (2 * CV_PI) / _paddedSize;
+        cv::Range images(0, src.size());
 
-        for (int i = 0; i != _paddedSize; ++ i) {
-            _cas.push_back(QVector<float>());
-            for (int k = 0; k != _paddedSize; ++ k) {
-                _cas[i].push_back(std::cos(k * twoPiN * i) + std::sin(k * twoPiN * i));
-            }
-        }
+        cv::parallel_for_(images, GaussPlaneLoop(&src, &blurred, _reconstructorData->gaussTable));
+        cv::parallel_for_(images, GaussDepthLoop(&blurred, &_gauss, _reconstructorData->gaussTable));
+
+        calcPolarTables(_reconstructorData->hartley->length, _tanTable, _radTable);
     }
 
     virtual void operator ()(const cv::Range & r) const {
-        for (int i = r.start; i != r.end; ++ i) {
-            cv::Mat slice;
+        const Parser::HartleyTables & hartley = *_reconstructorData->hartley;
 
-            calcSinogram(i, _paddedSize, _reconstructorData->src, slice);
+        const int width = _gauss.at(0).cols;
+        const int length = hartley.length;
 
-            dht<float>(slice, slice, _cas);
+        cv::Mat sinogram(_gauss.size(), width, CV_32FC1);
+        cv::Mat sinogramHartley(_gauss.size(), length, CV_32FC1);
 
-            fourier1Dto2D(slice, slice, _sinTable, _cosTable);
+        cv::Mat fourier;
+        cv::Mat rows(length, length, CV_32FC1);
 
-            swapMatParts(slice, slice);
+        const ReconstructionSlab & slab = _reconstructorData->slab;
 
-            dht2D<float>(slice, slice, _cas, _reconstructorData->src->at(0).cols, true);
+        for (int i = r.start; i != r.end; ++ i) {
+            for (int angle = 0; angle != _gauss.size(); ++ angle) {
+                _gauss.at(angle).row(slab.first - slab.haloFirst + i).copyTo(sinogram.row(angle));
+            }
 
-            swapMatParts(slice, slice);
+            // fhtSinogram
+            Parser::hartleyRows<float>(sinogram, sinogramHartley, hartley, (length - width) / 2);
 
-            cv::Mat slice8;
+            fourier2d(sinogramHartley, width, _tanTable, _radTable, fourier);
 
-            double maxVal;
-            double minVal;
+            // dht1dTranspose, twice
+            for (int pass = 0; pass != 2; ++ pass) {
+                Parser::hartleyRows<float>(fourier, rows, hartley, 0, 1.0f / length);
 
-            cv::minMaxLoc(slice, &minVal, &maxVal);
+                cv::transpose(rows, fourier);
+            }
 
-            cv::convertScaleAbs(slice, slice8,
-                                32 * 256.0f / (maxVal - minVal),
-                                minVal / (minVal - maxVal));
+            cv::Mat slice;
 
-            (*_reconstructorData->slices)[i] = new cv::Mat(slice8);
+            butterflyDht2d(fourier, width, slice);
 
-            qDebug() << i << "completed";
+            (*_reconstructorData->slices)[slab.first + i] = new cv::Mat(slice);
         }
     }
 };
@@ -0,0 +1,68 @@
+#ifndef REGIONPROCESSING_HPP
+#define REGIONPROCESSING_HPP
+
+#include <gdcmImage.h>
+#include <gdcmFile.h>
+#include <gdcmImageHelper.h>
+#include <gdcmImageRegionReader.h>
+#include <gdcmBoxRegion.h>
+
+#include "Parser/ctprocessing.hpp"
+
+namespace Parser {
+    // gdcm::ImageRegionReader reads no gdcm::Image, params are collected from the header the same way gdcm::ImageReader does
+    inline void imageFromHeader(const gdcm::File & dFile, gdcm::Image & dImage) {
+        std::vector<unsigned int> dimensions = gdcm::ImageHelper::GetDimensionsValue(dFile);
+        std::vector<double> spacing = gdcm::ImageHelper::GetSpacingValue(dFile);
+        std::vector<double> interceptSlope = gdcm::ImageHelper::GetRescaleInterceptSlopeValue(dFile);
+
+        dImage.SetNumberOfDimensions(3);
+        dImage.SetDimensions(&(dimensions[0]));
+        dImage.SetSpacing(&(spacing[0]));
+
+        dImage.SetPixelFormat(gdcm::ImageHelper::GetPixelFormatValue(dFile));
+        dImage.SetPhotometricInterpretation(gdcm::ImageHelper::GetPhotometricInterpretationValue(dFile));
+        dImage.SetTransferSyntax(dFile.GetHeader().GetDataSetTransferSyntax());
+
+        dImage.SetIntercept(interceptSlope[0]);
+        dImage.SetSlope(interceptSlope[1]);
+    }
+
+    /* reads raw frames of the region into dicomData->vbuffer: contiguous frames in one go, strided ones one by one;
+     * gdcm cuts x and y to the box, decimation is left for decoding
+     */
+    inline bool readRegionFrames(gdcm::ImageRegionReader & dIRReader, const VolumeRegion & region, DicomData * dicomData) {
+        const unsigned int xMin = region.origin[0];
+        const unsigned int xMax = region.origin[0] + region.size[0] - 1;
+        const unsigned int yMin = region.origin[1];
+        const unsigned int yMax = region.origin[1] + region.size[1] - 1;
+
+        gdcm::BoxRegion box;
+
+        if (region.stride[2] == 1) {
+            box.SetDomain(xMin, xMax, yMin, yMax, region.origin[2], region.origin[2] + dicomData->depth - 1);
+            dIRReader.SetRegion(box);
+
+            return dIRReader.ComputeBufferLength() == dicomData->vbuffer.size() &&
+                    dIRReader.ReadIntoBuffer(&(dicomData->vbuffer[0]), dicomData->vbuffer.size());
+        }
+
+        for (size_t i = 0; i != dicomData->depth && !dicomData->isCanceled(); ++ i) {
+            const unsigned int z = region.source(2, i);
+
+            box.SetDomain(xMin, xMax, yMin, yMax, z, z);
+            dIRReader.SetRegion(box);
+
+            if (dIRReader.ComputeBufferLength() != dicomData->sliceSize ||
+                !dIRReader.ReadIntoBuffer(&(dicomData->vbuffer[0]) + dicomData->sliceSize * i, dicomData->sliceSize)) {
+                return false;
+            }
+
+            dicomData->reportSlice((int) i);
+        }
+
+        return true;
+    }
+}
+
+#endif // REGIONPROCESSING_HPP
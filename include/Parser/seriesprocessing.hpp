@@ -0,0 +1,325 @@
+#ifndef SERIESPROCESSING_HPP
+#define SERIESPROCESSING_HPP
+
+#include <gdcmReader.h>
+#include <gdcmImageReader.h>
+#include <gdcmAttribute.h>
+
+#include "Parser/ctprocessing.hpp"
+
+namespace Parser {
+    class SeriesSlice {
+    public:
+        QString fileName;
+
+        std::string seriesUID;
+        std::string modality;
+        std::string transferSyntax;
+
+        // distance along the slice normal, see http://dicom.nema.org/medical/dicom/current/output/chtml/part03/sect_C.7.6.2.html
+        double location;
+
+        int instanceNumber;
+
+        size_t width;
+        size_t height;
+
+        // between columns and between rows
+        double spacingX;
+        double spacingY;
+
+        // of the file the header was read from, an indexed header is reused while they are the same
+        qint64 fileSize;
+        qint64 modified;
+
+        bool hasLocation;
+        bool isValid;
+
+        // gdcm got through the header, invalid slices which it didn't may only be unreadable for the moment
+        bool isRead;
+
+        SeriesSlice() :
+            location(0.0),
+            instanceNumber(0),
+            width(0),
+            height(0),
+            spacingX(1.0),
+            spacingY(1.0),
+            fileSize(0),
+            modified(0),
+            hasLocation(false),
+            isValid(false),
+            isRead(false) {
+        }
+    };
+
+    inline bool seriesSliceLess(const SeriesSlice & a, const SeriesSlice & b) {
+        if (a.hasLocation && b.hasLocation && a.location != b.location) {
+            return a.location < b.location;
+        }
+
+        if (a.instanceNumber != b.instanceNumber) {
+            return a.instanceNumber < b.instanceNumber;
+        }
+
+        return a.fileName < b.fileName;
+    }
+
+    inline void readSliceHeader(SeriesSlice & slice) {
+        gdcm::Reader dReader;
+        dReader.SetFileName(slice.fileName.toLocal8Bit().constData());
+
+        // everything we need is stored before pixel data, no need to read it yet
+        if (!dReader.ReadUpToTag(gdcm::Tag(0x7fe0, 0x0010), std::set<gdcm::Tag>())) {
+            return;
+        }
+
+        slice.isRead = true;
+
+        const gdcm::DataSet & dDataSet = dReader.GetFile().GetDataSet();
+
+        if (!dDataSet.FindDataElement(gdcm::Tag(0x0028, 0x0010)) ||
+            !dDataSet.FindDataElement(gdcm::Tag(0x0028, 0x0011))) {
+            return;
+        }
+
+        gdcm::Attribute<0x0028, 0x0010> rows;
+        gdcm::Attribute<0x0028, 0x0011> columns;
+
+        rows.SetFromDataSet(dDataSet);
+        columns.SetFromDataSet(dDataSet);
+
+        slice.height = rows.GetValue();
+        slice.width = columns.GetValue();
+
+        const char * transferSyntax = dReader.GetFile().GetHeader().GetDataSetTransferSyntax().GetString();
+
+        if (transferSyntax) {
+            slice.transferSyntax = transferSyntax;
+        }
+
+        if (dDataSet.FindDataElement(gdcm::Tag(0x0008, 0x0060))) {
+            gdcm::Attribute<0x0008, 0x0060> modality;
+            modality.SetFromDataSet(dDataSet);
+
+            slice.modality = modality.GetValue().Trim();
+        }
+
+        if (dDataSet.FindDataElement(gdcm::Tag(0x0028, 0x0030))) {
+            gdcm::Attribute<0x0028, 0x0030> pixelSpacing;
+            pixelSpacing.SetFromDataSet(dDataSet);
+
+            // row spacing goes first
+            slice.spacingY = pixelSpacing.GetValue(0);
+            slice.spacingX = pixelSpacing.GetValue(1);
+        }
+
+        if (dDataSet.FindDataElement(gdcm::Tag(0x0020, 0x000e))) {
+            gdcm::Attribute<0x0020, 0x000e> seriesUID;
+            seriesUID.SetFromDataSet(dDataSet);
+
+            slice.seriesUID = seriesUID.GetValue();
+        }
+
+        if (dDataSet.FindDataElement(gdcm::Tag(0x0020, 0x0013))) {
+            gdcm::Attribute<0x0020, 0x0013> instanceNumber;
+            instanceNumber.SetFromDataSet(dDataSet);
+
+            slice.instanceNumber = instanceNumber.GetValue();
+        }
+
+        if (dDataSet.FindDataElement(gdcm::Tag(0x0020, 0x0032))) {
+            gdcm::Attribute<0x0020, 0x0032> position;
+            position.SetFromDataSet(dDataSet);
+
+            QVector3D normal(0.0f, 0.0f, 1.0f);
+
+            if (dDataSet.FindDataElement(gdcm::Tag(0x0020, 0x0037))) {
+                gdcm::Attribute<0x0020, 0x0037> orientation;
+                orientation.SetFromDataSet(dDataSet);
+
+                normal = QVector3D::crossProduct(
+                            QVector3D(orientation.GetValue(0), orientation.GetValue(1), orientation.GetValue(2)),
+                            QVector3D(orientation.GetValue(3), orientation.GetValue(4), orientation.GetValue(5))
+                            );
+            }
+
+            slice.location = normal.x() * position.GetValue(0) +
+                    normal.y() * position.GetValue(1) +
+                    normal.z() * position.GetValue(2);
+
+            slice.hasLocation = true;
+        }
+
+        slice.isValid = true;
+    }
+
+    /* pixel data of uncompressed little endian files can be used right where gdcm::Reader left it,
+     * GetBuffer would only make one more copy of the same bytes; that holds as long as every
+     * allocated bit is a stored one: high bits and overlays packed into the pixel data are masked
+     * and sign extended by GetBuffer according to PixelRepresentation, so those go through it
+     */
+    inline const char * rawPixelData(const gdcm::File & dFile, const gdcm::Image & dImage) {
+        if (Q_BYTE_ORDER != Q_LITTLE_ENDIAN) {
+            return nullptr;
+        }
+
+        const gdcm::TransferSyntax & transferSyntax = dImage.GetTransferSyntax();
+
+        if (transferSyntax.IsEncapsulated() ||
+            transferSyntax.GetSwapCode() != gdcm::SwapCode::LittleEndian ||
+            transferSyntax == gdcm::TransferSyntax::DeflatedExplicitVRLittleEndian) {
+            return nullptr;
+        }
+
+        const gdcm::PixelFormat & pixelFormat = dImage.GetPixelFormat();
+
+        if (pixelFormat.GetSamplesPerPixel() != 1 ||
+            (pixelFormat.GetBitsAllocated() != 8 && pixelFormat.GetBitsAllocated() != 16) ||
+            pixelFormat.GetBitsStored() != pixelFormat.GetBitsAllocated()) {
+            return nullptr;
+        }
+
+        for (size_t i = 0; i != dImage.GetNumberOfOverlays(); ++ i) {
+            if (dImage.GetOverlay(i).IsInPixelData()) {
+                return nullptr;
+            }
+        }
+
+        const gdcm::DataSet & dDataSet = dFile.GetDataSet();
+        const gdcm::Tag pixelDataTag(0x7fe0, 0x0010);
+
+        if (!dDataSet.FindDataElement(pixelDataTag)) {
+            return nullptr;
+        }
+
+        const gdcm::ByteValue * byteValue = dDataSet.GetDataElement(pixelDataTag).GetByteValue();
+
+        if (!byteValue || byteValue->GetLength() < dImage.GetBufferLength()) {
+            return nullptr;
+        }
+
+        return byteValue->GetPointer();
+    }
+
+    class SeriesHeaderReading : public cv::ParallelLoopBody {
+    private:
+        std::vector<SeriesSlice> * _slices;
+
+        const QAtomicInt * _canceled;
+
+        std::function<void ()> _headerRead;
+
+    public:
+        // headerRead is called from workers after every header, may be empty
+        SeriesHeaderReading(std::vector<SeriesSlice> * slices, const QAtomicInt * canceled = nullptr,
+                            const std::function<void ()> & headerRead = nullptr) :
+            _slices(slices),
+            _canceled(canceled),
+            _headerRead(headerRead) {
+        }
+
+        virtual void operator ()(const cv::Range & r) const {
+            for (int i = r.start; i != r.end && !(_canceled && _canceled->load()); ++ i) {
+                readSliceHeader(_slices->at(i));
+
+                if (_headerRead) {
+                    _headerRead();
+                }
+            }
+        }
+    };
+
+    /* reads pixel data of already sorted slices; each slice goes straight to its place:
+     * decoded into the merged texture if there's nothing to smooth, or raw into dicomData->vbuffer otherwise
+     */
+    class SeriesSliceReading : public cv::ParallelLoopBody {
+    private:
+        const std::vector<SeriesSlice> * _slices;
+
+        DicomData * _dicomData;
+
+        uchar * _decodeLocation;
+
+        size_t _decodedSliceSize;
+
+        mutable cv::Mutex _mutex;
+
+    public:
+        mutable std::vector<bool> failed;
+
+        SeriesSliceReading(const std::vector<SeriesSlice> * slices, DicomData * dicomData,
+                           uchar * decodeLocation = nullptr, const size_t & decodedSliceSize = 0) :
+            _slices(slices),
+            _dicomData(dicomData),
+            _decodeLocation(decodeLocation),
+            _decodedSliceSize(decodedSliceSize) {
+
+            failed.resize(slices->size(), false);
+        }
+
+        // i-th slice from a reader that already read its file (or failed to), e.g. the one the series' params came from
+        void readSlice(const int & i, gdcm::ImageReader & dIReader, const bool & isRead, std::vector<char> & sliceBuffer) const {
+            bool canRead = isRead;
+
+            if (canRead) {
+                const gdcm::Image & dImage = dIReader.GetImage();
+
+                canRead = dImage.GetDimension(0) == _dicomData->rawWidth &&
+                        dImage.GetDimension(1) == _dicomData->rawHeight &&
+                        dImage.GetBufferLength() == _dicomData->sliceSize;
+
+                if (canRead) {
+                    if (_decodeLocation) {
+                        const char * pixelData = rawPixelData(dIReader.GetFile(), dImage);
+
+                        if (!pixelData) {
+                            sliceBuffer.resize(_dicomData->sliceSize);
+
+                            dImage.GetBuffer(&(sliceBuffer[0]));
+                            pixelData = &(sliceBuffer[0]);
+                        }
+
+                        decodeSlicePixels(pixelData, (quint16 *) (_decodeLocation + _decodedSliceSize * i), _dicomData);
+
+                        _dicomData->reportMerged(i, 1);
+                    }
+                    else {
+                        dImage.GetBuffer(&(_dicomData->vbuffer[0]) + _dicomData->sliceSize * i);
+                    }
+                }
+            }
+
+            if (!canRead) {
+                if (_decodeLocation) {
+                    memset(_decodeLocation + _decodedSliceSize * i, 0, _decodedSliceSize);
+                }
+                else {
+                    memset(&(_dicomData->vbuffer[0]) + _dicomData->sliceSize * i, 0, _dicomData->sliceSize);
+                }
+
+                _mutex.lock();
+                failed[i] = true;
+                _mutex.unlock();
+            }
+
+            _dicomData->reportSlice(i);
+        }
+
+        virtual void operator ()(const cv::Range & r) const {
+            // only needed for files which pixel data can't be used as is
+            std::vector<char> sliceBuffer;
+
+            for (int i = r.start; i != r.end && !_dicomData->isCanceled(); ++ i) {
+                gdcm::ImageReader dIReader;
+                dIReader.SetFileName(_slices->at(i).fileName.toLocal8Bit().constData());
+
+                bool isRead = dIReader.Read();
+
+                readSlice(i, dIReader, isRead, sliceBuffer);
+            }
+        }
+    };
+}
+
+#endif // SERIESPROCESSING_HPP
@@ -0,0 +1,575 @@
+#ifndef STLPROCESSING_HPP
+#define STLPROCESSING_HPP
+
+#include <QtCore/QAtomicInt>
+
+#include <functional>
+#include <cmath>
+
+#include "Parser/Helpers.hpp"
+
+#include "Parser/VertexPacker.h"
+
+#include "Model/VertexVN.h"
+
+// binary stl: 80 bytes of header and triangle count, then normal, 3 vertices and attribute per triangle
+#define STL_BINARY_HEADER 84
+#define STL_BINARY_TRIANGLE 50
+
+// ascii stl is split in chunks of at least this many bytes
+#define STL_ASCII_CHUNK_SIZE (1 << 20)
+
+namespace Parser {
+    class BoundingBox {
+    public:
+        ModelInfo::VertexV minV;
+        ModelInfo::VertexV maxV;
+
+        bool isEmpty;
+
+        BoundingBox() :
+            isEmpty(true) {
+        }
+
+        inline void add(const GLfloat & x, const GLfloat & y, const GLfloat & z) {
+            if (isEmpty) {
+                minV = ModelInfo::VertexV(x, y, z);
+                maxV = ModelInfo::VertexV(x, y, z);
+
+                isEmpty = false;
+                return;
+            }
+
+            minV.x = std::min(minV.x, x);
+            minV.y = std::min(minV.y, y);
+            minV.z = std::min(minV.z, z);
+
+            maxV.x = std::max(maxV.x, x);
+            maxV.y = std::max(maxV.y, y);
+            maxV.z = std::max(maxV.z, z);
+        }
+
+        inline void add(const BoundingBox & box) {
+            if (box.isEmpty) {
+                return;
+            }
+
+            add(box.minV.x, box.minV.y, box.minV.z);
+            add(box.maxV.x, box.maxV.y, box.maxV.z);
+        }
+    };
+
+    // maps the bounding box onto the centered box of scaleVector proportions: (v - min) * factor - scale
+    class StlNormalizing {
+    private:
+        ModelInfo::VertexV _minV;
+
+        QVector3D _factor;
+        QVector3D _scale;
+
+    public:
+        explicit StlNormalizing(const BoundingBox & box) :
+            _minV(box.minV) {
+
+            QVector3D size(box.maxV.x - box.minV.x, box.maxV.y - box.minV.y, box.maxV.z - box.minV.z);
+
+            _scale = scaleVector<float, QVector3D>(size.x(), size.y(), size.z());
+
+            for (int axis = 0; axis != 3; ++ axis) {
+                // flat models stay flat instead of turning into nans
+                _factor[axis] = size[axis] ? 2.0f * _scale[axis] / size[axis] : 0.0f;
+            }
+        }
+
+        inline void apply(const GLfloat & x, const GLfloat & y, const GLfloat & z, ModelInfo::VertexVN & vertex) const {
+            vertex.x = (x - _minV.x) * _factor.x() - _scale.x();
+            vertex.y = (y - _minV.y) * _factor.y() - _scale.y();
+            vertex.z = (z - _minV.z) * _factor.z() - _scale.z();
+        }
+    };
+
+    // a few chunks per thread keep them busy if some are slower, every chunk is a contiguous run of triangles
+    inline int stlChunkCount(const size_t & triangleCount) {
+        return (int) std::max((size_t) 1, std::min(triangleCount, (size_t) cv::getNumThreads() * 8));
+    }
+
+    inline void stlChunk(const int & chunk, const int & chunkCount, const size_t & triangleCount, size_t & first, size_t & last) {
+        first = triangleCount * chunk / chunkCount;
+        last = triangleCount * (chunk + 1) / chunkCount;
+    }
+
+    // every chunk gets its own box, threads never share one; boxes are merged once all of them are done
+    class BinaryStlBounding : public cv::ParallelLoopBody {
+    private:
+        const char * _triangles;
+
+        size_t _triangleCount;
+
+        std::vector<BoundingBox> * _boxes;
+
+    public:
+        BinaryStlBounding(const char * triangles, const size_t & triangleCount, std::vector<BoundingBox> * boxes) :
+            _triangles(triangles),
+            _triangleCount(triangleCount),
+            _boxes(boxes) {
+        }
+
+        virtual void operator ()(const cv::Range & r) const {
+            size_t first;
+            size_t last;
+
+            for (int chunk = r.start; chunk != r.end; ++ chunk) {
+                stlChunk(chunk, (int) _boxes->size(), _triangleCount, first, last);
+
+                BoundingBox box;
+
+                GLfloat triangle[9];
+
+                for (size_t i = first; i != last; ++ i) {
+                    memcpy(triangle, _triangles + STL_BINARY_TRIANGLE * i + 12, sizeof(triangle));
+
+                    box.add(triangle[0], triangle[1], triangle[2]);
+                    box.add(triangle[3], triangle[4], triangle[5]);
+                    box.add(triangle[6], triangle[7], triangle[8]);
+                }
+
+                (*_boxes)[chunk] = box;
+            }
+        }
+    };
+
+    /* parses triangles and normalizes them into the bounding box in the same pass,
+     * so every vertex is written once and never read back
+     */
+    class BinaryStlReading : public cv::ParallelLoopBody {
+    private:
+        const char * _triangles;
+
+        size_t _triangleCount;
+
+        int _chunkCount;
+
+        ModelInfo::VertexVN * _vertices;
+
+        const QAtomicInt * _canceled;
+
+        StlNormalizing _normalizing;
+
+    public:
+        BinaryStlReading(const char * triangles, const size_t & triangleCount, const int & chunkCount,
+                         const BoundingBox & box, ModelInfo::VertexVN * vertices, const QAtomicInt * canceled = nullptr) :
+            _triangles(triangles),
+            _triangleCount(triangleCount),
+            _chunkCount(chunkCount),
+            _vertices(vertices),
+            _canceled(canceled),
+            _normalizing(box) {
+        }
+
+        virtual void operator ()(const cv::Range & r) const {
+            size_t first;
+            size_t last;
+
+            for (int chunk = r.start; chunk != r.end && !(_canceled && _canceled->load()); ++ chunk) {
+                stlChunk(chunk, _chunkCount, _triangleCount, first, last);
+
+                GLfloat facet[12];
+
+                for (size_t i = first; i != last; ++ i) {
+                    memcpy(facet, _triangles + STL_BINARY_TRIANGLE * i, sizeof(facet));
+
+                    ModelInfo::VertexVN * vertex = _vertices + 3 * i;
+
+                    for (int v = 1; v != 4; ++ v, ++ vertex) {
+                        _normalizing.apply(facet[3 * v], facet[3 * v + 1], facet[3 * v + 2], *vertex);
+
+                        vertex->nx = facet[0];
+                        vertex->ny = facet[1];
+                        vertex->nz = facet[2];
+                    }
+                }
+            }
+        }
+    };
+
+    inline bool isBlank(const char & c) {
+        return c == ' ' || c == '\t' || c == '\r';
+    }
+
+    inline const char * skipBlanks(const char * pos, const char * end) {
+        while (pos != end && isBlank(*pos)) {
+            ++ pos;
+        }
+
+        return pos;
+    }
+
+    inline bool startsWith(const char * pos, const char * end, const char * word) {
+        size_t length = strlen(word);
+
+        return (size_t) (end - pos) >= length && !memcmp(pos, word, length);
+    }
+
+    /* from_chars-like float scanner: no locale, no allocations, no copies of the line;
+     * returns position right after the number or nullptr if there's none
+     */
+    inline const char * scanFloat(const char * pos, const char * end, GLfloat & value) {
+        static const double powersOf10[] = {
+            1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+            1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+        };
+
+        pos = skipBlanks(pos, end);
+
+        bool isNegative = false;
+
+        if (pos != end && (*pos == '-' || *pos == '+')) {
+            isNegative = (*pos == '-');
+            ++ pos;
+        }
+
+        // more digits than a double holds are only counted for the exponent
+        quint64 mantissa = 0;
+        int exponent = 0;
+
+        bool hasDigits = false;
+        bool isFraction = false;
+
+        for (; pos != end; ++ pos) {
+            if (*pos >= '0' && *pos <= '9') {
+                if (mantissa < 100000000000000000ULL) {
+                    mantissa = mantissa * 10 + (*pos - '0');
+                    exponent -= isFraction;
+                }
+                else {
+                    exponent += !isFraction;
+                }
+
+                hasDigits = true;
+            }
+            else if (*pos == '.' && !isFraction) {
+                isFraction = true;
+            }
+            else {
+                break;
+            }
+        }
+
+        if (!hasDigits) {
+            return nullptr;
+        }
+
+        if (pos != end && (*pos == 'e' || *pos == 'E')) {
+            const char * exponentPos = pos + 1;
+
+            bool isExponentNegative = false;
+
+            if (exponentPos != end && (*exponentPos == '-' || *exponentPos == '+')) {
+                isExponentNegative = (*exponentPos == '-');
+                ++ exponentPos;
+            }
+
+            int exponentValue = 0;
+
+            if (exponentPos != end && *exponentPos >= '0' && *exponentPos <= '9') {
+                for (; exponentPos != end && *exponentPos >= '0' && *exponentPos <= '9'; ++ exponentPos) {
+                    exponentValue = std::min(exponentValue * 10 + (*exponentPos - '0'), 100000);
+                }
+
+                exponent += isExponentNegative ? - exponentValue : exponentValue;
+                pos = exponentPos;
+            }
+        }
+
+        double result = (double) mantissa;
+
+        if (exponent < 0) {
+            result /= (- exponent < 23) ? powersOf10[- exponent] : std::pow(10.0, - exponent);
+        }
+        else if (exponent > 0) {
+            result *= (exponent < 23) ? powersOf10[exponent] : std::pow(10.0, exponent);
+        }
+
+        value = (GLfloat) (isNegative ? - result : result);
+
+        return pos;
+    }
+
+    class AsciiStlChunk {
+    public:
+        enum Ending {
+            CHUNK_END,
+            END_SOLID,
+            MALFORMED
+        };
+
+        std::vector<ModelInfo::VertexVN> vertices;
+
+        BoundingBox box;
+
+        Ending ending;
+
+        // no facet or loop is left open and there are only whole triangles
+        bool isClosed;
+
+        AsciiStlChunk() :
+            ending(MALFORMED),
+            isClosed(false) {
+        }
+    };
+
+    /* same rules as the line by line reader had: facets and outer loops have to be closed,
+     * only vertices can be inside of a triangle, the first line which isn't any of that has to be endsolid
+     */
+    inline void parseAsciiStl(const char * pos, const char * end, AsciiStlChunk & chunk, const QAtomicInt * canceled = nullptr) {
+        GLfloat normal[3] = { 0.0f, 0.0f, 0.0f };
+        GLfloat position[3];
+
+        bool outerLoopNotClosed = false;
+        bool facetNotClosed = false;
+
+        size_t lineCount = 0;
+
+        chunk.ending = AsciiStlChunk::CHUNK_END;
+
+        while (pos < end) {
+            const char * lineEnd = (const char *) memchr(pos, '\n', end - pos);
+
+            if (!lineEnd) {
+                lineEnd = end;
+            }
+
+            const char * line = skipBlanks(pos, lineEnd);
+
+            pos = (lineEnd == end) ? end : lineEnd + 1;
+
+            if ((++ lineCount & 0xfff) == 0 && canceled && canceled->load()) {
+                chunk.ending = AsciiStlChunk::MALFORMED;
+                break;
+            }
+
+            if (line == lineEnd) {
+                continue;
+            }
+
+            if (chunk.vertices.size() % 3 == 0) {
+                if ((!outerLoopNotClosed && startsWith(line, lineEnd, "outer loop")) ||
+                    (outerLoopNotClosed && startsWith(line, lineEnd, "endloop"))) {
+                    outerLoopNotClosed = !outerLoopNotClosed;
+                    continue;
+                }
+
+                if (!facetNotClosed && startsWith(line, lineEnd, "facet")) {
+                    facetNotClosed = true;
+
+                    const char * normalPos = skipBlanks(line + 5, lineEnd);
+
+                    if (startsWith(normalPos, lineEnd, "normal")) {
+                        normalPos += 6;
+
+                        for (int i = 0; i != 3 && normalPos; ++ i) {
+                            normalPos = scanFloat(normalPos, lineEnd, normal[i]);
+                        }
+
+                        if (!normalPos) {
+                            chunk.ending = AsciiStlChunk::MALFORMED;
+                            break;
+                        }
+                    }
+
+                    continue;
+                }
+
+                if (facetNotClosed && startsWith(line, lineEnd, "endfacet")) {
+                    facetNotClosed = false;
+                    continue;
+                }
+            }
+
+            if (!startsWith(line, lineEnd, "vertex")) {
+                chunk.ending = startsWith(line, lineEnd, "endsolid") ? AsciiStlChunk::END_SOLID : AsciiStlChunk::MALFORMED;
+                break;
+            }
+
+            const char * valuePos = line + 6;
+
+            for (int i = 0; i != 3 && valuePos; ++ i) {
+                valuePos = scanFloat(valuePos, lineEnd, position[i]);
+            }
+
+            if (!valuePos) {
+                chunk.ending = AsciiStlChunk::MALFORMED;
+                break;
+            }
+
+            chunk.vertices.push_back(ModelInfo::VertexVN(position[0], position[1], position[2], normal[0], normal[1], normal[2]));
+            chunk.box.add(position[0], position[1], position[2]);
+        }
+
+        chunk.isClosed = !outerLoopNotClosed && !facetNotClosed && chunk.vertices.size() % 3 == 0;
+    }
+
+    // every chunk but the first one starts at a line beginning with "facet", so it starts outside of any facet
+    inline std::vector<const char *> splitAsciiStl(const char * begin, const char * end, const int & chunkCount) {
+        std::vector<const char *> bounds(1, begin);
+
+        for (int chunk = 1; chunk < chunkCount; ++ chunk) {
+            const char * pos = std::max(bounds.back(), begin + (end - begin) * chunk / chunkCount);
+
+            while (pos < end) {
+                const char * lineStart = (const char *) memchr(pos, '\n', end - pos);
+
+                if (!lineStart) {
+                    pos = end;
+                    break;
+                }
+
+                pos = lineStart + 1;
+
+                if (startsWith(skipBlanks(pos, end), end, "facet")) {
+                    break;
+                }
+            }
+
+            if (pos >= end) {
+                break;
+            }
+
+            bounds.push_back(pos);
+        }
+
+        bounds.push_back(end);
+
+        return bounds;
+    }
+
+    /* number of leading chunks making up the solid, zero if it's malformed;
+     * chunkEndsOpen tells that a chunk was cut inside of a triangle, which only parsing in one go can sort out
+     */
+    inline size_t validAsciiStlChunks(const std::vector<AsciiStlChunk> & chunks, bool & chunkEndsOpen) {
+        chunkEndsOpen = false;
+
+        for (size_t i = 0; i != chunks.size(); ++ i) {
+            switch (chunks[i].ending) {
+            case AsciiStlChunk::END_SOLID:
+                return chunks[i].isClosed ? i + 1 : 0;
+            case AsciiStlChunk::CHUNK_END:
+                if (!chunks[i].isClosed) {
+                    chunkEndsOpen = (i + 1 != chunks.size());
+                    return 0;
+                }
+                break;
+            case AsciiStlChunk::MALFORMED:
+                return 0;
+            }
+        }
+
+        // endsolid is missing
+        return 0;
+    }
+
+    class AsciiStlParsing : public cv::ParallelLoopBody {
+    private:
+        const std::vector<const char *> * _bounds;
+
+        std::vector<AsciiStlChunk> * _chunks;
+
+        const QAtomicInt * _canceled;
+
+        std::function<void ()> _chunkParsed;
+
+    public:
+        // chunkParsed is called from workers after every chunk, may be empty
+        AsciiStlParsing(const std::vector<const char *> * bounds, std::vector<AsciiStlChunk> * chunks,
+                        const QAtomicInt * canceled = nullptr, const std::function<void ()> & chunkParsed = nullptr) :
+            _bounds(bounds),
+            _chunks(chunks),
+            _canceled(canceled),
+            _chunkParsed(chunkParsed) {
+        }
+
+        virtual void operator ()(const cv::Range & r) const {
+            for (int chunk = r.start; chunk != r.end && !(_canceled && _canceled->load()); ++ chunk) {
+                parseAsciiStl(_bounds->at(chunk), _bounds->at(chunk + 1), _chunks->at(chunk), _canceled);
+
+                if (_chunkParsed) {
+                    _chunkParsed();
+                }
+            }
+        }
+    };
+
+    // concatenates parsed chunks and normalizes them in the same pass
+    class AsciiStlConcatenating : public cv::ParallelLoopBody {
+    private:
+        const std::vector<AsciiStlChunk> * _chunks;
+
+        std::vector<size_t> _offsets;
+
+        ModelInfo::VertexVN * _vertices;
+
+        StlNormalizing _normalizing;
+
+    public:
+        AsciiStlConcatenating(const std::vector<AsciiStlChunk> * chunks, const size_t & chunkCount,
+                              const BoundingBox & box, ModelInfo::VertexVN * vertices) :
+            _chunks(chunks),
+            _offsets(chunkCount, 0),
+            _vertices(vertices),
+            _normalizing(box) {
+
+            for (size_t i = 1; i < chunkCount; ++ i) {
+                _offsets[i] = _offsets[i - 1] + chunks->at(i - 1).vertices.size();
+            }
+        }
+
+        virtual void operator ()(const cv::Range & r) const {
+            for (int chunk = r.start; chunk != r.end; ++ chunk) {
+                ModelInfo::VertexVN * vertex = _vertices + _offsets[chunk];
+
+                for (const ModelInfo::VertexVN & parsed : _chunks->at(chunk).vertices) {
+                    _normalizing.apply(parsed.x, parsed.y, parsed.z, *vertex);
+
+                    vertex->nx = parsed.nx;
+                    vertex->ny = parsed.ny;
+                    vertex->nz = parsed.nz;
+
+                    ++ vertex;
+                }
+            }
+        }
+    };
+
+    // packs contiguous runs of vertices, every chunk goes to the simd kernel as a whole
+    class VertexPacking : public cv::ParallelLoopBody {
+    private:
+        const ModelInfo::VertexVN * _src;
+
+        ModelInfo::VertexVNPacked * _dst;
+
+        size_t _count;
+
+        int _chunkCount;
+
+    public:
+        VertexPacking(const ModelInfo::VertexVN * src, ModelInfo::VertexVNPacked * dst, const size_t & count, const int & chunkCount) :
+            _src(src),
+            _dst(dst),
+            _count(count),
+            _chunkCount(chunkCount) {
+        }
+
+        virtual void operator ()(const cv::Range & r) const {
+            size_t first;
+            size_t last;
+
+            for (int chunk = r.start; chunk != r.end; ++ chunk) {
+                stlChunk(chunk, _chunkCount, _count, first, last);
+
+                VertexPacker::pack(_src + first, _dst + first, last - first);
+            }
+        }
+    };
+}
+
+#endif // STLPROCESSING_HPP
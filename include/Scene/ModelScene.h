@@ -48,6 +48,12 @@ namespace Scene {
 
         BlueprintQueue _blueprints;
 
+        // slices streamed into textures, messages come on the gui thread and are applied on the render one
+        QQueue<QVariantMap> _textureUpdates;
+        QMutex _textureUpdatesMutex;
+
+        void updateTextures();
+
         void selectModel(Model::AbstractModel * model);
 
         void render(const Model::AbstractModel::RenderState & state = Model::AbstractModel::RenderState::CORE_RENDER);
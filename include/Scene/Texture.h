@@ -18,6 +18,11 @@ namespace Scene {
 
         QOpenGLTexture * texture() const;
 
+        // uploads slices [firstSlice, firstSlice + sliceCount) of a 3d texture, data points to the whole volume
+        void setSlices(const TextureInfo::TextureInfo & textureInfo, const int & firstSlice, const int & sliceCount);
+        // all slices are there: mipmaps are generated and sampled from now on
+        void finishSlices();
+
         ~Texture();
 
         static QStringList initializationOrder;
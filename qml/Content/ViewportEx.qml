@@ -260,6 +260,27 @@ Viewport {
 
         property bool rotating: false;
 
+        // models drawn coarser while dragged get back to their finest level
+        function stopRotating() {
+            if (rotating) {
+                parent.rotate({
+                                  "header" : {
+                                      "sender" : "viewport",
+                                      "reciever" : "currentModel"
+                                  },
+                                  "data" : {
+                                      "action" : "rotate",
+                                      "params" : {
+                                          "angle" : Qt.vector3d(0.0, 0.0, 0.0),
+                                          "interactive" : false
+                                      }
+                                  }
+                              });
+            }
+
+            rotating = false;
+        }
+
         hoverEnabled: true;
 
         propagateComposedEvents: true;
@@ -313,7 +334,8 @@ Viewport {
                                             "angle" : Qt.vector3d(
                                                           (parent.invertedYAxis ? -1 : 1) * (prevMouseY - mouseY),
                                                           0.0,
-                                                          mouseX - prevMouseX)
+                                                          mouseX - prevMouseX),
+                                            "interactive" : true
                                         }
                                     }
                                 });
@@ -327,7 +349,7 @@ Viewport {
         }
 
         onReleased: {
-            rotating = false;
+            stopRotating();
         }
 
         onEntered: {
@@ -339,7 +361,7 @@ Viewport {
             prevMouseY = 0.0;
 
             parent.color = "green";
-            rotating = false;
+            stopRotating();
         }
 
         onWheel: {
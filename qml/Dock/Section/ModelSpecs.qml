@@ -214,6 +214,16 @@ Rectangle {
         }
     }
 
+    Text {
+        id: progressText;
+
+        anchors {
+            bottom: modelSpecs.bottom;
+            left: modelSpecs.left;
+            margins: 5;
+        }
+    }
+
     function recieve(message) {
         switch (message.data.action) {
         case "changeModelID" :
@@ -240,6 +250,12 @@ Rectangle {
             huRangeSlider.valueRange = huRangePossible;
             huRangeSlider.value = huRange;
             break;
+        case "setProgress" :
+            var progress = message.data["params"]["progress"];
+
+            progressText.text = progress < 1.0 ?
+                        message.data["params"]["stage"] + " " + (progress * 100).toFixed(0) + "%" : "";
+            break;
         }
     }
 }
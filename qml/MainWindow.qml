@@ -19,6 +19,9 @@ ApplicationWindow {
 
     signal recieve(variant message);
 
+    // only one file is loaded at a time, opening another one cancels it
+    property var currentReader: null;
+
     menuBar: MenuBar {
         id: menubar;
         Menu {
@@ -31,6 +34,13 @@ ApplicationWindow {
                 }
             }
 
+            MenuItem {
+                text: qsTr("Open dicom series");
+                onTriggered: {
+                    openFileDialogDicomSeries.visible = true;
+                }
+            }
+
             MenuItem {
                 text: qsTr("Open reconstructor");
                 onTriggered: {
@@ -69,6 +79,54 @@ ApplicationWindow {
         onAccepted: readDicom(fileUrl)
     }
 
+    FileDialog {
+        id: openFileDialogDicomSeries;
+        title: qsTr("Choose DICOM series folder");
+        selectFolder: true;
+        onAccepted: indexDicomSeries([fileUrl]);
+    }
+
+    // folder may hold several series, the one to load is picked here
+    Dialog {
+        id: seriesDialog;
+        title: qsTr("Choose DICOM series");
+        standardButtons: StandardButton.Ok | StandardButton.Cancel;
+
+        property var dicomIndex: null;
+
+        ListView {
+            id: seriesList;
+
+            width: 480;
+            height: 240;
+
+            clip: true;
+
+            model: seriesDialog.dicomIndex ? seriesDialog.dicomIndex.series : [];
+
+            highlight: Rectangle {
+                color: "lightsteelblue";
+            }
+
+            delegate: Text {
+                width: seriesList.width;
+
+                text: modelData.modality + " " + modelData.width + "x" + modelData.height + "x" + modelData.slices +
+                      ", " + modelData.directory;
+
+                MouseArea {
+                    anchors.fill: parent;
+
+                    onClicked: seriesList.currentIndex = index;
+                    onDoubleClicked: seriesDialog.click(StandardButton.Ok);
+                }
+            }
+        }
+
+        onAccepted: readIndexedSeries(seriesList.currentIndex);
+        onRejected: readIndexedSeries(-1);
+    }
+
     FileDialog {
         id: openFileDialogReconstructor;
         title: qsTr("Choose image files");
@@ -82,14 +140,96 @@ ApplicationWindow {
         onAccepted: readSTL(fileUrl);
     }
 
-    function readDicom(fileUrl) {
+    function cancelCurrentReader() {
+        if (currentReader) {
+            currentReader.cancel();
+        }
+
+        currentReader = null;
+    }
+
+    // region is optional: {"origin": vector3d, "size": vector3d, "stride": vector3d}
+    function readDicom(fileUrl, region) {
+        cancelCurrentReader();
+
         var component = Qt.createComponent("Parser/DicomReaderEx.qml");
         var dicomReader = component.createObject(null, {
                                                    "viewer" : viewerContent.viewer
                                                });
+        currentReader = dicomReader;
+
+        if (region) {
+            dicomReader.region = region;
+        }
+
         dicomReader.file = fileUrl;
     }
 
+    // series of the folders are listed first, headers only
+    function indexDicomSeries(folderUrls) {
+        cancelCurrentReader();
+
+        var component = Qt.createComponent("Parser/DicomIndexEx.qml");
+        var dicomIndex = component.createObject(null, {
+                                                  "viewer" : viewerContent.viewer
+                                              });
+        currentReader = dicomIndex;
+
+        dicomIndex.seriesChanged.connect(function() {
+            if (currentReader !== dicomIndex) {
+                dicomIndex.destroy();
+                return;
+            }
+
+            currentReader = null;
+
+            seriesDialog.dicomIndex = dicomIndex;
+
+            if (dicomIndex.series.length > 1) {
+                seriesList.currentIndex = 0;
+                seriesDialog.open();
+            }
+            else {
+                readIndexedSeries(dicomIndex.series.length - 1);
+            }
+        });
+
+        dicomIndex.files = folderUrls;
+    }
+
+    // position in the series of the index shown by seriesDialog, -1 just drops the index
+    function readIndexedSeries(position) {
+        var dicomIndex = seriesDialog.dicomIndex;
+
+        seriesDialog.dicomIndex = null;
+
+        if (!dicomIndex) {
+            return;
+        }
+
+        if (position >= 0 && position < dicomIndex.series.length) {
+            readDicomSeries(dicomIndex.seriesFiles(dicomIndex.series[position].seriesUID));
+        }
+
+        dicomIndex.destroy();
+    }
+
+    function readDicomSeries(fileUrls, region) {
+        cancelCurrentReader();
+
+        var component = Qt.createComponent("Parser/DicomReaderEx.qml");
+        var dicomReader = component.createObject(null, {
+                                                   "viewer" : viewerContent.viewer
+                                               });
+        currentReader = dicomReader;
+
+        if (region) {
+            dicomReader.region = region;
+        }
+
+        dicomReader.files = fileUrls;
+    }
+
     function readReconstructor(fileUrls) {
         var component = Qt.createComponent("Parser/ReconstructorEx.qml");
         var reconstructor = component.createObject(null, {
@@ -99,10 +239,13 @@ ApplicationWindow {
     }
 
     function readSTL(fileUrl) {
+        cancelCurrentReader();
+
         var component = Qt.createComponent("Parser/StlReaderEx.qml");
         var stlReader = component.createObject(null, {
                                                    "viewer" : viewerContent.viewer
                                                });
+        currentReader = stlReader;
         stlReader.file = fileUrl;
     }
 
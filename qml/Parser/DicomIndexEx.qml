@@ -0,0 +1,20 @@
+import QtQuick 2.3;
+
+import ParserTools 1.0;
+
+DicomIndex {
+    id: dicomIndex;
+
+    property var viewer: ({});
+
+    onSend: {
+        viewer.message = model;
+    }
+
+    onFinished: {
+        // series found are taken over by seriesChanged, nothing to pick from otherwise
+        if (!success) {
+            destroy();
+        }
+    }
+}
@@ -7,6 +7,8 @@ DicomReader {
 
     property var viewer: ({});
 
+    progressive: true;
+
     blueprint: {
             "textures" : [ {
                     "id" : "volume"
@@ -77,7 +79,13 @@ DicomReader {
 
     onSend: {
         viewer.message = model;
-        viewer.toggleDocks();
+    }
+
+    onFinished: {
+        if (success) {
+            viewer.toggleDocks();
+        }
+
         destroy();
     }
 }
@@ -56,6 +56,7 @@ StlReader {
                             "shineness" : "material.shininess"
                         }
                     },
+                    "coarseWhileRotating" : true,
                     "viewRangeShader" : {
                         "x" : "ranges.xRange",
                         "y" : "ranges.yRange",
@@ -69,8 +70,14 @@ StlReader {
     onSend: {
         if (viewer) {
             viewer.message = model;
+        }
+    }
+
+    onFinished: {
+        if (viewer && success) {
             viewer.toggleDocks();
-            destroy();
         }
+
+        destroy();
     }
 }
@@ -1,6 +1,6 @@
 #version 410
 layout(location = 0) in highp vec4 vertex;
-layout(location = 1) in highp vec3 normal;
+layout(location = 1) in highp vec2 normal;
 
 uniform highp mat4 model;
 uniform highp mat4 view;
@@ -12,11 +12,21 @@ layout(location = 0) out highp vec4 pos;
 layout(location = 1) out highp vec3 vertexTest;
 layout(location = 2) out highp vec4 N;
 
+// normal is packed onto the octahedron |x| + |y| + |z| = 1, its lower half folded over the upper one
+highp vec3 decodeOctahedral(highp vec2 e) {
+    highp vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+    highp float t = max(-n.z, 0.0);
+
+    n.xy += mix(vec2(t), vec2(-t), greaterThanEqual(n.xy, vec2(0.0)));
+
+    return normalize(n);
+}
+
 void main(void) {
     pos = model * vertex;
 
     vertexTest = vec3(vertex);
-    N = vec4(normalize(normalMatrix * normal), 0.0);
+    N = vec4(normalize(normalMatrix * decodeOctahedral(normal)), 0.0);
 
     gl_Position = projection * view * pos;
 }
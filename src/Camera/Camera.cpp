@@ -161,6 +161,20 @@ namespace Camera {
         }
     }
 
+    bool Camera::unprojectRay(const PointsInfo::Position2D & projection, const Matrix & mvp,
+                              PointsInfo::Position3D & origin, PointsInfo::Position3D & direction) {
+        PointsInfo::Position3D farPoint;
+
+        if (!unproject(PointsInfo::Position3D(projection.x(), projection.y(), 0.0f), mvp, origin)
+                || !unproject(PointsInfo::Position3D(projection.x(), projection.y(), 1.0f), mvp, farPoint)) {
+            return false;
+        }
+
+        direction = farPoint - origin;
+
+        return true;
+    }
+
     ModelMatrix Camera::modelBillboard() const {
         return _billboard.modelBillboard;
     }
@@ -3,10 +3,73 @@
 #include <QtCore/QTextStream>
 #include <QtCore/QTextCodec>
 #include <QtCore/QFile>
+#include <QtCore/QDir>
+#include <QtCore/QSaveFile>
+#include <QtCore/QStandardPaths>
+#include <QtCore/QCryptographicHash>
+#include <QtCore/QJsonDocument>
+#include <QtCore/QDebug>
 
 #include <OpenGL.h>
 
+// bump it whenever the way binaries are stored changes
+#define PROGRAM_CACHE_VERSION 1
+
 namespace CLInfo {
+    static Device selectedDevice = GPU;
+    static size_t selectedMemoryBudget = 0;
+    static QString selectedBuildOptions;
+    static bool selectedAutotuning = false;
+
+    Device device() {
+        return selectedDevice;
+    }
+
+    void setDevice(const Device & device) {
+        selectedDevice = device;
+    }
+
+    Device deviceFromName(const QString & name) {
+        QString lowerName = name.toLower();
+
+        if (lowerName == "cpu") {
+            return CPU;
+        }
+        else if (lowerName == "native") {
+            return NATIVE;
+        }
+
+        return GPU;
+    }
+
+    cl_device_type deviceType(const Device & device) {
+        return device == CPU ? CL_DEVICE_TYPE_CPU : CL_DEVICE_TYPE_GPU;
+    }
+
+    size_t memoryBudget() {
+        return selectedMemoryBudget;
+    }
+
+    void setMemoryBudget(const size_t & bytes) {
+        selectedMemoryBudget = bytes;
+    }
+
+    QString buildOptions() {
+        return selectedBuildOptions;
+    }
+
+    void setBuildOptions(const QString & options) {
+        selectedBuildOptions = options;
+    }
+
+    bool isAutotuning() {
+        return selectedAutotuning;
+    }
+
+    void setAutotuning(const bool & autotuning) {
+        selectedAutotuning = autotuning;
+    }
+
     cl_context createContext(cl_device_type device_type,
                              cl_uint num_devices,
                              cl_device_id * device_id,
@@ -15,16 +78,38 @@ namespace CLInfo {
                              cl_int * errcode_ret,
                              const bool & graphicsShared) {
         cl_platform_id * platforms;
-        cl_uint platforms_n;
+        cl_uint platforms_n = 0;
 
         clGetPlatformIDs(0, nullptr, &platforms_n);
         platforms = (cl_platform_id *) malloc(sizeof(cl_platform_id) * (platforms_n + 1));
         clGetPlatformIDs(platforms_n, platforms, &platforms_n);
 
-        clGetDeviceIDs(platforms[0], CL_DEVICE_TYPE_GPU, 1, device_id, nullptr);
+        // cpu runtimes such as pocl are rarely the first platform
+        cl_platform_id platform = nullptr;
+
+        for (cl_uint i = 0; i != platforms_n; ++ i) {
+            if (clGetDeviceIDs(platforms[i], device_type, num_devices, device_id, nullptr) == CL_SUCCESS) {
+                platform = platforms[i];
+                break;
+            }
+        }
+
+        free(platforms);
+
+        if (!platform) {
+            if (errcode_ret) {
+                *errcode_ret = CL_DEVICE_NOT_FOUND;
+            }
+
+            return nullptr;
+        }
 
         cl_context_properties props[10];
 
+        props[0] = CL_CONTEXT_PLATFORM;
+        props[1] = (cl_context_properties) platform;
+        props[2] = 0;
+
         if (graphicsShared) {
 #ifdef Q_OS_OSX
             CGLContextObj kCGLContext = CGLGetCurrentContext();
@@ -38,47 +123,221 @@ namespace CLInfo {
 //TODO: shared context creation for other OS
         }
 
-        cl_context context =
-
-#ifdef AMD_BARTS
-        clCreateContext(props, num_devices, device_id, pfn_notify, user_data, &errcode_ret);
-#else
-        clCreateContextFromType(graphicsShared ? props : nullptr, device_type, pfn_notify, user_data, errcode_ret);
-#endif
-        free(platforms);
-
-        return context;
+        // the device is already picked, so there's no need to go by type
+        return clCreateContext(props, num_devices, device_id, pfn_notify, user_data, errcode_ret);
     }
 
-    cl_program createProgram(cl_context context, const QString & source) {
+    static QString readSource(const QString & source) {
         QFile programFile(source);
 
-        programFile.open(QIODevice::ReadOnly | QIODevice::Text);
+        if (!programFile.open(QIODevice::ReadOnly | QIODevice::Text)) {
+            return QString();
+        }
 
         QTextStream stream(&programFile);
         stream.setCodec(QTextCodec::codecForName("UTF-8"));
 
-        QString programStringList;
+        return stream.readAll();
+    }
 
-        while (true) {
-            QString line = stream.readLine();
-            if (line.isNull()) {
-                break;
-            }
-            else {
-                programStringList.append(line + '\n');
-            }
+    static QByteArray deviceInfo(cl_device_id device, cl_device_info param) {
+        size_t size = 0;
+
+        if (clGetDeviceInfo(device, param, 0, nullptr, &size) != CL_SUCCESS || !size) {
+            return QByteArray();
         }
 
-        char * programText = (char *) malloc(programStringList.length());
-        size_t programLength = strlen(programStringList.toStdString().c_str()) + 1;
-        memcpy(programText, programStringList.toStdString().c_str(), programLength);
+        QByteArray value((int) size, 0);
 
-        programFile.close();
+        clGetDeviceInfo(device, param, size, value.data(), nullptr);
+
+        // without the terminating zero
+        return QByteArray(value.constData());
+    }
+
+    static QString programCacheDir() {
+        return QStandardPaths::writableLocation(QStandardPaths::CacheLocation) + "/opencl";
+    }
+
+    static QByteArray deviceDescription(cl_device_id device) {
+        return deviceInfo(device, CL_DEVICE_NAME) + ";" +
+                deviceInfo(device, CL_DEVICE_VERSION) + ";" +
+                deviceInfo(device, CL_DRIVER_VERSION) + ";";
+    }
+
+    // binaries are only good for the source, device, driver and options they were built from
+    static QString programCacheFileName(cl_device_id device, const QByteArray & sourceText, const QString & options) {
+        QCryptographicHash hash(QCryptographicHash::Sha1);
+
+        hash.addData(QByteArray::number(PROGRAM_CACHE_VERSION));
+        hash.addData(sourceText);
+        hash.addData(deviceDescription(device));
+        hash.addData(options.toUtf8());
+
+        return programCacheDir() + "/" + QString::fromLatin1(hash.result().toHex()) + ".bin";
+    }
+
+    static QString deviceProfileFileName(cl_device_id device, const QString & name) {
+        QByteArray hash = QCryptographicHash::hash(deviceDescription(device), QCryptographicHash::Sha1).toHex();
+
+        return programCacheDir() + "/" + name + "-" + QString::fromLatin1(hash) + ".json";
+    }
+
+    QJsonObject loadDeviceProfile(cl_device_id device, const QString & name) {
+        QFile profileFile(deviceProfileFileName(device, name));
+
+        if (!profileFile.open(QIODevice::ReadOnly)) {
+            return QJsonObject();
+        }
+
+        return QJsonDocument::fromJson(profileFile.readAll()).object();
+    }
 
-        cl_program program = clCreateProgramWithSource(context, 1, (const char **) &programText, (const size_t *) &programLength, nullptr);
+    bool storeDeviceProfile(cl_device_id device, const QString & name, const QJsonObject & profile) {
+        if (!QDir().mkpath(programCacheDir())) {
+            return false;
+        }
+
+        QJsonObject deviceProfile(profile);
+
+        // for the reader only, profiles are matched by their file name
+        deviceProfile["device"] = QString::fromUtf8(deviceDescription(device));
+
+        QSaveFile profileFile(deviceProfileFileName(device, name));
+
+        if (!profileFile.open(QIODevice::WriteOnly)) {
+            return false;
+        }
+
+        profileFile.write(QJsonDocument(deviceProfile).toJson());
+
+        return profileFile.commit();
+    }
+
+    QString buildLog(cl_program program, cl_device_id device) {
+        size_t size = 0;
+
+        if (clGetProgramBuildInfo(program, device, CL_PROGRAM_BUILD_LOG, 0, nullptr, &size) != CL_SUCCESS || !size) {
+            return QString();
+        }
+
+        QByteArray log((int) size, 0);
+
+        clGetProgramBuildInfo(program, device, CL_PROGRAM_BUILD_LOG, size, log.data(), nullptr);
+
+        return QString::fromUtf8(log.constData()).trimmed();
+    }
+
+    static cl_program loadProgramBinary(cl_context context, cl_device_id device, const QString & fileName,
+                                        const QByteArray & options) {
+        QFile binaryFile(fileName);
+
+        if (!binaryFile.open(QIODevice::ReadOnly)) {
+            return nullptr;
+        }
+
+        QByteArray binary = binaryFile.readAll();
+
+        const unsigned char * binaryData = (const unsigned char *) binary.constData();
+        size_t binarySize = binary.size();
+
+        cl_int binaryStatus = CL_INVALID_BINARY;
+        cl_int errNo = CL_SUCCESS;
+
+        cl_program program = clCreateProgramWithBinary(context, 1, &device, &binarySize, &binaryData, &binaryStatus, &errNo);
+
+        if (program && errNo == CL_SUCCESS && binaryStatus == CL_SUCCESS &&
+                clBuildProgram(program, 1, &device, options.constData(), nullptr, nullptr) == CL_SUCCESS) {
+            return program;
+        }
+
+        // e.g. the driver was updated without changing its version string
+        qDebug() << "stale OpenCL program cache" << fileName;
+
+        if (program) {
+            clReleaseProgram(program);
+        }
+
+        binaryFile.remove();
+
+        return nullptr;
+    }
+
+    static void storeProgramBinary(cl_program program, const QString & fileName) {
+        size_t binarySize = 0;
+
+        if (clGetProgramInfo(program, CL_PROGRAM_BINARY_SIZES, sizeof(size_t), &binarySize, nullptr) != CL_SUCCESS ||
+                !binarySize || !QDir().mkpath(programCacheDir())) {
+            return;
+        }
+
+        QByteArray binary((int) binarySize, 0);
+        unsigned char * binaryData = (unsigned char *) binary.data();
+
+        if (clGetProgramInfo(program, CL_PROGRAM_BINARIES, sizeof(unsigned char *), &binaryData, nullptr) != CL_SUCCESS) {
+            return;
+        }
+
+        QSaveFile binaryFile(fileName);
+
+        if (binaryFile.open(QIODevice::WriteOnly)) {
+            binaryFile.write(binary);
+            binaryFile.commit();
+        }
+    }
+
+    cl_program createProgram(cl_context context, const QString & source) {
+        QByteArray sourceText = readSource(source).toUtf8();
+
+        const char * programText = sourceText.constData();
+        size_t programLength = sourceText.size();
+
+        return clCreateProgramWithSource(context, 1, &programText, &programLength, nullptr);
+    }
+
+    cl_program buildProgram(cl_context context, cl_device_id device, const QString & source,
+                            const QString & options, QString * log) {
+        QByteArray sourceText = readSource(source).toUtf8();
+        QByteArray optionsText = options.toUtf8();
+
+        QString fileName = programCacheFileName(device, sourceText, options);
+
+        cl_program program = loadProgramBinary(context, device, fileName, optionsText);
+
+        if (program) {
+            return program;
+        }
+
+        const char * programText = sourceText.constData();
+        size_t programLength = sourceText.size();
+
+        program = clCreateProgramWithSource(context, 1, &programText, &programLength, nullptr);
+
+        if (!program) {
+            return nullptr;
+        }
+
+        cl_int errNo = clBuildProgram(program, 1, &device, optionsText.constData(), nullptr, nullptr);
+
+        QString programLog = buildLog(program, device);
+
+        if (!programLog.isEmpty()) {
+            qDebug() << "OpenCL build log of" << source << ":" << programLog;
+        }
+
+        if (log) {
+            *log = programLog;
+        }
+
+        if (errNo != CL_SUCCESS) {
+            qDebug() << "Building OpenCL Program, error: " << errNo;
+
+            clReleaseProgram(program);
+
+            return nullptr;
+        }
 
-        free(programText);
+        storeProgramBinary(program, fileName);
 
         return program;
     }
@@ -14,6 +14,7 @@ namespace Model {
                                                      const ShaderInfo::ShaderVariablesNames & shaderAttributeArrays,
                                                      const ShaderInfo::ShaderVariablesNames & shaderUniformValues) :
         AbstractModel(scene, shaderFiles, shaderAttributeArrays, appendToNames(shaderUniformValues)),
+        _viewRange(nullptr),
         _pointsTexture(nullptr) {
 
         _points = new PointsModel(scene);
@@ -24,6 +25,8 @@ namespace Model {
     void AbstractModelWithPoints::init(const ModelInfo::Params & params) {
         AbstractModel::init(params);
 
+        _bvh = params["bvh"].value<ModelInfo::TriangleBvhPointer>();
+
         QVariantMap rangesMap = params["viewRanges"].toMap();
 
         QVariantMap viewMap = params["viewRangeShader"].toMap();
@@ -67,6 +70,9 @@ namespace Model {
         point->position = position;
         point->viewport = viewport;
 
+        // may have been dropped after missing the model last time
+        point->shown = true;
+
         point->queueToRecalculate();
 
         queueForUpdate();
@@ -149,7 +155,22 @@ namespace Model {
         bool updateNeeded = AbstractModel::checkBuffers(viewport);
 
         for (PointsInfo::ModelPoint * modelPoint : _modelPoints.points()) {
-            if (modelPoint->viewport == viewport && !modelPoint->isPositionCalculated()) {
+            // hidden points, dropped ones as well, wait until they are shown or placed again
+            if (modelPoint->viewport == viewport && modelPoint->shown && !modelPoint->isPositionCalculated()) {
+                if (_bvh) {
+                    if (pickPoint(modelPoint, viewport, unprojectedPoint)) {
+                        positionCalculated(modelPoint, unprojectedPoint);
+                    }
+                    else {
+                        // nothing shown under it, the point is dropped instead of being picked again every frame
+                        modelPoint->shown = false;
+                    }
+
+                    updateNeeded = true;
+
+                    continue;
+                }
+
                 GLint posZ;
 
                 Viewport::ViewportRect boundingRect = viewport->boundingRect();
@@ -172,23 +193,9 @@ namespace Model {
                 modelPoint->position.setZ(depth / (0xFFFFFF * 1.0f));
 
                 if (Camera::Camera::unproject(modelPoint->position, mvp(viewport), unprojectedPoint)) {
-                    modelPoint->positionCalculated(unprojectedPoint);
+                    positionCalculated(modelPoint, unprojectedPoint);
 
                     updateNeeded = true;
-
-                    Message::SettingsMessage message(
-                                Message::Sender(id()),
-                                Message::Reciever("sidebar"),
-                                Message::Recievers() = { "appWindow" }
-                    );
-
-                    message.data["action"] = "updatePoint";
-                    message.data["params"] = ModelInfo::Params() = {
-                        { "id", _modelPoints.key(modelPoint) },
-                        { "position", modelPoint->position * scene()->scalingFactor() }
-                    };
-
-                    emit post(message);
                 }
             }
         }
@@ -200,6 +207,70 @@ namespace Model {
         return updateNeeded;
     }
 
+    bool AbstractModelWithPoints::pickPoint(const PointsInfo::ModelPoint * modelPoint, const Viewport::Viewport * viewport,
+                                            PointsInfo::Position3D & picked) const {
+        PointsInfo::Position3D origin;
+        PointsInfo::Position3D direction;
+
+        if (!Camera::Camera::unprojectRay(PointsInfo::Position2D(modelPoint->position.x(), modelPoint->position.y()), mvp(viewport),
+                                          origin, direction)) {
+            return false;
+        }
+
+        return intersect(origin, direction, picked);
+    }
+
+    bool AbstractModelWithPoints::castRay(const PointsInfo::Position3D & origin, const PointsInfo::Position3D & direction,
+                                          PointsInfo::Position3D & hit) const {
+        QMutexLocker locker (&modelMutex);
+
+        return intersect(origin, direction, hit);
+    }
+
+    bool AbstractModelWithPoints::intersect(const PointsInfo::Position3D & origin, const PointsInfo::Position3D & direction,
+                                            PointsInfo::Position3D & hit) const {
+        if (!_bvh) {
+            return false;
+        }
+
+        GLfloat t;
+
+        if (_viewRange) {
+            // what is cut off by the view range isn't drawn, the ray goes through it
+            ModelInfo::VertexV minV(_viewRange->xRange.x(), _viewRange->yRange.x(), _viewRange->zRange.x());
+            ModelInfo::VertexV maxV(_viewRange->xRange.y(), _viewRange->yRange.y(), _viewRange->zRange.y());
+
+            if (!_bvh->intersect(origin, direction, minV, maxV, t)) {
+                return false;
+            }
+        }
+        else if (!_bvh->intersect(origin, direction, t)) {
+            return false;
+        }
+
+        hit = origin + direction * t;
+
+        return true;
+    }
+
+    void AbstractModelWithPoints::positionCalculated(PointsInfo::ModelPoint * modelPoint, const PointsInfo::Position3D & position) {
+        modelPoint->positionCalculated(position);
+
+        Message::SettingsMessage message(
+                    Message::Sender(id()),
+                    Message::Reciever("sidebar"),
+                    Message::Recievers() = { "appWindow" }
+        );
+
+        message.data["action"] = "updatePoint";
+        message.data["params"] = ModelInfo::Params() = {
+            { "id", _modelPoints.key(modelPoint) },
+            { "position", modelPoint->position * scene()->scalingFactor() }
+        };
+
+        emit post(message);
+    }
+
     void AbstractModelWithPoints::setViewAxisRange(const ViewRangeInfo::ViewAxisRange & viewAxisRange,
                                                    const ViewRangeInfo::ViewAxis viewAxis) {
         _viewRange->setViewAxisRange(viewAxisRange, viewAxis);
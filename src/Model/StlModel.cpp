@@ -1,28 +1,118 @@
 #include "Model/StlModel.h"
 
+#include <QtCore/qmath.h>
+
 namespace Model {
     StlModel::StlModel(Scene::AbstractScene * scene,
                        const ShaderInfo::ShaderFiles & shaderFiles,
                        const ShaderInfo::ShaderVariablesNames & shaderAttributeArrays,
                        const ShaderInfo::ShaderVariablesNames & shaderUniformValues) :
-            AbstractModelWithPoints(scene, shaderFiles, shaderAttributeArrays, shaderUniformValues) {
+            AbstractModelWithPoints(scene, shaderFiles, shaderAttributeArrays, shaderUniformValues),
+            _radius(1.0f),
+            _coarseWhileRotating(false),
+            _rotating(false),
+            _currentLod(0) {
 
     }
 
     void StlModel::init(const ModelInfo::Params & params) {
         AbstractModelWithPoints::init(params);
 
-        fillBuffers<ModelInfo::BuffersVN>(params["buffers"].value<ModelInfo::BuffersVN>());
+        ModelInfo::BuffersVNPacked buffers = params["buffers"].value<ModelInfo::BuffersVNPacked>();
+
+        if (buffers.vertices) {
+            qint64 squaredRadius = 0;
+
+            for (const ModelInfo::VertexVNPacked & vertex : *buffers.vertices) {
+                squaredRadius = std::max(squaredRadius, (qint64) vertex.x * vertex.x + (qint64) vertex.y * vertex.y + (qint64) vertex.z * vertex.z);
+            }
+
+            _radius = std::sqrt((GLfloat) squaredRadius) / SNORM16_MAX;
+        }
+
+        _lods.clear();
+
+        for (const QVariant & lod : params["lods"].toList()) {
+            QVariantMap lodMap = lod.toMap();
+
+            _lods.push_back(qMakePair((GLsizei) lodMap["first"].toULongLong(), (GLsizei) lodMap["count"].toULongLong()));
+        }
+
+        _coarseWhileRotating = params["coarseWhileRotating"].toBool();
+
+        fillBuffers<ModelInfo::BuffersVNPacked>(buffers);
+    }
+
+    int StlModel::lodFor(const Viewport::Viewport * viewport) const {
+        if (_lods.size() < 2) {
+            return 0;
+        }
+
+        Camera::Matrix modelView = view(viewport) * model(viewport);
+
+        GLfloat scaling = std::max(modelView.column(0).toVector3D().length(),
+                                   std::max(modelView.column(1).toVector3D().length(), modelView.column(2).toVector3D().length()));
+
+        // bounding sphere of the model, measured across in screen pixels
+        QVector4D center = modelView * QVector4D(0.0f, 0.0f, 0.0f, 1.0f);
+        QVector4D top = center + QVector4D(0.0f, _radius * scaling, 0.0f, 0.0f);
+
+        Camera::ProjectionMatrix projectionMatrix = projection(viewport);
+
+        QVector4D centerProjected = projectionMatrix * center;
+        QVector4D topProjected = projectionMatrix * top;
+
+        int lod = 0;
+
+        if (centerProjected.w() > 0.0f && topProjected.w() > 0.0f) {
+            qreal radiusPixels = std::fabs(topProjected.y() / topProjected.w() - centerProjected.y() / centerProjected.w()) *
+                    viewport->boundingRect().height() / 2.0;
+
+            qreal triangleBudget = LOD_TRIANGLES_PER_PIXEL * M_PI * radiusPixels * radiusPixels;
+
+            while (lod + 1 < _lods.size() && _lods[lod].second / 3 > triangleBudget) {
+                ++ lod;
+            }
+        }
+
+        if (_coarseWhileRotating && _rotating) {
+            lod = std::min(lod + 1, _lods.size() - 1);
+        }
+
+        return lod;
+    }
+
+    void StlModel::drawingRoutine() const {
+        if (_lods.isEmpty()) {
+            AbstractModelWithPoints::drawingRoutine();
+            return;
+        }
+
+        QMutexLocker locker (&modelMutex);
+
+        const QPair<GLsizei, GLsizei> & lod = _lods[_currentLod];
+
+        glDrawElements(GL_TRIANGLES, lod.second, GL_UNSIGNED_INT, (const GLvoid *) (lod.first * sizeof(GLuint)));
+    }
+
+    void StlModel::invoke(const QString & name, const ModelInfo::Params & params) {
+        if (name == "rotate") {
+            // viewports say when the drag is over, so the finest level gets drawn again
+            _rotating = params["interactive"].toBool();
+        }
+
+        AbstractModelWithPoints::invoke(name, params);
     }
 
     void StlModel::bindAttributeArrays(QOpenGLShaderProgram * program) const {
         QMutexLocker locker (&modelMutex);
 
+        // snorm16 components are normalized to [-1, 1] by gl, the shader unfolds the octahedral normal
         program->enableAttributeArray(attributeArrays["vertex"]);
-        program->setAttributeBuffer(attributeArrays["vertex"], GL_FLOAT, 0, 3, stride());
+        program->setAttributeBuffer(attributeArrays["vertex"], GL_SHORT, 0, 3, stride());
 
         program->enableAttributeArray(attributeArrays["normal"]);
-        program->setAttributeBuffer(attributeArrays["normal"], GL_FLOAT, sizeof(GLfloat) * 3, 3, stride());
+        program->setAttributeBuffer(attributeArrays["normal"], GL_SHORT, sizeof(GLshort) * 4, 2, stride());
     }
 
     void StlModel::bindUniformValues(QOpenGLShaderProgram * program, const Viewport::Viewport * viewport) const {
@@ -38,6 +128,8 @@ namespace Model {
 
         program->setUniformValue(uniformValues["normalMatrix"], normalMatrix(viewport));
 
+        _currentLod = lodFor(viewport);
+
         AbstractModelWithPoints::bindUniformValues(program, viewport);
     }
 }
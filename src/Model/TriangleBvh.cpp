@@ -0,0 +1,180 @@
+#include "Model/TriangleBvh.h"
+
+#include <cmath>
+#include <limits>
+#include <utility>
+
+namespace ModelInfo {
+    // slab test, tNear and tExit come out as where the ray enters and leaves the box
+    static inline bool intersectBox(const VertexV & boxMin, const VertexV & boxMax, const GLfloat * origin, const GLfloat * inverse,
+                                    const GLfloat & tStart, const GLfloat & tFar, GLfloat & tNear, GLfloat & tExit) {
+        const GLfloat * minV = &boxMin.x;
+        const GLfloat * maxV = &boxMax.x;
+
+        GLfloat tMin = tStart;
+        GLfloat tMax = tFar;
+
+        for (int axis = 0; axis != 3; ++ axis) {
+            GLfloat t0 = (minV[axis] - origin[axis]) * inverse[axis];
+            GLfloat t1 = (maxV[axis] - origin[axis]) * inverse[axis];
+
+            if (t0 > t1) {
+                std::swap(t0, t1);
+            }
+
+            // nans of 0 * inf (ray in the slab's plane) are skipped by the comparisons
+            tMin = t0 > tMin ? t0 : tMin;
+            tMax = t1 < tMax ? t1 : tMax;
+
+            if (tMin > tMax) {
+                return false;
+            }
+        }
+
+        tNear = tMin;
+        tExit = tMax;
+
+        return true;
+    }
+
+    static inline bool intersectBox(const BvhNode & node, const GLfloat * origin, const GLfloat * inverse,
+                                    const GLfloat & tStart, const GLfloat & tFar, GLfloat & tNear) {
+        GLfloat tExit;
+
+        return intersectBox(node.minV, node.maxV, origin, inverse, tStart, tFar, tNear, tExit);
+    }
+
+    // Moller-Trumbore, both faces count
+    static inline bool intersectTriangle(const BvhTriangle & triangle, const QVector3D & origin, const QVector3D & direction,
+                                         const GLfloat & tMin, GLfloat & t) {
+        QVector3D e1(triangle.e1.x, triangle.e1.y, triangle.e1.z);
+        QVector3D e2(triangle.e2.x, triangle.e2.y, triangle.e2.z);
+
+        QVector3D p = QVector3D::crossProduct(direction, e2);
+
+        GLfloat determinant = QVector3D::dotProduct(e1, p);
+
+        if (std::fabs(determinant) < std::numeric_limits<GLfloat>::min()) {
+            return false;
+        }
+
+        GLfloat inverse = 1.0f / determinant;
+
+        QVector3D s = origin - QVector3D(triangle.v0.x, triangle.v0.y, triangle.v0.z);
+
+        GLfloat u = QVector3D::dotProduct(s, p) * inverse;
+
+        if (u < 0.0f || u > 1.0f) {
+            return false;
+        }
+
+        QVector3D q = QVector3D::crossProduct(s, e1);
+
+        GLfloat v = QVector3D::dotProduct(direction, q) * inverse;
+
+        if (v < 0.0f || u + v > 1.0f) {
+            return false;
+        }
+
+        GLfloat hit = QVector3D::dotProduct(e2, q) * inverse;
+
+        if (hit < tMin || hit >= t) {
+            return false;
+        }
+
+        t = hit;
+
+        return true;
+    }
+
+    bool TriangleBvh::intersect(const QVector3D & origin, const QVector3D & direction, GLfloat & t) const {
+        return intersect(origin, direction, 0.0f, std::numeric_limits<GLfloat>::infinity(), t);
+    }
+
+    bool TriangleBvh::intersect(const QVector3D & origin, const QVector3D & direction, const VertexV & minV, const VertexV & maxV,
+                                GLfloat & t) const {
+        GLfloat originV[3] = { origin.x(), origin.y(), origin.z() };
+        GLfloat inverse[3] = { 1.0f / direction.x(), 1.0f / direction.y(), 1.0f / direction.z() };
+
+        GLfloat tMin;
+        GLfloat tMax;
+
+        // the part of the ray inside of the box, hits on it are inside as well
+        if (!intersectBox(minV, maxV, originV, inverse, 0.0f, std::numeric_limits<GLfloat>::infinity(), tMin, tMax)) {
+            return false;
+        }
+
+        return intersect(origin, direction, tMin, tMax, t);
+    }
+
+    bool TriangleBvh::intersect(const QVector3D & origin, const QVector3D & direction, const GLfloat & tMin, const GLfloat & tMax,
+                                GLfloat & t) const {
+        if (nodes.isEmpty()) {
+            return false;
+        }
+
+        GLfloat originV[3] = { origin.x(), origin.y(), origin.z() };
+        GLfloat inverse[3] = { 1.0f / direction.x(), 1.0f / direction.y(), 1.0f / direction.z() };
+
+        // a hit right at tMax is missed, it's on the very border of the range anyway
+        GLfloat nearest = tMax;
+        bool found = false;
+
+        GLuint stack[BVH_STACK_SIZE];
+        int stackSize = 0;
+
+        GLfloat tBox;
+
+        if (!intersectBox(nodes[0], originV, inverse, tMin, nearest, tBox)) {
+            return false;
+        }
+
+        stack[stackSize ++] = 0;
+
+        while (stackSize) {
+            const BvhNode & node = nodes[stack[-- stackSize]];
+
+            if (node.count) {
+                for (GLuint i = node.first; i != node.first + node.count; ++ i) {
+                    if (intersectTriangle(triangles[i], origin, direction, tMin, nearest)) {
+                        found = true;
+                    }
+                }
+
+                continue;
+            }
+
+            GLfloat tLeft;
+            GLfloat tRight;
+
+            bool left = intersectBox(nodes[node.first], originV, inverse, tMin, nearest, tLeft);
+            bool right = intersectBox(nodes[node.first + 1], originV, inverse, tMin, nearest, tRight);
+
+            // the nearer child goes on top, so the farther one is often culled by the hit found in there
+            if (left && right) {
+                if (tLeft < tRight) {
+                    stack[stackSize ++] = node.first + 1;
+                    stack[stackSize ++] = node.first;
+                }
+                else {
+                    stack[stackSize ++] = node.first;
+                    stack[stackSize ++] = node.first + 1;
+                }
+            }
+            else if (left) {
+                stack[stackSize ++] = node.first;
+            }
+            else if (right) {
+                stack[stackSize ++] = node.first + 1;
+            }
+        }
+
+        if (!found) {
+            return false;
+        }
+
+        t = nearest;
+
+        return true;
+    }
+}
@@ -1,8 +1,42 @@
 #include <Parser/AbstractParser.h>
 
 namespace Parser {
-    AbstractParser::AbstractParser() {
+    class LoadingThread : public QThread {
+    public:
+        bool success;
 
+        LoadingThread(const std::function<bool ()> & job, QObject * parent) :
+            QThread(parent),
+            success(false),
+            _job(job) {
+        }
+
+    protected:
+        virtual void run() {
+            success = _job();
+        }
+
+    private:
+        std::function<bool ()> _job;
+    };
+
+    AbstractParser::AbstractParser(const QString & name) :
+        _name(name),
+        _loadingThread(nullptr),
+        _loadingGeneration(0),
+        _canceled(0) {
+
+    }
+
+    AbstractParser::~AbstractParser() {
+        _queuedJob = nullptr;
+
+        stopLoading();
+
+        // the thread is a child of the parser and can't outlive it, this is the only place loads are waited for
+        if (_loadingThread) {
+            _loadingThread->wait();
+        }
     }
 
     QUrl AbstractParser::file() const {
@@ -17,6 +51,87 @@ namespace Parser {
         return _blueprint;
     }
 
+    bool AbstractParser::loading() const {
+        return _loadingThread || _queuedJob;
+    }
+
+    void AbstractParser::load(const std::function<bool ()> & job) {
+        stopLoading();
+
+        // a job queued before and never started is just replaced
+        _queuedJob = job;
+
+        if (!_loadingThread) {
+            startLoading();
+        }
+
+        emit loadingChanged();
+    }
+
+    void AbstractParser::startLoading() {
+        // nothing runs at this point, so the flag can't be reset under a canceled job
+        _canceled.store(0);
+
+        int generation = _loadingGeneration;
+
+        LoadingThread * loadingThread = new LoadingThread(_queuedJob, this);
+
+        _queuedJob = nullptr;
+
+        // queued to the gui thread; loads superseded in the meantime don't report, they hand over to the queued job
+        QObject::connect(loadingThread, &QThread::finished, this, [=]() {
+            _loadingThread = nullptr;
+            loadingThread->deleteLater();
+
+            if (generation == _loadingGeneration) {
+                emit loadingChanged();
+                emit finished(loadingThread->success && !isCanceled());
+            }
+            else if (_queuedJob) {
+                startLoading();
+            }
+            else {
+                emit loadingChanged();
+                emit finished(false);
+            }
+        });
+
+        _loadingThread = loadingThread;
+        _loadingThread->start();
+    }
+
+    void AbstractParser::stopLoading() {
+        if (!_loadingThread) {
+            return;
+        }
+
+        _canceled.store(1);
+
+        ++ _loadingGeneration;
+    }
+
+    bool AbstractParser::isCanceled() const {
+        return _canceled.load();
+    }
+
+    const QAtomicInt * AbstractParser::cancelFlag() const {
+        return &_canceled;
+    }
+
+    void AbstractParser::reportProgress(const QString & stage, const qreal & progress, const QVariantMap & details) {
+        Message::SettingsMessage message(_name, "sidebar");
+        message.data["action"] = "setProgress";
+
+        QVariantMap params = details;
+
+        params["stage"] = stage;
+        params["progress"] = progress;
+
+        message.data["params"] = QVariant(params);
+
+        emit send(message);
+    }
+
     void AbstractParser::setFile(const QUrl & file) {
         Q_UNUSED(file)
 
@@ -34,4 +149,10 @@ namespace Parser {
 
         emit blueprintChanged(blueprint);
     }
+
+    void AbstractParser::cancel() {
+        _queuedJob = nullptr;
+
+        _canceled.store(1);
+    }
 }
@@ -0,0 +1,123 @@
+#include <QtCore/QDirIterator>
+#include <QtCore/QFileInfo>
+
+#include "Parser/DicomIndex.h"
+
+namespace Parser {
+    DicomIndex::DicomIndex() :
+        AbstractParser("DicomIndex") {
+
+        QObject::connect(this, &AbstractParser::finished, this, &DicomIndex::takeScannedSeries);
+    }
+
+    QVariant DicomIndex::files() const {
+        return _directories;
+    }
+
+    QVariantList DicomIndex::series() const {
+        return _series;
+    }
+
+    QVariantList DicomIndex::seriesFiles(const QString & seriesUID) const {
+        QVariantList urls;
+
+        for (const QString & fileName : _seriesFiles.value(seriesUID)) {
+            urls << QUrl::fromLocalFile(fileName);
+        }
+
+        return urls;
+    }
+
+    bool DicomIndex::scan(const QList<QUrl> & urls) {
+        QStringList fileNames;
+
+        for (const QUrl & url : urls) {
+            QFileInfo fileInfo(url.toLocalFile());
+
+            if (fileInfo.isFile()) {
+                fileNames << fileInfo.absoluteFilePath();
+                continue;
+            }
+
+            QDirIterator dirIterator(fileInfo.absoluteFilePath(), QDir::Files | QDir::Readable, QDirIterator::Subdirectories);
+
+            while (dirIterator.hasNext() && !isCanceled()) {
+                fileNames << dirIterator.next();
+            }
+        }
+
+        QVariantMap details;
+        details["filesTotal"] = fileNames.size();
+
+        reportProgress("scanning", 0.0, details);
+
+        int reportStep = std::max(1, fileNames.size() / 100);
+
+        std::vector<SeriesSlice> slices = SeriesIndex::scan(fileNames, cancelFlag(),
+                                                            [this, reportStep](const int & read, const int & total) {
+            if (read % reportStep == 0 || read == total) {
+                QVariantMap details;
+
+                details["headersRead"] = read;
+                details["headersTotal"] = total;
+
+                reportProgress("scanning", (qreal) read / total, details);
+            }
+        });
+
+        if (isCanceled()) {
+            return false;
+        }
+
+        _scannedSeries = SeriesIndex::group(slices);
+
+        return true;
+    }
+
+    void DicomIndex::takeScannedSeries(bool success) {
+        if (!success) {
+            return;
+        }
+
+        _series.clear();
+        _seriesFiles.clear();
+
+        for (const std::vector<SeriesSlice> & series : _scannedSeries) {
+            QVariantMap description = SeriesIndex::describe(series);
+
+            QStringList & fileNames = _seriesFiles[description["seriesUID"].toString()];
+
+            for (const SeriesSlice & slice : series) {
+                fileNames << slice.fileName;
+            }
+
+            _series << description;
+        }
+
+        std::vector<std::vector<SeriesSlice> >().swap(_scannedSeries);
+
+        emit seriesChanged();
+    }
+
+    void DicomIndex::setFiles(const QVariant & files) {
+        QList<QUrl> urls = files.value<QList<QUrl> >();
+
+        if (urls.isEmpty()) {
+            for (const QVariant & file : files.toList()) {
+                urls << file.toUrl();
+            }
+        }
+
+        if (urls.isEmpty()) {
+            return;
+        }
+
+        load([this, urls]() {
+            return scan(urls);
+        });
+
+        _directories = files;
+
+        emit filesChanged();
+    }
+}
@@ -1,27 +1,125 @@
 #include <gdcmReader.h>
 #include <gdcmImageReader.h>
+#include <gdcmImageRegionReader.h>
 #include <gdcmAttribute.h>
 #include <gdcmStringFilter.h>
 #include <gdcmException.h>
 
 #include <QtCore/QUrl>
+#include <QtCore/QDir>
+#include <QtCore/QFileInfo>
+#include <QtCore/QMutex>
 
 #include <opencv2/highgui/highgui.hpp>
 
+#include <algorithm>
+#include <cmath>
+
 #include "Parser/DicomReader.h"
 #include "Parser/Helpers.hpp"
+#include "Parser/seriesprocessing.hpp"
+#include "Parser/SeriesIndex.h"
+#include "Parser/frameprocessing.hpp"
+#include "Parser/regionprocessing.hpp"
+#include "Parser/VolumeCache.h"
 
 #define MIN_HU 200
 #define MAX_HU 1500
 
+#define NEIGHBOUR_RADIUS 0
+
+// parts of the volume streamed at most, fewer if slices are merged in larger slabs anyway
+#define STREAM_PARTS 32
+
 namespace Parser {
+    /* merged slices are reported in any order from any thread; they are sent in contiguous runs
+     * once enough of them have piled up, so the texture isn't updated slice by slice;
+     * start is called right before the first run, so nothing is shown until there's something to show
+     */
+    class SliceStream {
+    public:
+        SliceStream(const int & batchSize, const std::function<void ()> & start,
+                    const std::function<void (const int &, const int &)> & sendSlices, const std::function<void ()> & finish) :
+            _batchSize(batchSize),
+            _start(start),
+            _sendSlices(sendSlices),
+            _finish(finish),
+            _isStarted(false) {
+        }
+
+        void add(const int & first, const int & count) {
+            QMutexLocker locker(&_mutex);
+
+            for (int i = first; i != first + count; ++ i) {
+                _pending.push_back(i);
+            }
+
+            if ((int) _pending.size() >= _batchSize) {
+                sendPending();
+            }
+        }
+
+        void flush() {
+            QMutexLocker locker(&_mutex);
+
+            sendPending();
+        }
+
+        // after the last flush, streams which never started have nothing to finish
+        void finish() {
+            QMutexLocker locker(&_mutex);
+
+            if (_isStarted) {
+                _finish();
+            }
+        }
+
+    private:
+        int _batchSize;
+
+        std::function<void ()> _start;
+        std::function<void (const int &, const int &)> _sendSlices;
+        std::function<void ()> _finish;
+
+        bool _isStarted;
+
+        std::vector<int> _pending;
+
+        QMutex _mutex;
+
+        void sendPending() {
+            if (_pending.empty()) {
+                return;
+            }
+
+            if (!_isStarted) {
+                _start();
+                _isStarted = true;
+            }
+
+            std::sort(_pending.begin(), _pending.end());
+
+            size_t runStart = 0;
+
+            for (size_t i = 1; i <= _pending.size(); ++ i) {
+                if (i == _pending.size() || _pending[i] != _pending[i - 1] + 1) {
+                    _sendSlices(_pending[runStart], (int) (i - runStart));
+                    runStart = i;
+                }
+            }
+
+            _pending.clear();
+        }
+    };
+
     DicomReader::DicomReader() :
-        AbstractParser()
+        AbstractParser("DicomParser"),
+        _progressive(false)
     {
-
+        _dicomData.canceled = cancelFlag();
     }
 
-    void DicomReader::fetchDicomData(DicomData & dicomData, gdcm::File & dFile, const gdcm::Image & dImage) {
+    void DicomReader::fetchDicomParams(DicomData & dicomData, gdcm::File & dFile, const gdcm::Image & dImage) {
         gdcm::StringFilter dStringFilter;
         dStringFilter.SetFile(dFile);
 
@@ -68,9 +166,10 @@ namespace Parser {
         dicomData.height = dImage.GetDimension(1);
         dicomData.depth = dImage.GetDimension(2);
 
-        dicomData.vbuffer.resize(dImage.GetBufferLength());
-        dicomData.buffer = &(dicomData.vbuffer[0]);
-        dImage.GetBuffer(dicomData.buffer);
+        dicomData.rawWidth = dicomData.width;
+        dicomData.rawHeight = dicomData.height;
+
+        dicomData.sampling = VolumeRegion();
 
         //MONOCHROME2
 
@@ -103,21 +202,333 @@ namespace Parser {
         dicomData.minHUPossible = dicomData.slope * dicomData.minValue + dicomData.intercept;
         dicomData.maxHUPossible = dicomData.slope * dicomData.maxValue + dicomData.intercept;
 
-        dicomData.isLittleEndian = (pixelFormat.GetBitsAllocated() - pixelFormat.GetHighBit() == 1);
+        // gdcm swaps big endian transfer syntaxes while decoding, so GetBuffer always hands out host order
+        dicomData.isLittleEndian = (Q_BYTE_ORDER == Q_LITTLE_ENDIAN);
 
-        dicomData.neighbourRadius = 0;
+        dicomData.neighbourRadius = NEIGHBOUR_RADIUS;
 
         dicomData.minHU = std::max(dicomData.minHUPossible, MIN_HU);
         dicomData.maxHU = std::min(dicomData.maxHUPossible, MAX_HU);
     }
 
-    void DicomReader::readImage(gdcm::File & dFile, const gdcm::Image & dImage) {
+    void DicomReader::fetchDicomData(DicomData & dicomData, gdcm::File & dFile, const gdcm::Image & dImage) {
+        fetchDicomParams(dicomData, dFile, dImage);
+
+        dicomData.buffer = rawPixelData(dFile, dImage);
+
+        if (dicomData.buffer) {
+            std::vector<char>().swap(dicomData.vbuffer);
+            return;
+        }
+
+        dicomData.vbuffer.resize(dImage.GetBufferLength());
+        dImage.GetBuffer(&(dicomData.vbuffer[0]));
+
+        dicomData.buffer = &(dicomData.vbuffer[0]);
+    }
+
+    void DicomReader::trackSlices(const QString & stage, const int & slicesTotal) {
+        _decodedSlices.store(0);
+
+        int reportStep = std::max(1, slicesTotal / 100);
+        qint64 sliceSize = _dicomData.sliceSize;
+
+        _dicomData.sliceDecoded = [this, stage, slicesTotal, reportStep, sliceSize](const int &) {
+            int decodedSlices = _decodedSlices.fetchAndAddRelaxed(1) + 1;
+
+            if (decodedSlices % reportStep == 0 || decodedSlices == slicesTotal) {
+                QVariantMap details;
+
+                details["slicesDecoded"] = decodedSlices;
+                details["slicesTotal"] = slicesTotal;
+                details["bytesRead"] = sliceSize * decodedSlices;
+
+                reportProgress(stage, (qreal) decodedSlices / slicesTotal, details);
+            }
+        };
+    }
+
+    bool DicomReader::readFile(const QString & fileName, const VolumeRegion & region, const bool & progressive) {
+        _cacheKey.clear();
+
+        reportProgress("reading", 0.0);
+
+        // header alone is enough to find out whether the volume was already processed
+        SeriesSlice slice;
+        slice.fileName = fileName;
+
+        readSliceHeader(slice);
+
+        if (slice.isValid &&
+                sendCachedVolume(VolumeCache::key(QString::fromStdString(slice.seriesUID), QStringList(slice.fileName),
+                                                  NEIGHBOUR_RADIUS, region))) {
+            return true;
+        }
+
+        if (!region.isFull()) {
+            return readFileRegion(fileName, region, progressive);
+        }
+
+        return readWholeFile(fileName, region, progressive);
+    }
+
+    bool DicomReader::readWholeFile(const QString & fileName, const VolumeRegion & region, const bool & progressive) {
+        gdcm::ImageReader dIReader;
+
+        dIReader.SetFileName(fileName.toLocal8Bit().constData());
+
+        // gdcm can't be interrupted while reading, canceled loads just don't start it
+        if (isCanceled()) {
+            return false;
+        }
+
+        if (!dIReader.Read()) {
+            qDebug() << "can't read file";
+            return false;
+        }
+
+        QVariantMap details;
+        details["bytesRead"] = QFileInfo(fileName).size();
+
+        reportProgress("reading", 1.0, details);
+
+        return !isCanceled() && readImage(dIReader.GetFile(), dIReader.GetImage(), region, progressive);
+    }
+
+    bool DicomReader::readFileRegion(const QString & fileName, const VolumeRegion & region, const bool & progressive) {
+        gdcm::ImageRegionReader dIRReader;
+
+        dIRReader.SetFileName(fileName.toLocal8Bit().constData());
+
+        if (!dIRReader.ReadInformation()) {
+            qDebug() << "can't read region, reading the whole file";
+            return !isCanceled() && readWholeFile(fileName, region, progressive);
+        }
+
+        gdcm::Image dImage;
+        imageFromHeader(dIRReader.GetFile(), dImage);
+
+        fetchDicomParams(_dicomData, dIRReader.GetFile(), dImage);
+
+        VolumeRegion clamped = region.clamped(_dicomData.width, _dicomData.height, _dicomData.depth);
+
+        sampleRegion(_dicomData, clamped);
+
+        // gdcm hands out just the box, so raw slices are the box and only decimation is left
+        _dicomData.rawWidth = clamped.size[0];
+        _dicomData.rawHeight = clamped.size[1];
+
+        _dicomData.sampling.origin[0] = 0;
+        _dicomData.sampling.origin[1] = 0;
+
+        _dicomData.sliceSize = _dicomData.bytesAllocated * _dicomData.rawWidth * _dicomData.rawHeight;
+
+        if (!_dicomData.sliceSize || !_dicomData.depth) {
+            qDebug() << "empty region";
+            return false;
+        }
+
+        _dicomData.vbuffer.resize(_dicomData.sliceSize * _dicomData.depth);
+        _dicomData.buffer = &(_dicomData.vbuffer[0]);
+
+        qDebug() << "Region" << _dicomData.width << "x" << _dicomData.height << "x" << _dicomData.depth;
+
+        trackSlices("reading", (int) _dicomData.depth);
+
+        bool isRead = readRegionFrames(dIRReader, clamped, &_dicomData);
+
+        _dicomData.sliceDecoded = nullptr;
+
+        // not every transfer syntax can be read by regions, the whole file is read and cropped then
+        if (!isRead) {
+            qDebug() << "can't read region of" << dIRReader.GetFile().GetHeader().GetDataSetTransferSyntax().GetString()
+                     << ", reading the whole file";
+            return !isCanceled() && readWholeFile(fileName, region, progressive);
+        }
+
+        return !isCanceled() && runSliceProcessing(progressive, true);
+    }
+
+    bool DicomReader::readImage(gdcm::File & dFile, const gdcm::Image & dImage, const VolumeRegion & region, const bool & progressive) {
+        EncapsulatedFrames encapsulatedFrames;
+
+        // compressed multi-frame images are decompressed frame by frame on all threads instead of one GetBuffer
+        if (region.isFull() && splitFrames(dFile, dImage, encapsulatedFrames)) {
+            fetchDicomParams(_dicomData, dFile, dImage);
+
+            _dicomData.sliceSize = _dicomData.bytesAllocated * _dicomData.rawWidth * _dicomData.rawHeight;
+
+            _dicomData.vbuffer.resize(_dicomData.sliceSize * _dicomData.depth);
+            _dicomData.buffer = &(_dicomData.vbuffer[0]);
+
+            qDebug() << "Decoding" << encapsulatedFrames.frames.size() << "frames in parallel";
+
+            return runSliceProcessing(progressive, true, &encapsulatedFrames);
+        }
+
         fetchDicomData(_dicomData, dFile, dImage);
 
-        runSliceProcessing(true);
+        if (!region.isFull()) {
+            cropVolume(_dicomData, region);
+
+            qDebug() << "Region" << _dicomData.width << "x" << _dicomData.height << "x" << _dicomData.depth;
+        }
+
+        return runSliceProcessing(progressive, true);
+    }
+
+    bool DicomReader::readSeries(const QStringList & fileNames, const VolumeRegion & region, const bool & progressive) {
+        _cacheKey.clear();
+
+        float startTime = cv::getTickCount() / cv::getTickFrequency();
+
+        QVariantMap details;
+        details["filesTotal"] = fileNames.size();
+
+        reportProgress("scanning", 0.0, details);
+
+        // headers of already indexed files aren't read again
+        std::vector<SeriesSlice> slices = SeriesIndex::scan(fileNames, cancelFlag());
+
+        if (isCanceled()) {
+            return false;
+        }
+
+        // directory can contain more than one series (or not dicom files at all), take the largest one
+        std::vector<std::vector<SeriesSlice> > seriesList = SeriesIndex::group(slices);
+
+        if (seriesList.empty()) {
+            qDebug() << "no dicom slices found";
+            return false;
+        }
+
+        std::vector<SeriesSlice> series;
+        series.swap(seriesList.front());
+
+        QString seriesUID = QString::fromStdString(series.front().seriesUID);
+
+        QStringList seriesFiles;
+
+        for (const SeriesSlice & slice : series) {
+            seriesFiles << slice.fileName;
+        }
+
+        if (sendCachedVolume(VolumeCache::key(seriesUID, seriesFiles, NEIGHBOUR_RADIUS, region))) {
+            qDebug() << "Cached volume, elapsed Time: " << cv::getTickCount() / cv::getTickFrequency() - startTime;
+            return true;
+        }
+
+        VolumeRegion clamped = region.clamped(series.front().width, series.front().height, series.size());
+
+        if (!region.isFull()) {
+            // slices out of the region are never read
+            std::vector<SeriesSlice> regionSeries(clamped.samples(2));
+
+            for (size_t i = 0; i != regionSeries.size(); ++ i) {
+                regionSeries[i] = series[clamped.source(2, i)];
+            }
+
+            series.swap(regionSeries);
+        }
+
+        // metadata of the series are taken from the first slice, its pixel data is decoded from the same reader
+        gdcm::ImageReader dIReader;
+        dIReader.SetFileName(series.front().fileName.toLocal8Bit().constData());
+
+        if (isCanceled()) {
+            return false;
+        }
+
+        if (!dIReader.Read()) {
+            qDebug() << "can't read file" << series.front().fileName;
+            return false;
+        }
+
+        fetchDicomParams(_dicomData, dIReader.GetFile(), dIReader.GetImage());
+
+        sampleRegion(_dicomData, clamped);
+
+        _dicomData.sliceSize = _dicomData.bytesAllocated * _dicomData.rawWidth * _dicomData.rawHeight;
+
+        if (series.size() > 1 && series.front().hasLocation && series.back().hasLocation) {
+            _dicomData.imageSpacings.setZ(std::abs(series.back().location - series.front().location) / (series.size() - 1));
+        }
+
+        qDebug() << "Series headers:" << series.size() << "slices, elapsed Time: " << cv::getTickCount() / cv::getTickFrequency() - startTime;
+
+        if (_dicomData.neighbourRadius) {
+            // slices have to be smoothed with their neighbours - keep them raw and run usual processing
+            _dicomData.vbuffer.resize(_dicomData.sliceSize * _dicomData.depth);
+            _dicomData.buffer = &(_dicomData.vbuffer[0]);
+
+            trackSlices("reading", (int) series.size());
+
+            SeriesSliceReading seriesSliceReading(&series, &_dicomData);
+            std::vector<char> sliceBuffer;
+
+            seriesSliceReading.readSlice(0, dIReader, true, sliceBuffer);
+
+            cv::parallel_for_(cv::Range(1, (int) series.size()), seriesSliceReading);
+
+            return !isCanceled() && runSliceProcessing(progressive, true);
+        }
+
+        size_t decodedSliceSize = sizeof(quint16) * _dicomData.width * _dicomData.height;
+
+        TextureInfo::MergedDataPointer mergedData(new TextureInfo::MergedData[decodedSliceSize * _dicomData.depth],
+                                                  std::default_delete<TextureInfo::MergedData[]>());
+
+        QOpenGLPixelTransferOptions pixelTransferOptions;
+
+        size_t step = sizeof(quint16) * _dicomData.width;
+
+        pixelTransferOptions.setAlignment((step & 3) ? 1 : 4);
+        pixelTransferOptions.setRowLength((int) _dicomData.width);
+
+        SeriesSliceReading seriesSliceReading(&series, &_dicomData, mergedData.data(), decodedSliceSize);
+
+        if (progressive) {
+            streamVolume(mergedData, pixelTransferOptions, true);
+        }
+
+        trackSlices("decoding", (int) series.size());
+
+        std::vector<char> sliceBuffer;
+
+        seriesSliceReading.readSlice(0, dIReader, true, sliceBuffer);
+
+        cv::parallel_for_(cv::Range(1, (int) series.size()), seriesSliceReading);
+
+        _dicomData.sliceDecoded = nullptr;
+
+        finishStream();
+
+        if (isCanceled()) {
+            return false;
+        }
+
+        int failedCount = (int) std::count(seriesSliceReading.failed.begin(), seriesSliceReading.failed.end(), true);
+
+        if (failedCount) {
+            qDebug() << "can't read" << failedCount << "slices of the series";
+        }
+
+        qDebug() << "Elapsed Time: " << cv::getTickCount() / cv::getTickFrequency() - startTime;
+
+        if (!progressive) {
+            sendVolume(mergedData, pixelTransferOptions, true);
+        }
+
+        // broken slices are worth another try next time
+        if (!failedCount) {
+            cacheVolume(mergedData, pixelTransferOptions);
+        }
+
+        return true;
     }
 
-    void DicomReader::runSliceProcessing(const bool & tellAboutHURange) {
+    bool DicomReader::runSliceProcessing(const bool & progressive, const bool & tellAboutHURange,
+                                         const EncapsulatedFrames * encapsulatedFrames) {
         TextureInfo::MergedDataPtr mergedData = nullptr;
 
         QOpenGLPixelTransferOptions pixelTransferOptions;
@@ -127,10 +538,162 @@ namespace Parser {
 
         float startTime = cv::getTickCount() / cv::getTickFrequency();
 
-        cv::parallel_for_(cv::Range(0, (int) _dicomData.depth), SliceProcessing(&_dicomData));
+        trackSlices("decoding", (int) _dicomData.depth);
+
+        SliceProcessing sliceProcessing(&_dicomData);
+
+        TextureInfo::MergedDataPointer mergedDataPointer(mergedData, std::default_delete<TextureInfo::MergedData[]>());
+
+        if (progressive) {
+            streamVolume(mergedDataPointer, pixelTransferOptions, tellAboutHURange);
+        }
+
+        if (encapsulatedFrames) {
+            FrameDecoding frameDecoding(encapsulatedFrames, &_dicomData, &sliceProcessing);
+
+            cv::parallel_for_(cv::Range(0, (int) _dicomData.depth), frameDecoding);
+
+            if (frameDecoding.failedCount()) {
+                qDebug() << "can't decode" << frameDecoding.failedCount() << "frames";
+
+                // don't keep broken volume
+                _cacheKey.clear();
+            }
+        }
+        else {
+            cv::parallel_for_(cv::Range(0, (int) _dicomData.depth), sliceProcessing);
+        }
+
+        _dicomData.sliceDecoded = nullptr;
+
+        finishStream();
 
         qDebug() << "Elapsed Time: " << cv::getTickCount() / cv::getTickFrequency() - startTime;
 
+        // raw pixels aren't needed anymore, don't keep them alive along with the texture
+        std::vector<char>().swap(_dicomData.vbuffer);
+        _dicomData.buffer = nullptr;
+
+        if (isCanceled()) {
+            return false;
+        }
+
+        if (!progressive) {
+            sendVolume(mergedDataPointer, pixelTransferOptions, tellAboutHURange);
+        }
+
+        cacheVolume(mergedDataPointer, pixelTransferOptions);
+
+        return true;
+    }
+
+    bool DicomReader::sendCachedVolume(const QString & cacheKey) {
+        TextureInfo::MergedDataPointer mergedData;
+
+        QOpenGLPixelTransferOptions pixelTransferOptions;
+
+        if (!VolumeCache::load(cacheKey, _dicomData, mergedData, pixelTransferOptions)) {
+            // volume is going to be processed, keep it next time
+            _cacheKey = cacheKey;
+            return false;
+        }
+
+        _cacheKey.clear();
+
+        sendVolume(mergedData, pixelTransferOptions, true);
+
+        return true;
+    }
+
+    void DicomReader::cacheVolume(const TextureInfo::MergedDataPointer & mergedData, const QOpenGLPixelTransferOptions & pixelTransferOptions) {
+        if (_cacheKey.isEmpty()) {
+            return;
+        }
+
+        float startTime = cv::getTickCount() / cv::getTickFrequency();
+
+        if (VolumeCache::store(_cacheKey, _dicomData, mergedData, pixelTransferOptions, cancelFlag())) {
+            qDebug() << "Volume cached, elapsed Time: " << cv::getTickCount() / cv::getTickFrequency() - startTime;
+        }
+
+        _cacheKey.clear();
+    }
+
+    TextureInfo::TextureInfo DicomReader::volumeTexture(const TextureInfo::MergedDataPointer & mergedData,
+                                                        const QOpenGLPixelTransferOptions & pixelTransferOptions) const {
+        TextureInfo::TextureInfo texture;
+        texture.mergedData = mergedData;
+
+        texture.pixelTransferOptions = pixelTransferOptions;
+
+        texture.size = TextureInfo::Size(_dicomData.width, _dicomData.height, _dicomData.depth - _dicomData.neighbourRadius * 2);
+
+        texture.pixelType = QOpenGLTexture::UInt16;
+        texture.textureFormat = QOpenGLTexture::R16U;
+        texture.pixelFormat = QOpenGLTexture::Red_Integer;
+        texture.target = QOpenGLTexture::Target3D;
+
+        return texture;
+    }
+
+    void DicomReader::streamVolume(const TextureInfo::MergedDataPointer & mergedData, const QOpenGLPixelTransferOptions & pixelTransferOptions,
+                                   const bool & tellAboutHURange) {
+        // updates hold the data until the render thread has uploaded it
+        TextureInfo::TextureInfo texture = volumeTexture(mergedData, pixelTransferOptions);
+
+        QString textureID = _blueprint.toMap()["textures"].toList()[0].toMap()["id"].toString();
+
+        int batchSize = std::max(1, (int) texture.size.z() / STREAM_PARTS);
+
+        // messages are sent from one thread at a time, in order, so the scene gets the volume before its slices
+        _sliceStream.reset(new SliceStream(batchSize, [this, pixelTransferOptions, tellAboutHURange]() {
+            sendVolume(TextureInfo::MergedDataPointer(), pixelTransferOptions, tellAboutHURange);
+        },
+        [this, texture, textureID](const int & firstSlice, const int & sliceCount) {
+            Message::SettingsMessage message("DicomParser", "Scene");
+
+            message.data["action"] = "updateTexture";
+            message.data["texture"] = textureID;
+            message.data["descriptor"] = QVariant::fromValue(texture);
+            message.data["firstSlice"] = firstSlice;
+            message.data["sliceCount"] = sliceCount;
+
+            send(message);
+        },
+        [this, textureID]() {
+            Message::SettingsMessage message("DicomParser", "Scene");
+
+            message.data["action"] = "finishTexture";
+            message.data["texture"] = textureID;
+
+            send(message);
+        }));
+
+        SliceStream * sliceStream = _sliceStream.data();
+
+        _dicomData.slicesMerged = [sliceStream](const int & first, const int & count) {
+            sliceStream->add(first, count);
+        };
+    }
+
+    void DicomReader::finishStream() {
+        _dicomData.slicesMerged = nullptr;
+
+        if (_sliceStream) {
+            // slices left of a canceled load aren't sent, so it isn't shown unless some batch was already there
+            if (!isCanceled()) {
+                _sliceStream->flush();
+                _sliceStream->finish();
+            }
+
+            _sliceStream.clear();
+        }
+    }
+
+    void DicomReader::sendVolume(const TextureInfo::MergedDataPointer & mergedData, const QOpenGLPixelTransferOptions & pixelTransferOptions,
+                                 const bool & tellAboutHURange) {
+        Q_UNUSED(tellAboutHURange)
+
         size_t depth = _dicomData.depth - _dicomData.neighbourRadius * 2;
 
         VolumeInfo::Scaling scaling = scaleVector<float, QVector3D>(
@@ -146,17 +709,7 @@ namespace Parser {
 
         scaling.setZ(scaling.x());
 
-        TextureInfo::TextureInfo texture;
-        texture.mergedData = TextureInfo::MergedDataPointer(mergedData);
-
-        texture.pixelTransferOptions = pixelTransferOptions;
-
-        texture.size = TextureInfo::Size(_dicomData.width, _dicomData.height, depth);
-
-        texture.pixelType = QOpenGLTexture::UInt16;
-        texture.textureFormat = QOpenGLTexture::R16U;
-        texture.pixelFormat = QOpenGLTexture::Red_Integer;
-        texture.target = QOpenGLTexture::Target3D;
+        TextureInfo::TextureInfo texture = volumeTexture(mergedData, pixelTransferOptions);
 
         QVariantMap blueprintOverallMap = _blueprint.toMap();
         QVariantList textureVolumeList = blueprintOverallMap["textures"].toList();
@@ -220,19 +773,90 @@ namespace Parser {
             return;
         }
 
-        gdcm::ImageReader dIReader;
+        QString fileName = file.toLocalFile();
+
+        qDebug() << fileName;
+
+        VolumeRegion region = VolumeRegion::fromVariant(_region);
+        bool progressive = _progressive;
+
+        load([this, fileName, region, progressive]() {
+            return readFile(fileName, region, progressive);
+        });
+
+        _dicomFile = file;
+
+        emit fileChanged();
+    }
+
+    QVariant DicomReader::files() const {
+        return _dicomFiles;
+    }
 
-        qDebug() << file.toLocalFile().toStdString().c_str();
-        dIReader.SetFileName(file.toLocalFile().toStdString().c_str());
+    void DicomReader::setFiles(const QVariant & files) {
+        QList<QUrl> urls = files.value<QList<QUrl> >();
 
-        if (dIReader.Read()) {
-            readImage(dIReader.GetFile(), dIReader.GetImage());
-            _dicomFile = file;
+        if (urls.isEmpty()) {
+            for (const QVariant & file : files.toList()) {
+                urls << file.toUrl();
+            }
         }
-        else {
-            qDebug() << "can't read file";
+
+        if (urls.isEmpty()) {
+            return;
         }
 
-        emit fileChanged();
+        // directories can be huge (or remote), list them on the worker too
+        VolumeRegion region = VolumeRegion::fromVariant(_region);
+        bool progressive = _progressive;
+
+        load([this, urls, region, progressive]() {
+            return readSeries(listFiles(urls), region, progressive);
+        });
+
+        _dicomFiles = files;
+
+        emit filesChanged();
+    }
+
+    QVariant DicomReader::region() const {
+        return _region;
+    }
+
+    void DicomReader::setRegion(const QVariant & region) {
+        _region = region;
+
+        emit regionChanged();
+    }
+
+    bool DicomReader::progressive() const {
+        return _progressive;
+    }
+
+    void DicomReader::setProgressive(const bool & progressive) {
+        _progressive = progressive;
+
+        emit progressiveChanged();
+    }
+
+    QStringList DicomReader::listFiles(const QList<QUrl> & urls) {
+        QStringList fileNames;
+
+        for (const QUrl & file : urls) {
+            QFileInfo fileInfo(file.toLocalFile());
+
+            if (fileInfo.isDir()) {
+                QDir dir(fileInfo.absoluteFilePath());
+
+                for (const QString & entry : dir.entryList(QDir::Files | QDir::Readable, QDir::Name)) {
+                    fileNames << dir.absoluteFilePath(entry);
+                }
+            }
+            else if (fileInfo.isFile()) {
+                fileNames << fileInfo.absoluteFilePath();
+            }
+        }
+
+        return fileNames;
     }
 }
@@ -3,35 +3,228 @@
 
 #include "Info/CLInfo.h"
 
+#include <QtCore/QJsonArray>
+
 #define SLICES_IMAGE_WINDOW "slices"
 #define SLICE_POSITION "position"
 
-#define GAUSS
-
+// defaults of gaussSigma and gaussSize
 #define SIGMA_GAUSS 1.5
 #define KERN_SIZE_GAUSS 5
 
-#define ALL_EVENTS 9
+// block of voxels per gauss3d work-group if the device profile has none
+#define GAUSS_WORK_GROUP_WIDTH 8
+#define GAUSS_WORK_GROUP_HEIGHT 8
+#define GAUSS_WORK_GROUP_DEPTH 4
+
+// work-items sharing the butterflies of one fast hartley transform row
+#define FHT_WORK_GROUP_SIZE 128
+
+// name of the device profile holding the tuned local sizes
+#define DEVICE_PROFILE "reconstructor"
+
+// synthetic volume the local sizes are tuned on: detector width, rows and angles
+#define AUTOTUNE_WIDTH 256
+#define AUTOTUNE_ROWS 16
+#define AUTOTUNE_ANGLES 64
+
+#define AUTOTUNE_RUNS 3
+#define AUTOTUNE_MAX_WORK_GROUP_SIZE 256
+// rows of a slab per work-group, more won't fit next to the width and height ones
+#define AUTOTUNE_MAX_WORK_GROUP_DEPTH 4
 
-#define GAUSS_1D_COMPLETED_EVENT_X 0
-#define GAUSS_1D_COMPLETED_EVENT_Y 1
-#define GAUSS_1D_COMPLETED_EVENT_Z 2
-#define CALC_TABLES_COMPLETED_EVENT 3
+// budget of the native path if there's none on the command line
+#define NATIVE_MEMORY_BUDGET ((size_t) 1 << 30)
 
-#define DHT_1D_TO_2D_COMPLETED_EVENT 4
-#define DHT_2D_I_FIRST_1D_COMPLETED_EVENT 5
-#define DHT_2D_I_SECOND_1D_COMPLETED_EVENT 6
-#define DHT_2D_I_COMPLETED_EVENT 7
-#define MAP_FINAL_COMPLETED_EVENT 8
+// commands of one slab, every one waits for the one before
+#define UPLOAD_COMPLETED_EVENT 0
+#define GAUSS_3D_COMPLETED_EVENT 1
+#define FHT_SINOGRAM_COMPLETED_EVENT 2
 
-#define ALL_EVENTS_COMPLETED 8
+#define DHT_1D_TO_2D_COMPLETED_EVENT 3
+#define DHT_2D_I_FIRST_1D_COMPLETED_EVENT 4
+#define DHT_2D_I_SECOND_1D_COMPLETED_EVENT 5
+#define DHT_2D_I_COMPLETED_EVENT 6
+#define READBACK_COMPLETED_EVENT 7
+
+#define ALL_EVENTS 8
 
 namespace Parser {
+    // one row per work-group, there are no more than length / 4 butterflies per stage to share
+    static size_t fhtWorkGroupSize(cl_kernel kernel, cl_device_id device, const size_t & length, const size_t & preferred) {
+        size_t kernelWorkGroupSize = preferred;
+
+        clGetKernelWorkGroupInfo(kernel, device, CL_KERNEL_WORK_GROUP_SIZE,
+                                 sizeof(size_t), &kernelWorkGroupSize, nullptr);
+
+        return std::max((size_t) 1, std::min(std::min(preferred, kernelWorkGroupSize), length / 4));
+    }
+
+    static const size_t * localThreads(const QVector<size_t> & localSize) {
+        return localSize.at(0) ? localSize.constData() : nullptr;
+    }
+
+    // global sizes become multiples of the local ones, the kernels skip the work-items out of the image
+    static void padGlobalThreads(size_t * globalThreads, const QVector<size_t> & localSize, const cl_uint & dims) {
+        if (!localSize.at(0)) {
+            return;
+        }
+
+        for (cl_uint i = 0; i != dims; ++ i) {
+            globalThreads[i] = (globalThreads[i] + localSize.at(i) - 1) / localSize.at(i) * localSize.at(i);
+        }
+    }
+
+    // powers of two the kernel and the device allow, the runtime's own choice is the first one
+    static QVector<QVector<size_t> > localSizeCandidates(cl_kernel kernel, cl_device_id device, const cl_uint & dims) {
+        size_t kernelWorkGroupSize = 1;
+        size_t maxWorkItemSizes[3] = {1, 1, 1};
+
+        clGetKernelWorkGroupInfo(kernel, device, CL_KERNEL_WORK_GROUP_SIZE, sizeof(size_t), &kernelWorkGroupSize, nullptr);
+        clGetDeviceInfo(device, CL_DEVICE_MAX_WORK_ITEM_SIZES, sizeof(maxWorkItemSizes), maxWorkItemSizes, nullptr);
+
+        size_t maxWorkGroupSize = std::min(kernelWorkGroupSize, (size_t) AUTOTUNE_MAX_WORK_GROUP_SIZE);
+
+        size_t maxX = maxWorkItemSizes[0];
+        size_t maxY = dims > 1 ? maxWorkItemSizes[1] : 1;
+        size_t maxZ = dims > 2 ? std::min(maxWorkItemSizes[2], (size_t) AUTOTUNE_MAX_WORK_GROUP_DEPTH) : 1;
+
+        QVector<QVector<size_t> > candidates;
+
+        candidates.push_back(QVector<size_t>() << 0 << 0 << 0);
+
+        for (size_t z = 1; z <= maxZ; z *= 2) {
+            for (size_t y = 1; y <= maxY; y *= 2) {
+                for (size_t x = 1; x <= maxX && x * y * z <= maxWorkGroupSize; x *= 2) {
+                    candidates.push_back(QVector<size_t>() << x << y << z);
+                }
+            }
+        }
+
+        return candidates;
+    }
+
+    // work-groups of the fast hartley transforms are one row wide
+    static QVector<QVector<size_t> > fhtLocalSizeCandidates(cl_kernel kernel, cl_device_id device, const size_t & length) {
+        QVector<QVector<size_t> > candidates;
+
+        size_t maxSize = fhtWorkGroupSize(kernel, device, length, AUTOTUNE_MAX_WORK_GROUP_SIZE);
+
+        for (size_t x = 1; x <= maxSize; x *= 2) {
+            candidates.push_back(QVector<size_t>() << x << 1 << 1);
+        }
+
+        return candidates;
+    }
+
+    // tile and pass of gauss3d hold the work-group's block and radius voxels around it, each
+    static size_t gaussLocalBytes(const QVector<size_t> & localSize, const int & radius) {
+        return sizeof(float) * (localSize.at(0) + 2 * radius) * (localSize.at(1) + 2 * radius) * (localSize.at(2) + 2 * radius);
+    }
+
+    static bool isGaussLocalSizeFitting(cl_kernel kernel, cl_device_id device, const QVector<size_t> & localSize,
+                                        const int & radius) {
+        size_t kernelWorkGroupSize = 1;
+        cl_ulong localMemSize = 0;
+
+        clGetKernelWorkGroupInfo(kernel, device, CL_KERNEL_WORK_GROUP_SIZE, sizeof(size_t), &kernelWorkGroupSize, nullptr);
+        clGetDeviceInfo(device, CL_DEVICE_LOCAL_MEM_SIZE, sizeof(cl_ulong), &localMemSize, nullptr);
+
+        return localSize.at(0) * localSize.at(1) * localSize.at(2) <= kernelWorkGroupSize &&
+                2 * gaussLocalBytes(localSize, radius) <= localMemSize;
+    }
+
+    // the largest side is halved until gauss3d fits, the runtime can't choose since tiles are sized by the host
+    static QVector<size_t> fitGaussLocalSize(cl_kernel kernel, cl_device_id device, QVector<size_t> localSize,
+                                             const int & radius) {
+        for (size_t & size : localSize) {
+            size = std::max(size, (size_t) 1);
+        }
+
+        while (!isGaussLocalSizeFitting(kernel, device, localSize, radius)) {
+            size_t & largest = *std::max_element(localSize.begin(), localSize.end());
+
+            if (largest == 1) {
+                break;
+            }
+
+            largest /= 2;
+        }
+
+        return localSize;
+    }
+
+    static const char * eventNames[ALL_EVENTS] = {
+        "upload", "gauss3d", "fhtSinogram",
+        "fourier2d", "dht1dTranspose rows", "dht1dTranspose columns", "butterflyDht2d", "readback"
+    };
+
+    // seconds the command ran, 0 if the queue doesn't profile
+    static double profiledTime(cl_event event) {
+        cl_ulong start = 0;
+        cl_ulong end = 0;
+
+        if (clGetEventProfilingInfo(event, CL_PROFILING_COMMAND_START, sizeof(cl_ulong), &start, nullptr) != CL_SUCCESS ||
+                clGetEventProfilingInfo(event, CL_PROFILING_COMMAND_END, sizeof(cl_ulong), &end, nullptr) != CL_SUCCESS) {
+            return 0.0;
+        }
+
+        return (end - start) * 1e-9;
+    }
+
+    static cl_mem createImage3D(cl_context context, cl_mem_flags flags,
+                                const size_t & width, const size_t & height, const size_t & depth,
+                                cl_int * errNo) {
+        cl_image_format image_format;
+        image_format.image_channel_data_type = CL_FLOAT;
+        image_format.image_channel_order = CL_R;
+
+    #ifdef CL_VERSION_1_2
+        cl_image_desc image_desc;
+        image_desc.image_type = CL_MEM_OBJECT_IMAGE3D;
+        image_desc.image_width = width;
+        image_desc.image_height = height;
+        image_desc.image_depth = depth;
+        image_desc.image_array_size = 0;
+        image_desc.buffer = nullptr;
+        image_desc.num_mip_levels = 0;
+        image_desc.image_row_pitch = 0;
+        image_desc.image_slice_pitch = 0;
+        image_desc.num_samples = 0;
+
+        return clCreateImage(context, flags, &image_format, &image_desc, nullptr, errNo);
+    #else
+        return clCreateImage3D(context, flags, &image_format, width, height, depth, 0, 0, nullptr, errNo);
+    #endif
+    }
+
     Reconstructor::Reconstructor() :
         AbstractParser(),
+        _gaussSigma(SIGMA_GAUSS),
+        _gaussSize(KERN_SIZE_GAUSS),
         _isOCLInitialized(false) {
     }
 
+    qreal Reconstructor::gaussSigma() const {
+        return _gaussSigma;
+    }
+
+    int Reconstructor::gaussSize() const {
+        return _gaussSize;
+    }
+
+    void Reconstructor::setGaussSigma(const qreal & gaussSigma) {
+        _gaussSigma = gaussSigma;
+
+        emit gaussSigmaChanged();
+    }
+
+    void Reconstructor::setGaussSize(const int & gaussSize) {
+        _gaussSize = gaussSize;
+
+        emit gaussSizeChanged();
+    }
+
     Reconstructor::~Reconstructor() {
         reset();
 
@@ -44,30 +237,306 @@ namespace Parser {
         qDeleteAll(_slicesOCL);
     }
 
-    void Reconstructor::initOCL() {
-        _context = CLInfo::createContext(CL_DEVICE_TYPE_GPU, 1, const_cast<cl_device_id *>(&_device_id), nullptr, nullptr, nullptr, false);
-        _queue = clCreateCommandQueue(_context, _device_id, 0, nullptr);
-        _programReconstruction = CLInfo::createProgram(_context, ":cl/reconstructor.cl");
+    bool Reconstructor::initOCL() {
+        cl_int errNo = CL_SUCCESS;
+
+        _context = CLInfo::createContext(CLInfo::deviceType(CLInfo::device()), 1, const_cast<cl_device_id *>(&_device_id),
+                                         nullptr, nullptr, &errNo, false);
+
+        if (!_context) {
+            qDebug() << "No OpenCL device for reconstruction, error: " << errNo;
+            return false;
+        }
+
+        cl_command_queue_properties queueProperties = 0;
 
-        qDebug() << "Building OpenCL Program, error: " << clBuildProgram(_programReconstruction, 1, &_device_id, nullptr, nullptr, nullptr);
+        clGetDeviceInfo(_device_id, CL_DEVICE_QUEUE_PROPERTIES, sizeof(cl_command_queue_properties), &queueProperties, nullptr);
 
-        _gauss1dKernel = clCreateKernel(_programReconstruction, "gauss1d", nullptr);
+        // the event graph holds on devices that only run commands in order as well
+        queueProperties &= CL_QUEUE_OUT_OF_ORDER_EXEC_MODE_ENABLE | CL_QUEUE_PROFILING_ENABLE;
+
+        for (cl_command_queue & queue : _queues) {
+            queue = clCreateCommandQueue(_context, _device_id, queueProperties, nullptr);
+        }
+        _programReconstruction = CLInfo::buildProgram(_context, _device_id, ":cl/reconstructor.cl");
+
+        if (!_programReconstruction) {
+            for (cl_command_queue queue : _queues) {
+                clReleaseCommandQueue(queue);
+            }
+            clReleaseContext(_context);
+
+            return false;
+        }
+
+        _gauss3dKernel = clCreateKernel(_programReconstruction, "gauss3d", nullptr);
         _calcTablesKernel = clCreateKernel(_programReconstruction, "calcTables", nullptr);
+        _fhtSinogramKernel = clCreateKernel(_programReconstruction, "fhtSinogram", nullptr);
         _fourier2dKernel = clCreateKernel(_programReconstruction, "fourier2d", nullptr);
         _dht1dTransposeKernel = clCreateKernel(_programReconstruction, "dht1dTranspose", nullptr);
         _butterflyDht2dKernel = clCreateKernel(_programReconstruction, "butterflyDht2d", nullptr);
+
+        _localSizes["gauss3d"] = QVector<size_t>() << GAUSS_WORK_GROUP_WIDTH << GAUSS_WORK_GROUP_HEIGHT << GAUSS_WORK_GROUP_DEPTH;
+        _localSizes["calcTables"] = QVector<size_t>() << WORK_GROUP_WIDTH << WORK_GROUP_WIDTH << 1;
+        _localSizes["fhtSinogram"] = QVector<size_t>() << FHT_WORK_GROUP_SIZE << 1 << 1;
+        _localSizes["fourier2d"] = QVector<size_t>() << WORK_GROUP_WIDTH << WORK_GROUP_HEIGHT << 1;
+        _localSizes["dht1dTranspose"] = QVector<size_t>() << FHT_WORK_GROUP_SIZE << 1 << 1;
+        _localSizes["butterflyDht2d"] = QVector<size_t>() << 0 << 0 << 0;
+
+        if (CLInfo::isAutotuning()) {
+            autotune();
+        }
+        else {
+            QJsonObject kernels = CLInfo::loadDeviceProfile(_device_id, DEVICE_PROFILE)["kernels"].toObject();
+
+            for (auto it = _localSizes.begin(); it != _localSizes.end(); ++ it) {
+                QJsonArray localSize = kernels[it.key()].toArray();
+
+                if (localSize.size() == 3) {
+                    it.value() = QVector<size_t>() << localSize[0].toInt() << localSize[1].toInt() << localSize[2].toInt();
+                }
+            }
+        }
         
         _isOCLInitialized = true;
+
+        return true;
     }
     
+    double Reconstructor::timeKernel(cl_kernel kernel, const cl_uint & dims, const size_t * globalThreads,
+                                     const QVector<size_t> & localSize) {
+        size_t paddedGlobalThreads[3] = {1, 1, 1};
+
+        std::copy(globalThreads, globalThreads + dims, paddedGlobalThreads);
+
+        padGlobalThreads(paddedGlobalThreads, localSize, dims);
+
+        // warm up, sizes the device turns down are out
+        if (clEnqueueNDRangeKernel(_queues[0], kernel, dims, nullptr, paddedGlobalThreads, localThreads(localSize),
+                                   0, nullptr, nullptr) != CL_SUCCESS || clFinish(_queues[0]) != CL_SUCCESS) {
+            return -1.0;
+        }
+
+        double time = 0.0;
+
+        for (int run = 0; run != AUTOTUNE_RUNS; ++ run) {
+            cl_event event;
+
+            double startTime = cv::getTickCount() / cv::getTickFrequency();
+
+            if (clEnqueueNDRangeKernel(_queues[0], kernel, dims, nullptr, paddedGlobalThreads, localThreads(localSize),
+                                       0, nullptr, &event) != CL_SUCCESS) {
+                return -1.0;
+            }
+
+            clWaitForEvents(1, &event);
+
+            // host time if the queue doesn't profile
+            double eventTime = profiledTime(event);
+
+            time += eventTime > 0.0 ? eventTime : cv::getTickCount() / cv::getTickFrequency() - startTime;
+
+            clReleaseEvent(event);
+        }
+
+        return time / AUTOTUNE_RUNS;
+    }
+
+    void Reconstructor::autotune() {
+        const size_t width = AUTOTUNE_WIDTH;
+        const size_t rows = AUTOTUNE_ROWS;
+        const size_t depth = AUTOTUNE_ANGLES;
+
+        HartleyTables hartley(width * PADDED_INCREASE);
+
+        const size_t paddedWidth = hartley.length;
+
+        std::vector<float> gaussTable = gaussWeights(_gaussSigma, _gaussSize);
+
+        cl_mem gaussBuf = clCreateBuffer(_context, CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR,
+                                         sizeof(float) * gaussTable.size(), (void *) gaussTable.data(), nullptr);
+        cl_mem cosBuf = clCreateBuffer(_context, CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR,
+                                       sizeof(float) * hartley.cosTable.size(), (void *) hartley.cosTable.data(), nullptr);
+        cl_mem sinBuf = clCreateBuffer(_context, CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR,
+                                       sizeof(float) * hartley.sinTable.size(), (void *) hartley.sinTable.data(), nullptr);
+        cl_mem reorderedBuf = clCreateBuffer(_context, CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR,
+                                             sizeof(int) * hartley.digitReversed.size(), (void *) hartley.digitReversed.data(), nullptr);
+        cl_mem tanBuf = clCreateBuffer(_context, CL_MEM_READ_WRITE, sizeof(float) * paddedWidth * paddedWidth, nullptr, nullptr);
+        cl_mem radBuf = clCreateBuffer(_context, CL_MEM_READ_WRITE, sizeof(float) * paddedWidth * paddedWidth, nullptr, nullptr);
+        cl_mem hartleyBuf = clCreateBuffer(_context, CL_MEM_READ_WRITE, sizeof(float) * paddedWidth * rows * depth, nullptr, nullptr);
+
+        cl_mem srcImage = createImage3D(_context, CL_MEM_READ_WRITE, width, rows, depth, nullptr);
+        cl_mem gaussImage = createImage3D(_context, CL_MEM_READ_WRITE, width, rows, depth, nullptr);
+        cl_mem fourier2dImageA = createImage3D(_context, CL_MEM_READ_WRITE, paddedWidth, paddedWidth, rows, nullptr);
+        cl_mem fourier2dImageB = createImage3D(_context, CL_MEM_READ_WRITE, paddedWidth, paddedWidth, rows, nullptr);
+        cl_mem sliceImage = createImage3D(_context, CL_MEM_WRITE_ONLY, width, width, rows, nullptr);
+
+        // zeros, so no kernel runs into denormals or nans; every kernel below reads what the one before wrote
+        std::vector<float> srcData(width * rows * depth, 0.0f);
+
+        size_t origin[3] = {0, 0, 0};
+        size_t regionSrc[3] = {width, rows, depth};
+
+        if (!gaussBuf || !cosBuf || !sinBuf || !reorderedBuf || !tanBuf || !radBuf || !hartleyBuf ||
+                !srcImage || !gaussImage || !fourier2dImageA || !fourier2dImageB || !sliceImage) {
+            qDebug() << "Allocating autotuning data failed, local sizes are left as they are";
+        }
+        else if (clEnqueueWriteImage(_queues[0], srcImage, CL_TRUE, origin, regionSrc, sizeof(float) * width,
+                                     sizeof(float) * width * rows, srcData.data(), 0, nullptr, nullptr) != CL_SUCCESS) {
+            qDebug() << "Uploading autotuning data failed, local sizes are left as they are";
+        }
+        else {
+            int radius = gaussTable.size() / 2;
+            int paddedWidthKernelArg = (int) paddedWidth;
+            int firstRow = 0;
+            float coeff = 1.0f / paddedWidth;
+
+            /* prepare sets the kernel args depending on the local size, if there are any;
+             * the size the kernel had before is timed as well, less than 0 if the device turns it down
+             */
+            auto tune = [&](const QString & name, cl_kernel kernel, const cl_uint & dims, const size_t * globalThreads,
+                            const QVector<QVector<size_t> > & candidates,
+                            const std::function<void (const QVector<size_t> &)> & prepare) {
+                const QVector<size_t> defaultSize = _localSizes[name];
+
+                if (prepare) {
+                    prepare(defaultSize);
+                }
+
+                double defaultTime = timeKernel(kernel, dims, globalThreads, defaultSize);
+
+                double bestTime = -1.0;
+
+                for (const QVector<size_t> & localSize : candidates) {
+                    if (prepare) {
+                        prepare(localSize);
+                    }
+
+                    double time = timeKernel(kernel, dims, globalThreads, localSize);
+
+                    if (time >= 0.0 && (bestTime < 0.0 || time < bestTime)) {
+                        bestTime = time;
+                        _localSizes[name] = localSize;
+                    }
+                }
+
+                qDebug() << "Autotuned" << name << _localSizes[name] << "Elapsed Time: " << bestTime
+                         << "default" << defaultSize << "Elapsed Time: " << defaultTime;
+            };
+
+            clSetKernelArg(_gauss3dKernel, 0, sizeof(cl_mem), (void *) &srcImage);
+            clSetKernelArg(_gauss3dKernel, 1, sizeof(cl_mem), (void *) &gaussImage);
+            clSetKernelArg(_gauss3dKernel, 2, sizeof(cl_mem), (void *) &gaussBuf);
+            clSetKernelArg(_gauss3dKernel, 5, sizeof(int), (void *) &radius);
+
+            size_t globalThreadsGauss3d[3] = {width, rows, depth};
+
+            // only the ones whose tiles fit into local memory
+            QVector<QVector<size_t> > candidatesGauss3d;
+
+            for (const QVector<size_t> & localSize : localSizeCandidates(_gauss3dKernel, _device_id, 3)) {
+                if (localSize.at(0) && isGaussLocalSizeFitting(_gauss3dKernel, _device_id, localSize, radius)) {
+                    candidatesGauss3d.push_back(localSize);
+                }
+            }
+
+            tune("gauss3d", _gauss3dKernel, 3, globalThreadsGauss3d, candidatesGauss3d, [&](const QVector<size_t> & localSize) {
+                clSetKernelArg(_gauss3dKernel, 3, gaussLocalBytes(localSize, radius), nullptr);
+                clSetKernelArg(_gauss3dKernel, 4, gaussLocalBytes(localSize, radius), nullptr);
+            });
+
+            clSetKernelArg(_calcTablesKernel, 0, sizeof(cl_mem), (void *) &tanBuf);
+            clSetKernelArg(_calcTablesKernel, 1, sizeof(cl_mem), (void *) &radBuf);
+            clSetKernelArg(_calcTablesKernel, 2, sizeof(int), (void *) &paddedWidthKernelArg);
+            clSetKernelArg(_calcTablesKernel, 3, sizeof(int), (void *) &paddedWidthKernelArg);
+
+            size_t globalThreadsCalcTables[2] = {paddedWidth, paddedWidth};
+
+            tune("calcTables", _calcTablesKernel, 2, globalThreadsCalcTables, localSizeCandidates(_calcTablesKernel, _device_id, 2),
+                 nullptr);
+
+            clSetKernelArg(_fhtSinogramKernel, 0, sizeof(cl_mem), (void *) &gaussImage);
+            clSetKernelArg(_fhtSinogramKernel, 1, sizeof(cl_mem), (void *) &hartleyBuf);
+            clSetKernelArg(_fhtSinogramKernel, 2, sizeof(cl_mem), (void *) &cosBuf);
+            clSetKernelArg(_fhtSinogramKernel, 3, sizeof(cl_mem), (void *) &sinBuf);
+            clSetKernelArg(_fhtSinogramKernel, 4, sizeof(float) * paddedWidth, nullptr);
+            clSetKernelArg(_fhtSinogramKernel, 5, sizeof(int), (void *) &paddedWidthKernelArg);
+            clSetKernelArg(_fhtSinogramKernel, 6, sizeof(cl_mem), (void *) &reorderedBuf);
+            clSetKernelArg(_fhtSinogramKernel, 7, sizeof(int), (void *) &firstRow);
+
+            // padded up to one work-group per row
+            size_t globalThreadsFhtSinogram[3] = {1, rows, depth};
+
+            tune("fhtSinogram", _fhtSinogramKernel, 3, globalThreadsFhtSinogram,
+                 fhtLocalSizeCandidates(_fhtSinogramKernel, _device_id, paddedWidth), nullptr);
+
+            clSetKernelArg(_fourier2dKernel, 0, sizeof(cl_mem), (void *) &gaussImage);
+            clSetKernelArg(_fourier2dKernel, 1, sizeof(cl_mem), (void *) &fourier2dImageA);
+            clSetKernelArg(_fourier2dKernel, 2, sizeof(cl_mem), (void *) &hartleyBuf);
+            clSetKernelArg(_fourier2dKernel, 3, sizeof(cl_mem), (void *) &tanBuf);
+            clSetKernelArg(_fourier2dKernel, 4, sizeof(cl_mem), (void *) &radBuf);
+
+            size_t globalThreadsFourier2d[3] = {paddedWidth, paddedWidth, rows};
+
+            tune("fourier2d", _fourier2dKernel, 3, globalThreadsFourier2d, localSizeCandidates(_fourier2dKernel, _device_id, 3),
+                 nullptr);
+
+            clSetKernelArg(_dht1dTransposeKernel, 0, sizeof(cl_mem), (void *) &fourier2dImageA);
+            clSetKernelArg(_dht1dTransposeKernel, 1, sizeof(cl_mem), (void *) &fourier2dImageB);
+            clSetKernelArg(_dht1dTransposeKernel, 2, sizeof(cl_mem), (void *) &cosBuf);
+            clSetKernelArg(_dht1dTransposeKernel, 3, sizeof(cl_mem), (void *) &sinBuf);
+            clSetKernelArg(_dht1dTransposeKernel, 4, sizeof(float) * paddedWidth, nullptr);
+            clSetKernelArg(_dht1dTransposeKernel, 5, sizeof(cl_mem), (void *) &reorderedBuf);
+            clSetKernelArg(_dht1dTransposeKernel, 6, sizeof(float), (void *) &coeff);
+
+            size_t globalThreadsDht1dTranspose[3] = {1, paddedWidth, rows};
+
+            tune("dht1dTranspose", _dht1dTransposeKernel, 3, globalThreadsDht1dTranspose,
+                 fhtLocalSizeCandidates(_dht1dTransposeKernel, _device_id, paddedWidth), nullptr);
+
+            clSetKernelArg(_butterflyDht2dKernel, 0, sizeof(cl_mem), (void *) &fourier2dImageB);
+            clSetKernelArg(_butterflyDht2dKernel, 1, sizeof(cl_mem), (void *) &sliceImage);
+
+            size_t globalThreadsButterfly[3] = {paddedWidth / 2 + 1, paddedWidth / 2 + 1, rows};
+
+            tune("butterflyDht2d", _butterflyDht2dKernel, 3, globalThreadsButterfly,
+                 localSizeCandidates(_butterflyDht2dKernel, _device_id, 3), nullptr);
+
+            QJsonObject kernels;
+
+            for (auto it = _localSizes.constBegin(); it != _localSizes.constEnd(); ++ it) {
+                kernels[it.key()] = QJsonArray() << (int) it.value().at(0) << (int) it.value().at(1) << (int) it.value().at(2);
+            }
+
+            QJsonObject profile;
+
+            profile["kernels"] = kernels;
+
+            if (!CLInfo::storeDeviceProfile(_device_id, DEVICE_PROFILE, profile)) {
+                qDebug() << "Storing the device profile failed";
+            }
+        }
+
+        for (cl_mem mem : {gaussBuf, cosBuf, sinBuf, reorderedBuf, tanBuf, radBuf, hartleyBuf,
+                           srcImage, gaussImage, fourier2dImageA, fourier2dImageB, sliceImage}) {
+            if (mem) {
+                clReleaseMemObject(mem);
+            }
+        }
+    }
+
     void Reconstructor::releaseOCLResources() {
+        clReleaseKernel(_gauss3dKernel);
         clReleaseKernel(_calcTablesKernel);
         clReleaseKernel(_butterflyDht2dKernel);
+        clReleaseKernel(_fhtSinogramKernel);
         clReleaseKernel(_fourier2dKernel);
         clReleaseKernel(_dht1dTransposeKernel);
         
         clReleaseProgram(_programReconstruction);
-        clReleaseCommandQueue(_queue);
+        for (cl_command_queue queue : _queues) {
+            clReleaseCommandQueue(queue);
+        }
 #ifdef CL_VERSION_1_2
         clReleaseDevice(_device_id);
 #endif
@@ -75,288 +544,435 @@ namespace Parser {
     }
 
     void Reconstructor::reconstruct() {
-        if (!_isOCLInitialized) {
-            initOCL();
-        }
-        
         float startTime = cv::getTickCount() / cv::getTickFrequency();
 
-        size_t height = _src.at(0).rows;
-        size_t width = _src.at(0).cols;
-        size_t depth = _src.size();
-        size_t paddedWidth = width * PADDED_INCREASE;
+        reconstructSlices();
 
-        size_t rowPitchSrc = sizeof(float) * width;
-        size_t slicePitchSrc = rowPitchSrc * height;
-        size_t srcSize = slicePitchSrc * depth;
+        qDebug() << "Elapsed Time: " << cv::getTickCount() / cv::getTickFrequency() - startTime;
 
-        size_t slicePitchFourier2d = sizeof(float) * paddedWidth * paddedWidth;
+        maskSlices();
 
-        size_t rowPitchDst = sizeof(float) * width;
-        size_t slicePitchDst = rowPitchDst * width;
+        sendToScene();
+    }
 
-        uchar * srcData = new uchar[srcSize];
-        uchar * posSlice = srcData;
+    bool Reconstructor::reconstructSlices(const QVector<cv::Mat> & projections, QVector<cv::Mat> & slices) {
+        _src = projections;
 
-        for (const cv::Mat & slice : _src) {
-            memcpy(posSlice, slice.data, slicePitchSrc);
-            posSlice += slicePitchSrc;
-        }
+        bool isReconstructedOCL = reconstructSlices();
 
-        float gaussTab[KERN_SIZE_GAUSS];
+        slices.clear();
 
-#ifdef GAUSS
-        float r;
-        float s = 2.0 * SIGMA_GAUSS * SIGMA_GAUSS;
-        
-        float sum = 0.0;
-        
-        for (int x = - KERN_SIZE_GAUSS / 2; x <= KERN_SIZE_GAUSS / 2 + 1; ++ x) {
-            r = x * x;
-            gaussTab[x + 2] = (exp(-r / s)) / (CV_PI * s);
-            sum += gaussTab[x + 2];
+        for (const cv::Mat * slice : _slicesOCL) {
+            slices.push_back(slice->clone());
         }
 
-        // normalize the Kernel
-        for(int i = 0; i < KERN_SIZE_GAUSS; ++i) {
-            gaussTab[i] /= sum;
+        return isReconstructedOCL;
+    }
+
+    bool Reconstructor::reconstructSlices() {
+        std::vector<float> gaussTable = gaussWeights(_gaussSigma, _gaussSize);
+
+        // fast hartley transform needs 2^a * 3^b, the shortest one the padded rows fit into
+        Parser::HartleyTables hartley(_src.at(0).cols * PADDED_INCREASE);
+
+        bool isReconstructed = false;
+
+        if (CLInfo::device() != CLInfo::NATIVE) {
+            if (!_isOCLInitialized) {
+                initOCL();
+            }
+
+            isReconstructed = _isOCLInitialized && reconstructOCL(gaussTable, hartley);
+
+            if (_isOCLInitialized && !isReconstructed) {
+                qDebug() << "OpenCL reconstruction failed, it's done natively";
+            }
         }
-#else
-        for(int i = 0; i < KERN_SIZE_GAUSS; ++i) {
-            gaussTab[i] = KERN_SIZE_GAUSS;
+
+        // no opencl device on this machine, so it's done with all cores
+        if (!isReconstructed) {
+            reconstructCPU(gaussTable, hartley);
         }
-#endif
 
-        cl_image_format image_format;
-        image_format.image_channel_data_type = CL_FLOAT;
-        image_format.image_channel_order = CL_R;
+        return isReconstructed;
+    }
 
-    #ifdef CL_VERSION_1_2
-        cl_image_desc image_desc_src;
-        image_desc_src.image_type = CL_MEM_OBJECT_IMAGE3D;
-        image_desc_src.image_width = width;
-        image_desc_src.image_height = height;
-        image_desc_src.image_depth = depth;
-        image_desc_src.buffer = nullptr;
-        image_desc_src.num_mip_levels = 0;
-        image_desc_src.image_row_pitch = rowPitchSrc;
-        image_desc_src.image_slice_pitch = slicePitchSrc;
-        image_desc_src.num_samples = 0;
-
-        cl_image_desc image_desc_gauss;
-        image_desc_gauss.image_type = CL_MEM_OBJECT_IMAGE3D;
-        image_desc_gauss.image_width = width;
-        image_desc_gauss.image_height = height;
-        image_desc_gauss.image_depth = depth;
-        image_desc_gauss.buffer = nullptr;
-        image_desc_gauss.num_mip_levels = 0;
-        image_desc_gauss.image_row_pitch = rowPitchSrc;
-        image_desc_gauss.image_slice_pitch = slicePitchSrc;
-        image_desc_gauss.num_samples = 0;
-
-        cl_image_desc image_desc_fourier2d;
-        image_desc_fourier2d.image_type = CL_MEM_OBJECT_IMAGE3D;
-        image_desc_fourier2d.image_width = paddedWidth;
-        image_desc_fourier2d.image_height = paddedWidth;
-        image_desc_fourier2d.image_depth = height;
-        image_desc_fourier2d.buffer = nullptr;
-        image_desc_fourier2d.num_mip_levels = 0;
-        image_desc_fourier2d.image_row_pitch = 0;
-        image_desc_fourier2d.image_slice_pitch = 0;
-        image_desc_fourier2d.num_samples = 0;
-
-        cl_image_desc image_desc_slices;
-        image_desc_slices.image_type = CL_MEM_OBJECT_IMAGE3D;
-        image_desc_slices.image_width = width;
-        image_desc_slices.image_height = width;
-        image_desc_slices.image_depth = height;
-        image_desc_slices.buffer = nullptr;
-        image_desc_slices.num_mip_levels = 0;
-        image_desc_slices.image_row_pitch = 0;
-        image_desc_slices.image_slice_pitch = 0;
-        image_desc_slices.num_samples = 0;
-    #endif
-        size_t origin[3] = {0, 0, 0};
-        size_t regionSlice[3] = {width, width, height};
+    // device memory and host staging of one slab, its queue keeps upload, kernels and readback in order
+    typedef struct _OCLSlab {
+        ReconstructionSlab rows;
 
-        cl_event eventList[ALL_EVENTS];
+        cl_command_queue queue;
 
-        cl_int errNo;
+        cl_mem srcImage;
+        cl_mem gaussImage;
+        cl_mem hartleyBuf;
+        cl_mem fourier2dImageA;
+        cl_mem fourier2dImageB;
+        cl_mem sliceImage;
 
-    #ifdef CL_VERSION_1_2
-        cl_mem srcImage = clCreateImage(_context, CL_MEM_READ_WRITE | CL_MEM_USE_HOST_PTR,
-                                          &image_format, &image_desc_src, (void *) srcData, &errNo);
+        cl_event events[ALL_EVENTS];
 
-        cl_mem gaussImage = clCreateImage(_context, CL_MEM_READ_WRITE | CL_MEM_ALLOC_HOST_PTR,
-                                          &image_format, &image_desc_gauss, nullptr, &errNo);
+        std::vector<float> srcData;
+        std::vector<float> sliceData;
 
-    #else
-        cl_mem srcImage = clCreateImage3D(_context, CL_MEM_READ_WRITE | CL_MEM_USE_HOST_PTR,
-                                          &image_format, width, height, depth,
-                                          rowPitchSrc, slicePitchSrc, (void *) srcData, nullptr);
+        bool isBusy;
+    } OCLSlab;
 
-        cl_mem gaussImage = clCreateImage3D(_context, CL_MEM_READ_WRITE | CL_MEM_USE_HOST_PTR,
-                                          &image_format, width, height, depth,
-                                          0, 0, nullptr, nullptr);
+    bool Reconstructor::reconstructOCL(const std::vector<float> & gaussTable, const HartleyTables & hartley) {
+        size_t height = _src.at(0).rows;
+        size_t width = _src.at(0).cols;
+        size_t depth = _src.size();
 
-    #endif
+        size_t paddedWidth = hartley.length;
 
-        uint dir0 = 0;
-        uint dir1 = 1;
+        int radius = gaussTable.size() / 2;
+        int halo = radius;
 
-        int kernGaussSize = KERN_SIZE_GAUSS / 2;
+        size_t rowPitchSrc = sizeof(float) * width;
+        size_t slicePitchFourier2d = sizeof(float) * paddedWidth * paddedWidth;
+        size_t slicePitchDst = sizeof(float) * width * width;
 
-        cl_mem gaussBuf = clCreateBuffer(_context, CL_MEM_READ_ONLY | CL_MEM_USE_HOST_PTR,
-                                         sizeof(float) * KERN_SIZE_GAUSS, (void *) &gaussTab, nullptr);
-        
-        size_t globalThreadsGauss1d[3] = {width, height, depth};
-        size_t localThreadsGauss1d[3] = {WORK_GROUP_WIDTH, WORK_GROUP_HEIGHT, 6};
-
-        clSetKernelArg(_gauss1dKernel, 0, sizeof(cl_mem), (void *) &srcImage);
-        clSetKernelArg(_gauss1dKernel, 1, sizeof(cl_mem), (void *) &gaussImage);
-        clSetKernelArg(_gauss1dKernel, 2, sizeof(cl_mem), (void *) &gaussBuf);
-        clSetKernelArg(_gauss1dKernel, 3, sizeof(uint), (void *) &dir1);
-        clSetKernelArg(_gauss1dKernel, 4, sizeof(uint), (void *) &dir0);
-        clSetKernelArg(_gauss1dKernel, 5, sizeof(uint), (void *) &dir0);
-        clSetKernelArg(_gauss1dKernel, 6, sizeof(int), (void *) &kernGaussSize);
-        
-        clEnqueueNDRangeKernel(_queue, _gauss1dKernel, 3, nullptr, globalThreadsGauss1d, localThreadsGauss1d,
-                               0, nullptr, eventList + GAUSS_1D_COMPLETED_EVENT_X);
-        
-        clWaitForEvents(GAUSS_1D_COMPLETED_EVENT_X, eventList);
+        cl_ulong globalMemSize = 0;
+        cl_ulong maxAllocSize = 0;
 
-        clSetKernelArg(_gauss1dKernel, 0, sizeof(cl_mem), (void *) &gaussImage);
-        clSetKernelArg(_gauss1dKernel, 1, sizeof(cl_mem), (void *) &srcImage);
-        clSetKernelArg(_gauss1dKernel, 3, sizeof(uint), (void *) &dir0);
-        clSetKernelArg(_gauss1dKernel, 4, sizeof(uint), (void *) &dir1);
-        clSetKernelArg(_gauss1dKernel, 5, sizeof(uint), (void *) &dir0);
-        
-        clEnqueueNDRangeKernel(_queue, _gauss1dKernel, 3, nullptr, globalThreadsGauss1d, localThreadsGauss1d,
-                               GAUSS_1D_COMPLETED_EVENT_Y, eventList, eventList + GAUSS_1D_COMPLETED_EVENT_Y);
-        
-        clWaitForEvents(GAUSS_1D_COMPLETED_EVENT_Y, eventList);
+        clGetDeviceInfo(_device_id, CL_DEVICE_GLOBAL_MEM_SIZE, sizeof(cl_ulong), &globalMemSize, nullptr);
+        clGetDeviceInfo(_device_id, CL_DEVICE_MAX_MEM_ALLOC_SIZE, sizeof(cl_ulong), &maxAllocSize, nullptr);
 
-        clSetKernelArg(_gauss1dKernel, 0, sizeof(cl_mem), (void *) &srcImage);
-        clSetKernelArg(_gauss1dKernel, 1, sizeof(cl_mem), (void *) &gaussImage);
-        clSetKernelArg(_gauss1dKernel, 3, sizeof(uint), (void *) &dir0);
-        clSetKernelArg(_gauss1dKernel, 4, sizeof(uint), (void *) &dir0);
-        clSetKernelArg(_gauss1dKernel, 5, sizeof(uint), (void *) &dir1);
+        // half of the device is left for the driver and everybody else if there's no budget
+        size_t budget = CLInfo::memoryBudget() ? std::min((size_t) globalMemSize, CLInfo::memoryBudget()) : (size_t) globalMemSize / 2;
+
+        // source and gauss volumes, transformed sinogram, both fourier images and the slices, per detector row
+        size_t rowBytes = 2 * rowPitchSrc * depth + sizeof(float) * paddedWidth * depth + 2 * slicePitchFourier2d + slicePitchDst;
+        size_t fixedBytes = 2 * slicePitchFourier2d + SLABS_IN_FLIGHT * 2 * halo * 2 * rowPitchSrc * depth;
+
+        int rowsPerSlab = slabRowCount(budget, fixedBytes, rowBytes, SLABS_IN_FLIGHT, (int) height);
+
+        // every fourier image and the transformed sinogram are single allocations
+        rowsPerSlab = std::min(rowsPerSlab, (int) (maxAllocSize / slicePitchFourier2d));
+        rowsPerSlab = std::max(1, std::min(rowsPerSlab, (int) (maxAllocSize / (sizeof(float) * paddedWidth * depth))));
+
+        QVector<ReconstructionSlab> slabs = splitSlabs((int) height, rowsPerSlab, halo);
+
+        qDebug() << "Reconstruction slabs: " << slabs.size() << "of" << rowsPerSlab << "rows";
+
+        cl_int errNo = CL_SUCCESS;
+
+        cl_mem gaussBuf = clCreateBuffer(_context, CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR,
+                                         sizeof(float) * gaussTable.size(), (void *) gaussTable.data(), nullptr);
+        cl_mem cosBuf = clCreateBuffer(_context, CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR,
+                                       sizeof(float) * hartley.cosTable.size(), (void *) hartley.cosTable.data(), nullptr);
+        cl_mem sinBuf = clCreateBuffer(_context, CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR,
+                                       sizeof(float) * hartley.sinTable.size(), (void *) hartley.sinTable.data(), nullptr);
+        cl_mem reorderedBuf = clCreateBuffer(_context, CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR,
+                                             sizeof(int) * hartley.digitReversed.size(), (void *) hartley.digitReversed.data(), nullptr);
 
-        clEnqueueNDRangeKernel(_queue, _gauss1dKernel, 3, nullptr, globalThreadsGauss1d, localThreadsGauss1d,
-                               GAUSS_1D_COMPLETED_EVENT_Z, eventList, eventList + GAUSS_1D_COMPLETED_EVENT_Z);
-        
-        clWaitForEvents(GAUSS_1D_COMPLETED_EVENT_Z, eventList);
-        
-        delete [] srcData;
-        clReleaseMemObject(srcImage);
-        clReleaseMemObject(gaussBuf);
-        
-        cl_mem casBuf = clCreateBuffer(_context, CL_MEM_READ_WRITE, slicePitchFourier2d, nullptr, nullptr);
         cl_mem tanBuf = clCreateBuffer(_context, CL_MEM_READ_WRITE, slicePitchFourier2d, nullptr, nullptr);
         cl_mem radBuf = clCreateBuffer(_context, CL_MEM_READ_WRITE, slicePitchFourier2d, nullptr, nullptr);
 
-        float twoPiN = (2 * CV_PI) / paddedWidth;
-
         int paddedWidthKernelArg = (int) paddedWidth;
 
-        clSetKernelArg(_calcTablesKernel, 0, sizeof(cl_mem), (void *) &casBuf);
-        clSetKernelArg(_calcTablesKernel, 1, sizeof(cl_mem), (void *) &tanBuf);
-        clSetKernelArg(_calcTablesKernel, 2, sizeof(cl_mem), (void *) &radBuf);
+        clSetKernelArg(_calcTablesKernel, 0, sizeof(cl_mem), (void *) &tanBuf);
+        clSetKernelArg(_calcTablesKernel, 1, sizeof(cl_mem), (void *) &radBuf);
+        clSetKernelArg(_calcTablesKernel, 2, sizeof(int), (void *) &paddedWidthKernelArg);
         clSetKernelArg(_calcTablesKernel, 3, sizeof(int), (void *) &paddedWidthKernelArg);
-        clSetKernelArg(_calcTablesKernel, 4, sizeof(int), (void *) &paddedWidthKernelArg);
-        clSetKernelArg(_calcTablesKernel, 5, sizeof(float), (void *) &twoPiN);
         
+        const QVector<size_t> & localSizeCalcTables = _localSizes["calcTables"];
+
         size_t globalThreadsCalcTables[2] = {paddedWidth, paddedWidth};
-        size_t localThreadsCalcTables[2] = {WORK_GROUP_WIDTH, WORK_GROUP_WIDTH};
-        
-        clEnqueueNDRangeKernel(_queue, _calcTablesKernel, 2, nullptr,
-                               globalThreadsCalcTables, localThreadsCalcTables, 0, nullptr,
-                               eventList + CALC_TABLES_COMPLETED_EVENT);
-        
-        clWaitForEvents(CALC_TABLES_COMPLETED_EVENT, eventList);
-        
-        
-#ifdef CL_VERSION_1_2
-        cl_mem fourier2dImageA = clCreateImage(_context, CL_MEM_READ_WRITE | CL_MEM_ALLOC_HOST_PTR,
-                                               &image_format, &image_desc_fourier2d, nullptr, &errNo);
-#else
-        cl_mem fourier2dImageA = clCreateImage3D(_context, CL_MEM_READ_WRITE | CL_MEM_ALLOC_HOST_PTR,
-                                                 &image_format, paddedWidth, paddedWidth, height, 0, 0, nullptr, nullptr);
-#endif
-        
-        clSetKernelArg(_fourier2dKernel, 0, sizeof(cl_mem), (void *) &gaussImage);
-        clSetKernelArg(_fourier2dKernel, 1, sizeof(cl_mem), (void *) &fourier2dImageA);
-        clSetKernelArg(_fourier2dKernel, 2, sizeof(cl_mem), (void *) &casBuf);
-        clSetKernelArg(_fourier2dKernel, 3, sizeof(cl_mem), (void *) &tanBuf);
-        clSetKernelArg(_fourier2dKernel, 4, sizeof(cl_mem), (void *) &radBuf);
-        
-        size_t globalThreadsFourier2d[3] = {paddedWidth, paddedWidth, height};
-        size_t localThreadsFourier2d[3] = {WORK_GROUP_WIDTH, WORK_GROUP_HEIGHT, WORK_GROUP_DEPTH};
+
+        padGlobalThreads(globalThreadsCalcTables, localSizeCalcTables, 2);
         
-        clEnqueueNDRangeKernel(_queue, _fourier2dKernel, 3, nullptr, globalThreadsFourier2d, localThreadsFourier2d,
-                               CALC_TABLES_COMPLETED_EVENT, eventList, eventList + DHT_1D_TO_2D_COMPLETED_EVENT);
+        // a command the device turned down fails the reconstruction, so the native path takes over
+        auto isEnqueued = [](const char * name, const cl_int & errNo) -> bool {
+            if (errNo != CL_SUCCESS) {
+                qDebug() << "Enqueueing" << name << "failed, error: " << errNo;
+            }
 
-        clWaitForEvents(DHT_1D_TO_2D_COMPLETED_EVENT, eventList);
+            return errNo == CL_SUCCESS;
+        };
 
-        clReleaseMemObject(gaussImage);
+        // the tables are shared by the slabs of both queues, fourier2d of every slab waits for them
+        cl_event calcTablesEvent;
 
-    #ifdef CL_VERSION_1_2
-        cl_mem fourier2dImageB = clCreateImage(_context, CL_MEM_READ_WRITE | CL_MEM_ALLOC_HOST_PTR,
-                                               &image_format, &image_desc_fourier2d, nullptr, &errNo);
-    #else
-        cl_mem fourier2dImageB = clCreateImage3D(_context, CL_MEM_READ_WRITE | CL_MEM_ALLOC_HOST_PTR,
-                                                 &image_format, paddedWidth, paddedWidth, height, 0, 0, nullptr, nullptr);
-    #endif
+        if (!isEnqueued("calcTables", clEnqueueNDRangeKernel(_queues[0], _calcTablesKernel, 2, nullptr, globalThreadsCalcTables,
+                                                             localThreads(localSizeCalcTables), 0, nullptr, &calcTablesEvent))) {
+            for (cl_mem mem : {gaussBuf, cosBuf, sinBuf, reorderedBuf, tanBuf, radBuf}) {
+                if (mem) {
+                    clReleaseMemObject(mem);
+                }
+            }
+
+            return false;
+        }
+
+        clFlush(_queues[0]);
+
+        // summed over the slabs
+        double eventTimes[ALL_EVENTS] = {0.0};
+
+        // tuned on another length maybe, so clamped to this one
+        size_t fhtWorkGroupSizeSinogram = fhtWorkGroupSize(_fhtSinogramKernel, _device_id, paddedWidth,
+                                                           _localSizes["fhtSinogram"].at(0));
+        size_t fhtWorkGroupSizeTranspose = fhtWorkGroupSize(_dht1dTransposeKernel, _device_id, paddedWidth,
+                                                            _localSizes["dht1dTranspose"].at(0));
+
+        const QVector<size_t> localSizeGauss3d = fitGaussLocalSize(_gauss3dKernel, _device_id, _localSizes["gauss3d"], radius);
+        const QVector<size_t> & localSizeFourier2d = _localSizes["fourier2d"];
+        const QVector<size_t> & localSizeButterfly = _localSizes["butterflyDht2d"];
 
         float coeff = 1.0f / paddedWidth;
-        size_t globalThreadsDht1dTranspose[3] = {paddedWidth, paddedWidth, height};
-        size_t localThreadsDht1dTranspose[3] = {WORK_GROUP_WIDTH, WORK_GROUP_HEIGHT, WORK_GROUP_DEPTH};
-        
-        clSetKernelArg(_dht1dTransposeKernel, 0, sizeof(cl_mem), (void *) &fourier2dImageA);
-        clSetKernelArg(_dht1dTransposeKernel, 1, sizeof(cl_mem), (void *) &fourier2dImageB);
-        clSetKernelArg(_dht1dTransposeKernel, 2, sizeof(cl_mem), (void *) &casBuf);
-        clSetKernelArg(_dht1dTransposeKernel, 3, sizeof(float), (void *) &coeff);
-        
-        clEnqueueNDRangeKernel(_queue, _dht1dTransposeKernel, 3, nullptr, globalThreadsDht1dTranspose,
-                                          localThreadsDht1dTranspose, DHT_1D_TO_2D_COMPLETED_EVENT, eventList, eventList + DHT_2D_I_FIRST_1D_COMPLETED_EVENT);
 
-        clWaitForEvents(DHT_2D_I_FIRST_1D_COMPLETED_EVENT, eventList);
-        
-        clSetKernelArg(_dht1dTransposeKernel, 0, sizeof(cl_mem), (void *) &fourier2dImageB);
-        clSetKernelArg(_dht1dTransposeKernel, 1, sizeof(cl_mem), (void *) &fourier2dImageA);
-        
-        clEnqueueNDRangeKernel(_queue, _dht1dTransposeKernel, 3, nullptr, globalThreadsDht1dTranspose,
-                               localThreadsDht1dTranspose, DHT_2D_I_FIRST_1D_COMPLETED_EVENT, eventList, eventList + DHT_2D_I_SECOND_1D_COMPLETED_EVENT);
+        OCLSlab inFlight[SLABS_IN_FLIGHT];
 
-        clWaitForEvents(DHT_2D_I_SECOND_1D_COMPLETED_EVENT, eventList);
-        
-        clReleaseMemObject(fourier2dImageB);
-        
-#ifdef CL_VERSION_1_2
-        cl_mem sliceImage = clCreateImage(_context, CL_MEM_WRITE_ONLY | CL_MEM_ALLOC_HOST_PTR,
-                                          &image_format, &image_desc_slices, nullptr, &errNo);
-#else
-        cl_mem sliceImage = clCreateImage3D(_context, CL_MEM_WRITE_ONLY | CL_MEM_ALLOC_HOST_PTR,
-                                            &image_format, width, width, height, 0, 0, nullptr, nullptr);
-#endif
+        for (int i = 0; i != SLABS_IN_FLIGHT; ++ i) {
+            inFlight[i].queue = _queues[i];
+            inFlight[i].isBusy = false;
+        }
 
-        size_t globalThreadsButterfly[3] = {paddedWidth / 2 + 1, paddedWidth / 2 + 1, height};
+        // kernel args are taken at enqueue, so both queues can share the kernels
+        auto enqueueSlab = [&](OCLSlab & slab) -> bool {
+            const size_t rows = slab.rows.count;
+            const size_t haloRows = slab.rows.haloCount;
 
-        clSetKernelArg(_butterflyDht2dKernel, 0, sizeof(cl_mem), (void *) &fourier2dImageA);
-        clSetKernelArg(_butterflyDht2dKernel, 1, sizeof(cl_mem), (void *) &sliceImage);
-        
-        clEnqueueNDRangeKernel(_queue, _butterflyDht2dKernel, 3, nullptr, globalThreadsButterfly,
-                               nullptr, DHT_2D_I_SECOND_1D_COMPLETED_EVENT, eventList, eventList + DHT_2D_I_COMPLETED_EVENT);
-        
-        uchar * sliceData = (uchar *) clEnqueueMapImage(_queue, sliceImage,
-                                                 CL_TRUE, CL_MEM_WRITE_ONLY, origin, regionSlice,
-                                                 &rowPitchDst, &slicePitchDst,
-                                                 DHT_2D_I_COMPLETED_EVENT, eventList, eventList + MAP_FINAL_COMPLETED_EVENT, &errNo);
-        
-        qDebug() << errNo;
-        
-        clWaitForEvents(ALL_EVENTS_COMPLETED, eventList);
-        
+            slab.srcData.resize(width * haloRows * depth);
+            slab.sliceData.resize(width * width * rows);
+
+            float * posSlice = slab.srcData.data();
+
+            for (const cv::Mat & image : _src) {
+                memcpy(posSlice, image.ptr<float>(slab.rows.haloFirst), rowPitchSrc * haloRows);
+                posSlice += width * haloRows;
+            }
+
+            errNo = CL_SUCCESS;
+
+            slab.srcImage = createImage3D(_context, CL_MEM_READ_WRITE, width, haloRows, depth, &errNo);
+            slab.gaussImage = createImage3D(_context, CL_MEM_READ_WRITE, width, haloRows, depth, &errNo);
+            slab.hartleyBuf = clCreateBuffer(_context, CL_MEM_READ_WRITE, sizeof(float) * paddedWidth * rows * depth,
+                                             nullptr, &errNo);
+            slab.fourier2dImageA = createImage3D(_context, CL_MEM_READ_WRITE, paddedWidth, paddedWidth, rows, &errNo);
+            slab.fourier2dImageB = createImage3D(_context, CL_MEM_READ_WRITE, paddedWidth, paddedWidth, rows, &errNo);
+            slab.sliceImage = createImage3D(_context, CL_MEM_WRITE_ONLY, width, width, rows, &errNo);
+
+            std::fill(slab.events, slab.events + ALL_EVENTS, (cl_event) nullptr);
+            slab.isBusy = true;
+
+            if (!slab.srcImage || !slab.gaussImage || !slab.hartleyBuf ||
+                    !slab.fourier2dImageA || !slab.fourier2dImageB || !slab.sliceImage) {
+                qDebug() << "Allocating reconstruction slab, error: " << errNo;
+                return false;
+            }
+
+            size_t origin[3] = {0, 0, 0};
+            size_t regionSrc[3] = {width, haloRows, depth};
+            size_t regionSlice[3] = {width, width, rows};
+
+            if (!isEnqueued(eventNames[UPLOAD_COMPLETED_EVENT],
+                            clEnqueueWriteImage(slab.queue, slab.srcImage, CL_FALSE, origin, regionSrc,
+                                                rowPitchSrc, rowPitchSrc * haloRows, slab.srcData.data(), 0, nullptr,
+                                                slab.events + UPLOAD_COMPLETED_EVENT))) {
+                return false;
+            }
+
+            size_t globalThreadsGauss3d[3] = {width, haloRows, depth};
+
+            padGlobalThreads(globalThreadsGauss3d, localSizeGauss3d, 3);
+
+            // all three passes at once, the halo rows only feed it
+            clSetKernelArg(_gauss3dKernel, 0, sizeof(cl_mem), (void *) &slab.srcImage);
+            clSetKernelArg(_gauss3dKernel, 1, sizeof(cl_mem), (void *) &slab.gaussImage);
+            clSetKernelArg(_gauss3dKernel, 2, sizeof(cl_mem), (void *) &gaussBuf);
+            clSetKernelArg(_gauss3dKernel, 3, gaussLocalBytes(localSizeGauss3d, radius), nullptr);
+            clSetKernelArg(_gauss3dKernel, 4, gaussLocalBytes(localSizeGauss3d, radius), nullptr);
+            clSetKernelArg(_gauss3dKernel, 5, sizeof(int), (void *) &radius);
+
+            if (!isEnqueued(eventNames[GAUSS_3D_COMPLETED_EVENT],
+                            clEnqueueNDRangeKernel(slab.queue, _gauss3dKernel, 3, nullptr, globalThreadsGauss3d,
+                                                   localSizeGauss3d.constData(), 1, slab.events + UPLOAD_COMPLETED_EVENT,
+                                                   slab.events + GAUSS_3D_COMPLETED_EVENT))) {
+                return false;
+            }
+
+            int firstRow = slab.rows.first - slab.rows.haloFirst;
+
+            clSetKernelArg(_fhtSinogramKernel, 0, sizeof(cl_mem), (void *) &slab.gaussImage);
+            clSetKernelArg(_fhtSinogramKernel, 1, sizeof(cl_mem), (void *) &slab.hartleyBuf);
+            clSetKernelArg(_fhtSinogramKernel, 2, sizeof(cl_mem), (void *) &cosBuf);
+            clSetKernelArg(_fhtSinogramKernel, 3, sizeof(cl_mem), (void *) &sinBuf);
+            clSetKernelArg(_fhtSinogramKernel, 4, sizeof(float) * paddedWidth, nullptr);
+            clSetKernelArg(_fhtSinogramKernel, 5, sizeof(int), (void *) &paddedWidthKernelArg);
+            clSetKernelArg(_fhtSinogramKernel, 6, sizeof(cl_mem), (void *) &reorderedBuf);
+            clSetKernelArg(_fhtSinogramKernel, 7, sizeof(int), (void *) &firstRow);
+
+            size_t globalThreadsFhtSinogram[3] = {fhtWorkGroupSizeSinogram, rows, depth};
+            size_t localThreadsFhtSinogram[3] = {fhtWorkGroupSizeSinogram, 1, 1};
+
+            if (!isEnqueued(eventNames[FHT_SINOGRAM_COMPLETED_EVENT],
+                            clEnqueueNDRangeKernel(slab.queue, _fhtSinogramKernel, 3, nullptr, globalThreadsFhtSinogram,
+                                                   localThreadsFhtSinogram, 1, slab.events + GAUSS_3D_COMPLETED_EVENT,
+                                                   slab.events + FHT_SINOGRAM_COMPLETED_EVENT))) {
+                return false;
+            }
+
+            clSetKernelArg(_fourier2dKernel, 0, sizeof(cl_mem), (void *) &slab.gaussImage);
+            clSetKernelArg(_fourier2dKernel, 1, sizeof(cl_mem), (void *) &slab.fourier2dImageA);
+            clSetKernelArg(_fourier2dKernel, 2, sizeof(cl_mem), (void *) &slab.hartleyBuf);
+            clSetKernelArg(_fourier2dKernel, 3, sizeof(cl_mem), (void *) &tanBuf);
+            clSetKernelArg(_fourier2dKernel, 4, sizeof(cl_mem), (void *) &radBuf);
+
+            size_t globalThreadsFourier2d[3] = {paddedWidth, paddedWidth, rows};
+
+            padGlobalThreads(globalThreadsFourier2d, localSizeFourier2d, 3);
+
+            cl_event fourier2dWaitList[2] = {slab.events[FHT_SINOGRAM_COMPLETED_EVENT], calcTablesEvent};
+
+            if (!isEnqueued(eventNames[DHT_1D_TO_2D_COMPLETED_EVENT],
+                            clEnqueueNDRangeKernel(slab.queue, _fourier2dKernel, 3, nullptr, globalThreadsFourier2d,
+                                                   localThreads(localSizeFourier2d), 2, fourier2dWaitList,
+                                                   slab.events + DHT_1D_TO_2D_COMPLETED_EVENT))) {
+                return false;
+            }
+
+            size_t globalThreadsDht1dTranspose[3] = {fhtWorkGroupSizeTranspose, paddedWidth, rows};
+            size_t localThreadsDht1dTranspose[3] = {fhtWorkGroupSizeTranspose, 1, 1};
+
+            clSetKernelArg(_dht1dTransposeKernel, 0, sizeof(cl_mem), (void *) &slab.fourier2dImageA);
+            clSetKernelArg(_dht1dTransposeKernel, 1, sizeof(cl_mem), (void *) &slab.fourier2dImageB);
+            clSetKernelArg(_dht1dTransposeKernel, 2, sizeof(cl_mem), (void *) &cosBuf);
+            clSetKernelArg(_dht1dTransposeKernel, 3, sizeof(cl_mem), (void *) &sinBuf);
+            clSetKernelArg(_dht1dTransposeKernel, 4, sizeof(float) * paddedWidth, nullptr);
+            clSetKernelArg(_dht1dTransposeKernel, 5, sizeof(cl_mem), (void *) &reorderedBuf);
+            clSetKernelArg(_dht1dTransposeKernel, 6, sizeof(float), (void *) &coeff);
+
+            if (!isEnqueued(eventNames[DHT_2D_I_FIRST_1D_COMPLETED_EVENT],
+                            clEnqueueNDRangeKernel(slab.queue, _dht1dTransposeKernel, 3, nullptr, globalThreadsDht1dTranspose,
+                                                   localThreadsDht1dTranspose, 1, slab.events + DHT_1D_TO_2D_COMPLETED_EVENT,
+                                                   slab.events + DHT_2D_I_FIRST_1D_COMPLETED_EVENT))) {
+                return false;
+            }
+
+            clSetKernelArg(_dht1dTransposeKernel, 0, sizeof(cl_mem), (void *) &slab.fourier2dImageB);
+            clSetKernelArg(_dht1dTransposeKernel, 1, sizeof(cl_mem), (void *) &slab.fourier2dImageA);
+
+            if (!isEnqueued(eventNames[DHT_2D_I_SECOND_1D_COMPLETED_EVENT],
+                            clEnqueueNDRangeKernel(slab.queue, _dht1dTransposeKernel, 3, nullptr, globalThreadsDht1dTranspose,
+                                                   localThreadsDht1dTranspose, 1, slab.events + DHT_2D_I_FIRST_1D_COMPLETED_EVENT,
+                                                   slab.events + DHT_2D_I_SECOND_1D_COMPLETED_EVENT))) {
+                return false;
+            }
+
+            size_t globalThreadsButterfly[3] = {paddedWidth / 2 + 1, paddedWidth / 2 + 1, rows};
+
+            padGlobalThreads(globalThreadsButterfly, localSizeButterfly, 3);
+
+            clSetKernelArg(_butterflyDht2dKernel, 0, sizeof(cl_mem), (void *) &slab.fourier2dImageA);
+            clSetKernelArg(_butterflyDht2dKernel, 1, sizeof(cl_mem), (void *) &slab.sliceImage);
+
+            if (!isEnqueued(eventNames[DHT_2D_I_COMPLETED_EVENT],
+                            clEnqueueNDRangeKernel(slab.queue, _butterflyDht2dKernel, 3, nullptr, globalThreadsButterfly,
+                                                   localThreads(localSizeButterfly), 1, slab.events + DHT_2D_I_SECOND_1D_COMPLETED_EVENT,
+                                                   slab.events + DHT_2D_I_COMPLETED_EVENT))) {
+                return false;
+            }
+
+            if (!isEnqueued(eventNames[READBACK_COMPLETED_EVENT],
+                            clEnqueueReadImage(slab.queue, slab.sliceImage, CL_FALSE, origin, regionSlice, 0, 0,
+                                               slab.sliceData.data(), 1, slab.events + DHT_2D_I_COMPLETED_EVENT,
+                                               slab.events + READBACK_COMPLETED_EVENT))) {
+                return false;
+            }
+
+            clFlush(slab.queue);
+
+            return true;
+        };
+
+        // waits for the readback and stitches the slab's slices into the volume
+        auto finishSlab = [&](OCLSlab & slab) -> bool {
+            cl_event & readEvent = slab.events[READBACK_COMPLETED_EVENT];
+
+            bool isRead = readEvent && clWaitForEvents(1, &readEvent) == CL_SUCCESS;
+
+            // the commands enqueued before the one that failed still use the slab's memory
+            if (!isRead) {
+                if (readEvent) {
+                    qDebug() << "Reconstructing rows" << slab.rows.first << "to" << slab.rows.first + slab.rows.count << "failed";
+                }
+
+                clFinish(slab.queue);
+            }
+
+            if (isRead) {
+                for (int i = 0; i != slab.rows.count; ++ i) {
+                    _slicesOCL[slab.rows.first + i] = new cv::Mat(cv::Mat((int) width, (int) width, CV_32FC1,
+                                                                          (void *) (slab.sliceData.data() + i * width * width)).clone());
+                }
+            }
+
+            for (int i = 0; i != ALL_EVENTS; ++ i) {
+                if (slab.events[i]) {
+                    eventTimes[i] += isRead ? profiledTime(slab.events[i]) : 0.0;
+                    clReleaseEvent(slab.events[i]);
+                }
+            }
+
+            for (cl_mem * mem : {&slab.srcImage, &slab.gaussImage, &slab.hartleyBuf,
+                                 &slab.fourier2dImageA, &slab.fourier2dImageB, &slab.sliceImage}) {
+                if (*mem) {
+                    clReleaseMemObject(*mem);
+                }
+            }
+
+            slab.isBusy = false;
+
+            return isRead;
+        };
+
+        qDeleteAll(_slicesOCL);
+        _slicesOCL.fill(nullptr, (int) height);
+
+        bool isReconstructed = true;
+
+        // while one slab computes, the other one uploads or reads back
+        for (int i = 0; i != slabs.size() && isReconstructed; ++ i) {
+            OCLSlab & slab = inFlight[i % SLABS_IN_FLIGHT];
+
+            if (slab.isBusy) {
+                isReconstructed = finishSlab(slab);
+            }
+
+            slab.rows = slabs.at(i);
+
+            isReconstructed = isReconstructed && enqueueSlab(slab);
+        }
+
+        for (OCLSlab & slab : inFlight) {
+            if (slab.isBusy) {
+                isReconstructed = finishSlab(slab) && isReconstructed;
+            }
+        }
+
+        clWaitForEvents(1, &calcTablesEvent);
+
+        qDebug() << "Elapsed Time: " << "calcTables" << profiledTime(calcTablesEvent);
+
+        for (int i = 0; i != ALL_EVENTS; ++ i) {
+            qDebug() << "Elapsed Time: " << eventNames[i] << eventTimes[i];
+        }
+
+        clReleaseEvent(calcTablesEvent);
+
+        clReleaseMemObject(gaussBuf);
+        clReleaseMemObject(cosBuf);
+        clReleaseMemObject(sinBuf);
+        clReleaseMemObject(reorderedBuf);
+        clReleaseMemObject(tanBuf);
+        clReleaseMemObject(radBuf);
+
+        return isReconstructed;
+    }
+
+    void Reconstructor::maskSlices() {
         cv::Mat helperMat;
         
         double minVal;
@@ -366,19 +982,8 @@ namespace Parser {
         double minValVolume = 1000.0f;
         double maxValVolume = -1000.0f;
         
-        _slicesOCL.resize((int) height);
-        posSlice = sliceData;
-        QMutableVectorIterator<cv::Mat *>it(_slicesOCL);
-        
-        qDebug() << "Elapsed Time: " << cv::getTickCount() / cv::getTickFrequency() - startTime << sliceData;
-        
-        while (it.hasNext()) {
-            helperMat = cv::Mat((int) width, (int) width, CV_32FC1, (void *) (posSlice));
-            posSlice += slicePitchDst;
-            
-            cv::minMaxLoc(helperMat, &minVal, &maxVal);
-            
-            it.next() = new cv::Mat(helperMat);
+        for (const cv::Mat * slice : _slicesOCL) {
+            cv::minMaxLoc(*slice, &minVal, &maxVal);
             
             maxValVolume = std::max(maxValVolume, maxVal);
             minValVolume = std::min(minValVolume, minVal);
@@ -409,20 +1014,6 @@ namespace Parser {
             cv::bitwise_and(*slice, *slice, result, helperMat);
             result.copyTo(*slice);
         }
-        
-        for (int i = 0; i != ALL_EVENTS_COMPLETED; ++ i) {
-            clReleaseEvent(eventList[i]);
-        }
-        
-        clReleaseMemObject(fourier2dImageA);
-        clReleaseMemObject(casBuf);
-        clReleaseMemObject(tanBuf);
-        clReleaseMemObject(radBuf);
-        clEnqueueUnmapMemObject(_queue, sliceImage, sliceData, 0, nullptr, nullptr);
-        
-        clReleaseMemObject(sliceImage);
-        
-        sendToScene();
     }
 
     void Reconstructor::sendToScene() {
@@ -521,7 +1112,6 @@ namespace Parser {
         }
 
         reconstruct();
-        //reconstructCPU();
 
         cv::namedWindow(SLICES_IMAGE_WINDOW);
         cv::namedWindow(SLICE_POSITION);
@@ -530,16 +1120,33 @@ namespace Parser {
         emit filesChanged();
     }
 
-    void Reconstructor::reconstructCPU() {
+    void Reconstructor::reconstructCPU(const std::vector<float> & gaussTable, const HartleyTables & hartley) {
+        int height = _src.at(0).rows;
+        int halo = gaussTable.size() / 2;
+
+        size_t budget = CLInfo::memoryBudget() ? CLInfo::memoryBudget() : NATIVE_MEMORY_BUDGET;
+
+        // both gauss volumes per detector row, the rest is per thread
+        size_t rowBytes = 2 * sizeof(float) * _src.at(0).cols * _src.size();
+
+        int rowsPerSlab = slabRowCount(budget, 2 * halo * rowBytes, rowBytes, 1, height);
+
+        qDeleteAll(_slicesOCL);
+        _slicesOCL.fill(nullptr, height);
+
         ReconstructionData reconstructionData;
 
         reconstructionData.src = &_src;
         reconstructionData.slices = &_slicesOCL;
 
-        reconstructionData.sliceCount = _src.at(0).rows;
+        reconstructionData.gaussTable = &gaussTable;
 
-        cv::parallel_for_(cv::Range(0, reconstructionData.sliceCount), ReconstructorLoop(&reconstructionData));
+        reconstructionData.hartley = &hartley;
 
-        sendToScene();
+        for (const ReconstructionSlab & slab : splitSlabs(height, rowsPerSlab, halo)) {
+            reconstructionData.slab = slab;
+
+            cv::parallel_for_(cv::Range(0, slab.count), ReconstructorLoop(&reconstructionData));
+        }
     }
 }
@@ -0,0 +1,312 @@
+#include <QtCore/QFile>
+#include <QtCore/QFileInfo>
+#include <QtCore/QDir>
+#include <QtCore/QDateTime>
+#include <QtCore/QSaveFile>
+#include <QtCore/QStandardPaths>
+#include <QtCore/QCryptographicHash>
+#include <QtCore/QJsonDocument>
+#include <QtCore/QJsonObject>
+#include <QtCore/QSet>
+
+#include <algorithm>
+#include <cmath>
+
+#include "Parser/SeriesIndex.h"
+
+#define INDEX_VERSION 1
+
+namespace Parser {
+    namespace SeriesIndex {
+        static QString indexFileName(const QString & directory) {
+            QByteArray hash = QCryptographicHash::hash(directory.toUtf8(), QCryptographicHash::Sha1).toHex();
+
+            return QStandardPaths::writableLocation(QStandardPaths::CacheLocation) + "/index/" + QString::fromLatin1(hash) + ".json";
+        }
+
+        // json numbers are doubles, sizes and times in ms still fit them exactly
+        static QJsonObject toJson(const SeriesSlice & slice) {
+            QJsonObject entry;
+
+            entry["size"] = (double) slice.fileSize;
+            entry["modified"] = (double) slice.modified;
+            entry["valid"] = slice.isValid;
+
+            if (!slice.isValid) {
+                return entry;
+            }
+
+            entry["seriesUID"] = QString::fromStdString(slice.seriesUID);
+            entry["modality"] = QString::fromStdString(slice.modality);
+            entry["transferSyntax"] = QString::fromStdString(slice.transferSyntax);
+
+            entry["instanceNumber"] = slice.instanceNumber;
+
+            if (slice.hasLocation) {
+                entry["location"] = slice.location;
+            }
+
+            entry["width"] = (double) slice.width;
+            entry["height"] = (double) slice.height;
+
+            entry["spacingX"] = slice.spacingX;
+            entry["spacingY"] = slice.spacingY;
+
+            return entry;
+        }
+
+        static void fromJson(const QJsonObject & entry, SeriesSlice & slice) {
+            // only headers gdcm got through are indexed
+            slice.isRead = true;
+            slice.isValid = entry["valid"].toBool();
+
+            if (!slice.isValid) {
+                return;
+            }
+
+            slice.seriesUID = entry["seriesUID"].toString().toStdString();
+            slice.modality = entry["modality"].toString().toStdString();
+            slice.transferSyntax = entry["transferSyntax"].toString().toStdString();
+
+            slice.instanceNumber = entry["instanceNumber"].toInt();
+
+            slice.hasLocation = entry.contains("location");
+            slice.location = entry["location"].toDouble();
+
+            slice.width = (size_t) entry["width"].toDouble();
+            slice.height = (size_t) entry["height"].toDouble();
+
+            slice.spacingX = entry["spacingX"].toDouble(1.0);
+            slice.spacingY = entry["spacingY"].toDouble(1.0);
+        }
+
+        static QJsonObject loadIndex(const QString & directory) {
+            QFile file(indexFileName(directory));
+
+            if (!file.open(QIODevice::ReadOnly)) {
+                return QJsonObject();
+            }
+
+            QJsonObject index = QJsonDocument::fromJson(file.readAll()).object();
+
+            if (index["version"].toInt() != INDEX_VERSION || index["directory"].toString() != directory) {
+                qDebug() << "stale dicom index" << file.fileName();
+                return QJsonObject();
+            }
+
+            return index["files"].toObject();
+        }
+
+        static void storeIndex(const QString & directory, const QJsonObject & files) {
+            QString fileName = indexFileName(directory);
+
+            if (!QDir().mkpath(QFileInfo(fileName).absolutePath())) {
+                return;
+            }
+
+            QJsonObject index;
+
+            index["version"] = INDEX_VERSION;
+            index["directory"] = directory;
+            index["files"] = files;
+
+            QSaveFile file(fileName);
+
+            if (!file.open(QIODevice::WriteOnly) ||
+                file.write(QJsonDocument(index).toJson(QJsonDocument::Compact)) < 0) {
+                qDebug() << "can't write dicom index" << file.fileName();
+                file.cancelWriting();
+                return;
+            }
+
+            file.commit();
+        }
+
+        std::vector<SeriesSlice> scan(const QStringList & fileNames, const QAtomicInt * canceled,
+                                      const std::function<void (const int &, const int &)> & headerRead) {
+            float startTime = cv::getTickCount() / cv::getTickFrequency();
+
+            std::vector<SeriesSlice> slices(fileNames.size());
+
+            // every index is loaded and stored once, whatever the order of files is
+            QHash<QString, std::vector<int> > directories;
+
+            for (int i = 0; i != fileNames.size(); ++ i) {
+                QFileInfo fileInfo(fileNames.at(i));
+
+                slices[i].fileName = fileNames.at(i);
+                slices[i].fileSize = fileInfo.size();
+                slices[i].modified = fileInfo.lastModified().toMSecsSinceEpoch();
+
+                directories[fileInfo.absolutePath()].push_back(i);
+            }
+
+            QHash<QString, QJsonObject> indices;
+
+            std::vector<SeriesSlice> changed;
+            std::vector<int> changedPositions;
+
+            for (auto directory = directories.cbegin(); directory != directories.cend(); ++ directory) {
+                const QJsonObject & index = indices[directory.key()] = loadIndex(directory.key());
+
+                for (int i : directory.value()) {
+                    const QJsonObject entry = index.value(QFileInfo(slices[i].fileName).fileName()).toObject();
+
+                    if (!entry.isEmpty() &&
+                        (qint64) entry["size"].toDouble() == slices[i].fileSize &&
+                        (qint64) entry["modified"].toDouble() == slices[i].modified) {
+                        fromJson(entry, slices[i]);
+                    }
+                    else {
+                        changed.push_back(slices[i]);
+                        changedPositions.push_back(i);
+                    }
+                }
+            }
+
+            if (!changed.empty()) {
+                const int total = (int) changed.size();
+
+                QAtomicInt readCount(0);
+
+                std::function<void ()> countRead;
+
+                if (headerRead) {
+                    countRead = [&readCount, &headerRead, total]() {
+                        headerRead(readCount.fetchAndAddRelaxed(1) + 1, total);
+                    };
+                }
+
+                cv::parallel_for_(cv::Range(0, total), SeriesHeaderReading(&changed, canceled, countRead));
+
+                // headers left unread must not get into the index
+                if (canceled && canceled->load()) {
+                    return slices;
+                }
+
+                for (size_t i = 0; i != changed.size(); ++ i) {
+                    slices[changedPositions[i]] = changed[i];
+                }
+            }
+
+            std::vector<bool> isChanged(slices.size(), false);
+
+            for (int i : changedPositions) {
+                isChanged[i] = true;
+            }
+
+            for (auto directory = directories.cbegin(); directory != directories.cend(); ++ directory) {
+                QJsonObject & index = indices[directory.key()];
+
+                bool isIndexChanged = false;
+
+                QSet<QString> listed;
+
+                for (int i : directory.value()) {
+                    QString name = QFileInfo(slices[i].fileName).fileName();
+
+                    listed << name;
+
+                    if (!isChanged[i]) {
+                        continue;
+                    }
+
+                    // files which couldn't be read (yet) are tried again next scan, whatever their modification time is
+                    if (slices[i].isRead) {
+                        index[name] = toJson(slices[i]);
+                        isIndexChanged = true;
+                    }
+                    else if (index.contains(name)) {
+                        index.remove(name);
+                        isIndexChanged = true;
+                    }
+                }
+
+                // files not asked for stay indexed while they exist
+                for (auto entry = index.begin(); entry != index.end(); ) {
+                    if (!listed.contains(entry.key()) && !QFileInfo::exists(directory.key() + "/" + entry.key())) {
+                        entry = index.erase(entry);
+                        isIndexChanged = true;
+                    }
+                    else {
+                        ++ entry;
+                    }
+                }
+
+                if (isIndexChanged) {
+                    storeIndex(directory.key(), index);
+                }
+            }
+
+            qDebug() << "Indexed" << slices.size() << "files," << changed.size() << "headers read, elapsed Time: "
+                     << cv::getTickCount() / cv::getTickFrequency() - startTime;
+
+            return slices;
+        }
+
+        std::vector<std::vector<SeriesSlice> > group(const std::vector<SeriesSlice> & slices) {
+            QHash<QString, size_t> seriesPositions;
+
+            std::vector<std::vector<SeriesSlice> > seriesList;
+
+            for (const SeriesSlice & slice : slices) {
+                if (!slice.isValid) {
+                    continue;
+                }
+
+                QString seriesUID = QString::fromStdString(slice.seriesUID);
+
+                auto position = seriesPositions.find(seriesUID);
+
+                if (position == seriesPositions.end()) {
+                    position = seriesPositions.insert(seriesUID, seriesList.size());
+                    seriesList.push_back(std::vector<SeriesSlice>());
+                }
+
+                seriesList[position.value()].push_back(slice);
+            }
+
+            for (std::vector<SeriesSlice> & series : seriesList) {
+                std::stable_sort(series.begin(), series.end(), seriesSliceLess);
+            }
+
+            std::stable_sort(seriesList.begin(), seriesList.end(),
+                             [](const std::vector<SeriesSlice> & a, const std::vector<SeriesSlice> & b) {
+                return a.size() > b.size();
+            });
+
+            return seriesList;
+        }
+
+        QVariantMap describe(const std::vector<SeriesSlice> & series) {
+            QVariantMap description;
+
+            if (series.empty()) {
+                return description;
+            }
+
+            const SeriesSlice & front = series.front();
+            const SeriesSlice & back = series.back();
+
+            description["seriesUID"] = QString::fromStdString(front.seriesUID);
+            description["modality"] = QString::fromStdString(front.modality);
+            description["transferSyntax"] = QString::fromStdString(front.transferSyntax);
+            description["directory"] = QFileInfo(front.fileName).absolutePath();
+
+            description["width"] = (int) front.width;
+            description["height"] = (int) front.height;
+            description["slices"] = (int) series.size();
+
+            // zero if it can't be told from slice positions
+            double spacingZ = 0.0;
+
+            if (series.size() > 1 && front.hasLocation && back.hasLocation) {
+                spacingZ = std::abs(back.location - front.location) / (series.size() - 1);
+            }
+
+            description["spacing"] = QVector3D(front.spacingX, front.spacingY, spacingZ);
+
+            return description;
+        }
+    }
+}
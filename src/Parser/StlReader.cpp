@@ -1,5 +1,4 @@
 #include <QtCore/QFile>
-#include <QtCore/QTextStream>
 #include <QtCore/QDataStream>
 #include <QtCore/QUrl>
 
@@ -9,6 +8,7 @@
 
 #include "Parser/StlReader.h"
 #include "Parser/Helpers.hpp"
+#include "Parser/stlprocessing.hpp"
 
 #include "Info/ModelInfo.h"
 #include "Info/MaterialInfo.h"
@@ -18,161 +18,102 @@
 
 #include <opencv2/core/core.hpp>
 
-inline QString removeWhitespaces(QString & str) {
-    while (str.length() > 0 && (str[0] == ' ' || str[0] == '\t')) {
-        str.remove(0, 1);
+namespace Parser {
+    StlReader::StlReader() :
+        AbstractParser("StlParser"),
+        _loadStartTime(0.0f) {
     }
 
-    return str;
-}
-
-class BufferData {
-public:
-    char * src;
-    ModelInfo::VerticesVNPtr * dst;
-
-    QScopedPointer<ModelInfo::VertexV> * minV;
-    QScopedPointer<ModelInfo::VertexV> * maxV;
-
-    quint32 vertexCount;
-};
-
-class BufferParallelReading : public cv::ParallelLoopBody {
-private:
-    BufferData _bufferData;
-
-    mutable cv::Mutex _mutex;
-
-public:
-    BufferParallelReading(BufferData & bufferData) {
-        _bufferData.src = bufferData.src;
-        _bufferData.dst = bufferData.dst;
-
-        _bufferData.minV = bufferData.minV;
-        _bufferData.maxV = bufferData.maxV;
+    StlReader::~StlReader() {
 
-        (*_bufferData.dst)->resize(bufferData.vertexCount);
     }
 
-    virtual void operator ()(const cv::Range & r) const {
-        for (int i = r.start; i != r.end; ++ i) {
-            char * currentPos = _bufferData.src + i * 50;
-
-            GLfloat triangle[12];
-            GLfloat normals[3];
-
-            GLfloat x;
-            GLfloat y;
-            GLfloat z;
+    QUrl StlReader::file() const {
+        return _stlFile;
+    }
 
-            memcpy((GLfloat *) normals, currentPos, 12);
-            memcpy((GLfloat *) triangle, currentPos + 12, 36);
+    qreal StlReader::weldEpsilon() const {
+        return _settings.weldSettings.epsilon;
+    }
 
-            for (int v = 0; v != 3; ++ v) {
-                x = triangle[3 * v];
-                y = triangle[3 * v + 1];
-                z = triangle[3 * v + 2];
+    qreal StlReader::creaseAngle() const {
+        return _settings.weldSettings.creaseAngle;
+    }
 
-                ModelInfo::VertexVN vertex(x, y, z, normals[0], normals[1], normals[2]);
+    int StlReader::lodLevels() const {
+        return _settings.lodLevels;
+    }
 
-                _mutex.lock();
+    bool StlReader::overdrawOrdering() const {
+        return _settings.overdrawOrdering;
+    }
 
-                if (_bufferData.minV->isNull()) {
-                    (*(_bufferData.minV)).reset(new ModelInfo::VertexV(x, y, z));
-                }
-                else {
-                    _bufferData.minV->data()->x = std::min(x, _bufferData.minV->data()->x);
-                    _bufferData.minV->data()->y = std::min(y, _bufferData.minV->data()->y);
-                    _bufferData.minV->data()->z = std::min(z, _bufferData.minV->data()->z);
-                }
+    void StlReader::setLodLevels(const int & lodLevels) {
+        _settings.lodLevels = lodLevels;
 
-                if (_bufferData.maxV->isNull()) {
-                    (*(_bufferData.maxV)).reset(new ModelInfo::VertexV(x, y, z));
-                }
-                else {
-                    _bufferData.maxV->data()->x = std::max(x, _bufferData.maxV->data()->x);
-                    _bufferData.maxV->data()->y = std::max(y, _bufferData.maxV->data()->y);
-                    _bufferData.maxV->data()->z = std::max(z, _bufferData.maxV->data()->z);
-                }
+        emit lodLevelsChanged();
+    }
 
-                _mutex.unlock();
+    void StlReader::setOverdrawOrdering(const bool & overdrawOrdering) {
+        _settings.overdrawOrdering = overdrawOrdering;
 
-                (**_bufferData.dst)[3 * i + v] = vertex;
-            }
-        }
+        emit overdrawOrderingChanged();
     }
-};
 
-class NormData {
-public:
-    ModelInfo::VerticesVNPtr * data;
+    void StlReader::setWeldEpsilon(const qreal & weldEpsilon) {
+        _settings.weldSettings.epsilon = weldEpsilon;
 
-    ModelInfo::VertexV minV;
-    ModelInfo::VertexV maxV;
-};
+        emit weldEpsilonChanged();
+    }
 
-class ParallelNormalizing : public cv::ParallelLoopBody {
-private:
-    NormData _normData;
+    void StlReader::setCreaseAngle(const qreal & creaseAngle) {
+        _settings.weldSettings.creaseAngle = creaseAngle;
 
-    QVector3D _scale;
+        emit creaseAngleChanged();
+    }
 
-public:
-    ParallelNormalizing(NormData & normData) {
-        _normData.data = normData.data;
+    void StlReader::setFile(const QUrl & file) {
+        if (file.isEmpty()) {
+            return;
+        }
 
-        _normData.minV = normData.minV;
-        _normData.maxV = normData.maxV;
+        QString fileName = file.toLocalFile();
 
-        _scale = scaleVector<float, QVector3D>(normData.maxV.x - normData.minV.x,
-                                               normData.maxV.y - normData.minV.y,
-                                               normData.maxV.z - normData.minV.z);
-    }
+        StlSettings settings = _settings;
 
-    virtual void operator ()(const cv::Range & r) const {
-        for (int i = r.start; i != r.end; ++ i) {
-            ModelInfo::VertexVN vertex = (*_normData.data)->at(i);
+        load([this, fileName, settings]() {
+            return readFile(fileName, settings);
+        });
 
-            vertex.x = normalize<GLfloat>(vertex.x, _normData.minV.x, _normData.maxV.x, - _scale.x(), _scale.x());
-            vertex.y = normalize<GLfloat>(vertex.y, _normData.minV.y, _normData.maxV.y, - _scale.y(), _scale.y());
-            vertex.z = normalize<GLfloat>(vertex.z, _normData.minV.z, _normData.maxV.z, - _scale.z(), _scale.z());
+        _stlFile = file;
 
-            (**_normData.data)[i] = vertex;
-        }
+        emit fileChanged();
     }
-};
 
-namespace Parser {
-    StlReader::StlReader() :
-        AbstractParser() {
-    }
+    bool StlReader::readFile(const QString & fileName, const StlSettings & settings) {
+        reportProgress("reading", 0.0);
 
-    StlReader::~StlReader() {
+        _loadStartTime = cv::getTickCount() / cv::getTickFrequency();
 
-    }
+        ModelInfo::VerticesVNPtr vertices = readVertices(fileName);
 
-    QUrl StlReader::file() const {
-        return _stlFile;
+        return vertices && sendVertices(vertices, settings);
     }
 
-    void StlReader::setFile(const QUrl & file) {
-        if (file.isEmpty()) {
-            return;
-        }
-
-        QString fileName = file.toLocalFile();
-
+    ModelInfo::VerticesVNPtr StlReader::readVertices(const QString & fileName) {
         QFile stlFile(fileName);
 
         QString fileNameLower = fileName.toLower();
 
+        ModelInfo::VerticesVNPtr vertices = nullptr;
+
         if (stlFile.open(QIODevice::ReadOnly)) {
             if (fileNameLower.at(fileName.length() - 4) == 's' &&
                 fileNameLower.at(fileName.length() - 3) == 't' &&
                 fileNameLower.at(fileName.length() - 2) == 'l' &&
                 fileNameLower.at(fileName.length() - 1) == 'a'
             ) {
-                readASCII(stlFile);
+                vertices = readASCII(stlFile);
             }
             else {
                 char firstBits[5];
@@ -184,213 +125,365 @@ namespace Parser {
                     firstBits[3] == 'i' &&
                     firstBits[4] == 'd'
                  ) {
-                    readASCII(stlFile);
+                    vertices = readASCII(stlFile);
                 }
                 else {
-                    readBinary(stlFile);
+                    vertices = readBinary(stlFile);
                 }
             }
 
             stlFile.close();
         }
 
-        _stlFile = file;
-
-        emit fileChanged();
+        return vertices;
     }
 
-    void StlReader::readASCII(QFile & stlFile, const bool & solidChecked) {
-        QTextStream fileStream(&stlFile);
+    ModelInfo::VerticesVNPtr StlReader::readASCII(QFile & stlFile, const bool & solidChecked) {
+        qint64 fileSize = stlFile.size();
 
-        QString readStr = fileStream.readLine();
+        // chunks are parsed right from the mapping, the file is never copied to the heap
+        uchar * mapped = stlFile.map(0, fileSize);
 
-        if (!solidChecked) {
-            readStr = removeWhitespaces(readStr);
+        QByteArray buffer;
 
-            if (readStr.indexOf("solid ") != 0) {
-                emit readingErrorHappened();
-                return;
-            }
-        }
+        const char * data = (const char *) mapped;
 
-        QString floatStr;
+        if (!data) {
+            buffer = stlFile.readAll();
 
-        float x;
-        float y;
-        float z;
+            data = buffer.constData();
+            fileSize = buffer.size();
+        }
 
-        ModelInfo::VertexVN vertex;
-        ModelInfo::VerticesVNPtr vertices = new ModelInfo::VerticesVN;
+        const char * end = data + fileSize;
+        const char * firstLineEnd = (const char *) memchr(data, '\n', fileSize);
 
-        uint vertexNumber = 0;
+        if (!firstLineEnd) {
+            firstLineEnd = end;
+        }
 
-        bool outerLoopNotClosed = false;
-        bool facetNotClosed = false;
+        if (!solidChecked && !startsWith(skipBlanks(data, firstLineEnd), firstLineEnd, "solid ")) {
+            emit readingErrorHappened();
+            return nullptr;
+        }
 
-        QScopedPointer<ModelInfo::VertexV> minV;
-        QScopedPointer<ModelInfo::VertexV> maxV;
+        const char * body = (firstLineEnd == end) ? end : firstLineEnd + 1;
 
-        while (readStr.length()) {
-            readStr = fileStream.readLine();
-            readStr = removeWhitespaces(readStr);
+        float startTime = cv::getTickCount() / cv::getTickFrequency();
 
-            if (!readStr.length()) {
-                continue;
-            }
+        int chunkCount = (int) std::min((qint64) cv::getNumThreads() * 8, std::max(fileSize / STL_ASCII_CHUNK_SIZE, (qint64) 1));
 
-            if (vertexNumber % 3 == 0) {
-                if ((!outerLoopNotClosed && readStr.indexOf("outer loop") == 0) ||
-                    (outerLoopNotClosed && readStr.indexOf("endloop") == 0)) {
-                    outerLoopNotClosed = !outerLoopNotClosed;
-                    continue;
-                }
-                else if (!facetNotClosed && readStr.indexOf("facet") == 0) {
-                    facetNotClosed = !facetNotClosed;
+        std::vector<const char *> bounds = splitAsciiStl(body, end, chunkCount);
+        std::vector<AsciiStlChunk> chunks(bounds.size() - 1);
 
-                    if (readStr.indexOf("normal") == 6) {
-                        floatStr = readStr.mid(13);
-                        QTextStream normalStream(&floatStr);
+        chunkCount = (int) chunks.size();
 
-                        normalStream >> x >> y >> z;
+        QAtomicInt parsedChunks(0);
 
-                        vertex.nx = (GLfloat) x;
-                        vertex.ny = (GLfloat) y;
-                        vertex.nz = (GLfloat) z;
+        cv::parallel_for_(cv::Range(0, chunkCount), AsciiStlParsing(&bounds, &chunks, cancelFlag(), [this, &parsedChunks, &chunkCount, &fileSize]() {
+            int parsed = parsedChunks.fetchAndAddRelaxed(1) + 1;
 
-                        continue;
-                    }
-                }
-                else if (facetNotClosed && readStr.indexOf("endfacet") == 0) {
-                    facetNotClosed = !facetNotClosed;
-                    continue;
-                }
-                else if (readStr.indexOf("vertex") != 0) {
-                    break;
-                }
-            }
+            QVariantMap details;
+            details["bytesRead"] = fileSize * parsed / chunkCount;
 
-            if (vertexNumber % 3 == 0 || readStr.indexOf("vertex") == 0) {
-                floatStr = readStr.mid(7);
-                QTextStream vertexStream(&floatStr);
+            reportProgress("parsing", 0.9 * parsed / chunkCount, details);
+        }), chunkCount);
 
-                vertexStream >> x >> y >> z;
+        bool chunkEndsOpen;
+        size_t chunksUsed = validAsciiStlChunks(chunks, chunkEndsOpen);
 
-                vertex.x = (GLfloat) x;
-                vertex.y = (GLfloat) y;
-                vertex.z = (GLfloat) z;
+        if (chunkEndsOpen && !isCanceled()) {
+            chunks.assign(1, AsciiStlChunk());
+            parseAsciiStl(body, end, chunks[0], cancelFlag());
 
-                if (minV) {
-                    minV->x = std::min(minV->x, vertex.x);
-                    minV->y = std::min(minV->y, vertex.y);
-                    minV->z = std::min(minV->z, vertex.z);
-                }
-                else {
-                    minV.reset(new ModelInfo::VertexV(vertex.x, vertex.y, vertex.z));
-                }
+            chunksUsed = validAsciiStlChunks(chunks, chunkEndsOpen);
+        }
 
-                if (maxV) {
-                    maxV->x = std::max(maxV->x, vertex.x);
-                    maxV->y = std::max(maxV->y, vertex.y);
-                    maxV->z = std::max(maxV->z, vertex.z);
-                }
-                else {
-                    maxV.reset(new ModelInfo::VertexV(vertex.x, vertex.y, vertex.z));
-                }
+        if (isCanceled()) {
+            if (mapped) {
+                stlFile.unmap(mapped);
             }
-            else {
-                break;
+
+            return nullptr;
+        }
+
+        if (!chunksUsed) {
+            if (mapped) {
+                stlFile.unmap(mapped);
             }
 
-            vertices->push_back(vertex);
+            emit readingErrorHappened();
+            return nullptr;
+        }
+
+        BoundingBox box;
+        size_t vertexCount = 0;
 
-            vertexNumber ++;
+        for (size_t i = 0; i != chunksUsed; ++ i) {
+            box.add(chunks[i].box);
+            vertexCount += chunks[i].vertices.size();
         }
 
-        if (outerLoopNotClosed || facetNotClosed || readStr.indexOf("endsolid") != 0) {
-            delete [] vertices;
-            emit readingErrorHappened();
-            return;
+        if (mapped) {
+            stlFile.unmap(mapped);
         }
 
-        NormData normData;
-        normData.data = &vertices;
-        normData.minV = *minV;
-        normData.maxV = *maxV;
+        // no triangles -> no need to create buffers, etc
+        if (!vertexCount) {
+            return nullptr;
+        }
 
-        cv::parallel_for_(cv::Range(0, vertexNumber), ParallelNormalizing(normData));
+        QVariantMap details;
+        details["bytesRead"] = fileSize;
 
-        ModelInfo::BuffersVN buffers;
-        buffers.vertices = ModelInfo::VerticesVNPointer(vertices);
+        reportProgress("normalizing", 0.9, details);
+
+        ModelInfo::VerticesVNPtr vertices = new ModelInfo::VerticesVN(vertexCount);
+
+        cv::parallel_for_(cv::Range(0, (int) chunksUsed), AsciiStlConcatenating(&chunks, chunksUsed, box, vertices->data()));
+
+        float elapsedTime = cv::getTickCount() / cv::getTickFrequency() - startTime;
 
-        sendBuffers(buffers);
+        qDebug() << "Elapsed Time: " << elapsedTime << "," << fileSize / std::max(elapsedTime, 1e-6f) / (1 << 20) << "MB/s";
+
+        return vertices;
     }
 
-    void StlReader::readBinary(QFile & stlFile) {
-        QByteArray buffer = stlFile.readAll();
+    ModelInfo::VerticesVNPtr StlReader::readBinary(QFile & stlFile) {
+        qint64 fileSize = stlFile.size();
 
-        if (!buffer.size()) {
-            emit readingErrorHappened();
-            return;
+        // triangles are parsed right from the mapping, the file is never copied to the heap
+        uchar * mapped = stlFile.map(0, fileSize);
+
+        QByteArray buffer;
+
+        const char * data = (const char *) mapped;
+
+        if (!data) {
+            buffer = stlFile.readAll();
+
+            data = buffer.constData();
+            fileSize = buffer.size();
         }
 
-        char * bufferPos = buffer.data() + 80;
+        if (fileSize < STL_BINARY_HEADER) {
+            emit readingErrorHappened();
+            return nullptr;
+        }
 
         quint32 triangleCount;
-        memcpy(&triangleCount, bufferPos, 4);
+        memcpy(&triangleCount, data + 80, 4);
 
-        bufferPos += 4;
-
-        if (buffer.size() - 84 != (int) triangleCount * 50) {
+        if (fileSize - STL_BINARY_HEADER != (qint64) triangleCount * STL_BINARY_TRIANGLE) {
             emit readingErrorHappened();
-            return;
+            return nullptr;
         }
 
         // no triangles -> no need to create buffers, etc
         if (!triangleCount) {
-            return;
+            return nullptr;
         }
 
-        ModelInfo::VerticesVNPtr vertices = new ModelInfo::VerticesVN;
+        QVariantMap details;
+        details["bytesRead"] = fileSize;
 
-        BufferData bufferData;
+        reportProgress("parsing", 0.0, details);
 
-        bufferData.src = bufferPos;
-        bufferData.dst = &vertices;
-        bufferData.vertexCount = triangleCount * 3;
+        float startTime = cv::getTickCount() / cv::getTickFrequency();
 
-        QScopedPointer<ModelInfo::VertexV> minV;
-        QScopedPointer<ModelInfo::VertexV> maxV;
+        const char * triangles = data + STL_BINARY_HEADER;
 
-        bufferData.minV = &minV;
-        bufferData.maxV = &maxV;
+        int chunkCount = stlChunkCount(triangleCount);
 
-        float startTime = cv::getTickCount() / cv::getTickFrequency();
+        std::vector<BoundingBox> boxes(chunkCount);
+
+        cv::parallel_for_(cv::Range(0, chunkCount), BinaryStlBounding(triangles, triangleCount, &boxes), chunkCount);
+
+        BoundingBox box;
+
+        for (const BoundingBox & chunkBox : boxes) {
+            box.add(chunkBox);
+        }
 
-        cv::parallel_for_(cv::Range(0, triangleCount), BufferParallelReading(bufferData));
+        if (isCanceled()) {
+            return nullptr;
+        }
+
+        reportProgress("normalizing", 0.5, details);
+
+        ModelInfo::VerticesVNPtr vertices = new ModelInfo::VerticesVN(triangleCount * 3);
 
-        NormData normData;
-        normData.data = &vertices;
-        normData.minV = *minV;
-        normData.maxV = *maxV;
+        cv::parallel_for_(cv::Range(0, chunkCount),
+                          BinaryStlReading(triangles, triangleCount, chunkCount, box, vertices->data(), cancelFlag()), chunkCount);
 
-        cv::parallel_for_(cv::Range(0, bufferData.vertexCount), ParallelNormalizing(normData));
+        if (mapped) {
+            stlFile.unmap(mapped);
+        }
+
+        if (isCanceled()) {
+            delete vertices;
+            return nullptr;
+        }
 
-        qDebug() << "Elapsed Time: " << cv::getTickCount() / cv::getTickFrequency() - startTime;
+        float elapsedTime = cv::getTickCount() / cv::getTickFrequency() - startTime;
 
+        qDebug() << "Elapsed Time: " << elapsedTime << "," << fileSize / std::max(elapsedTime, 1e-6f) / (1 << 20) << "MB/s";
+
+        return vertices;
+    }
+
+    bool StlReader::sendVertices(ModelInfo::VerticesVNPtr vertices, const StlSettings & settings) {
         ModelInfo::BuffersVN buffers;
-        buffers.vertices = ModelInfo::VerticesVNPointer(vertices);
 
-        sendBuffers(buffers);
+        if (!settings.weldSettings.isEnabled()) {
+            buffers.vertices = ModelInfo::VerticesVNPointer(vertices);
+
+            return sendBuffers(buffers);
+        }
+
+        QVariantMap details;
+        details["vertices"] = vertices->size();
+
+        reportProgress("welding", 0.95, details);
+
+        float startTime = cv::getTickCount() / cv::getTickFrequency();
+
+        buffers = weldVertices(*vertices, settings.weldSettings, cancelFlag());
+
+        int soupSize = vertices->size();
+
+        delete vertices;
+
+        if (isCanceled()) {
+            return false;
+        }
+
+        float elapsedTime = cv::getTickCount() / cv::getTickFrequency() - startTime;
+
+        qDebug() << "Elapsed Time: " << elapsedTime << "," << soupSize << "->" << buffers.vertices->size() << "vertices";
+
+        // everything collapsed -> no need to create buffers, etc
+        if (buffers.indices->isEmpty()) {
+            return false;
+        }
+
+        std::vector<LevelOfDetail> levels(1, LevelOfDetail(0, buffers.indices->size()));
+
+        if (settings.lodLevels > 0 && buffers.indices->size() / 3 >= LOD_MIN_TRIANGLES) {
+            reportProgress("simplifying", 0.97, details);
+
+            startTime = cv::getTickCount() / cv::getTickFrequency();
+
+            levels = buildLevelsOfDetail(*buffers.vertices, *buffers.indices, settings.lodLevels, cancelFlag());
+
+            if (isCanceled()) {
+                return false;
+            }
+
+            elapsedTime = cv::getTickCount() / cv::getTickFrequency() - startTime;
+
+            QDebug lodLog = qDebug() << "Elapsed Time: " << elapsedTime << ", triangles:";
+
+            for (const LevelOfDetail & level : levels) {
+                lodLog << level.count / 3;
+            }
+        }
+
+        reportProgress("reordering", 0.99, details);
+
+        startTime = cv::getTickCount() / cv::getTickFrequency();
+
+        qreal acmrBefore = acmr(buffers.indices->constData(), levels[0].count, buffers.vertices->size());
+
+        optimizeTriangleOrder(*buffers.vertices, *buffers.indices, levels, settings.overdrawOrdering, cancelFlag());
+
+        if (isCanceled()) {
+            return false;
+        }
+
+        float endTime = cv::getTickCount() / cv::getTickFrequency();
+
+        elapsedTime = endTime - startTime;
+
+        qDebug() << "Elapsed Time: " << elapsedTime << ", ACMR:" << acmrBefore << "->"
+                 << acmr(buffers.indices->constData(), levels[0].count, buffers.vertices->size())
+                 << "," << 100.0f * elapsedTime / std::max(endTime - _loadStartTime, 1e-6f) << "% of the load so far";
+
+        return sendBuffers(buffers, levels);
+    }
+
+    ModelInfo::BuffersVNPacked StlReader::packBuffers(const ModelInfo::BuffersVN & buffers) {
+        float startTime = cv::getTickCount() / cv::getTickFrequency();
+
+        ModelInfo::BuffersVNPacked packed;
+        packed.indices = buffers.indices;
+        packed.vertices = ModelInfo::VerticesVNPackedPointer(new ModelInfo::VerticesVNPacked(buffers.vertices->size()));
+
+        int chunkCount = stlChunkCount(buffers.vertices->size());
+
+        cv::parallel_for_(cv::Range(0, chunkCount),
+                          VertexPacking(buffers.vertices->constData(), packed.vertices->data(), buffers.vertices->size(), chunkCount), chunkCount);
+
+        float elapsedTime = cv::getTickCount() / cv::getTickFrequency() - startTime;
+
+        qDebug() << "Elapsed Time: " << elapsedTime << "," << buffers.vertices->size() * sizeof(ModelInfo::VertexVN) << "->"
+                 << packed.vertices->size() * sizeof(ModelInfo::VertexVNPacked) << "bytes";
+
+        return packed;
     }
 
-    void StlReader::sendBuffers(ModelInfo::BuffersVN buffers) {
+    ModelInfo::TriangleBvhPointer StlReader::buildBvh(const ModelInfo::BuffersVN & buffers, const std::vector<LevelOfDetail> & levels) {
+        // picking works on the finest level, it's what is drawn up close
+        size_t indexCount = levels.empty() ? (buffers.indices ? buffers.indices->size() : buffers.vertices->size()) : levels[0].count;
+
+        QVariantMap details;
+        details["triangles"] = (qulonglong) indexCount / 3;
+
+        reportProgress("partitioning", 0.99, details);
+
+        float startTime = cv::getTickCount() / cv::getTickFrequency();
+
+        ModelInfo::TriangleBvhPointer bvh = buildTriangleBvh(*buffers.vertices, buffers.indices ? buffers.indices->constData() : nullptr,
+                                                             indexCount / 3, cancelFlag());
+
+        float elapsedTime = cv::getTickCount() / cv::getTickFrequency() - startTime;
+
+        if (bvh) {
+            qDebug() << "Elapsed Time: " << elapsedTime << "," << bvh->nodes.size() << "bvh nodes";
+        }
+
+        return bvh;
+    }
+
+    bool StlReader::sendBuffers(ModelInfo::BuffersVN buffers, const std::vector<LevelOfDetail> & levels) {
+        ModelInfo::TriangleBvhPointer bvh = buildBvh(buffers, levels);
+
+        if (isCanceled()) {
+            return false;
+        }
+
         QVariantMap blueprintOverallMap = _blueprint.toMap();
         QVariantList blueprintList = blueprintOverallMap["models"].toList();
 
         QVariantMap blueprintMap = blueprintList[0].toMap();
         QVariantMap blueprintParams = blueprintMap["params"].toMap();
 
-        blueprintParams["buffers"] = QVariant::fromValue(buffers);
+        blueprintParams["buffers"] = QVariant::fromValue(packBuffers(buffers));
+        blueprintParams["bvh"] = QVariant::fromValue(bvh);
+
+        if (levels.size() > 1) {
+            QVariantList lods;
+
+            for (const LevelOfDetail & level : levels) {
+                QVariantMap lod;
+                lod["first"] = (qulonglong) level.first;
+                lod["count"] = (qulonglong) level.count;
+
+                lods << QVariant(lod);
+            }
+
+            blueprintParams["lods"] = lods;
+        }
         blueprintMap["params"] = QVariant(blueprintParams);
 
         blueprintList[0] = QVariant(blueprintMap);
@@ -401,5 +494,7 @@ namespace Parser {
         message.data["blueprint"] = QVariant(blueprintOverallMap);
 
         send(message);
+
+        return true;
     }
 }
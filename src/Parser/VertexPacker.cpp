@@ -0,0 +1,167 @@
+#include "Parser/VertexPacker.h"
+#include "Parser/PixelDecoder.h"
+
+#include <cmath>
+#include <algorithm>
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+    #define VERTEXPACKER_X86
+
+    #include <immintrin.h>
+
+    #ifdef _MSC_VER
+        #define VERTEXPACKER_TARGET(x)
+    #else
+        #define VERTEXPACKER_TARGET(x) __attribute__((target(x)))
+    #endif
+#endif
+
+// zero normals end up as (0, 0) - pointing along z - instead of nans
+#define OCTAHEDRAL_MIN_SUM 1e-30f
+
+namespace Parser {
+    namespace VertexPacker {
+        typedef void (*Kernel)(const ModelInfo::VertexVN *, ModelInfo::VertexVNPacked *, const size_t &);
+
+        static inline GLshort snorm16(const GLfloat & value) {
+            return (GLshort) std::lrint(std::min(std::max(value, -1.0f), 1.0f) * SNORM16_MAX);
+        }
+
+        static void packScalar(const ModelInfo::VertexVN * src, ModelInfo::VertexVNPacked * dst, const size_t & count) {
+            for (size_t i = 0; i != count; ++ i) {
+                const ModelInfo::VertexVN & vertex = src[i];
+
+                // normal is projected onto the octahedron |x| + |y| + |z| = 1, lower half is folded over the upper one
+                GLfloat sum = std::max(std::fabs(vertex.nx) + std::fabs(vertex.ny) + std::fabs(vertex.nz), OCTAHEDRAL_MIN_SUM);
+
+                GLfloat ox = vertex.nx / sum;
+                GLfloat oy = vertex.ny / sum;
+
+                if (vertex.nz < 0.0f) {
+                    GLfloat fx = (1.0f - std::fabs(oy)) * std::copysign(1.0f, ox);
+                    GLfloat fy = (1.0f - std::fabs(ox)) * std::copysign(1.0f, oy);
+
+                    ox = fx;
+                    oy = fy;
+                }
+
+                dst[i] = ModelInfo::VertexVNPacked(snorm16(vertex.x), snorm16(vertex.y), snorm16(vertex.z), snorm16(ox), snorm16(oy));
+            }
+        }
+
+#ifdef VERTEXPACKER_X86
+        VERTEXPACKER_TARGET("sse2")
+        static inline __m128i snorm16x4SSE2(const __m128 & values) {
+            const __m128 one = _mm_set1_ps(1.0f);
+
+            return _mm_cvtps_epi32(_mm_mul_ps(_mm_min_ps(_mm_max_ps(values, _mm_sub_ps(_mm_setzero_ps(), one)), one),
+                                              _mm_set1_ps(SNORM16_MAX)));
+        }
+
+        // 4 vertices at once: 24 floats are transposed into x, y, z, nx, ny, nz lanes and 12 bytes per vertex go out
+        VERTEXPACKER_TARGET("sse2")
+        static void packSSE2(const ModelInfo::VertexVN * src, ModelInfo::VertexVNPacked * dst, const size_t & count) {
+            const __m128 signMask = _mm_set1_ps(-0.0f);
+            const __m128 one = _mm_set1_ps(1.0f);
+            const __m128 minSum = _mm_set1_ps(OCTAHEDRAL_MIN_SUM);
+
+            size_t i = 0;
+
+            for (; i + 4 <= count; i += 4) {
+                const float * floats = (const float *) (src + i);
+
+                __m128 a0 = _mm_loadu_ps(floats);
+                __m128 a1 = _mm_loadu_ps(floats + 4);
+                __m128 a2 = _mm_loadu_ps(floats + 8);
+                __m128 a3 = _mm_loadu_ps(floats + 12);
+                __m128 a4 = _mm_loadu_ps(floats + 16);
+                __m128 a5 = _mm_loadu_ps(floats + 20);
+
+                // (x0, y0, x1, y1), (z0, nx0, z1, nx1), (ny0, nz0, ny1, nz1) and the same for vertices 2 and 3
+                __m128 xy01 = _mm_shuffle_ps(a0, a1, _MM_SHUFFLE(3, 2, 1, 0));
+                __m128 znx01 = _mm_shuffle_ps(a0, a2, _MM_SHUFFLE(1, 0, 3, 2));
+                __m128 nynz01 = _mm_shuffle_ps(a1, a2, _MM_SHUFFLE(3, 2, 1, 0));
+
+                __m128 xy23 = _mm_shuffle_ps(a3, a4, _MM_SHUFFLE(3, 2, 1, 0));
+                __m128 znx23 = _mm_shuffle_ps(a3, a5, _MM_SHUFFLE(1, 0, 3, 2));
+                __m128 nynz23 = _mm_shuffle_ps(a4, a5, _MM_SHUFFLE(3, 2, 1, 0));
+
+                __m128 x = _mm_shuffle_ps(xy01, xy23, _MM_SHUFFLE(2, 0, 2, 0));
+                __m128 y = _mm_shuffle_ps(xy01, xy23, _MM_SHUFFLE(3, 1, 3, 1));
+                __m128 z = _mm_shuffle_ps(znx01, znx23, _MM_SHUFFLE(2, 0, 2, 0));
+                __m128 nx = _mm_shuffle_ps(znx01, znx23, _MM_SHUFFLE(3, 1, 3, 1));
+                __m128 ny = _mm_shuffle_ps(nynz01, nynz23, _MM_SHUFFLE(2, 0, 2, 0));
+                __m128 nz = _mm_shuffle_ps(nynz01, nynz23, _MM_SHUFFLE(3, 1, 3, 1));
+
+                __m128 sum = _mm_add_ps(_mm_add_ps(_mm_andnot_ps(signMask, nx), _mm_andnot_ps(signMask, ny)), _mm_andnot_ps(signMask, nz));
+                sum = _mm_max_ps(sum, minSum);
+
+                __m128 ox = _mm_div_ps(nx, sum);
+                __m128 oy = _mm_div_ps(ny, sum);
+
+                __m128 fx = _mm_mul_ps(_mm_sub_ps(one, _mm_andnot_ps(signMask, oy)), _mm_or_ps(_mm_and_ps(ox, signMask), one));
+                __m128 fy = _mm_mul_ps(_mm_sub_ps(one, _mm_andnot_ps(signMask, ox)), _mm_or_ps(_mm_and_ps(oy, signMask), one));
+
+                __m128 folded = _mm_cmplt_ps(nz, _mm_setzero_ps());
+
+                ox = _mm_or_ps(_mm_and_ps(folded, fx), _mm_andnot_ps(folded, ox));
+                oy = _mm_or_ps(_mm_and_ps(folded, fy), _mm_andnot_ps(folded, oy));
+
+                __m128i positionsXY = _mm_packs_epi32(snorm16x4SSE2(x), snorm16x4SSE2(y));
+                __m128i positionsZ = _mm_packs_epi32(snorm16x4SSE2(z), _mm_setzero_si128());
+                __m128i normals = _mm_packs_epi32(snorm16x4SSE2(ox), snorm16x4SSE2(oy));
+
+                // 32 bit lanes: (x, y) per vertex, (z, padding) per vertex, (nx, ny) per vertex
+                __m128i xy = _mm_unpacklo_epi16(positionsXY, _mm_srli_si128(positionsXY, 8));
+                __m128i zp = _mm_unpacklo_epi16(positionsZ, _mm_setzero_si128());
+                __m128i n = _mm_unpacklo_epi16(normals, _mm_srli_si128(normals, 8));
+
+                __m128 xyz01 = _mm_castsi128_ps(_mm_unpacklo_epi32(xy, zp));
+                __m128 xyz23 = _mm_castsi128_ps(_mm_unpackhi_epi32(xy, zp));
+                __m128 zn01 = _mm_castsi128_ps(_mm_unpacklo_epi32(zp, n));
+                __m128 zn23 = _mm_castsi128_ps(_mm_unpackhi_epi32(zp, n));
+                __m128 nxy01 = _mm_castsi128_ps(_mm_unpacklo_epi32(n, xy));
+                __m128 nxy23 = _mm_castsi128_ps(_mm_unpackhi_epi32(n, xy));
+
+                float * out = (float *) (dst + i);
+
+                _mm_storeu_ps(out, _mm_shuffle_ps(xyz01, nxy01, _MM_SHUFFLE(3, 0, 1, 0)));
+                _mm_storeu_ps(out + 4, _mm_shuffle_ps(zn01, xyz23, _MM_SHUFFLE(1, 0, 3, 2)));
+                _mm_storeu_ps(out + 8, _mm_shuffle_ps(nxy23, zn23, _MM_SHUFFLE(3, 2, 3, 0)));
+            }
+
+            packScalar(src + i, dst + i, count - i);
+        }
+#endif
+
+        void pack(const ModelInfo::VertexVN * src, ModelInfo::VertexVNPacked * dst, const size_t & count) {
+#ifdef VERTEXPACKER_X86
+            static const Kernel kernel = (PixelDecoder::instructionSet() != PixelDecoder::SCALAR) ? packSSE2 : packScalar;
+#else
+            static const Kernel kernel = packScalar;
+#endif
+            kernel(src, dst, count);
+        }
+
+        void unpack(const ModelInfo::VertexVNPacked & src, ModelInfo::VertexVN & dst) {
+            dst.x = std::max(src.x / SNORM16_MAX, -1.0f);
+            dst.y = std::max(src.y / SNORM16_MAX, -1.0f);
+            dst.z = std::max(src.z / SNORM16_MAX, -1.0f);
+
+            GLfloat ox = std::max(src.nx / SNORM16_MAX, -1.0f);
+            GLfloat oy = std::max(src.ny / SNORM16_MAX, -1.0f);
+
+            GLfloat nz = 1.0f - std::fabs(ox) - std::fabs(oy);
+            GLfloat fold = std::max(- nz, 0.0f);
+
+            GLfloat nx = ox + (ox >= 0.0f ? - fold : fold);
+            GLfloat ny = oy + (oy >= 0.0f ? - fold : fold);
+
+            GLfloat length = std::sqrt(nx * nx + ny * ny + nz * nz);
+
+            dst.nx = nx / length;
+            dst.ny = ny / length;
+            dst.nz = nz / length;
+        }
+    }
+}
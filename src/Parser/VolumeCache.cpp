@@ -0,0 +1,352 @@
+#include <QtCore/QFile>
+#include <QtCore/QFileInfo>
+#include <QtCore/QDir>
+#include <QtCore/QDateTime>
+#include <QtCore/QSaveFile>
+#include <QtCore/QStandardPaths>
+#include <QtCore/QCryptographicHash>
+
+#include <cstddef>
+
+#include "Parser/VolumeCache.h"
+
+#define CACHE_MAGIC "VISVOLUM"
+#define CACHE_VERSION 1
+
+// data starts on its own page, so the mapped volume is page aligned
+#define CACHE_HEADER_SIZE 4096
+
+// bytes taken from head, middle and tail of sampled files, the head of every file covers its header
+#define CACHE_SAMPLE_SIZE 4096
+
+// bytes written at once, canceled loads are noticed in between
+#define CACHE_WRITE_CHUNK (64 << 20)
+
+// MiB all cached volumes may take together by default
+#define CACHE_SIZE_LIMIT 4096
+
+namespace Parser {
+    namespace VolumeCache {
+        class CacheHeader {
+        public:
+            char magic[8];
+
+            quint32 version;
+            quint32 headerSize;
+
+            quint64 width;
+            quint64 height;
+            quint64 depth;
+
+            quint64 dataSize;
+
+            qint32 neighbourRadius;
+
+            float spacingX;
+            float spacingY;
+            float spacingZ;
+
+            float slope;
+            float intercept;
+
+            qint32 windowCenter;
+            qint32 windowWidth;
+
+            qint32 minValue;
+            qint32 maxValue;
+
+            qint32 minHUPossible;
+            qint32 maxHUPossible;
+
+            qint32 minHU;
+            qint32 maxHU;
+
+            qint32 alignment;
+            qint32 rowLength;
+
+            // msecs since epoch the volume was stored or loaded last, the least recently used ones are evicted first
+            qint64 lastUsed;
+        };
+
+        static quint64 cacheSizeLimit = (quint64) CACHE_SIZE_LIMIT << 20;
+
+        quint64 sizeLimit() {
+            return cacheSizeLimit;
+        }
+
+        void setSizeLimit(const quint64 & bytes) {
+            cacheSizeLimit = bytes;
+        }
+
+        static QString cacheDir() {
+            return QStandardPaths::writableLocation(QStandardPaths::CacheLocation) + "/volumes";
+        }
+
+        static QString cacheFileName(const QString & key) {
+            return cacheDir() + "/" + key + ".volume";
+        }
+
+        static quint64 mergedSize(const DicomData & dicomData) {
+            return sizeof(quint16) * dicomData.width * dicomData.height * (dicomData.depth - 2 * dicomData.neighbourRadius);
+        }
+
+        // head of the file only, or head, middle and tail of it
+        static void addSamples(QCryptographicHash & hash, const QString & fileName, const bool & headOnly = false) {
+            QFile file(fileName);
+
+            if (!file.open(QIODevice::ReadOnly)) {
+                return;
+            }
+
+            qint64 size = file.size();
+
+            if (headOnly) {
+                hash.addData(file.read(CACHE_SAMPLE_SIZE));
+                return;
+            }
+
+            for (qint64 offset : { (qint64) 0, size / 2, size - CACHE_SAMPLE_SIZE }) {
+                if (file.seek(std::max((qint64) 0, offset))) {
+                    hash.addData(file.read(CACHE_SAMPLE_SIZE));
+                }
+            }
+        }
+
+        QString key(const QString & seriesUID, const QStringList & fileNames, const int & neighbourRadius,
+                    const VolumeRegion & region) {
+            QCryptographicHash hash(QCryptographicHash::Sha1);
+
+            hash.addData(seriesUID.toUtf8());
+            hash.addData(QByteArray::number(neighbourRadius));
+            hash.addData(QByteArray::number(CACHE_VERSION));
+
+            // whole volume keeps the key it always had
+            if (!region.isFull()) {
+                for (int axis = 0; axis != 3; ++ axis) {
+                    hash.addData(QByteArray::number((quint64) region.origin[axis]) + "," +
+                                 QByteArray::number((quint64) region.size[axis]) + "," +
+                                 QByteArray::number((quint64) region.stride[axis]) + ";");
+                }
+            }
+
+            for (const QString & fileName : fileNames) {
+                QFileInfo fileInfo(fileName);
+
+                hash.addData(fileInfo.absoluteFilePath().toUtf8());
+                hash.addData(QByteArray::number(fileInfo.size()));
+                hash.addData(QByteArray::number(fileInfo.lastModified().toMSecsSinceEpoch()));
+
+                addSamples(hash, fileName, true);
+            }
+
+            if (!fileNames.isEmpty()) {
+                addSamples(hash, fileNames.first());
+                addSamples(hash, fileNames.at(fileNames.size() / 2));
+                addSamples(hash, fileNames.last());
+            }
+
+            return QString::fromLatin1(hash.result().toHex());
+        }
+
+        static void touch(const QString & fileName) {
+            QFile file(fileName);
+
+            qint64 lastUsed = QDateTime::currentMSecsSinceEpoch();
+
+            if (!file.open(QIODevice::ReadWrite) ||
+                !file.seek(offsetof(CacheHeader, lastUsed)) ||
+                file.write((const char *) &lastUsed, sizeof(lastUsed)) != sizeof(lastUsed)) {
+                qDebug() << "can't touch volume cache" << fileName;
+            }
+        }
+
+        // removes least recently used volumes, never the kept one, until the cache fits the size limit
+        static void evict(const QString & keptFileName) {
+            QFileInfoList fileInfos = QDir(cacheDir()).entryInfoList(QStringList("*.volume"), QDir::Files);
+
+            QList<QPair<qint64, QFileInfo> > lru;
+
+            quint64 cacheSize = 0;
+
+            for (const QFileInfo & fileInfo : fileInfos) {
+                cacheSize += fileInfo.size();
+
+                if (fileInfo.absoluteFilePath() == QFileInfo(keptFileName).absoluteFilePath()) {
+                    continue;
+                }
+
+                CacheHeader header;
+                memset(&header, 0, sizeof(CacheHeader));
+
+                QFile file(fileInfo.absoluteFilePath());
+
+                // volumes of no use can't be told apart from old ones
+                if (!file.open(QIODevice::ReadOnly) || file.read((char *) &header, sizeof(CacheHeader)) != sizeof(CacheHeader)) {
+                    header.lastUsed = 0;
+                }
+
+                lru.append(qMakePair(std::max(header.lastUsed, fileInfo.lastModified().toMSecsSinceEpoch()), fileInfo));
+            }
+
+            std::sort(lru.begin(), lru.end(), [](const QPair<qint64, QFileInfo> & a, const QPair<qint64, QFileInfo> & b) {
+                return a.first < b.first;
+            });
+
+            for (int i = 0; i != lru.size() && cacheSize > cacheSizeLimit; ++ i) {
+                // volumes still mapped can't be removed on some systems, they get their turn next time
+                if (QFile::remove(lru.at(i).second.absoluteFilePath())) {
+                    cacheSize -= lru.at(i).second.size();
+
+                    qDebug() << "volume cache evicted" << lru.at(i).second.fileName();
+                }
+            }
+        }
+
+        bool load(const QString & key, DicomData & dicomData,
+                  TextureInfo::MergedDataPointer & mergedData, QOpenGLPixelTransferOptions & pixelTransferOptions) {
+            QSharedPointer<QFile> file(new QFile(cacheFileName(key)));
+
+            if (!file->open(QIODevice::ReadOnly) || file->size() < CACHE_HEADER_SIZE) {
+                return false;
+            }
+
+            CacheHeader header;
+
+            if (file->read((char *) &header, sizeof(CacheHeader)) != sizeof(CacheHeader) ||
+                memcmp(header.magic, CACHE_MAGIC, sizeof(header.magic)) ||
+                header.version != CACHE_VERSION ||
+                header.headerSize != CACHE_HEADER_SIZE ||
+                (quint64) file->size() != CACHE_HEADER_SIZE + header.dataSize) {
+                qDebug() << "stale volume cache" << file->fileName();
+                return false;
+            }
+
+            uchar * mapped = file->map(0, file->size());
+
+            if (!mapped) {
+                return false;
+            }
+
+            touch(file->fileName());
+
+            // mapping lives as long as somebody (the texture, at least) holds the data
+            mergedData = TextureInfo::MergedDataPointer(mapped + CACHE_HEADER_SIZE, [file, mapped](TextureInfo::MergedDataPtr) {
+                file->unmap(mapped);
+            });
+
+            dicomData.width = header.width;
+            dicomData.height = header.height;
+            dicomData.depth = header.depth;
+
+            dicomData.neighbourRadius = header.neighbourRadius;
+
+            dicomData.imageSpacings = QVector3D(header.spacingX, header.spacingY, header.spacingZ);
+
+            dicomData.slope = header.slope;
+            dicomData.intercept = header.intercept;
+
+            dicomData.windowCenter = header.windowCenter;
+            dicomData.windowWidth = header.windowWidth;
+
+            dicomData.minValue = header.minValue;
+            dicomData.maxValue = header.maxValue;
+
+            dicomData.minHUPossible = header.minHUPossible;
+            dicomData.maxHUPossible = header.maxHUPossible;
+
+            dicomData.minHU = header.minHU;
+            dicomData.maxHU = header.maxHU;
+
+            dicomData.buffer = nullptr;
+            std::vector<char>().swap(dicomData.vbuffer);
+
+            pixelTransferOptions.setAlignment(header.alignment);
+            pixelTransferOptions.setRowLength(header.rowLength);
+
+            return true;
+        }
+
+        bool store(const QString & key, const DicomData & dicomData,
+                   const TextureInfo::MergedDataPointer & mergedData, const QOpenGLPixelTransferOptions & pixelTransferOptions,
+                   const QAtomicInt * canceled) {
+            if (!mergedData || !QDir().mkpath(cacheDir())) {
+                return false;
+            }
+
+            CacheHeader header;
+            memset(&header, 0, sizeof(CacheHeader));
+
+            memcpy(header.magic, CACHE_MAGIC, sizeof(header.magic));
+
+            header.version = CACHE_VERSION;
+            header.headerSize = CACHE_HEADER_SIZE;
+
+            header.width = dicomData.width;
+            header.height = dicomData.height;
+            header.depth = dicomData.depth;
+
+            header.dataSize = mergedSize(dicomData);
+
+            header.neighbourRadius = dicomData.neighbourRadius;
+
+            header.spacingX = dicomData.imageSpacings.x();
+            header.spacingY = dicomData.imageSpacings.y();
+            header.spacingZ = dicomData.imageSpacings.z();
+
+            header.slope = dicomData.slope;
+            header.intercept = dicomData.intercept;
+
+            header.windowCenter = dicomData.windowCenter;
+            header.windowWidth = dicomData.windowWidth;
+
+            header.minValue = dicomData.minValue;
+            header.maxValue = dicomData.maxValue;
+
+            header.minHUPossible = dicomData.minHUPossible;
+            header.maxHUPossible = dicomData.maxHUPossible;
+
+            header.minHU = dicomData.minHU;
+            header.maxHU = dicomData.maxHU;
+
+            header.alignment = pixelTransferOptions.alignment();
+            header.rowLength = pixelTransferOptions.rowLength();
+
+            header.lastUsed = QDateTime::currentMSecsSinceEpoch();
+
+            QByteArray headerPage(CACHE_HEADER_SIZE, 0);
+            memcpy(headerPage.data(), &header, sizeof(CacheHeader));
+
+            // readers never see half-written volume, it's renamed into place on commit
+            QSaveFile file(cacheFileName(key));
+
+            if (!file.open(QIODevice::WriteOnly) || file.write(headerPage) != CACHE_HEADER_SIZE) {
+                qDebug() << "can't write volume cache" << file.fileName();
+                file.cancelWriting();
+                return false;
+            }
+
+            for (quint64 written = 0; written < header.dataSize; written += CACHE_WRITE_CHUNK) {
+                if (canceled && canceled->load()) {
+                    file.cancelWriting();
+                    return false;
+                }
+
+                qint64 chunkSize = (qint64) std::min((quint64) CACHE_WRITE_CHUNK, header.dataSize - written);
+
+                if (file.write((const char *) mergedData.data() + written, chunkSize) != chunkSize) {
+                    qDebug() << "can't write volume cache" << file.fileName();
+                    file.cancelWriting();
+                    return false;
+                }
+            }
+
+            if (!file.commit()) {
+                return false;
+            }
+
+            evict(file.fileName());
+
+            return true;
+        }
+    }
+}
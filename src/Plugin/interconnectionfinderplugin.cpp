@@ -11,9 +11,7 @@ namespace Plugin {
 
         queue = clCreateCommandQueue(context, device_id, 0, nullptr);
 
-        program = CLInfo::createProgram(context, source());
-
-        qDebug() << "Building OpenCL Program, error: " << clBuildProgram(program, 1, &device_id, nullptr, nullptr, nullptr);
+        program = CLInfo::buildProgram(context, device_id, source());
 /*
         _gauss1dKernel = clCreateKernel(_programReconstruction, "gauss1d", nullptr);
         _calcTablesKernel = clCreateKernel(_programReconstruction, "calcTables", nullptr);
@@ -34,6 +34,8 @@ namespace Scene {
             unpackBlueprint(_blueprints.dequeue());
         }
 
+        updateTextures();
+
         for (Model::AbstractModel * model : _models.list()) {
             if (model->updateNeeded()) {
                 model->update();
@@ -41,6 +43,41 @@ namespace Scene {
         }
     }
 
+    void ModelScene::updateTextures() {
+        _textureUpdatesMutex.lock();
+
+        QQueue<QVariantMap> textureUpdates;
+        textureUpdates.swap(_textureUpdates);
+
+        _textureUpdatesMutex.unlock();
+
+        for (const QVariantMap & textureUpdate : textureUpdates) {
+            ObjectID textureID = textureUpdate["texture"].value<ObjectID>();
+
+            Texture * texture = nullptr;
+
+            // the same id can be reused by volumes loaded later, the latest one is being streamed
+            for (Texture * sceneTexture : textures.list()) {
+                if (sceneTexture->id() == textureID) {
+                    texture = sceneTexture;
+                }
+            }
+
+            if (!texture) {
+                continue;
+            }
+
+            // mipmaps are built once, when the last slice is there
+            if (textureUpdate["action"] == "finishTexture") {
+                texture->finishSlices();
+                continue;
+            }
+
+            texture->setSlices(textureUpdate["descriptor"].value<TextureInfo::TextureInfo>(),
+                               textureUpdate["firstSlice"].toInt(), textureUpdate["sliceCount"].toInt());
+        }
+    }
+
     void ModelScene::renderScene(const QSize & surfaceSize) {
         viewportArray()->resize(surfaceSize);
 
@@ -208,6 +245,13 @@ namespace Scene {
                 return;
             }
 
+            if (message.data["action"] == "updateTexture" || message.data["action"] == "finishTexture") {
+                QMutexLocker locker(&_textureUpdatesMutex);
+
+                _textureUpdates.enqueue(message.data);
+                return;
+            }
+
             return;
         }
 
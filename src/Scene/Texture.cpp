@@ -1,8 +1,77 @@
+#include <QtGui/QOpenGLContext>
+#include <QtGui/QOpenGLFunctions>
+
 #include "Scene/Texture.h"
 
 static uint textureCount = 0;
 
 namespace Scene {
+    typedef void (QOPENGLF_APIENTRYP TexSubImage3D)(GLenum target, GLint level, GLint xoffset, GLint yoffset, GLint zoffset,
+                                                    GLsizei width, GLsizei height, GLsizei depth,
+                                                    GLenum format, GLenum type, const GLvoid * pixels);
+
+    static size_t texelSize(const TextureInfo::TextureInfo & textureInfo) {
+        size_t components = 1;
+
+        switch (textureInfo.pixelFormat) {
+        case QOpenGLTexture::RG:
+        case QOpenGLTexture::RG_Integer:
+            components = 2;
+            break;
+        case QOpenGLTexture::RGB:
+        case QOpenGLTexture::BGR:
+        case QOpenGLTexture::RGB_Integer:
+        case QOpenGLTexture::BGR_Integer:
+            components = 3;
+            break;
+        case QOpenGLTexture::RGBA:
+        case QOpenGLTexture::BGRA:
+        case QOpenGLTexture::RGBA_Integer:
+        case QOpenGLTexture::BGRA_Integer:
+            components = 4;
+            break;
+        default:
+            break;
+        }
+
+        switch (textureInfo.pixelType) {
+        case QOpenGLTexture::Int16:
+        case QOpenGLTexture::UInt16:
+        case QOpenGLTexture::Float16:
+            return 2 * components;
+        case QOpenGLTexture::Int32:
+        case QOpenGLTexture::UInt32:
+        case QOpenGLTexture::Float32:
+            return 4 * components;
+        default:
+            return components;
+        }
+    }
+
+    // QOpenGLTexture has no sub-image uploads, glTexSubImage3D isn't part of gl 1.1 headers either
+    static void texSubImage3D(QOpenGLTexture * texture, const TextureInfo::TextureInfo & textureInfo,
+                              const int & firstSlice, const int & sliceCount, const void * data) {
+        static TexSubImage3D glTexSubImage3DPtr = (TexSubImage3D) QOpenGLContext::currentContext()->getProcAddress("glTexSubImage3D");
+
+        if (!glTexSubImage3DPtr) {
+            qDebug() << "glTexSubImage3D is not available";
+            return;
+        }
+
+        texture->bind();
+
+        glPixelStorei(GL_UNPACK_ALIGNMENT, textureInfo.pixelTransferOptions.alignment());
+        glPixelStorei(GL_UNPACK_ROW_LENGTH, textureInfo.pixelTransferOptions.rowLength());
+
+        glTexSubImage3DPtr(texture->target(), 0, 0, 0, firstSlice,
+                           texture->width(), texture->height(), sliceCount,
+                           textureInfo.pixelFormat, textureInfo.pixelType, data);
+
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+        glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+
+        texture->release();
+    }
     QStringList Texture::initializationOrder = { "sampler" };
 
     Texture::Texture() :
@@ -28,13 +97,48 @@ namespace Scene {
 
         _texture->allocateStorage();
 
-        _texture->setMinMagFilters(QOpenGLTexture::NearestMipMapNearest, QOpenGLTexture::Nearest);
         _texture->setWrapMode(QOpenGLTexture::ClampToBorder);
 
-        _texture->setData(textureInfo.pixelFormat, textureInfo.pixelType,
-                         (void *) textureInfo.mergedData.data(), &(textureInfo.pixelTransferOptions));
+        if (textureInfo.mergedData) {
+            _texture->setData(textureInfo.pixelFormat, textureInfo.pixelType,
+                             (void *) textureInfo.mergedData.data(), &(textureInfo.pixelTransferOptions));
 
+            finishSlices();
+        }
+        else {
+            // streamed slices are sampled from the base level, mipmaps of a half-uploaded volume would be rebuilt every batch
+            _texture->setMinMagFilters(QOpenGLTexture::Nearest, QOpenGLTexture::Nearest);
+
+            // data is going to come in slices, until then the volume is empty rather than undefined
+            std::vector<char> zeroSlice(texelSize(textureInfo) * _texture->width() * _texture->height(), 0);
+
+            TextureInfo::TextureInfo zeroInfo = textureInfo;
+            zeroInfo.pixelTransferOptions = QOpenGLPixelTransferOptions();
+            zeroInfo.pixelTransferOptions.setAlignment(1);
+
+            for (int i = 0; i != _texture->depth(); ++ i) {
+                texSubImage3D(_texture, zeroInfo, i, 1, &(zeroSlice[0]));
+            }
+        }
+    }
+
+    void Texture::setSlices(const TextureInfo::TextureInfo & textureInfo, const int & firstSlice, const int & sliceCount) {
+        const TextureInfo::MergedData * data = textureInfo.mergedData.data();
+
+        if (!data) {
+            return;
+        }
+
+        size_t rowLength = textureInfo.pixelTransferOptions.rowLength() ?
+                    textureInfo.pixelTransferOptions.rowLength() : _texture->width();
+        size_t sliceSize = texelSize(textureInfo) * rowLength * _texture->height();
+
+        texSubImage3D(_texture, textureInfo, firstSlice, sliceCount, data + sliceSize * firstSlice);
+    }
+
+    void Texture::finishSlices() {
         _texture->generateMipMaps();
+        _texture->setMinMagFilters(QOpenGLTexture::NearestMipMapNearest, QOpenGLTexture::Nearest);
     }
 
     Texture::~Texture() {
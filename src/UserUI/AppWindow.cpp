@@ -3,6 +3,7 @@
 #include "UserUI/ConsoleLogger.h"
 
 #include "Parser/DicomReader.h"
+#include "Parser/DicomIndex.h"
 #include "Parser/StlReader.h"
 #include "Parser/Reconstructor.h"
 
@@ -53,6 +54,7 @@ namespace UserUI {
         qmlRegisterType<Viewport::Viewport>("RenderTools", 1, 0, "Viewport");
 
         qmlRegisterType<Parser::DicomReader>("ParserTools", 1, 0, "DicomReader");
+        qmlRegisterType<Parser::DicomIndex>("ParserTools", 1, 0, "DicomIndex");
         qmlRegisterType<Parser::StlReader>("ParserTools", 1, 0, "StlReader");
         qmlRegisterType<Parser::Reconstructor>("ParserTools", 1, 0, "Reconstructor");
 
@@ -4,6 +4,10 @@
 
 #include "UserUI/AppWindow.h"
 
+#include "Info/CLInfo.h"
+
+#include "Parser/VolumeCache.h"
+
 int main(int argc, char * argv[]) {
     QGuiApplication a(argc, argv);
     QGuiApplication::setApplicationVersion("visualizer");
@@ -24,11 +28,38 @@ int main(int argc, char * argv[]) {
                                                      QGuiApplication::translate("main", (std::string("Specify port for network (default is ")
                                                                                 + std::to_string(DEFAULT_PORT) + std::string(").")).c_str()),
                                                      QGuiApplication::tr("number", "port"), QString::number(DEFAULT_PORT)));
+    QCommandLineOption deviceOption(QCommandLineOption(QStringList() << "d" << "device",
+                                                       QGuiApplication::translate("main", "Device for slice reconstruction: gpu, cpu (OpenCL) or native (default is gpu)."),
+                                                       QGuiApplication::tr("device", "device"), "gpu"));
+    QCommandLineOption memoryOption(QCommandLineOption(QStringList() << "m" << "memory",
+                                                       QGuiApplication::translate("main", "Memory budget of slice reconstruction in MiB (default is half of the device)."),
+                                                       QGuiApplication::tr("MiB", "memory"), "0"));
+    QCommandLineOption clOptionsOption(QCommandLineOption(QStringList() << "cl-options",
+                                                          QGuiApplication::translate("main", "Build options of OpenCL programs, binaries are cached per device and options."),
+                                                          QGuiApplication::tr("options", "cl-options"), ""));
+    QCommandLineOption autotuneOption(QStringList() << "autotune",
+                                      QGuiApplication::translate("main", "Benchmark work-group sizes of the reconstruction kernels and store them for this device."));
+    QCommandLineOption cacheSizeOption(QCommandLineOption(QStringList() << "cache-size",
+                                                          QGuiApplication::translate("main", (std::string("Size limit of processed volumes cache in MiB (default is ")
+                                                                                     + std::to_string(Parser::VolumeCache::sizeLimit() >> 20) + std::string(").")).c_str()),
+                                                          QGuiApplication::tr("MiB", "cache-size"), QString::number(Parser::VolumeCache::sizeLimit() >> 20)));
     parser.addOption(hostOption);
     parser.addOption(portOption);
+    parser.addOption(deviceOption);
+    parser.addOption(memoryOption);
+    parser.addOption(clOptionsOption);
+    parser.addOption(autotuneOption);
+    parser.addOption(cacheSizeOption);
 
     parser.process(a);
 
+    CLInfo::setDevice(CLInfo::deviceFromName(parser.value(deviceOption)));
+    CLInfo::setMemoryBudget((size_t) parser.value(memoryOption).toULongLong() << 20);
+    CLInfo::setBuildOptions(parser.value(clOptionsOption));
+    CLInfo::setAutotuning(parser.isSet(autotuneOption));
+
+    Parser::VolumeCache::setSizeLimit(parser.value(cacheSizeOption).toULongLong() << 20);
+
     UserUI::AppWindow appWindow("qrc:/qml/MainWindow.qml",
                                 QString::fromStdString(parser.value(hostOption).toStdString()),
                                 parser.value(portOption).toInt()
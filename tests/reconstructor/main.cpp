@@ -0,0 +1,82 @@
+#include <cstdlib>
+#include <vector>
+
+#include "Parser/Reconstructor.h"
+
+#include "Info/CLInfo.h"
+
+#include "phantoms.h"
+
+// small enough to run on any opencl device within a second
+#define PHANTOM_WIDTH 64
+#define PHANTOM_ROWS 8
+
+// relative to the largest native value, both paths round their own way but run the same stages
+#define RECONSTRUCTION_TOLERANCE 1e-2
+
+// on any platform, the reconstructor takes the first one that has it
+static bool hasDevice(const cl_device_type & deviceType) {
+    cl_uint platformCount = 0;
+
+    clGetPlatformIDs(0, nullptr, &platformCount);
+
+    std::vector<cl_platform_id> platforms(platformCount);
+
+    if (!platformCount || clGetPlatformIDs(platformCount, platforms.data(), nullptr) != CL_SUCCESS) {
+        return false;
+    }
+
+    for (cl_platform_id platform : platforms) {
+        cl_uint deviceCount = 0;
+
+        if (clGetDeviceIDs(platform, deviceType, 0, nullptr, &deviceCount) == CL_SUCCESS && deviceCount) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+int main() {
+    const QVector<cv::Mat> projections = Benchmark::phantomProjections(PHANTOM_WIDTH, PHANTOM_ROWS);
+
+    QVector<cv::Mat> nativeSlices;
+
+    CLInfo::setDevice(CLInfo::NATIVE);
+
+    Parser::Reconstructor reconstructor;
+
+    if (reconstructor.reconstructSlices(projections, nativeSlices) || nativeSlices.size() != PHANTOM_ROWS ||
+            !cv::norm(nativeSlices.at(0), cv::NORM_INF)) {
+        qDebug() << "Native reconstruction" << "INVALID";
+        return EXIT_FAILURE;
+    }
+
+    // a gpu if there's one, pocl and the like otherwise
+    CLInfo::Device device = hasDevice(CL_DEVICE_TYPE_GPU) ? CLInfo::GPU : CLInfo::CPU;
+
+    if (!hasDevice(CLInfo::deviceType(device))) {
+        qDebug() << "No OpenCL device, the OpenCL reconstruction is skipped";
+        return EXIT_SUCCESS;
+    }
+
+    CLInfo::setDevice(device);
+
+    Parser::Reconstructor reconstructorOCL;
+
+    QVector<cv::Mat> slices;
+
+    // the native path stepped in, the opencl one failed on a device it should run on
+    if (!reconstructorOCL.reconstructSlices(projections, slices) || slices.size() != nativeSlices.size()) {
+        qDebug() << "OpenCL reconstruction" << "INVALID";
+        return EXIT_FAILURE;
+    }
+
+    const double error = Benchmark::relativeError(slices, nativeSlices);
+
+    const bool equal = error <= RECONSTRUCTION_TOLERANCE;
+
+    qDebug() << "OpenCL against native, relative error:" << error << (equal ? "ok" : "MISMATCH");
+
+    return equal ? EXIT_SUCCESS : EXIT_FAILURE;
+}
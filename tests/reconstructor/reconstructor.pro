@@ -0,0 +1,22 @@
+include(../tests.pri)
+
+QT += gui quick
+
+TARGET = reconstructor
+
+SOURCES += main.cpp \
+           $$PWD/../../src/Parser/Reconstructor.cpp \
+           $$PWD/../../src/Parser/AbstractParser.cpp \
+           $$PWD/../../src/Message/AbstractMessage.cpp \
+           $$PWD/../../src/Message/SettingsMessage.cpp \
+           $$PWD/../../src/Info/CLInfo.cpp
+
+HEADERS += $$PWD/../../include/Parser/Reconstructor.h \
+           $$PWD/../../include/Parser/AbstractParser.h \
+           $$PWD/../../include/Parser/parallelprocessing.hpp \
+           $$PWD/../../include/Message/AbstractMessage.h \
+           $$PWD/../../include/Message/SettingsMessage.h \
+           $$PWD/../../include/Info/CLInfo.h
+
+# cl/reconstructor.cl is built from the resources
+RESOURCES += $$PWD/../../resources.qrc
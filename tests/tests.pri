@@ -0,0 +1,48 @@
+TEMPLATE = app
+
+CONFIG += console c++11
+CONFIG -= app_bundle
+
+# synthetic data is shared with the benchmarks
+INCLUDEPATH += $$PWD/../include \
+               $$PWD/../bench
+
+HEADERS += $$PWD/../bench/phantoms.h
+
+unix:macx {
+    INCLUDEPATH += /usr/local/include
+
+    LIBS += -L/usr/local/lib -lopencv_core \
+                            -lopencv_imgproc \
+                            -lopencv_highgui
+
+    LIBS += -framework OpenCL
+}
+
+unix:!macx {
+    LIBS += -lopencv_core \
+            -lopencv_imgproc \
+            -lopencv_highgui
+
+    LIBS += -lOpenCL
+}
+
+win32 {
+    INCLUDEPATH += "C:\opencv\build\include" \
+                   "C:\Program Files (x86)\AMD APP SDK\2.9-1\include"
+
+    !contains(QMAKE_HOST.arch, x86_64) {
+        LIBS += -L"C:\opencv\build\x86\vc12\lib" \
+                -L"C:\Program Files (x86)\AMD APP SDK\2.9-1\lib\x86"
+    }
+    else {
+        LIBS += -L"C:\opencv\build\x64\vc12\lib" \
+                -L"C:\Program Files (x86)\AMD APP SDK\2.9-1\lib\x86_64"
+    }
+
+    LIBS += -lopencv_core249 \
+            -lopencv_highgui249 \
+            -lopencv_imgproc249
+
+    LIBS += -lOpenCL
+}
@@ -0,0 +1,10 @@
+#-------------------------------------------------
+#
+# Tests of the parser, built apart from the application:
+#   qmake tests/tests.pro && make && ./reconstructor/reconstructor
+#
+#-------------------------------------------------
+
+TEMPLATE = subdirs
+
+SUBDIRS += reconstructor
@@ -89,10 +89,16 @@ SOURCES +=  src/main.cpp \
             src/Parser/DicomReader.cpp \
             src/Parser/Reconstructor.cpp \
             src/Parser/StlReader.cpp \
+            src/Parser/PixelDecoder.cpp \
+            src/Parser/VertexPacker.cpp \
+            src/Parser/VolumeCache.cpp \
+            src/Parser/SeriesIndex.cpp \
+            src/Parser/DicomIndex.cpp \
             src/Render/AbstractRenderer.cpp \
             src/Render/ModelRenderer.cpp \
             src/Model/AbstractModel.cpp \
             src/Model/StlModel.cpp \
+            src/Model/TriangleBvh.cpp \
             src/Scene/ModelScene.cpp \
             src/Model/PointsModel.cpp \
             src/Model/AbstractModelWithPoints.cpp \
@@ -126,9 +132,24 @@ HEADERS  += include/UserUI/AppWindow.h \
             include/UserUI/ModelViewer.h \
             include/Parser/ctprocessing.hpp \
             include/Parser/parallelprocessing.hpp \
+            include/Parser/hartleyprocessing.hpp \
+            include/Parser/gaussprocessing.hpp \
+            include/Parser/seriesprocessing.hpp \
+            include/Parser/frameprocessing.hpp \
+            include/Parser/regionprocessing.hpp \
+            include/Parser/stlprocessing.hpp \
+            include/Parser/meshprocessing.hpp \
+            include/Parser/lodprocessing.hpp \
+            include/Parser/cacheprocessing.hpp \
+            include/Parser/bvhprocessing.hpp \
             include/Parser/DicomReader.h \
             include/Parser/Reconstructor.h \
             include/Parser/StlReader.h \
+            include/Parser/PixelDecoder.h \
+            include/Parser/VertexPacker.h \
+            include/Parser/VolumeCache.h \
+            include/Parser/SeriesIndex.h \
+            include/Parser/DicomIndex.h \
             include/Render/AbstractRenderer.h \
             include/Render/ModelRenderer.h \
             include/Model/AbstractModel.h \
@@ -151,6 +172,8 @@ HEADERS  += include/UserUI/AppWindow.h \
             include/UserUI/ConsoleLogger.h \
             include/Model/VertexVC.h \
             include/Model/VertexVN.h \
+            include/Model/VertexVNPacked.h \
+            include/Model/TriangleBvh.h \
             include/Model/VertexVT.h \
             include/Info/ViewRangeInfo.h \
             include/Model/EvaluatorModel.h \